@@ -3,8 +3,8 @@ if(TARGET renderer_interface)
 endif()
 add_library(renderer_interface INTERFACE)
 
-set(SE_SVG OFF)
-set(SE_BITMAP OFF)
+include("${CMAKE_CURRENT_SOURCE_DIR}/cmake/deps/add_dependency.cmake")
+se_add_dependency(renderer_interface stb_truetype)
 
 set(SE_WINDOWING_VALID_OPTIONS "headless")
 
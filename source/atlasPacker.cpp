@@ -0,0 +1,163 @@
+#include "atlasPacker.hpp"
+#include <algorithm>
+#include <climits>
+
+AtlasPacker::AtlasPacker(int pageWidth, int pageHeight, int maxPages)
+    : pageWidth(pageWidth), pageHeight(pageHeight), maxPages(maxPages) {
+}
+
+void AtlasPacker::resetPage(Page &page) {
+    page.skyline.assign(1, {0, 0, pageWidth});
+    page.liveArea = 0;
+    page.usedArea = 0;
+    page.liveCount = 0;
+}
+
+bool AtlasPacker::fragmented(const Page &page) const {
+    return page.liveCount > 0 && page.liveArea * 2 < page.usedArea;
+}
+
+std::optional<AtlasPacker::Rect> AtlasPacker::place(Page &page, int w, int h) {
+    // find the lowest spot (then the leftmost) where the rectangle rests on the skyline
+    size_t best = SIZE_MAX;
+    int bestX = 0;
+    int bestY = INT_MAX;
+    for (size_t i = 0; i < page.skyline.size(); i++) {
+        const int x = page.skyline[i].x;
+        if (x + w > pageWidth) break;
+
+        int y = 0;
+        int covered = 0;
+        for (size_t j = i; covered < w; j++) {
+            y = std::max(y, page.skyline[j].y);
+            covered = page.skyline[j].x + page.skyline[j].w - x;
+        }
+        if (y + h > pageHeight || y >= bestY) continue;
+        best = i;
+        bestX = x;
+        bestY = y;
+    }
+    if (best == SIZE_MAX) return std::nullopt;
+
+    // raise the skyline under the new rectangle
+    std::vector<Segment> &skyline = page.skyline;
+    skyline.insert(skyline.begin() + best, {bestX, bestY + h, w});
+    const int right = bestX + w;
+    size_t next = best + 1;
+    while (next < skyline.size() && skyline[next].x < right) {
+        const int end = skyline[next].x + skyline[next].w;
+        if (end <= right) {
+            skyline.erase(skyline.begin() + next);
+        } else {
+            skyline[next].w = end - right;
+            skyline[next].x = right;
+            break;
+        }
+    }
+    for (size_t i = 0; i + 1 < skyline.size();) {
+        if (skyline[i].y == skyline[i + 1].y) {
+            skyline[i].w += skyline[i + 1].w;
+            skyline.erase(skyline.begin() + i + 1);
+        } else {
+            i++;
+        }
+    }
+
+    const size_t area = static_cast<size_t>(w) * h;
+    page.liveArea += area;
+    page.usedArea += area;
+    page.liveCount++;
+    return Rect{bestX, bestY, w, h};
+}
+
+std::optional<AtlasPacker::Allocation> AtlasPacker::placeAnywhere(int w, int h) {
+    for (size_t i = 0; i < pages.size(); i++) {
+        if (auto rect = place(pages[i], w, h)) return Allocation{static_cast<int>(i), *rect};
+    }
+    if (maxPages > 0 && static_cast<int>(pages.size()) >= maxPages) return std::nullopt;
+
+    pages.emplace_back();
+    resetPage(pages.back());
+    auto rect = place(pages.back(), w, h);
+    if (!rect) {
+        pages.pop_back();
+        return std::nullopt;
+    }
+    return Allocation{static_cast<int>(pages.size() - 1), *rect};
+}
+
+std::optional<uint32_t> AtlasPacker::allocate(int w, int h) {
+    if (w <= 0 || h <= 0 || w > pageWidth || h > pageHeight) return std::nullopt;
+
+    auto allocation = placeAnywhere(w, h);
+    if (!allocation) return std::nullopt;
+
+    const uint32_t id = nextId++;
+    allocations[id] = *allocation;
+    return id;
+}
+
+void AtlasPacker::release(uint32_t id) {
+    auto it = allocations.find(id);
+    if (it == allocations.end()) return;
+
+    Page &page = pages[it->second.page];
+    page.liveArea -= static_cast<size_t>(it->second.rect.w) * it->second.rect.h;
+    page.liveCount--;
+    if (page.liveCount == 0) resetPage(page);
+    allocations.erase(it);
+    released = true;
+}
+
+const AtlasPacker::Allocation &AtlasPacker::get(uint32_t id) const {
+    return allocations.at(id);
+}
+
+bool AtlasPacker::needsRepack() const {
+    if (!released) return false;
+    for (const Page &page : pages) {
+        if (fragmented(page)) return true;
+    }
+    return false;
+}
+
+std::vector<AtlasPacker::Move> AtlasPacker::repack() {
+    released = false;
+
+    std::vector<bool> repacked(pages.size());
+    for (size_t i = 0; i < pages.size(); i++)
+        repacked[i] = fragmented(pages[i]);
+
+    std::vector<std::pair<uint32_t, Allocation>> moving;
+    for (const auto &[id, allocation] : allocations) {
+        if (repacked[allocation.page]) moving.emplace_back(id, allocation);
+    }
+    for (size_t i = 0; i < pages.size(); i++) {
+        if (repacked[i]) resetPage(pages[i]);
+    }
+
+    // tallest first packs a skyline best; ids break ties so the result doesn't depend on hash order
+    std::sort(moving.begin(), moving.end(), [](const auto &a, const auto &b) {
+        if (a.second.rect.h != b.second.rect.h) return a.second.rect.h > b.second.rect.h;
+        if (a.second.rect.w != b.second.rect.w) return a.second.rect.w > b.second.rect.w;
+        return a.first < b.first;
+    });
+
+    std::vector<Move> moves;
+    const int limit = maxPages;
+    maxPages = 0; // everything fit before, so it has to fit again even if it briefly takes another page
+    for (const auto &[id, from] : moving) {
+        const Allocation to = *placeAnywhere(from.rect.w, from.rect.h);
+        allocations[id] = to;
+        if (to.page != from.page || to.rect.x != from.rect.x || to.rect.y != from.rect.y) moves.push_back({id, from, to});
+    }
+    maxPages = limit;
+
+    while (!pages.empty() && pages.back().liveCount == 0)
+        pages.pop_back();
+    return moves;
+}
+
+float AtlasPacker::getOccupancy(int page) const {
+    return static_cast<float>(pages[page].liveArea) / (static_cast<float>(pageWidth) * pageHeight);
+}
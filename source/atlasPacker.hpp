@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Packs small rectangles (costume images) into fixed-size atlas pages with a bottom-left skyline, so renderers can
+ * draw many of them from one texture.
+ *
+ * Only does the bookkeeping: which page and where each rectangle lives. The renderer owns the page textures and copies
+ * pixels around when `repack` moves something. Nothing here touches a graphics API.
+ */
+class AtlasPacker {
+  public:
+    struct Rect {
+        int x = 0;
+        int y = 0;
+        int w = 0;
+        int h = 0;
+    };
+
+    struct Allocation {
+        int page = -1;
+        Rect rect;
+    };
+
+    struct Move {
+        uint32_t id;
+        Allocation from;
+        Allocation to;
+    };
+
+    /**
+     * @param maxPages The most pages `allocate` may open. 0 means no limit.
+     */
+    AtlasPacker(int pageWidth, int pageHeight, int maxPages = 0);
+
+    /**
+     * Finds room for a `w`×`h` rectangle, opening a new page if none has any.
+     * @return An id to look the allocation up by, or nothing if it doesn't fit on a page or `maxPages` is reached.
+     */
+    std::optional<uint32_t> allocate(int w, int h);
+
+    /**
+     * Frees the rectangle of `id`. A page whose last rectangle is released is emptied right away; other holes stay
+     * until `repack`.
+     */
+    void release(uint32_t id);
+
+    const Allocation &get(uint32_t id) const;
+
+    /**
+     * Whether releases since the last repack left at least one page less than half used.
+     */
+    bool needsRepack() const;
+
+    /**
+     * Packs the live rectangles of every page that is less than half used again, tallest first, and drops empty
+     * pages at the end.
+     * @return Every rectangle that moved, so the renderer can copy its pixels to the new spot.
+     */
+    std::vector<Move> repack();
+
+    int getPageWidth() const { return pageWidth; }
+    int getPageHeight() const { return pageHeight; }
+    size_t getPageCount() const { return pages.size(); }
+    size_t getAllocationCount() const { return allocations.size(); }
+
+    /**
+     * Fraction of the page covered by live rectangles.
+     */
+    float getOccupancy(int page) const;
+
+  private:
+    struct Segment {
+        int x;
+        int y;
+        int w;
+    };
+
+    struct Page {
+        std::vector<Segment> skyline;
+        size_t liveArea = 0;
+        size_t usedArea = 0; // area taken since the page was last emptied, freed or not
+        int liveCount = 0;
+    };
+
+    int pageWidth;
+    int pageHeight;
+    int maxPages;
+    uint32_t nextId = 0;
+    bool released = false;
+    std::vector<Page> pages;
+    std::unordered_map<uint32_t, Allocation> allocations;
+
+    void resetPage(Page &page);
+    bool fragmented(const Page &page) const;
+    std::optional<Rect> place(Page &page, int w, int h);
+    std::optional<Allocation> placeAnywhere(int w, int h);
+};
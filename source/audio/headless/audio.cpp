@@ -1,7 +1,13 @@
 #include <audio.hpp>
 #include <audiostack.hpp>
 
-bool SoundPlayer::init() { return false; }
+// There's no device to feed, so the mixer only runs when something calls Mixer::requestSound itself (--render-audio).
+bool SoundPlayer::init() {
+#ifdef ENABLE_AUDIO
+    return true;
+#endif
+    return false;
+}
 void SoundPlayer::deinit() {
 #ifdef ENABLE_AUDIO
     Mixer::cleanupAudio();
@@ -0,0 +1,179 @@
+#include "audioRender.hpp"
+#if defined(__PC__) && defined(ENABLE_AUDIO)
+
+#include <algorithm>
+#include <audiostack.hpp>
+#include <blockExecutor.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <log.hpp>
+#include <runtime.hpp>
+#include <timer.hpp>
+#include <vector>
+
+namespace AudioRender {
+
+struct Level {
+    float peak = 0.0f;
+    float rms = 0.0f;
+};
+
+// Peak and RMS of each window of interleaved stereo samples, as a fraction of full scale.
+static std::vector<Level> levels(const int16_t *samples, size_t frames, size_t windowFrames) {
+    std::vector<Level> out;
+    for (size_t start = 0; start < frames; start += windowFrames) {
+        const size_t end = std::min(frames, start + windowFrames);
+        Level level;
+        double sum = 0.0;
+        for (size_t i = start * 2; i < end * 2; i++) {
+            const float x = samples[i] / 32768.0f;
+            level.peak = std::max(level.peak, std::fabs(x));
+            sum += static_cast<double>(x) * x;
+        }
+        level.rms = static_cast<float>(std::sqrt(sum / ((end - start) * 2)));
+        out.push_back(level);
+    }
+    return out;
+}
+
+static bool writeWav(const std::string &path, const std::vector<int16_t> &samples) {
+    drwav_data_format format;
+    format.container = drwav_container_riff;
+    format.format = DR_WAVE_FORMAT_PCM;
+    format.channels = 2;
+    format.sampleRate = Mixer::rate;
+    format.bitsPerSample = 16;
+
+    drwav wav;
+    if (!drwav_init_file_write(&wav, path.c_str(), &format, nullptr)) {
+        Log::logError("Failed to open " + path + " for writing.");
+        return false;
+    }
+    const drwav_uint64 frames = samples.size() / 2;
+    const drwav_uint64 written = drwav_write_pcm_frames(&wav, frames, samples.data());
+    drwav_uninit(&wav);
+    if (written != frames) {
+        Log::logError("Failed to write " + path + ".");
+        return false;
+    }
+    return true;
+}
+
+static bool compareWithReference(const std::string &path, const std::vector<int16_t> &samples, const Options &options) {
+    unsigned int channels = 0;
+    unsigned int sampleRate = 0;
+    drwav_uint64 referenceFrames = 0;
+    drwav_int16 *reference = drwav_open_file_and_read_pcm_frames_s16(path.c_str(), &channels, &sampleRate, &referenceFrames, nullptr);
+    if (reference == nullptr) {
+        Log::logError("Failed to read reference " + path + ".");
+        return false;
+    }
+    if (channels != 2 || sampleRate != Mixer::rate) {
+        Log::logError("Reference " + path + " is " + std::to_string(channels) + " channels at " + std::to_string(sampleRate) + " Hz, expected 2 channels at " + std::to_string(Mixer::rate) + " Hz.");
+        drwav_free(reference, nullptr);
+        return false;
+    }
+
+    const size_t windowFrames = std::max<size_t>(1, static_cast<size_t>(Mixer::rate) * options.windowMs / 1000);
+    const std::vector<Level> expected = levels(reference, static_cast<size_t>(referenceFrames), windowFrames);
+    const std::vector<Level> actual = levels(samples.data(), samples.size() / 2, windowFrames);
+    drwav_free(reference, nullptr);
+
+    bool passed = true;
+    if (expected.size() != actual.size()) {
+        Log::logError("Length mismatch: expected " + std::to_string(referenceFrames) + " samples, got " + std::to_string(samples.size() / 2) + ".");
+        passed = false;
+    }
+
+    constexpr size_t maxReported = 20;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < std::min(expected.size(), actual.size()); i++) {
+        if (std::fabs(expected[i].peak - actual[i].peak) <= options.tolerance && std::fabs(expected[i].rms - actual[i].rms) <= options.tolerance) continue;
+
+        if (mismatches++ < maxReported) {
+            char line[160];
+            snprintf(line, sizeof(line), "  %.3fs: peak expected %.4f actual %.4f, rms expected %.4f actual %.4f",
+                     static_cast<double>(i * windowFrames) / Mixer::rate, expected[i].peak, actual[i].peak, expected[i].rms, actual[i].rms);
+            Log::logError(line);
+        }
+    }
+    if (mismatches > maxReported) Log::logError("  ...");
+    if (mismatches != 0) {
+        Log::logError("Level mismatch in " + std::to_string(mismatches) + " of " + std::to_string(actual.size()) + " windows.");
+        passed = false;
+    }
+    return passed;
+}
+
+int run(const Options &options) {
+    srand(options.seed);
+    Timer::setFixedClock(true);
+    Scratch::streamCostumes = false;
+
+    Scratch::initializeScratchProject();
+    ScriptThread monitorDisplayThread;
+
+    std::vector<int16_t> samples;
+    samples.reserve(static_cast<size_t>(options.frames) * (Mixer::rate / std::max(1, Scratch::FPS) + 1) * 2);
+
+    std::chrono::steady_clock::duration mixTime{};
+    bool stopped = false;
+    for (unsigned int frame = 1; frame <= options.frames; frame++) {
+        Timer::advanceFixedClock(1000.0 / Scratch::FPS);
+
+        if (!Scratch::stepScratchProject(monitorDisplayThread).first) {
+            Log::logWarning("Project stopped after " + std::to_string(frame) + " of " + std::to_string(options.frames) + " frames.");
+            stopped = true;
+            break;
+        }
+
+        // round the running total instead of each frame so the output doesn't drift at frame rates that don't divide the sample rate
+        const size_t total = static_cast<size_t>(std::llround(static_cast<double>(frame) * Mixer::rate / Scratch::FPS));
+        const size_t done = samples.size() / 2;
+        if (total <= done) continue;
+
+        samples.resize(total * 2);
+        const auto start = std::chrono::steady_clock::now();
+        Mixer::requestSound(samples.data() + done * 2, static_cast<int>(total - done));
+        mixTime += std::chrono::steady_clock::now() - start;
+    }
+
+    if (!stopped) Scratch::cleanupScratchProject();
+    Timer::setFixedClock(false);
+
+    const double audioSeconds = static_cast<double>(samples.size() / 2) / Mixer::rate;
+    const double mixSeconds = std::chrono::duration<double>(mixTime).count();
+    char stats[128];
+    snprintf(stats, sizeof(stats), "Mixed %.2fs of audio in %.3fs (%.1fx real time).", audioSeconds, mixSeconds, mixSeconds > 0.0 ? audioSeconds / mixSeconds : 0.0);
+    Log::log(stats);
+
+    bool passed = true;
+    if (!options.outputPath.empty()) {
+        if (writeWav(options.outputPath, samples))
+            Log::log("Wrote " + options.outputPath);
+        else
+            passed = false;
+    }
+    if (!options.referencePath.empty()) {
+        if (!compareWithReference(options.referencePath, samples, options)) passed = false;
+        Log::log(std::string(passed ? "PASS " : "FAIL ") + options.referencePath);
+    }
+    return passed ? 0 : 1;
+}
+
+} // namespace AudioRender
+
+#else
+
+#include <log.hpp>
+
+namespace AudioRender {
+int run(const Options &options) {
+    Log::logError("Rendering audio requires a PC build with audio enabled.");
+    return 1;
+}
+} // namespace AudioRender
+
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+
+namespace AudioRender {
+
+struct Options {
+    /**
+     * WAV file the mixed output is written to. Nothing is written if empty.
+     */
+    std::string outputPath;
+
+    /**
+     * WAV file to compare the output against. Nothing is compared if empty.
+     */
+    std::string referencePath;
+
+    /**
+     * Total number of frames to step the project for.
+     */
+    unsigned int frames = 300;
+
+    /**
+     * Seed passed to `srand` before the project starts.
+     */
+    unsigned int seed = 0;
+
+    /**
+     * Length of the windows the peak and RMS levels are compared in, in milliseconds.
+     */
+    unsigned int windowMs = 50;
+
+    /**
+     * How far the peak and RMS of a window may be from the reference, as a fraction of full scale.
+     * Resampling and float rounding differ slightly between compilers, so the output isn't compared bit for bit.
+     */
+    float tolerance = 0.02f;
+};
+
+/**
+ * Steps the currently loaded project with a fixed seed and a fixed timestep, and mixes exactly one frame worth of
+ * audio after each step, as fast as possible instead of in real time. Needs an audio backend without a device of its
+ * own (`SE_AUDIO_ENGINE=headless`), since the mixer is driven from the runtime thread; `main` refuses to start it
+ * with any other.
+ * @return 0 if the output was written and matched the reference (if any), 1 otherwise.
+ */
+int run(const Options &options);
+
+} // namespace AudioRender
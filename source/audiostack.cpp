@@ -7,17 +7,27 @@
 #include "runtime.hpp"
 #include "unzip.hpp"
 #include <log.hpp>
+#include <musicTimeline.hpp>
+#include <resampler.hpp>
+#include <spscQueue.hpp>
+#include <tracer.hpp>
 #ifdef USE_CMAKERC
 #include <cmrc/cmrc.hpp>
 
 CMRC_DECLARE(romfs);
 #endif
 
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <vector>
 
+static void startStream(SoundStream *stream);
+static void forgetStream(SoundStream *stream);
+
 SoundConfig::SoundConfig() {
     this->volume = 100;
     this->pan = 0;
@@ -85,26 +95,155 @@ bool SoundStream::loadAsVorbis() {
 }
 #endif
 
+std::unordered_map<std::string, SoundCache::Entry> SoundCache::entries;
+uint64_t SoundCache::useCounter = 0;
+size_t SoundCache::budget = SoundCache::defaultBudget;
+float SoundCache::maxSeconds = SoundCache::defaultMaxSeconds;
+SoundCache::Stats SoundCache::stats;
+
+std::shared_ptr<const SoundBuffer> SoundCache::find(const std::string &name) {
+    auto it = entries.find(name);
+    if (it == entries.end()) return nullptr;
+
+    it->second.lastUsed = ++useCounter;
+    stats.hits++;
+    return it->second.buffer;
+}
+
+void SoundCache::insert(const std::string &name, std::shared_ptr<const SoundBuffer> buffer) {
+    const size_t size = buffer->getMemorySize();
+    if (size > budget) return;
+
+    while (stats.residentBytes + size > budget && !entries.empty()) {
+        auto oldest = entries.begin();
+        for (auto it = entries.begin(); it != entries.end(); it++) {
+            if (it->second.lastUsed < oldest->second.lastUsed) oldest = it;
+        }
+        // streams still playing it keep their own reference
+        stats.residentBytes -= oldest->second.buffer->getMemorySize();
+        stats.evictions++;
+        entries.erase(oldest);
+    }
+
+    auto [it, inserted] = entries.try_emplace(name, Entry{buffer, ++useCounter});
+    if (!inserted) {
+        stats.residentBytes -= it->second.buffer->getMemorySize();
+        it->second = Entry{buffer, useCounter};
+    }
+    stats.residentBytes += size;
+}
+
+void SoundCache::clear() {
+    entries.clear();
+    stats.residentBytes = 0;
+}
+
+void SoundStream::loadFromPCM(std::shared_ptr<const SoundBuffer> decoded) {
+    this->pcm = std::move(decoded);
+    this->pcmPosition = 0;
+    this->type = SoundStreamPCM;
+    this->rate = this->pcm->rate;
+    this->channels = this->pcm->channels;
+}
+
+void SoundStream::closeDecoder() {
+#ifdef ENABLE_AUDIO
+    if (this->type == SoundStreamWAV) {
+        drwav_uninit(&this->wav);
+#if !defined(NO_MP3)
+    } else if (this->type == SoundStreamMP3) {
+        drmp3_uninit(&this->mp3);
+#endif
+#if !defined(NO_VORBIS)
+    } else if (this->type == SoundStreamVorbis) {
+        stb_vorbis_close(this->vorbis);
+#endif
+    }
+
+    if (this->type != SoundStreamStream && this->buffer != nullptr) free(this->buffer);
+    this->buffer = nullptr;
+    this->type = SoundStreamUnknown;
+#endif
+}
+
+// Decodes the whole sound if it's short enough to cache, and plays the decoded copy from then on.
+bool SoundStream::decodeToPCM() {
+#ifdef ENABLE_AUDIO
+    uint64_t frames = 0;
+    if (this->type == SoundStreamWAV) {
+        frames = this->wav.totalPCMFrameCount;
+#if !defined(NO_MP3)
+    } else if (this->type == SoundStreamMP3) {
+        frames = drmp3_get_pcm_frame_count(&this->mp3);
+        drmp3_seek_to_pcm_frame(&this->mp3, 0);
+#endif
+#if !defined(NO_VORBIS)
+    } else if (this->type == SoundStreamVorbis) {
+        frames = stb_vorbis_stream_length_in_samples(this->vorbis);
+#endif
+    }
+
+    if (frames == 0 || this->channels <= 0 || frames > SoundCache::maxSeconds * this->rate) return false;
+    if (frames * this->channels * sizeof(int16_t) > SoundCache::budget) return false;
+
+    SE_TRACE_SCOPE("sound decode to cache", "assets", this->name);
+
+    auto decoded = std::make_shared<SoundBuffer>();
+    decoded->channels = this->channels;
+    decoded->rate = this->rate;
+    decoded->samples.resize(frames * this->channels);
+
+    uint64_t read = 0;
+    if (this->type == SoundStreamWAV) {
+        read = drwav_read_pcm_frames_s16(&this->wav, frames, decoded->samples.data());
+#if !defined(NO_MP3)
+    } else if (this->type == SoundStreamMP3) {
+        read = drmp3_read_pcm_frames_s16(&this->mp3, frames, decoded->samples.data());
+#endif
+#if !defined(NO_VORBIS)
+    } else if (this->type == SoundStreamVorbis) {
+        const int got = stb_vorbis_get_samples_short_interleaved(this->vorbis, this->channels, decoded->samples.data(), static_cast<int>(decoded->samples.size()));
+        read = got > 0 ? static_cast<uint64_t>(got) : 0;
+#endif
+    }
+
+    decoded->frames = read;
+    decoded->samples.resize(read * this->channels);
+
+    closeDecoder();
+    SoundCache::stats.misses++;
+    SoundCache::insert(this->name, decoded);
+    loadFromPCM(std::move(decoded));
+    return true;
+#endif
+    return false;
+}
+
 void SoundStream::commonInit() {
 #ifdef ENABLE_AUDIO
     this->paused = false;
     this->auto_clean = false;
-    this->no_lock = false;
-
-    Mixer::mutex.lock();
+    this->finished = false;
+
+    if (this->owner != nullptr) {
+        // sounds of a sprite start with its current effects
+        this->config.volume = this->owner->volume;
+        this->config.pan = this->owner->pan;
+        this->config.pitch = pow(2, this->owner->pitch / 120.0);
+        return;
+    }
 
     auto e = Mixer::configs.find(this->name);
 
     if (e != Mixer::configs.end()) {
         this->config = e->second;
     }
-
-    Mixer::mutex.unlock();
 #endif
 }
 
 bool SoundStream::loadFromBuffer() {
 #ifdef ENABLE_AUDIO
+    SE_TRACE_SCOPE("sound decode", "assets", this->name);
     this->type = SoundStreamUnknown;
 
     if (this->buffer == nullptr || this->buffer_size <= 0) {
@@ -135,6 +274,19 @@ bool SoundStream::loadFromBuffer() {
 
 nonstd::expected<void, std::string> SoundStream::init(std::string path, bool cached, bool on_disk) {
 #ifdef ENABLE_AUDIO
+    this->buffer = nullptr;
+
+    if (!on_disk) {
+        if (auto decoded = SoundCache::find(path)) {
+            this->name = path;
+            commonInit();
+            loadFromPCM(std::move(decoded));
+
+            startStream(this);
+            return {};
+        }
+    }
+
     std::string prefix = "";
     if (!cached && !Unzip::UnpackedInSD && !on_disk) prefix = OS::getRomFSLocation();
     else if (Unzip::UnpackedInSD && !on_disk) prefix = Unzip::filePath;
@@ -175,16 +327,16 @@ nonstd::expected<void, std::string> SoundStream::init(std::string path, bool cac
     if (!loadFromBuffer()) {
         return nonstd::make_unexpected("Failed to load sound.");
     }
+    if (!on_disk) decodeToPCM();
 
-    Mixer::mutex.lock();
-    Mixer::streams[path] = this;
-    Mixer::mutex.unlock();
+    startStream(this);
     return {};
 #endif
     return nonstd::make_unexpected("Audio not enabled.");
 }
 
-SoundStream::SoundStream(std::string path, bool cached, bool on_disk) {
+SoundStream::SoundStream(std::string path, bool cached, bool on_disk, Sprite *owner) {
+    this->owner = owner;
     auto potentialError = init(path, cached, on_disk);
     if (!potentialError.has_value()) error = potentialError.error();
 }
@@ -200,16 +352,25 @@ SoundStream::SoundStream(std::string name, int (*callback)(SoundStream *strm, fl
 
     commonInit();
 
-    Mixer::mutex.lock();
-    Mixer::streams[name] = this;
-    Mixer::mutex.unlock();
+    startStream(this);
 }
 
 nonstd::expected<void, std::string> SoundStream::init(mz_zip_archive *zip, std::string path) {
 
 #ifdef ENABLE_AUDIO
-    if (zip != nullptr) {
-        int file_index = mz_zip_reader_locate_file(zip, path.c_str(), nullptr, 0);
+    this->buffer = nullptr;
+    this->name = path;
+
+    if (auto decoded = SoundCache::find(path)) {
+        commonInit();
+        loadFromPCM(std::move(decoded));
+
+        startStream(this);
+        return {};
+    }
+
+    if (zip != nullptr && zip != &Unzip::zipArchive) {
+        int file_index = Unzip::findFile(zip, path);
 
         if (file_index < 0) {
             return nonstd::make_unexpected("Audio not found in zip");
@@ -217,56 +378,34 @@ nonstd::expected<void, std::string> SoundStream::init(mz_zip_archive *zip, std::
 
         this->buffer = (unsigned char *)mz_zip_reader_extract_to_heap(zip, file_index, &this->buffer_size, 0);
     } else {
+        // the project's archive is shared with the decode workers, so it's only read under its lock
         this->buffer = (unsigned char *)Unzip::getFileInSB3(path, &this->buffer_size);
     }
 
-    this->name = path;
     commonInit();
 
     if (!loadFromBuffer()) {
         return nonstd::make_unexpected("Failed to load sound.");
     }
+    decodeToPCM();
 
-    Mixer::mutex.lock();
-    Mixer::streams[path] = this;
-    Mixer::mutex.unlock();
+    startStream(this);
     return {};
 #endif
     return nonstd::make_unexpected("Audio not enabled.");
 }
 
-SoundStream::SoundStream(mz_zip_archive *zip, std::string path) {
+SoundStream::SoundStream(mz_zip_archive *zip, std::string path, Sprite *owner) {
+    this->owner = owner;
     auto potentialError = init(zip, path);
-    if (error.has_value()) error = potentialError.error();
+    if (!potentialError.has_value()) error = potentialError.error();
 }
 
 SoundStream::~SoundStream() {
 #ifdef ENABLE_AUDIO
-    int i;
-
-    if (!this->no_lock) Mixer::mutex.lock();
-    for (auto it = Mixer::streams.begin(); it != Mixer::streams.end();) {
-        if (it->second == this) {
-            Mixer::streams.erase(it);
-            break;
-        }
-        it++;
-    }
-    if (!this->no_lock) Mixer::mutex.unlock();
-
-    if (this->type == SoundStreamWAV) {
-        drwav_uninit(&this->wav);
-#if !defined(NO_MP3)
-    } else if (this->type == SoundStreamMP3) {
-        drmp3_uninit(&this->mp3);
-#endif
-#if !defined(NO_VORBIS)
-    } else if (this->type == SoundStreamVorbis) {
-        stb_vorbis_close(this->vorbis);
-#endif
-    }
+    forgetStream(this);
 
-    if (this->type != SoundStreamStream && this->buffer != nullptr) free(this->buffer);
+    closeDecoder();
 #endif
 }
 
@@ -274,6 +413,13 @@ int SoundStream::read(float *output, int frames) {
 #ifdef ENABLE_AUDIO
     if (this->type == SoundStreamStream) {
         return this->callback(this, output, frames);
+    } else if (this->type == SoundStreamPCM) {
+        const int count = static_cast<int>(std::min<size_t>(frames, this->pcm->frames - this->pcmPosition));
+        const int16_t *src = this->pcm->samples.data() + this->pcmPosition * this->channels;
+        for (int i = 0; i < count * this->channels; i++)
+            output[i] = src[i] / 32768.0f;
+        this->pcmPosition += count;
+        return count;
     } else if (this->type == SoundStreamWAV) {
         return drwav_read_pcm_frames_f32(&this->wav, frames, output);
 #if !defined(NO_MP3)
@@ -289,16 +435,353 @@ int SoundStream::read(float *output, int frames) {
     return 0;
 }
 
-std::unordered_map<std::string, SoundStream *> Mixer::streams;
+std::vector<SoundStream *> Mixer::streams;
 std::unordered_map<std::string, SoundConfig> Mixer::configs;
-SE_Mutex Mixer::mutex;
 #ifdef ENABLE_AUDIO
 tsf *Mixer::hTsf = nullptr;
 #endif
 void *Mixer::sf2_buffer = nullptr;
 int Mixer::sf2_seq = 0;
-std::unordered_map<int, float> Mixer::notes;
 bool Mixer::musicInitialized = false;
+int Mixer::polyphony = Mixer::defaultPolyphony;
+Mixer::StealPolicy Mixer::stealPolicy = Mixer::StealPolicy::Oldest;
+Mixer::Interpolation Mixer::interpolation = Mixer::defaultInterpolation;
+
+#ifdef ENABLE_AUDIO
+#if defined(__NDS__)
+static constexpr int maxBlockFrames = 256;
+static constexpr int scratchSamples = 2048;
+#else
+static constexpr int maxBlockFrames = 1024;
+static constexpr int scratchSamples = 8192;
+#endif
+static constexpr int musicChannels = 64;
+static constexpr int maxMusicVoices = 64;
+
+// 8x pitch on a 192 kHz sound, the most Scratch can ask for
+static constexpr double maxStep = 32.0;
+
+namespace {
+
+struct MixerCommand {
+    enum Type : uint8_t {
+        Play,
+        Stop,
+        SetVolume,
+        SetPan,
+        SetPitch,
+        NoteOn,
+        SetSynth,
+    };
+
+    Type type;
+    SoundStream *stream = nullptr;
+    int voice = 0;      // the slot of the voice pool the stream plays in
+    SoundConfig config; // for Play
+    bool cubic = false; // for Play
+    float value = 0.0f; // the new volume, pan or pitch, or the volume of a note
+    // for NoteOn
+    int note = 0;
+    int preset = 0;
+    int key = 0;
+    bool drums = false;
+    uint64_t start = 0; // on the music timeline
+    uint64_t end = 0;
+#ifndef NO_MUSIC
+    tsf *synth = nullptr; // for SetSynth
+#endif
+};
+
+struct Voice {
+    SoundStream *stream = nullptr;
+    SoundConfig config;
+    bool cubic;
+    Resampler::State resampler;
+};
+
+struct NoteSlot {
+    int id = -1;
+    bool started = false;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    int preset = 0;
+    int key = 0;
+    bool drums = false;
+    float volume = 0.0f;
+};
+
+} // namespace
+
+// The runtime's view of the voice pool: the stream last started in each slot and when. A slot is free again once its
+// stream is finished.
+static SoundStream *slotStreams[Mixer::maxVoices];
+static uint64_t slotStarted[Mixer::maxVoices];
+static uint64_t startCounter = 0;
+
+// Everything from here up to requestSound belongs to whichever thread calls requestSound. The runtime only changes it
+// through `commands`, or while the mixer is suspended.
+
+static SPSCQueue<MixerCommand, 256> commands;
+static std::atomic<bool> suspended{false};
+static std::atomic<bool> mixing{false};
+
+static std::vector<float> mixBuffer;
+static std::vector<float> scratchBuffer;
+static Voice voices[Mixer::maxVoices];
+
+#ifndef NO_MUSIC
+static tsf *synth = nullptr;
+static NoteSlot noteSlots[musicChannels];
+// frames mixed since audio started, which is the timeline notes are scheduled on
+static uint64_t mixPosition = 0;
+// the low bits of mixPosition as of the last requestSound; 64-bit atomics aren't lock-free on every console
+static std::atomic<uint32_t> mixedFrames{0};
+// the most frames requestSound was asked for at once, which bounds how far the mixer may be ahead of the runtime
+static std::atomic<int> largestRequest{0};
+#endif
+
+// Keeps the mixer from touching any of its state until resumeMixer, so the runtime can change it directly.
+static void suspendMixer() {
+    suspended.store(true);
+    while (mixing.load())
+        SE_Thread::sleep(1);
+}
+
+static void resumeMixer() {
+    suspended.store(false);
+}
+
+static void removeVoice(int slot) {
+    SoundStream *stream = voices[slot].stream;
+    voices[slot].stream = nullptr;
+    stream->finished.store(true, std::memory_order_release);
+}
+
+static Voice *findVoice(const MixerCommand &command) {
+    Voice &voice = voices[command.voice];
+    return voice.stream == command.stream ? &voice : nullptr;
+}
+
+#ifndef NO_MUSIC
+static void endNote(int channel) {
+    if (noteSlots[channel].started) tsf_channel_note_off_all(synth, channel);
+    noteSlots[channel].id = -1;
+    noteSlots[channel].started = false;
+}
+
+static void scheduleNote(const MixerCommand &command) {
+    if (!synth) return;
+
+    // channels are reused once every musicChannels notes, cutting off whatever is still on it
+    const int channel = command.note % musicChannels;
+    if (noteSlots[channel].id >= 0) endNote(channel);
+
+    NoteSlot &slot = noteSlots[channel];
+    slot.id = command.note;
+    slot.started = false;
+    slot.start = command.start;
+    slot.end = command.end;
+    slot.preset = command.preset;
+    slot.key = command.key;
+    slot.drums = command.drums;
+    slot.volume = command.value;
+}
+
+// Starts and ends the notes that are due at `now`.
+static void updateNotes(uint64_t now) {
+    for (int channel = 0; channel < musicChannels; channel++) {
+        NoteSlot &slot = noteSlots[channel];
+        if (slot.id < 0) continue;
+        if (!slot.started && slot.start <= now) {
+            tsf_channel_set_presetnumber(synth, channel, slot.preset, slot.drums);
+            tsf_channel_set_volume(synth, channel, slot.volume);
+            tsf_channel_note_on(synth, channel, slot.key, 1.0);
+            slot.started = true;
+        }
+        if (slot.started && slot.end <= now) endNote(channel);
+    }
+}
+
+// Renders the synth into the start of mixBuffer, splitting the block wherever a note starts or ends so every note
+// lands on its exact frame instead of the start of the next block.
+static void renderMusic(int frames) {
+    int done = 0;
+    while (done < frames) {
+        updateNotes(mixPosition + done);
+
+        uint64_t next = mixPosition + frames;
+        for (const NoteSlot &slot : noteSlots) {
+            if (slot.id < 0) continue;
+            next = std::min(next, slot.started ? slot.end : slot.start);
+        }
+        const int until = (int)(next - mixPosition);
+
+        tsf_render_float(synth, mixBuffer.data() + done * 2, until - done, 0);
+        done = until;
+    }
+}
+#endif
+
+static void applyCommand(const MixerCommand &command) {
+    switch (command.type) {
+    case MixerCommand::Play:
+        // the runtime only reuses a slot that is free or that it decided to steal
+        if (voices[command.voice].stream != nullptr) removeVoice(command.voice);
+        {
+            Voice &voice = voices[command.voice];
+            voice.stream = command.stream;
+            voice.config = command.config;
+            voice.cubic = command.cubic;
+            // the sound starts on its first frame, with silence before it
+            voice.resampler = Resampler::State();
+        }
+        break;
+    case MixerCommand::Stop:
+        if (findVoice(command)) removeVoice(command.voice);
+        break;
+    case MixerCommand::SetVolume:
+        if (Voice *voice = findVoice(command)) voice->config.volume = command.value;
+        break;
+    case MixerCommand::SetPan:
+        if (Voice *voice = findVoice(command)) voice->config.pan = command.value;
+        break;
+    case MixerCommand::SetPitch:
+        if (Voice *voice = findVoice(command)) voice->config.pitch = command.value;
+        break;
+#ifndef NO_MUSIC
+    case MixerCommand::NoteOn:
+        scheduleNote(command);
+        break;
+    case MixerCommand::SetSynth:
+        synth = command.synth;
+        break;
+#else
+    default:
+        break;
+#endif
+    }
+}
+
+// Hands `command` to the mixer. Only call this from the runtime thread.
+static void sendCommand(const MixerCommand &command) {
+    if (commands.push(command)) return;
+
+    // the mixer isn't keeping up (or isn't running at all), so catch it up from here
+    suspendMixer();
+    MixerCommand queued;
+    while (commands.pop(queued))
+        applyCommand(queued);
+    applyCommand(command);
+    resumeMixer();
+}
+
+static void sendToVoice(MixerCommand::Type type, SoundStream *stream, float value = 0.0f) {
+    if (stream->voice < 0) return;
+
+    MixerCommand command;
+    command.type = type;
+    command.stream = stream;
+    command.voice = stream->voice;
+    command.value = value;
+    sendCommand(command);
+}
+
+static void stopStream(SoundStream *stream) {
+    if (stream->paused) return;
+    stream->paused = true;
+    sendToVoice(MixerCommand::Stop, stream);
+}
+
+// Picks the slot of the voice pool a new sound plays in, cutting off another sound if all of them are taken.
+static int claimVoice() {
+    const int polyphony = std::clamp(Mixer::polyphony, 1, Mixer::maxVoices);
+
+    int victim = -1;
+    for (int slot = 0; slot < polyphony; slot++) {
+        SoundStream *stream = slotStreams[slot];
+        if (stream == nullptr || stream->finished.load(std::memory_order_acquire)) return slot;
+        if (victim < 0) {
+            victim = slot;
+            continue;
+        }
+
+        SoundStream *best = slotStreams[victim];
+        if (stream->paused != best->paused) {
+            if (stream->paused) victim = slot;
+            continue;
+        }
+        if (Mixer::stealPolicy == Mixer::StealPolicy::Quietest && stream->config.volume != best->config.volume) {
+            if (stream->config.volume < best->config.volume) victim = slot;
+            continue;
+        }
+        if (slotStarted[slot] < slotStarted[victim]) victim = slot;
+    }
+
+    // the mixer stops the old stream when it starts the new one
+    slotStreams[victim]->paused = true;
+    return victim;
+}
+
+static SoundStream *findStream(const std::string &name, Sprite *owner) {
+    for (auto it = Mixer::streams.rbegin(); it != Mixer::streams.rend(); it++) {
+        if ((*it)->name == name && (*it)->owner == owner) return *it;
+    }
+    return nullptr;
+}
+
+// Starts playing `stream`. An owner playing a sound it is already playing restarts it, like Scratch does.
+static void startStream(SoundStream *stream) {
+    Mixer::update();
+
+    if (SoundStream *previous = findStream(stream->name, stream->owner)) {
+        stopStream(previous);
+        previous->auto_clean = true;
+    }
+    Mixer::streams.push_back(stream);
+
+    const int slot = claimVoice();
+    slotStreams[slot] = stream;
+    slotStarted[slot] = ++startCounter;
+    stream->voice = slot;
+
+    MixerCommand play;
+    play.type = MixerCommand::Play;
+    play.stream = stream;
+    play.voice = slot;
+    play.config = stream->config;
+    play.cubic = Mixer::interpolation == Mixer::Interpolation::Cubic;
+    sendCommand(play);
+}
+
+static void forgetStream(SoundStream *stream) {
+    auto it = std::find(Mixer::streams.begin(), Mixer::streams.end(), stream);
+    if (it != Mixer::streams.end()) Mixer::streams.erase(it);
+    if (stream->voice >= 0 && slotStreams[stream->voice] == stream) slotStreams[stream->voice] = nullptr;
+}
+#else
+static void startStream(SoundStream *stream) {}
+static void forgetStream(SoundStream *stream) {}
+#endif
+
+void Mixer::init() {
+#ifdef ENABLE_AUDIO
+    mixBuffer.assign(maxBlockFrames * 2, 0.0f);
+    scratchBuffer.assign(scratchSamples, 0.0f);
+#endif
+}
+
+void Mixer::update() {
+#ifdef ENABLE_AUDIO
+    for (size_t i = 0; i < streams.size();) {
+        SoundStream *stream = streams[i];
+        if (!stream->auto_clean || !stream->finished.load(std::memory_order_acquire)) {
+            i++;
+            continue;
+        }
+        delete stream; // removes itself from `streams`
+    }
+#endif
+}
 
 void Mixer::initMusic() {
 #if defined(ENABLE_AUDIO) && !defined(NO_MUSIC)
@@ -340,126 +823,115 @@ void Mixer::initMusic() {
 
     if (Mixer::hTsf) {
         tsf_set_output(Mixer::hTsf, TSF_STEREO_INTERLEAVED, Mixer::rate, 0);
+
+        // allocate every voice and channel now, so starting notes doesn't allocate in the mixer
+        tsf_set_max_voices(Mixer::hTsf, maxMusicVoices);
+        tsf_channel_set_presetnumber(Mixer::hTsf, musicChannels - 1, 0);
+
+        MixerCommand command;
+        command.type = MixerCommand::SetSynth;
+        command.synth = Mixer::hTsf;
+        sendCommand(command);
     }
 
     Mixer::musicInitialized = true;
 #endif
 }
 
-void Mixer::requestSound(short *output, int frames) {
 #ifdef ENABLE_AUDIO
-    const int channels_out = 2;
-    std::vector<float> mixBuffer(frames * channels_out, 0.0f);
+// Mixes `frames` frames of `voice` into mixBuffer. The fractional position and the last few input frames are carried
+// over to the next call, so the output is continuous across blocks and callbacks.
+// @return false once the stream has run out.
+static bool mixVoice(Voice &voice, int frames) {
+    SoundStream *s = voice.stream;
+    const int channels = s->channels;
+    if (channels <= 0 || channels > Resampler::maxChannels) return false;
+
+    const double step = std::min((double)s->rate * voice.config.pitch / (double)Mixer::rate, maxStep);
+    const float volume = voice.config.volume / 100.0f;
+    const float pan = std::clamp(voice.config.pan / 100.0f, -1.0f, 1.0f);
+    const float gainL = (pan <= 0.0f ? 1.0f : 1.0f - pan) * volume;
+    const float gainR = (pan >= 0.0f ? 1.0f : 1.0f + pan) * volume;
+
+    const auto read = [s](float *dst, int frames) { return s->read(dst, frames); };
+    return Resampler::mix(voice.resampler, read, channels, step, voice.cubic, gainL, gainR, scratchBuffer.data(), scratchSamples, mixBuffer.data(), frames);
+}
 
-    Mixer::mutex.lock();
+static void mixBlock(int frames) {
+    std::fill(mixBuffer.begin(), mixBuffer.begin() + frames * 2, 0.0f);
 
 #ifndef NO_MUSIC
-    if (Mixer::hTsf) {
-        tsf_render_float(Mixer::hTsf, mixBuffer.data(), frames, 0);
-    }
-
-    for (auto it = notes.begin(); it != notes.end();) {
-        it->second -= (float)frames / Mixer::rate;
+    if (synth) renderMusic(frames);
+    mixPosition += frames;
+#endif
 
-        if (it->second <= 0) {
-            tsf_channel_note_off_all(Mixer::hTsf, it->first);
-            it = notes.erase(it);
-        } else {
-            it++;
-        }
+    for (int slot = 0; slot < Mixer::maxVoices; slot++) {
+        if (voices[slot].stream != nullptr && !mixVoice(voices[slot], frames)) removeVoice(slot);
     }
+}
 #endif
 
-    for (auto it = streams.begin(); it != streams.end();) {
-        SoundStream *s = it->second;
-        if (s->paused) {
-            it++;
-            if (s->auto_clean) {
-                s->no_lock = true;
-                delete s;
-            }
-            continue;
-        }
-
-        const float pitch = s->config.pitch;
-        const float volume = s->config.volume / 100.0f;
-        const float step = (float)s->rate * pitch / (float)Mixer::rate;
-        int maxFramesNeeded = (int)(frames * step) + 2;
-
-        std::vector<float> decodeBuffer(maxFramesNeeded * s->channels, 0.0f);
-
-        int decoded = s->read(decodeBuffer.data(), maxFramesNeeded);
-        if (decoded <= 0) {
-            s->paused = true;
-            it++;
-            continue;
-        }
-
-        float pos = 0.0f;
-
-        for (int i = 0; i < frames; i++) {
-            int i0 = (int)pos;
-            int i1 = std::min(i0 + 1, decoded - 1);
-            float frac = pos - i0;
-
-            float left = 0.0f;
-            float right = 0.0f;
-
-            if (s->channels == 1) {
-                float a = decodeBuffer[i0];
-                float b = decodeBuffer[i1];
-                float sample = a + (b - a) * frac;
-                left = right = sample;
-            } else {
-                float aL = decodeBuffer[2 * i0 + 0];
-                float aR = decodeBuffer[2 * i0 + 1];
-                float bL = decodeBuffer[2 * i1 + 0];
-                float bR = decodeBuffer[2 * i1 + 1];
-
-                left = aL + (bL - aL) * frac;
-                right = aR + (bR - aR) * frac;
-            }
+void Mixer::requestSound(short *output, int frames) {
+#ifdef ENABLE_AUDIO
+    mixing.store(true);
+    if (suspended.load() || mixBuffer.empty()) {
+        mixing.store(false, std::memory_order_release);
+        memset(output, 0, frames * 2 * sizeof(short));
+        return;
+    }
 
-            float p = std::clamp(s->config.pan / 100.0f, -1.0f, 1.0f);
-            float panL = (p <= 0.0f) ? 1.0f : 1.0f - p;
-            float panR = (p >= 0.0f) ? 1.0f : 1.0f + p;
+#ifndef NO_MUSIC
+    if (frames > largestRequest.load(std::memory_order_relaxed)) largestRequest.store(frames, std::memory_order_relaxed);
+#endif
 
-            left *= panL * volume;
-            right *= panR * volume;
+    MixerCommand command;
+    while (commands.pop(command))
+        applyCommand(command);
 
-            mixBuffer[2 * i + 0] += left;
-            mixBuffer[2 * i + 1] += right;
+    for (int done = 0; done < frames; done += maxBlockFrames) {
+        const int block = std::min(frames - done, maxBlockFrames);
+        mixBlock(block);
 
-            pos += step;
+        short *out = output + done * 2;
+        for (int i = 0; i < block * 2; i++) {
+            float x = std::clamp(mixBuffer[i], -1.0f, 1.0f);
+            out[i] = (short)(x * 32767.0f);
         }
-
-        it++;
     }
 
-    Mixer::mutex.unlock();
-
-    for (int i = 0; i < frames * 2; i++) {
-        float x = std::clamp(mixBuffer[i], -1.0f, 1.0f);
-        output[i] = (short)(x * 32767.0f);
-    }
+#ifndef NO_MUSIC
+    mixedFrames.store((uint32_t)mixPosition, std::memory_order_release);
+#endif
+    mixing.store(false, std::memory_order_release);
 #endif
 }
 
 void Mixer::cleanupAudio() {
 #ifdef ENABLE_AUDIO
-    std::vector<SoundStream *> streams;
-    int i;
+    // nothing may be mixed while the streams are deleted
+    suspendMixer();
 
-    for (auto e : Mixer::streams) {
-        streams.push_back(e.second);
+    MixerCommand command;
+    while (commands.pop(command)) {
     }
+    for (Voice &voice : voices)
+        voice.stream = nullptr;
+
+    std::vector<SoundStream *> streams = Mixer::streams;
+    int i;
 
     for (i = 0; i < streams.size(); i++)
         delete streams[i];
 
-    Mixer::notes.clear();
+    SoundCache::clear();
 
 #ifndef NO_MUSIC
+    synth = nullptr;
+    // the timeline keeps running, so scripts waiting for a note don't have to be told
+    for (NoteSlot &slot : noteSlots)
+        slot = NoteSlot();
+    Mixer::sf2_seq = 0;
+
     if (Mixer::hTsf) {
         tsf_close(Mixer::hTsf);
         Mixer::hTsf = nullptr;
@@ -470,54 +942,52 @@ void Mixer::cleanupAudio() {
     }
     Mixer::musicInitialized = false;
 #endif
+
+    resumeMixer();
 #endif
 }
 
 #ifdef ENABLE_AUDIO
 
-#define FIND(blk)                \
-    Mixer::mutex.lock();         \
-                                 \
-    blk;                         \
-                                 \
-    auto e = streams.find(name); \
-    if (e != streams.end()) {
-
-#define END \
-    }       \
-            \
-    Mixer::mutex.unlock();
-
-#define PRESERVE(x)                                        \
-    {                                                      \
-        SoundConfig config;                                \
-        auto e = Mixer::configs.find(name);                \
-                                                           \
-        if (e != Mixer::configs.end()) config = e->second; \
-                                                           \
-        config.x = x;                                      \
-                                                           \
-        Mixer::configs[name] = config;                     \
-    }
-
-#endif
-void Mixer::stopSound(std::string name) {
+#define FIND(blk)                             \
+    blk;                                      \
+                                              \
+    SoundStream *e = findStream(name, owner); \
+    if (e != nullptr) {
+
+#define END }
+
+/* sounds of a sprite take its effects when they start instead */
+#define PRESERVE(x)                                            \
+    if (owner == nullptr) {                                    \
+        SoundConfig config;                                    \
+        auto e = Mixer::configs.find(name);                    \
+                                                               \
+        if (e != Mixer::configs.end()) config = e->second;     \
+                                                               \
+        config.x = x;                                          \
+                                                               \
+        Mixer::configs[name] = config;                         \
+    }
+
+#endif
+void Mixer::stopSound(std::string name, Sprite *owner) {
 #ifdef ENABLE_AUDIO
     FIND({});
 
-    e->second->paused = true;
+    stopStream(e);
 
     END;
 #endif
 }
 
-bool Mixer::isSoundPlaying(std::string name) {
+bool Mixer::isSoundPlaying(std::string name, Sprite *owner) {
 #ifdef ENABLE_AUDIO
     bool b = false;
 
     FIND({});
 
-    b = !e->second->paused;
+    b = !e->paused && !e->finished.load(std::memory_order_acquire);
 
     END;
 
@@ -526,45 +996,48 @@ bool Mixer::isSoundPlaying(std::string name) {
     return false;
 }
 
-void Mixer::setPitch(std::string name, float pitch) {
+void Mixer::setPitch(std::string name, float pitch, Sprite *owner) {
 #ifdef ENABLE_AUDIO
     pitch = pow(2, pitch / 120.0);
 
     FIND(PRESERVE(pitch));
 
-    e->second->config.pitch = pitch;
+    e->config.pitch = pitch;
+    sendToVoice(MixerCommand::SetPitch, e, pitch);
 
     END;
 #endif
 }
 
-void Mixer::setPan(std::string name, float pan) {
+void Mixer::setPan(std::string name, float pan, Sprite *owner) {
 #ifdef ENABLE_AUDIO
     FIND(PRESERVE(pan));
 
-    e->second->config.pan = pan;
+    e->config.pan = pan;
+    sendToVoice(MixerCommand::SetPan, e, pan);
 
     END;
 #endif
 }
 
-void Mixer::setSoundVolume(std::string name, float volume) {
+void Mixer::setSoundVolume(std::string name, float volume, Sprite *owner) {
 #ifdef ENABLE_AUDIO
     FIND(PRESERVE(volume));
 
-    e->second->config.volume = volume;
+    e->config.volume = volume;
+    sendToVoice(MixerCommand::SetVolume, e, volume);
 
     END;
 #endif
 }
 
-float Mixer::getSoundVolume(std::string name) {
+float Mixer::getSoundVolume(std::string name, Sprite *owner) {
 #ifdef ENABLE_AUDIO
-    float v;
+    float v = 0.0f;
 
     FIND({});
 
-    v = e->second->config.volume;
+    v = e->config.volume;
 
     END;
 
@@ -573,20 +1046,100 @@ float Mixer::getSoundVolume(std::string name) {
     return 0.0f;
 }
 
-void Mixer::setAutoClean(std::string name, bool toggle) {
+void Mixer::setAutoClean(std::string name, bool toggle, Sprite *owner) {
 #ifdef ENABLE_AUDIO
     FIND({});
 
-    e->second->auto_clean = toggle;
+    e->auto_clean = toggle;
 
     END;
 #endif
 }
 
+void Mixer::stopSounds(Sprite *owner) {
+#ifdef ENABLE_AUDIO
+    for (SoundStream *stream : streams) {
+        if (stream->owner != owner) continue;
+        stopStream(stream);
+        stream->auto_clean = true;
+    }
+#endif
+}
+
+void Mixer::stopAllSounds() {
+#ifdef ENABLE_AUDIO
+    for (SoundStream *stream : streams) {
+        if (stream->owner == nullptr) continue;
+        stopStream(stream);
+        stream->auto_clean = true;
+    }
+#endif
+}
+
+void Mixer::updateSpriteEffects(Sprite *owner) {
+#ifdef ENABLE_AUDIO
+    const float volume = owner->volume;
+    const float pan = owner->pan;
+    const float pitch = pow(2, owner->pitch / 120.0);
+
+    for (SoundStream *stream : streams) {
+        if (stream->owner != owner || stream->paused) continue;
+        if (stream->config.volume != volume) sendToVoice(MixerCommand::SetVolume, stream, volume);
+        if (stream->config.pan != pan) sendToVoice(MixerCommand::SetPan, stream, pan);
+        if (stream->config.pitch != pitch) sendToVoice(MixerCommand::SetPitch, stream, pitch);
+        stream->config.volume = volume;
+        stream->config.pan = pan;
+        stream->config.pitch = pitch;
+    }
+#endif
+}
+
 float Mixer::beatsToSec(float v) {
     return v / (Scratch::tempo / 60.0);
 }
 
+uint64_t Mixer::beatsToFrames(float beats) {
+    return (uint64_t)std::llround(std::max(0.0f, Mixer::beatsToSec(beats)) * Mixer::rate);
+}
+
+#if defined(ENABLE_AUDIO) && !defined(NO_MUSIC)
+// musicPosition widened back to 64 bits; only used from the runtime thread
+static uint64_t runtimePosition = 0;
+#endif
+
+uint64_t Mixer::musicPosition() {
+#if defined(ENABLE_AUDIO) && !defined(NO_MUSIC)
+    const uint32_t low = mixedFrames.load(std::memory_order_acquire);
+    runtimePosition += (uint32_t)(low - (uint32_t)runtimePosition);
+    return runtimePosition;
+#endif
+    return 0;
+}
+
+bool Mixer::musicReached(uint64_t time) {
+#if defined(ENABLE_AUDIO) && !defined(NO_MUSIC)
+    return MusicTimeline::reached(Mixer::musicPosition(), time, Mixer::rate / std::max(1, Scratch::FPS));
+#endif
+    return true;
+}
+
+uint64_t Mixer::musicStart(uint64_t musicTime) {
+#if defined(ENABLE_AUDIO) && !defined(NO_MUSIC)
+    // A script notices its wait is over on the frame after the mixer got there, and the device may have mixed another
+    // buffer before the note's command reaches it.
+    const uint64_t slack = Mixer::rate / std::max(1, Scratch::FPS) + largestRequest.load(std::memory_order_relaxed);
+    return MusicTimeline::nextStart(musicTime, Mixer::musicPosition(), slack);
+#endif
+    return musicTime;
+}
+
+bool Mixer::isMusicScheduled() {
+#if defined(ENABLE_AUDIO) && !defined(NO_MUSIC)
+    return Mixer::hTsf != nullptr;
+#endif
+    return false;
+}
+
 static constexpr int instrument_lut[] = {
     0,   /* Piano -> Acoustic Grand */
     4,   /* Electric Piano -> Electric Piano 1 */
@@ -611,30 +1164,27 @@ static constexpr int instrument_lut[] = {
     89   /* Synth Pad -> Pad 2 (warm) */
 };
 
-int Mixer::note(int instrument, int note, float volume, float beats) {
+bool Mixer::note(int instrument, int note, float volume, uint64_t start, uint64_t end) {
 #if defined(ENABLE_AUDIO) && !defined(NO_MUSIC)
-    int n;
-
-    if (!Mixer::hTsf) return -1;
+    if (!Mixer::hTsf) return false;
 
     instrument = ((instrument - 1) % (sizeof(instrument_lut) / sizeof(instrument_lut[0])));
 
-    if (instrument_lut[instrument] == -1) return -1;
-
-    Mixer::mutex.lock();
+    if (instrument_lut[instrument] == -1) return false;
 
-    n = Mixer::sf2_seq++;
-    tsf_channel_set_presetnumber(Mixer::hTsf, n, instrument_lut[instrument]);
-    tsf_channel_set_volume(Mixer::hTsf, n, volume);
-    tsf_channel_note_on(Mixer::hTsf, n, note, 1.0);
+    MixerCommand command;
+    command.type = MixerCommand::NoteOn;
+    command.note = Mixer::sf2_seq++;
+    command.preset = instrument_lut[instrument];
+    command.key = note;
+    command.value = volume;
+    command.start = start;
+    command.end = end;
+    sendCommand(command);
 
-    Mixer::notes[n] = Mixer::beatsToSec(beats);
-
-    Mixer::mutex.unlock();
-
-    return n;
+    return true;
 #endif
-    return -1;
+    return false;
 }
 
 static constexpr int drum_lut[] = {
@@ -658,45 +1208,26 @@ static constexpr int drum_lut[] = {
     79  /* Cuica -> Open Cuica */
 };
 
-int Mixer::drum(int drum, float volume, float beats) {
+bool Mixer::drum(int drum, float volume, uint64_t start, uint64_t end) {
 #if defined(ENABLE_AUDIO) && !defined(NO_MUSIC)
-    int n;
-
-    if (!Mixer::hTsf) return -1;
+    if (!Mixer::hTsf) return false;
 
     drum = ((drum - 1) % (sizeof(drum_lut) / sizeof(drum_lut[0])));
 
-    if (drum_lut[drum] == -1) return -1;
-
-    Mixer::mutex.lock();
-
-    n = Mixer::sf2_seq++;
-    tsf_channel_set_presetnumber(Mixer::hTsf, n, drum_lut[drum], 1);
-    tsf_channel_set_volume(Mixer::hTsf, n, volume);
-    tsf_channel_note_on(Mixer::hTsf, n, drum_lut[drum], 1.0);
-
-    Mixer::notes[n] = Mixer::beatsToSec(beats);
-
-    Mixer::mutex.unlock();
+    if (drum_lut[drum] == -1) return false;
 
-    return n;
-#endif
-    return -1;
-}
-
-bool Mixer::isInstrumentPlaying(int channel) {
-#if defined(ENABLE_AUDIO) && !defined(NO_MUSIC)
-    bool v = false;
+    MixerCommand command;
+    command.type = MixerCommand::NoteOn;
+    command.note = Mixer::sf2_seq++;
+    command.preset = drum_lut[drum];
+    command.key = drum_lut[drum];
+    command.drums = true;
+    command.value = volume;
+    command.start = start;
+    command.end = end;
+    sendCommand(command);
 
-    if (!Mixer::hTsf) return 0;
-
-    Mixer::mutex.lock();
-
-    if (Mixer::notes.find(channel) != Mixer::notes.end() && Mixer::notes[channel]) v = true;
-
-    Mixer::mutex.unlock();
-
-    return v;
+    return true;
 #endif
-    return 0;
+    return false;
 }
@@ -21,11 +21,17 @@
 #endif
 #endif
 #include "nonstd/expected.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <miniz.h>
 #include <optional>
 #include <string>
 #include <thread.hpp>
 #include <unordered_map>
+#include <vector>
+
+class Sprite;
 
 enum SoundStreamTypes {
     SoundStreamUnknown = 0,
@@ -33,6 +39,7 @@ enum SoundStreamTypes {
     SoundStreamWAV,
     SoundStreamMP3,
     SoundStreamVorbis,
+    SoundStreamPCM,
 };
 
 class SoundConfig {
@@ -44,6 +51,73 @@ class SoundConfig {
     SoundConfig();
 };
 
+/**
+ * A fully decoded sound. Immutable once made, so any number of streams can play it at once.
+ */
+struct SoundBuffer {
+    std::vector<int16_t> samples; /* interleaved */
+    int channels = 0;
+    int rate = 0;
+    size_t frames = 0;
+
+    size_t getMemorySize() const {
+        return samples.size() * sizeof(int16_t);
+    }
+};
+
+/**
+ * Decoded sounds of the current project, so sounds that are played over and over aren't decoded every time.
+ * Only sounds up to `maxSeconds` long are kept; longer ones keep streaming from their compressed data. Once the
+ * sounds take more than `budget` bytes, the least recently played ones are dropped.
+ * Only used from the runtime thread.
+ */
+class SoundCache {
+  public:
+#if defined(__NDS__)
+    constexpr static size_t defaultBudget = 512 * 1024;
+    constexpr static float defaultMaxSeconds = 2.0f;
+#elif defined(__3DS__) || defined(GAMECUBE) || defined(__PSP__) || defined(WII)
+    constexpr static size_t defaultBudget = 4 * 1024 * 1024;
+    constexpr static float defaultMaxSeconds = 5.0f;
+#elif defined(VITA) || defined(__WIIU__) || defined(WEBOS)
+    constexpr static size_t defaultBudget = 16 * 1024 * 1024;
+    constexpr static float defaultMaxSeconds = 10.0f;
+#else
+    constexpr static size_t defaultBudget = 64 * 1024 * 1024;
+    constexpr static float defaultMaxSeconds = 10.0f;
+#endif
+
+    /**
+     * How many bytes of decoded sounds may stay cached. Set from the `soundCacheMB` setting.
+     */
+    static size_t budget;
+
+    /**
+     * The longest sound that is decoded up front. Set from the `soundCacheSeconds` setting.
+     */
+    static float maxSeconds;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t residentBytes = 0;
+    };
+    static Stats stats;
+
+    static std::shared_ptr<const SoundBuffer> find(const std::string &name);
+    static void insert(const std::string &name, std::shared_ptr<const SoundBuffer> buffer);
+    static void clear();
+
+  private:
+    struct Entry {
+        std::shared_ptr<const SoundBuffer> buffer;
+        uint64_t lastUsed;
+    };
+    static std::unordered_map<std::string, Entry> entries;
+    static uint64_t useCounter;
+};
+
 /* TODO: maybe make this modular? but it's not like we're going to support
  * more than wav/mp3
  */
@@ -56,6 +130,9 @@ class SoundStream {
     bool loadAsMP3();
     bool loadAsVorbis();
     bool loadFromBuffer();
+    bool decodeToPCM();
+    void closeDecoder();
+    void loadFromPCM(std::shared_ptr<const SoundBuffer> buffer);
     void commonInit();
 
   public:
@@ -68,26 +145,46 @@ class SoundStream {
     stb_vorbis *vorbis;
 #endif
 #endif
+    std::shared_ptr<const SoundBuffer> pcm;
+    size_t pcmPosition = 0;
 
     std::string name;
 
+    /**
+     * The sprite or clone playing the sound, or nullptr for sounds that don't belong to one (menu music, text to
+     * speech). The same sound can play once per owner at the same time.
+     */
+    Sprite *owner = nullptr;
+
+    /**
+     * The slot of the voice pool the stream plays in, or -1 before it was started.
+     */
+    int voice = -1;
+
     int type;
 
     int channels;
     int rate;
     SoundConfig config;
 
+    /**
+     * Set by the runtime once the stream was stopped.
+     */
     bool paused;
     bool auto_clean;
-    bool no_lock;
+
+    /**
+     * Set by the mixer once it stopped playing the stream and won't touch it again, so the runtime may delete it.
+     */
+    std::atomic<bool> finished{false};
 
     /**
      * Set if an error occurs in the constructor.
      */
     std::optional<std::string> error;
 
-    SoundStream(std::string path, bool cached = false, bool on_disk = false);
-    SoundStream(mz_zip_archive *zip, std::string path);
+    SoundStream(std::string path, bool cached = false, bool on_disk = false, Sprite *owner = nullptr);
+    SoundStream(mz_zip_archive *zip, std::string path, Sprite *owner = nullptr);
     SoundStream(std::string name, int (*callback)(SoundStream *strm, float *iwave, int length), int channels, int rate);
 
     nonstd::expected<void, std::string> init(std::string path, bool cached = false, bool on_disk = false);
@@ -106,28 +203,130 @@ class Mixer {
     static constexpr unsigned int rate = 48000;
 #endif
 
-    static SE_Mutex mutex;
+    /**
+     * How many sounds can play at once: `maxVoices` is the size of the voice pool, `defaultPolyphony` how much of it
+     * is used unless the `maxPolyphony` setting says otherwise.
+     */
+#if defined(__NDS__)
+    static constexpr int maxVoices = 16;
+    static constexpr int defaultPolyphony = 8;
+#elif defined(__3DS__) || defined(GAMECUBE) || defined(__PSP__) || defined(WII)
+    static constexpr int maxVoices = 32;
+    static constexpr int defaultPolyphony = 16;
+#else
+    static constexpr int maxVoices = 64;
+    static constexpr int defaultPolyphony = 32;
+#endif
+
+    /**
+     * Which voice gets cut off when a sound starts while `polyphony` sounds are already playing.
+     * Stopped sounds the mixer hasn't let go of yet are always taken first.
+     */
+    enum class StealPolicy {
+        Oldest,  // the sound that started first
+        Quietest // the sound with the lowest volume, then the oldest
+    };
+
+    static int polyphony;
+    static StealPolicy stealPolicy;
+
+    /**
+     * How sounds are resampled when their rate or pitch doesn't match the output. Set from the `audioInterpolation`
+     * setting ("linear" or "cubic") and used for sounds started afterwards.
+     */
+    enum class Interpolation {
+        Linear,
+        Cubic // 4-point Catmull-Rom, about twice the work of linear
+    };
+#if defined(__NDS__) || defined(__3DS__) || defined(GAMECUBE) || defined(__PSP__) || defined(WII)
+    static constexpr Interpolation defaultInterpolation = Interpolation::Linear;
+#else
+    static constexpr Interpolation defaultInterpolation = Interpolation::Cubic;
+#endif
+
+    static Interpolation interpolation;
+
 #ifdef ENABLE_AUDIO
     static tsf *hTsf;
 #endif
     static void *sf2_buffer;
     static int sf2_seq;
-    static std::unordered_map<std::string, SoundStream *> streams;
-    static std::unordered_map<int, float> notes;
+    /**
+     * Every stream that hasn't been deleted yet, oldest first. Only used from the runtime thread; the mixer gets told
+     * about changes through a lock-free command queue.
+     */
+    static std::vector<SoundStream *> streams;
     static std::unordered_map<std::string, SoundConfig> configs;
     static bool musicInitialized;
+
+    /**
+     * Allocates the buffers the mixer needs. Call before audio output starts.
+     */
+    static void init();
+
+    /**
+     * Deletes streams the mixer is done with. Called once per frame from the runtime thread.
+     */
+    static void update();
+
     static void initMusic();
-    static void requestSound(short *output, int frames); /* expects stereo */
-    static void stopSound(std::string name);
-    static bool isSoundPlaying(std::string name);
-    static void setPitch(std::string name, float pitch);
-    static void setPan(std::string name, float pan);
-    static void setSoundVolume(std::string name, float volume);
-    static float getSoundVolume(std::string name);
-    static void setAutoClean(std::string name, bool toggle);
+    static void requestSound(short *output, int frames); /* expects stereo, never allocates or locks */
+    /* these act on the newest stream with the given name and owner */
+    static void stopSound(std::string name, Sprite *owner = nullptr);
+    static bool isSoundPlaying(std::string name, Sprite *owner = nullptr);
+    static void setPitch(std::string name, float pitch, Sprite *owner = nullptr);
+    static void setPan(std::string name, float pan, Sprite *owner = nullptr);
+    static void setSoundVolume(std::string name, float volume, Sprite *owner = nullptr);
+    static float getSoundVolume(std::string name, Sprite *owner = nullptr);
+    static void setAutoClean(std::string name, bool toggle, Sprite *owner = nullptr);
+
+    /**
+     * Stops every sound played by `owner`.
+     */
+    static void stopSounds(Sprite *owner);
+
+    /**
+     * Stops every sound played by a sprite or clone.
+     */
+    static void stopAllSounds();
+
+    /**
+     * Applies the volume, pitch and pan of `owner` to the sounds it is playing.
+     */
+    static void updateSpriteEffects(Sprite *owner);
+
     static void cleanupAudio();
     static float beatsToSec(float v);
-    static int note(int instrument, int note, float volume, float beats);
-    static int drum(int drum, float volume, float beats);
-    static bool isInstrumentPlaying(int channel);
+
+    /**
+     * Converts `beats` to output frames at the current tempo.
+     */
+    static uint64_t beatsToFrames(float beats);
+
+    /**
+     * How many frames have been mixed since audio started. Music is scheduled on this timeline: a note may start at
+     * any frame in the future, and a frame that already passed means as soon as possible.
+     */
+    static uint64_t musicPosition();
+
+    /**
+     * Whether a script waiting for `time` on the music timeline may go on. This turns true at most one project frame
+     * before the mixer gets there.
+     */
+    static bool musicReached(uint64_t time);
+
+    /**
+     * Where a note or rest should start on the music timeline when the thread's previous one ends at `musicTime`:
+     * right on `musicTime` if the mixer only just passed it, so notes played back to back don't drift, otherwise now.
+     */
+    static uint64_t musicStart(uint64_t musicTime);
+
+    /**
+     * Whether notes and rests are timed by the music timeline, i.e. the music extension has loaded its soundfont.
+     */
+    static bool isMusicScheduled();
+
+    /* play from frame `start` up to frame `end` of the music timeline; false if the note can't be played */
+    static bool note(int instrument, int note, float volume, uint64_t start, uint64_t end);
+    static bool drum(int drum, float volume, uint64_t start, uint64_t end);
 };
@@ -0,0 +1,225 @@
+#include "decodePool.hpp"
+#include <algorithm>
+#include <deque>
+#include <log.hpp>
+#include <runtime.hpp>
+#include <thread.hpp>
+#include <unordered_map>
+#include <unzip.hpp>
+#ifdef __PC__
+#include <thread>
+#endif
+
+namespace {
+
+// An image that only holds CPU-side pixels, so it can be created off the main thread.
+class DecodedImage : public Image {
+  public:
+    DecodedImage(const std::string &filePath, bool bitmapHalfQuality, float scale) {
+        useDecodePool = false;
+        nonstd::expected<void, std::string> result;
+        if (Scratch::projectType == ProjectType::UNZIPPED) result = init(filePath, true, bitmapHalfQuality, scale);
+        else result = init(filePath, static_cast<mz_zip_archive *>(nullptr), bitmapHalfQuality, scale);
+        if (!result.has_value()) error = result.error();
+    }
+
+    void *getNativeTexture() override { return nullptr; }
+    void render(ImageRenderParams &params) override {}
+    void renderNineslice(double xPos, double yPos, double width, double height, double padding, bool centered = false) override {}
+
+  protected:
+    nonstd::expected<void, std::string> refreshTexture() override { return {}; }
+};
+
+struct Job {
+    std::string filePath;
+    bool bitmapHalfQuality;
+    float scale;
+};
+
+struct Entry {
+    bool done = false;
+    std::unique_ptr<Image> image;
+};
+
+struct Worker {
+    SE_Thread thread;
+    bool running = false;
+};
+
+} // namespace
+
+static SE_Mutex mutex;
+static unsigned int maxWorkers = 0;
+static std::vector<std::unique_ptr<Worker>> workers;
+static std::deque<Job> queue;
+static std::unordered_map<std::string, Entry> entries;
+static std::vector<std::string> finishedFiles;
+static size_t decoding = 0;
+
+static void workerMain(void *arg) {
+    Worker *worker = static_cast<Worker *>(arg);
+
+    while (true) {
+        mutex.lock();
+        if (queue.empty()) {
+            worker->running = false;
+            mutex.unlock();
+            return;
+        }
+        Job job = std::move(queue.front());
+        queue.pop_front();
+        decoding++;
+        mutex.unlock();
+
+        std::unique_ptr<Image> image = std::make_unique<DecodedImage>(job.filePath, job.bitmapHalfQuality, job.scale);
+
+        mutex.lock();
+        decoding--;
+        auto it = entries.find(job.filePath);
+        if (it != entries.end()) {
+            it->second.image = std::move(image);
+            it->second.done = true;
+            finishedFiles.push_back(job.filePath);
+        }
+        mutex.unlock();
+    }
+}
+
+unsigned int DecodePool::configuredWorkerCount() {
+    auto setting = Unzip::getSetting("decodeThreads");
+    if (setting.is_number_integer()) return static_cast<unsigned int>(std::max(1, setting.get<int>()));
+
+#if defined(__PC__)
+    return std::clamp(std::thread::hardware_concurrency(), 1u, 4u);
+#elif defined(__PS4__)
+    return 4;
+#elif defined(__SWITCH__)
+    return 3;
+#else
+    return 1;
+#endif
+}
+
+void DecodePool::start(unsigned int workerCount) {
+    stop();
+    mutex.init();
+    maxWorkers = workerCount;
+    if (maxWorkers < 2) return;
+
+    for (unsigned int i = 0; i < maxWorkers; i++)
+        workers.push_back(std::make_unique<Worker>());
+}
+
+void DecodePool::stop() {
+    mutex.lock();
+    for (const Job &job : queue)
+        entries.erase(job.filePath);
+    queue.clear();
+    mutex.unlock();
+
+    for (auto &worker : workers)
+        worker->thread.join();
+    workers.clear();
+
+    mutex.lock();
+    entries.clear();
+    finishedFiles.clear();
+    mutex.unlock();
+    maxWorkers = 0;
+}
+
+bool DecodePool::running() {
+    return maxWorkers >= 2;
+}
+
+void DecodePool::submit(const std::string &filePath, bool bitmapHalfQuality, float scale) {
+    if (!running()) return;
+
+    mutex.lock();
+    if (!entries.try_emplace(filePath).second) {
+        mutex.unlock();
+        return;
+    }
+    queue.push_back({filePath, bitmapHalfQuality, scale});
+
+    // start another worker if every running one already has something to do
+    Worker *idle = nullptr;
+    size_t runningWorkers = 0;
+    for (auto &worker : workers) {
+        if (worker->running) runningWorkers++;
+        else if (idle == nullptr) idle = worker.get();
+    }
+    if (idle == nullptr || queue.size() + decoding <= runningWorkers) {
+        mutex.unlock();
+        return;
+    }
+    idle->running = true;
+    mutex.unlock();
+
+    idle->thread.join();
+    if (idle->thread.create(workerMain, idle, 0x40000, 1, -1, "CostumeDecoder")) return;
+
+    Log::logWarning("Failed to start a costume decoding thread.");
+    mutex.lock();
+    idle->running = false;
+    if (runningWorkers == 0) {
+        // nobody is left to decode what's queued, so leave it to whoever needs it
+        for (const Job &job : queue)
+            entries.erase(job.filePath);
+        queue.clear();
+    }
+    mutex.unlock();
+}
+
+std::unique_ptr<Image> DecodePool::take(const std::string &filePath) {
+    if (!running()) return nullptr;
+
+    mutex.lock();
+    while (true) {
+        auto it = entries.find(filePath);
+        if (it == entries.end()) {
+            mutex.unlock();
+            return nullptr;
+        }
+
+        if (it->second.done) {
+            std::unique_ptr<Image> image = std::move(it->second.image);
+            entries.erase(it);
+            mutex.unlock();
+            return image;
+        }
+
+        // not started yet, so decoding it right here is quicker than waiting
+        auto queued = std::find_if(queue.begin(), queue.end(), [&](const Job &job) { return job.filePath == filePath; });
+        if (queued != queue.end()) {
+            queue.erase(queued);
+            entries.erase(it);
+            mutex.unlock();
+            return nullptr;
+        }
+
+        mutex.unlock();
+        SE_Thread::sleep(1);
+        mutex.lock();
+    }
+}
+
+std::vector<std::string> DecodePool::finished() {
+    std::vector<std::string> files;
+    if (!running()) return files;
+
+    mutex.lock();
+    files.swap(finishedFiles);
+    mutex.unlock();
+    return files;
+}
+
+size_t DecodePool::pending() {
+    if (!running()) return 0;
+
+    mutex.lock();
+    const size_t count = queue.size() + decoding;
+    mutex.unlock();
+    return count;
+}
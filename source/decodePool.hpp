@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <image.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Worker threads that decode and rasterise project costumes into CPU-side pixels.
+ * Nothing touches the GPU here; the main thread creates the image as usual, and `Image::init` takes over the pixels a
+ * worker already produced instead of decoding them again.
+ */
+class DecodePool {
+  public:
+    /**
+     * The number of decoding threads to use, from the project's `decodeThreads` setting or the platform's default.
+     */
+    static unsigned int configuredWorkerCount();
+
+    /**
+     * Lets up to `workers` threads decode costumes. With fewer than 2 workers, the pool stays off and costumes are
+     * decoded on the thread that needs them, like before.
+     * Threads are only started when there is work, and quit when the queue runs dry.
+     */
+    static void start(unsigned int workers);
+
+    /**
+     * Drops everything queued, waits for the workers to finish and frees all decoded images that were never taken.
+     */
+    static void stop();
+
+    static bool running();
+
+    /**
+     * Queues a costume of the project for decoding. Ignored if the costume is already queued or decoded.
+     */
+    static void submit(const std::string &filePath, bool bitmapHalfQuality, float scale);
+
+    /**
+     * Takes the decoded image for `filePath`, waiting for it if a worker is decoding it right now.
+     * Returns nullptr if nothing was decoded for it, in which case the caller should decode it itself.
+     */
+    static std::unique_ptr<Image> take(const std::string &filePath);
+
+    /**
+     * Returns the costumes that finished decoding since the last call.
+     */
+    static std::vector<std::string> finished();
+
+    /**
+     * The number of costumes that are queued or being decoded.
+     */
+    static size_t pending();
+};
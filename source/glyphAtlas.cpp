@@ -0,0 +1,80 @@
+#include "glyphAtlas.hpp"
+#include <algorithm>
+
+GlyphAtlas::GlyphAtlas(int pageSize, int maxPages, int border)
+    : pageSize(pageSize), maxPages(std::max(1, maxPages)), border(border) {
+}
+
+uint64_t GlyphAtlas::key(uint32_t codepoint, int pixelSize) {
+    return (static_cast<uint64_t>(codepoint) << 32) | static_cast<uint32_t>(pixelSize);
+}
+
+void GlyphAtlas::begin() {
+    clock++;
+}
+
+const GlyphAtlas::Glyph *GlyphAtlas::find(uint32_t codepoint, int pixelSize) {
+    auto it = glyphs.find(key(codepoint, pixelSize));
+    if (it == glyphs.end()) return nullptr;
+    touch(it->second.page);
+    return &it->second;
+}
+
+void GlyphAtlas::touch(int page) {
+    if (page >= 0 && static_cast<size_t>(page) < pages.size()) pages[page].lastUsed = clock;
+}
+
+std::optional<GlyphAtlas::Glyph> GlyphAtlas::placeOn(int page, int w, int h) {
+    AtlasPacker &packer = *pages[page].packer;
+    const auto id = packer.allocate(w + border * 2, h + border * 2);
+    if (!id) return std::nullopt;
+
+    Glyph glyph;
+    glyph.page = page;
+    glyph.rect = packer.get(*id).rect;
+    glyph.rect.x += border;
+    glyph.rect.y += border;
+    glyph.rect.w = w;
+    glyph.rect.h = h;
+    pages[page].lastUsed = clock;
+    return glyph;
+}
+
+void GlyphAtlas::evict(int page) {
+    for (auto it = glyphs.begin(); it != glyphs.end();) {
+        if (it->second.page == page)
+            it = glyphs.erase(it);
+        else
+            ++it;
+    }
+    pages[page].packer = std::make_unique<AtlasPacker>(pageSize, pageSize, 1);
+    evictions++;
+}
+
+std::optional<GlyphAtlas::Glyph> GlyphAtlas::insert(uint32_t codepoint, int pixelSize, int w, int h) {
+    if (w <= 0 || h <= 0 || w + border * 2 > pageSize || h + border * 2 > pageSize) return std::nullopt;
+
+    std::optional<Glyph> glyph;
+    for (size_t i = 0; i < pages.size() && !glyph; i++)
+        glyph = placeOn(static_cast<int>(i), w, h);
+
+    if (!glyph && static_cast<int>(pages.size()) < maxPages) {
+        pages.push_back({std::make_unique<AtlasPacker>(pageSize, pageSize, 1), clock});
+        glyph = placeOn(static_cast<int>(pages.size() - 1), w, h);
+    }
+
+    if (!glyph) {
+        // empty the page used longest ago, as long as nothing in the current use is on it
+        int oldest = -1;
+        for (size_t i = 0; i < pages.size(); i++) {
+            if (pages[i].lastUsed == clock) continue;
+            if (oldest < 0 || pages[i].lastUsed < pages[oldest].lastUsed) oldest = static_cast<int>(i);
+        }
+        if (oldest < 0) return std::nullopt;
+        evict(oldest);
+        glyph = placeOn(oldest, w, h);
+    }
+
+    if (glyph) glyphs[key(codepoint, pixelSize)] = *glyph;
+    return glyph;
+}
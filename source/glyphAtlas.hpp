@@ -0,0 +1,79 @@
+#pragma once
+#include "atlasPacker.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Keeps track of where the glyphs of one font live on a few fixed-size atlas pages, keyed by codepoint and the pixel
+ * size they were rasterised at. Once every page is full, the page used longest ago is emptied for the new glyph.
+ *
+ * Only does the bookkeeping, like `AtlasPacker`: the renderer rasterises glyphs, owns the page textures and copies
+ * pixels in. Nothing here touches a graphics API.
+ */
+class GlyphAtlas {
+  public:
+    struct Glyph {
+        int page = -1;
+        AtlasPacker::Rect rect; // without the border
+    };
+
+    /**
+     * @param border Empty pixels kept around every glyph so filtering never picks up a neighbour.
+     */
+    GlyphAtlas(int pageSize, int maxPages, int border = 1);
+
+    /**
+     * Starts a new use of the atlas, such as laying out one string. Pages touched since the last call are never
+     * emptied, so glyphs looked up earlier in the same use stay valid.
+     */
+    void begin();
+
+    /**
+     * Where the glyph is, if it's on a page. Marks its page as used.
+     */
+    const Glyph *find(uint32_t codepoint, int pixelSize);
+
+    /**
+     * Finds room for a `w`×`h` glyph, emptying the least recently used page if no page has any.
+     * The caller has to copy the glyph's pixels, surrounded by `border` empty pixels, to the rect grown by `border`.
+     * @return Where it went, or nothing if it's too big for a page or every page was touched since `begin`.
+     */
+    std::optional<Glyph> insert(uint32_t codepoint, int pixelSize, int w, int h);
+
+    /**
+     * Marks `page` as used, for glyphs found some other way (such as a cached run).
+     */
+    void touch(int page);
+
+    /**
+     * How many pages have been emptied so far. Anything that remembers where glyphs are is stale once this changes.
+     */
+    uint64_t getEvictions() const { return evictions; }
+
+    int getPageSize() const { return pageSize; }
+    size_t getPageCount() const { return pages.size(); }
+    size_t getGlyphCount() const { return glyphs.size(); }
+    int getBorder() const { return border; }
+
+  private:
+    struct Page {
+        std::unique_ptr<AtlasPacker> packer;
+        uint64_t lastUsed = 0;
+    };
+
+    int pageSize;
+    int maxPages;
+    int border;
+    uint64_t clock = 0;
+    uint64_t evictions = 0;
+    std::vector<Page> pages;
+    std::unordered_map<uint64_t, Glyph> glyphs;
+
+    static uint64_t key(uint32_t codepoint, int pixelSize);
+    std::optional<Glyph> placeOn(int page, int w, int h);
+    void evict(int page);
+};
@@ -0,0 +1,248 @@
+#include "golden.hpp"
+#ifdef __PC__
+
+#include <algorithm>
+#include <blockExecutor.hpp>
+#include <cstdlib>
+#include <filesystem.hpp>
+#include <fstream>
+#include <log.hpp>
+#include <map>
+#include <math.hpp>
+#include <render.hpp>
+#include <runtime.hpp>
+#include <sprite.hpp>
+#include <timer.hpp>
+#include <unzip.hpp>
+
+namespace Golden {
+
+static nlohmann::json valueToJson(const Value &value) {
+    if (value.isBoolean()) return value.asBoolean();
+    if (value.isDouble()) return Math::toString(value.asDouble());
+    return value.asString();
+}
+
+static std::string numberToString(double number) {
+    return Math::toString(std::round(number * 1e6) / 1e6);
+}
+
+static nlohmann::json spriteToJson(Sprite *sprite) {
+    nlohmann::json out;
+    out["name"] = sprite->name;
+    out["isStage"] = sprite->isStage;
+    out["isClone"] = sprite->isClone;
+    out["layer"] = Scratch::getLayer(sprite);
+    out["visible"] = sprite->visible;
+    out["x"] = numberToString(sprite->xPosition);
+    out["y"] = numberToString(sprite->yPosition);
+    out["size"] = numberToString(sprite->size);
+    out["direction"] = numberToString(sprite->rotation);
+    out["rotationStyle"] = sprite->rotationStyle == Sprite::ALL_AROUND ? "all around" : sprite->rotationStyle == Sprite::LEFT_RIGHT ? "left-right"
+                                                                                                                                    : "don't rotate";
+    out["draggable"] = sprite->draggable;
+    out["costume"] = sprite->currentCostume;
+    if (sprite->currentCostume >= 0 && sprite->currentCostume < static_cast<int>(sprite->costumes.size()))
+        out["costumeName"] = sprite->costumes[sprite->currentCostume].name;
+
+    out["effects"] = {
+        {"ghost", numberToString(sprite->ghostEffect)},
+        {"brightness", numberToString(sprite->brightnessEffect)},
+        {"color", numberToString(sprite->colorEffect)},
+        {"fisheye", numberToString(sprite->fisheyeEffect)},
+        {"whirl", numberToString(sprite->whirlEffect)},
+        {"pixelate", numberToString(sprite->pixelateEffect)},
+        {"mosaic", numberToString(sprite->mosaicEffect)}};
+
+    out["sound"] = {
+        {"volume", numberToString(sprite->volume)},
+        {"pitch", numberToString(sprite->pitch)},
+        {"pan", numberToString(sprite->pan)}};
+
+    out["pen"] = {
+        {"down", sprite->penData.down},
+        {"size", numberToString(sprite->penData.size)},
+        {"hue", numberToString(sprite->penData.color.hue)},
+        {"saturation", numberToString(sprite->penData.color.saturation)},
+        {"brightness", numberToString(sprite->penData.color.brightness)},
+        {"transparency", numberToString(sprite->penData.color.transparency)}};
+
+    // Sorted by ID so the output doesn't depend on hash map ordering
+    std::map<std::string, const Variable *> variables;
+    for (const auto &[id, var] : sprite->variables) {
+        if (id.rfind("SE!__", 0) == 0) continue; // debug variables change every run
+        variables[id] = &var;
+    }
+    out["variables"] = nlohmann::json::object();
+    for (const auto &[id, var] : variables) {
+        out["variables"][id] = {{"name", var->name}, {"value", valueToJson(var->value)}};
+    }
+
+    std::map<std::string, const List *> lists;
+    for (const auto &[id, list] : sprite->lists) {
+        lists[id] = &list;
+    }
+    out["lists"] = nlohmann::json::object();
+    for (const auto &[id, list] : lists) {
+        nlohmann::json items = nlohmann::json::array();
+        for (const Value &item : list->items) {
+            items.push_back(valueToJson(item));
+        }
+        out["lists"][id] = {{"name", list->name}, {"items", items}};
+    }
+
+    return out;
+}
+
+nlohmann::json snapshot() {
+    nlohmann::json out;
+
+    // Scratch::sprites is kept in front to back order, so this doubles as the layer order.
+    nlohmann::json sprites = nlohmann::json::array();
+    for (Sprite *sprite : Scratch::sprites) {
+        if (sprite->toDelete) continue;
+        sprites.push_back(spriteToJson(sprite));
+    }
+    out["sprites"] = sprites;
+    out["cloneCount"] = Scratch::cloneCount;
+    out["answer"] = Scratch::answer;
+    out["tempo"] = numberToString(Scratch::tempo);
+
+    return out;
+}
+
+static std::string projectBaseName() {
+    std::string name = Unzip::filePath;
+    while (!name.empty() && (name.back() == '/' || name.back() == '\\'))
+        name.pop_back();
+
+    const size_t slash = name.find_last_of("/\\");
+    if (slash != std::string::npos) name = name.substr(slash + 1);
+    const size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot != 0) name = name.substr(0, dot);
+    return name.empty() ? "project" : name;
+}
+
+static bool compareSnapshot(const std::string &path, const nlohmann::json &actual, bool update) {
+    if (update) {
+        std::ofstream file(path);
+        if (!file) {
+            Log::logError("Failed to write golden: " + path);
+            return false;
+        }
+        file << actual.dump(2) << "\n";
+        Log::log("Updated golden: " + path);
+        return true;
+    }
+
+    std::ifstream file(path);
+    if (!file) {
+        Log::logError("Missing golden: " + path + " (run with --update-goldens to create it)");
+        return false;
+    }
+
+    nlohmann::json expected;
+    try {
+        expected = nlohmann::json::parse(file);
+    } catch (const nlohmann::json::parse_error &e) {
+        Log::logError("Failed to parse golden " + path + ": " + e.what());
+        return false;
+    }
+
+    if (expected == actual) return true;
+
+    const nlohmann::json patch = nlohmann::json::diff(expected, actual);
+    Log::logError("Snapshot mismatch in " + path + " (" + std::to_string(patch.size()) + " differences)");
+
+    constexpr size_t maxReported = 20;
+    for (size_t i = 0; i < patch.size() && i < maxReported; i++) {
+        const nlohmann::json &op = patch[i];
+        const std::string opPath = op["path"].get<std::string>();
+        const nlohmann::json::json_pointer pointer(opPath);
+        std::string line = "  " + op["op"].get<std::string>() + " " + opPath;
+        if (expected.contains(pointer)) line += "  expected: " + expected[pointer].dump();
+        if (actual.contains(pointer)) line += "  actual: " + actual[pointer].dump();
+        Log::logError(line);
+    }
+    if (patch.size() > maxReported) Log::logError("  ...");
+
+    return false;
+}
+
+int run(const Options &options) {
+    std::vector<unsigned int> snapshotFrames = options.snapshotFrames;
+    snapshotFrames.push_back(options.frames);
+    std::sort(snapshotFrames.begin(), snapshotFrames.end());
+    snapshotFrames.erase(std::unique(snapshotFrames.begin(), snapshotFrames.end()), snapshotFrames.end());
+
+    if (!options.goldenDir.empty() && !FileSystem::fileExists(options.goldenDir)) {
+        if (!options.updateGoldens) {
+            Log::logError("Golden directory does not exist: " + options.goldenDir);
+            return 1;
+        }
+        auto created = FileSystem::createDirectory(options.goldenDir);
+        if (!created.has_value()) {
+            Log::logError("Failed to create golden directory: " + created.error());
+            return 1;
+        }
+    }
+
+    const std::string prefix = (options.goldenDir.empty() ? "" : options.goldenDir + "/") + projectBaseName();
+
+    srand(options.seed);
+    Timer::setFixedClock(true);
+    Scratch::streamCostumes = false;
+
+    Scratch::initializeScratchProject();
+    ScriptThread monitorDisplayThread;
+
+    bool passed = true;
+    bool stopped = false;
+    size_t nextSnapshot = 0;
+    for (unsigned int frame = 1; frame <= options.frames && nextSnapshot < snapshotFrames.size(); frame++) {
+        // advance by exactly one frame so every step renders and timers move the same amount each run
+        Timer::advanceFixedClock(1000.0 / Scratch::FPS);
+
+        if (!Scratch::stepScratchProject(monitorDisplayThread).first) {
+            // the project already cleaned itself up, so there's nothing left to snapshot
+            Log::logError("Project stopped after " + std::to_string(frame) + " of " + std::to_string(options.frames) + " frames.");
+            passed = false;
+            stopped = true;
+            break;
+        }
+
+        if (frame != snapshotFrames[nextSnapshot]) continue;
+        nextSnapshot++;
+
+        const std::string path = prefix + ".frame" + std::to_string(frame);
+        if (!compareSnapshot(path + ".json", snapshot(), options.updateGoldens)) passed = false;
+#ifdef RENDERER_HEADLESS
+        if (options.captureFrames) {
+            auto captured = Render::captureFrame(path + ".png");
+            if (!captured.has_value()) Log::logWarning("Failed to capture frame: " + captured.error());
+        }
+#endif
+    }
+
+    if (!stopped) Scratch::cleanupScratchProject();
+    Timer::setFixedClock(false);
+
+    Log::log(std::string(passed ? "PASS " : "FAIL ") + projectBaseName());
+    return passed ? 0 : 1;
+}
+
+} // namespace Golden
+
+#else
+
+namespace Golden {
+nlohmann::json snapshot() {
+    return nlohmann::json::object();
+}
+
+int run(const Options &options) {
+    return 1;
+}
+} // namespace Golden
+
+#endif
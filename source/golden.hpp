@@ -0,0 +1,52 @@
+#pragma once
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+namespace Golden {
+
+struct Options {
+    /**
+     * Directory the golden snapshots are read from (and written to with `updateGoldens`).
+     */
+    std::string goldenDir;
+
+    /**
+     * Total number of frames to step the project for.
+     */
+    unsigned int frames = 300;
+
+    /**
+     * Frames (1-based) to take a snapshot at. The last frame is always snapshotted.
+     */
+    std::vector<unsigned int> snapshotFrames;
+
+    /**
+     * Seed passed to `srand` before the project starts.
+     */
+    unsigned int seed = 0;
+
+    /**
+     * Overwrite the goldens with the current results instead of comparing against them.
+     */
+    bool updateGoldens = false;
+
+    /**
+     * [Headless] Also write a PNG of the frame next to each snapshot.
+     */
+    bool captureFrames = false;
+};
+
+/**
+ * Builds a canonical JSON snapshot of every sprite's state (position, costume, effects, variables, lists and layer order).
+ * The output only depends on project state, so two identical runs always produce the same snapshot.
+ */
+nlohmann::json snapshot();
+
+/**
+ * Steps the currently loaded project with a fixed seed and a fixed timestep, and compares snapshots against the goldens.
+ * @return 0 if every snapshot matched (or goldens were updated), 1 otherwise.
+ */
+int run(const Options &options);
+
+} // namespace Golden
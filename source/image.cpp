@@ -1,8 +1,12 @@
 #include "image.hpp"
 #include "nonstd/expected.hpp"
 #include "os.hpp"
+#include <decodePool.hpp>
+#include <mutex>
+#include <pixelKernels.hpp>
 #include <stdexcept>
 #include <string_view>
+#include <thread.hpp>
 #include <unzip.hpp>
 #ifdef ENABLE_BITMAP
 #ifdef __WIIU__
@@ -50,6 +54,8 @@ std::unordered_map<std::string, SVGFont> Image::loadedFonts = {
     {"Marker", {"gfx/ingame/fonts/Knewave-Regular", false}},
     {"Curly", {"gfx/ingame/fonts/Griffy-Regular", false}},
     {"Pixel", {"gfx/ingame/fonts/Grand9KPixel", false}}};
+
+static SE_Mutex fontMutex;
 #endif
 
 constexpr unsigned int maxScale = 5; // TODO: Make project setting, set to 0 to remove scaling limit.
@@ -202,43 +208,14 @@ nonstd::expected<std::vector<unsigned char>, std::string> Image::readFileToBuffe
 }
 
 #ifdef ENABLE_SVG
-inline void reorderPixels(unsigned char *src, unsigned char *dst, const size_t pixelsSize) {
-    for (size_t i = 0; i < pixelsSize; i += 4) {
-#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
-        unsigned char a = src[i + 0];
-        unsigned char r = src[i + 1];
-        unsigned char g = src[i + 2];
-        unsigned char b = src[i + 3];
-#else
-        unsigned char b = src[i + 0];
-        unsigned char g = src[i + 1];
-        unsigned char r = src[i + 2];
-        unsigned char a = src[i + 3];
-#endif
-        // LunaSVG multiplies the colors when there's alpha present, so we gotta un-mulitply it
-        if (a > 0 && a < 255) {
-            r = (unsigned char)((r * 255) / a);
-            g = (unsigned char)((g * 255) / a);
-            b = (unsigned char)((b * 255) / a);
-        }
-
-        dst[i + 0] = r;
-        dst[i + 1] = g;
-        dst[i + 2] = b;
-        dst[i + 3] = a;
-    }
-}
-#endif
-
-nonstd::expected<unsigned char *, std::string> Image::loadSVGFromMemory(const char *data, size_t size, int &width, int &height, float scale) {
-#ifdef ENABLE_SVG
-    if constexpr (maxScale != 0)
-        if (scale > maxScale) scale = maxScale;
-
+nonstd::expected<void, std::string> Image::parseSVG(const char *data, size_t size) {
     const std::string_view svgView(data, size);
 
+    // lunasvg's font faces are global, so costumes decoded on DecodePool workers add fonts and lay out text one at a time
+    std::unique_lock<SE_Mutex> fontLock(fontMutex);
+
     // always load default font if there is text present
-    if (svgView.find("<text") != std::string_view::npos || svgView.find("<tspan") != std::string_view::npos) {
+    if (svgHasText) {
         loadFont("");
     }
 
@@ -250,14 +227,19 @@ nonstd::expected<unsigned char *, std::string> Image::loadSVGFromMemory(const ch
         }
     }
 
+    if (!svgHasText) fontLock.unlock();
+
     svgDocument = lunasvg::Document::loadFromData(std::string(data, size).c_str());
     if (!svgDocument) return nonstd::make_unexpected("LunaSVG failed to parse SVG");
+    return {};
+}
 
+nonstd::expected<unsigned char *, std::string> Image::rasteriseSVG(float scale, int &width, int &height, float &finalScale) {
     const float targetWidth = svgDocument->width() * scale;
     const float targetHeight = svgDocument->height() * scale;
 
     const auto [maxWidth, maxHeight] = maxTextureSize;
-    float finalScale = scale;
+    finalScale = scale;
     if (maxWidth > 0 && maxHeight > 0) {
         if (targetWidth > maxWidth || targetHeight > maxHeight) {
             const float ratioWidth = (float)maxWidth / targetWidth;
@@ -268,9 +250,11 @@ nonstd::expected<unsigned char *, std::string> Image::loadSVGFromMemory(const ch
 
     width = std::max(1, (int)(svgDocument->width() * finalScale));
     height = std::max(1, (int)(svgDocument->height() * finalScale));
-    imgData.scale = finalScale;
 
+    std::unique_lock<SE_Mutex> fontLock(fontMutex, std::defer_lock);
+    if (svgHasText) fontLock.lock();
     auto bitmap = svgDocument->renderToBitmap(width, height);
+    if (fontLock.owns_lock()) fontLock.unlock();
     if (!bitmap.valid()) return nonstd::make_unexpected("LunaSVG failed to render SVG to bitmap");
 
     unsigned char *src = bitmap.data();
@@ -278,11 +262,54 @@ nonstd::expected<unsigned char *, std::string> Image::loadSVGFromMemory(const ch
     unsigned char *dst = (unsigned char *)malloc(pixelsSize);
     if (!dst) return nonstd::make_unexpected("Failed to allocate SVG pixels buffer");
 
-    reorderPixels(src, dst, pixelsSize);
+    PixelKernels::unpremultiply(src, dst, static_cast<size_t>(width) * height);
+    return dst;
+}
+#endif
+
+nonstd::expected<unsigned char *, std::string> Image::loadSVGFromMemory(const char *data, size_t size, int &width, int &height, float scale, bool bitmapHalfQuality, const std::string &cacheName) {
+#ifdef ENABLE_SVG
+    if constexpr (maxScale != 0)
+        if (scale > maxScale) scale = maxScale;
+
+    const std::string_view svgView(data, size);
+    svgHasText = svgView.find("<text") != std::string_view::npos || svgView.find("<tspan") != std::string_view::npos;
+
+    svgCacheKey = SVGCache::Key();
+    if (!cacheName.empty() && SVGCache::enabled()) {
+        svgCacheKey.asset = cacheName;
+        svgCacheKey.sourceCrc = static_cast<uint32_t>(mz_crc32(MZ_CRC32_INIT, reinterpret_cast<const unsigned char *>(data), size));
+        svgCacheKey.sourceSize = size;
+        svgCacheKey.bitmapHalfQuality = bitmapHalfQuality;
+        svgCacheKey.maxTextureWidth = maxTextureSize.first;
+        svgCacheKey.maxTextureHeight = maxTextureSize.second;
+
+        // cached costumes are rasterised a little larger, at one of a few scales, so resized sprites find them too
+        scale = SVGCache::bucket(scale);
+        if constexpr (maxScale != 0)
+            if (scale > maxScale) scale = maxScale;
+
+        float finalScale;
+        if (unsigned char *pixels = SVGCache::load(svgCacheKey, scale, width, height, finalScale)) {
+            svgSource.assign(data, size);
+            imgData.scale = finalScale;
+            imgData.pitch = width * 4;
+            return pixels;
+        }
+    }
+
+    auto parsed = parseSVG(data, size);
+    if (!parsed.has_value()) return nonstd::make_unexpected(parsed.error());
 
+    float finalScale;
+    auto pixels = rasteriseSVG(scale, width, height, finalScale);
+    if (!pixels.has_value()) return pixels;
+    if (!svgCacheKey.asset.empty()) SVGCache::store(svgCacheKey, scale, pixels.value(), width, height, finalScale);
+
+    imgData.scale = finalScale;
     imgData.pitch = width * 4;
 
-    return dst;
+    return pixels;
 #endif
     width = 0;
     height = 0;
@@ -297,42 +324,37 @@ nonstd::expected<void, std::string> Image::resizeSVG(float scale) {
     if constexpr (maxScale != 0)
         if (scale > maxScale) scale = maxScale;
 
-    if (!svgDocument || scale <= imgData.scale) return {};
-
-    // TODO: De-duplicate code.
-
-    const float targetWidth = svgDocument->width() * scale;
-    const float targetHeight = svgDocument->height() * scale;
+    if ((!svgDocument && svgSource.empty()) || scale <= imgData.scale) return {};
+
+    int width, height;
+    float finalScale;
+    unsigned char *dst = nullptr;
+    // resizing only reads the cache: writing a raster for every step of a growing sprite would stall the frame
+    if (!svgCacheKey.asset.empty()) {
+        float cachedScale = SVGCache::bucket(scale);
+        if constexpr (maxScale != 0)
+            if (cachedScale > maxScale) cachedScale = maxScale;
+        dst = SVGCache::load(svgCacheKey, cachedScale, width, height, finalScale);
+    }
 
-    const auto [maxWidth, maxHeight] = maxTextureSize;
-    float finalScale = scale;
-    if (maxWidth > 0 && maxHeight > 0) {
-        if (targetWidth > maxWidth || targetHeight > maxHeight) {
-            const float ratioWidth = (float)maxWidth / targetWidth;
-            const float ratioHeight = (float)maxHeight / targetHeight;
-            finalScale *= std::min(ratioWidth, ratioHeight);
+    if (!dst) {
+        if (!svgDocument) {
+            auto parsed = parseSVG(svgSource.data(), svgSource.size());
+            if (!parsed.has_value()) return parsed;
+            svgSource.clear();
+            svgSource.shrink_to_fit();
         }
+
+        auto pixels = rasteriseSVG(scale, width, height, finalScale);
+        if (!pixels.has_value()) return nonstd::make_unexpected(pixels.error());
+        dst = pixels.value();
     }
 
-    const int width = std::max(1, (int)(svgDocument->width() * finalScale));
-    const int height = std::max(1, (int)(svgDocument->height() * finalScale));
+    if (imgData.pixels != nullptr) free(imgData.pixels);
 
     imgData.width = width;
     imgData.height = height;
     imgData.scale = finalScale;
-
-    auto bitmap = svgDocument->renderToBitmap(width, height);
-    if (!bitmap.valid()) return nonstd::make_unexpected("LunaSVG failed to render SVG to bitmap");
-
-    unsigned char *src = bitmap.data();
-    const size_t pixelsSize = width * height * 4;
-    unsigned char *dst = (unsigned char *)malloc(pixelsSize);
-    if (!dst) return nonstd::make_unexpected("Failed to allocate SVG pixels buffer");
-
-    reorderPixels(src, dst, pixelsSize);
-
-    if (imgData.pixels != nullptr) free(imgData.pixels);
-
     imgData.pitch = width * 4;
     imgData.pixels = dst;
 
@@ -350,22 +372,9 @@ unsigned char *Image::resizeRaster(const unsigned char *srcPixels, int srcW, int
     if (outH <= 0) outH = 1;
 
     unsigned char *dst = (unsigned char *)malloc(outW * outH * 4);
+    if (!dst) return nullptr;
 
-    const int srcStride = srcW * 4;
-    const int dstStride = outW * 4;
-
-    for (int y = 0; y < outH; ++y) {
-        const unsigned char *srcRow = srcPixels + (y << 1) * srcStride;
-        unsigned char *dstRow = dst + y * dstStride;
-
-        for (int x = 0; x < outW; ++x) {
-            const unsigned char *p = srcRow + (x << 1) * 4;
-
-            *(uint32_t *)dstRow = *(const uint32_t *)p;
-
-            dstRow += 4;
-        }
-    }
+    PixelKernels::downsample2x(srcPixels, srcW, srcH, dst, outW, outH);
 
     return dst;
 }
@@ -411,7 +420,33 @@ Image::Image(std::string filePath, mz_zip_archive *zip, bool bitmapHalfQuality,
     if (!potentialError.has_value()) error = potentialError.error();
 }
 
+bool Image::adopt(Image &decoded) {
+    const auto [maxWidth, maxHeight] = maxTextureSize;
+    if (maxWidth > 0 && maxHeight > 0 && (static_cast<unsigned int>(decoded.imgData.width) > maxWidth || static_cast<unsigned int>(decoded.imgData.height) > maxHeight)) return false;
+
+    if (imgData.pixels) free(imgData.pixels);
+    imgData = decoded.imgData;
+    decoded.imgData = ImageData();
+#ifdef ENABLE_SVG
+    svgDocument = std::move(decoded.svgDocument);
+    svgHasText = decoded.svgHasText;
+    svgCacheKey = std::move(decoded.svgCacheKey);
+    svgSource = std::move(decoded.svgSource);
+    // the pixels fit, so rasterising with this image's texture size limit would have given the same result
+    svgCacheKey.maxTextureWidth = maxTextureSize.first;
+    svgCacheKey.maxTextureHeight = maxTextureSize.second;
+#endif
+    return true;
+}
+
 nonstd::expected<void, std::string> Image::init(std::string filePath, bool fromScratchProject, bool bitmapHalfQuality, float scale) {
+    if (fromScratchProject && useDecodePool) {
+        if (auto decoded = DecodePool::take(filePath)) {
+            if (decoded->error.has_value()) return nonstd::make_unexpected(decoded->error.value());
+            if (adopt(*decoded)) return {};
+        }
+    }
+
     if (fromScratchProject) {
         if (Unzip::UnpackedInSD) filePath = Unzip::filePath + filePath;
         else filePath = OS::getRomFSLocation() + "project/" + filePath;
@@ -423,7 +458,8 @@ nonstd::expected<void, std::string> Image::init(std::string filePath, bool fromS
     if (!buffer.has_value()) return nonstd::make_unexpected(buffer.error());
 
     if (isSVG) {
-        auto pixels = loadSVGFromMemory(reinterpret_cast<const char *>(buffer.value().data()), buffer.value().size(), imgData.width, imgData.height);
+        const std::string cacheName = fromScratchProject ? filePath.substr(filePath.find_last_of('/') + 1) : "";
+        auto pixels = loadSVGFromMemory(reinterpret_cast<const char *>(buffer.value().data()), buffer.value().size(), imgData.width, imgData.height, scale, bitmapHalfQuality, cacheName);
         if (!pixels.has_value()) return nonstd::make_unexpected(pixels.error());
         imgData.pixels = pixels.value();
     } else {
@@ -438,14 +474,22 @@ nonstd::expected<void, std::string> Image::init(std::string filePath, bool fromS
 }
 
 nonstd::expected<void, std::string> Image::init(std::string filePath, mz_zip_archive *zip, bool bitmapHalfQuality, float scale) {
+    if (useDecodePool) {
+        if (auto decoded = DecodePool::take(filePath)) {
+            if (decoded->error.has_value()) return nonstd::make_unexpected(decoded->error.value());
+            if (adopt(*decoded)) return {};
+        }
+    }
+
     std::unique_ptr<void, decltype(&mz_free)> file_data(nullptr, mz_free);
     size_t file_size;
-    if (zip != nullptr) {
-        int file_index = mz_zip_reader_locate_file(zip, filePath.c_str(), nullptr, 0);
+    if (zip != nullptr && zip != &Unzip::zipArchive) {
+        int file_index = Unzip::findFile(zip, filePath);
         if (file_index < 0) return nonstd::make_unexpected("Image not found in SB3: " + filePath);
 
         file_data.reset(mz_zip_reader_extract_to_heap(zip, file_index, &file_size, 0));
     } else {
+        // the project's archive is shared with the decode workers, so it's only read under its lock
         file_data.reset(Unzip::getFileInSB3(filePath, &file_size));
     }
 
@@ -460,7 +504,8 @@ nonstd::expected<void, std::string> Image::init(std::string filePath, mz_zip_arc
         memcpy(buffer.data(), file_data.get(), file_size);
         buffer[file_size] = '\0';
 
-        auto pixels = loadSVGFromMemory(reinterpret_cast<const char *>(buffer.data()), file_size, imgData.width, imgData.height, scale);
+        const std::string cacheName = filePath.substr(filePath.find_last_of('/') + 1);
+        auto pixels = loadSVGFromMemory(reinterpret_cast<const char *>(buffer.data()), file_size, imgData.width, imgData.height, scale, bitmapHalfQuality, cacheName);
         if (!pixels.has_value()) return nonstd::make_unexpected(pixels.error());
         imgData.pixels = pixels.value();
     } else {
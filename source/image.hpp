@@ -3,8 +3,10 @@
 #include <optional>
 #ifdef ENABLE_SVG
 #include "lunasvg.h"
+#include <svgCache.hpp>
 #endif
 #include <cstddef>
+#include <cstdint>
 #include <memory.h>
 #include <miniz.h>
 #include <sprite.hpp>
@@ -63,11 +65,24 @@ class Image {
 #ifdef ENABLE_SVG
     std::unique_ptr<lunasvg::Document> svgDocument = nullptr;
     static std::unordered_map<std::string, SVGFont> loadedFonts;
+    bool svgHasText = false;
+    SVGCache::Key svgCacheKey;
+    /**
+     * The SVG the pixels came from, kept when they were loaded from `SVGCache` so the document can still be parsed if
+     * the image has to be rasterised at a new scale.
+     */
+    std::string svgSource;
+
+    nonstd::expected<void, std::string> parseSVG(const char *data, size_t size);
+    nonstd::expected<unsigned char *, std::string> rasteriseSVG(float scale, int &width, int &height, float &finalScale);
 #endif
 
     bool loadFont(const std::string &family);
     inline nonstd::expected<std::vector<unsigned char>, std::string> readFileToBuffer(const std::string &filePath, bool fromScratchProject);
-    inline nonstd::expected<unsigned char *, std::string> loadSVGFromMemory(const char *data, size_t size, int &width, int &height, float scale = 1);
+    /**
+     * @param cacheName File name to look the raster up by in `SVGCache`, or empty to always rasterise.
+     */
+    inline nonstd::expected<unsigned char *, std::string> loadSVGFromMemory(const char *data, size_t size, int &width, int &height, float scale = 1, bool bitmapHalfQuality = false, const std::string &cacheName = "");
     inline nonstd::expected<unsigned char *, std::string> loadRasterFromMemory(const unsigned char *data, size_t size, int &width, int &height, bool bitmapHalfQuality = false);
     inline unsigned char *resizeRaster(const unsigned char *srcPixels, int srcW, int srcH, int &outW, int &outH);
 
@@ -78,9 +93,33 @@ class Image {
 
     std::pair<unsigned int, unsigned int> maxTextureSize = {0, 0};
 
+    /**
+     * Whether `init` may take over pixels `DecodePool` already decoded for the file.
+     */
+    bool useDecodePool = true;
+
+    /**
+     * Moves the pixels (and SVG document) of `decoded` into this image. Fails if they don't fit in `maxTextureSize`.
+     */
+    bool adopt(Image &decoded);
+
   public:
-    const unsigned int maxFreeTimer = 540;
-    unsigned int freeTimer = maxFreeTimer;
+    /**
+     * Frame counter the costume cache uses to find the least recently drawn images. Advanced once per rendered frame.
+     */
+    static inline uint64_t currentFrame = 0;
+    uint64_t lastUsedFrame = 0;
+
+    inline void markUsed() {
+        lastUsedFrame = currentFrame;
+    }
+
+    /**
+     * Bytes of pixel data the image keeps resident (width × height × bytes per pixel).
+     */
+    size_t getMemorySize() const {
+        return static_cast<size_t>(imgData.width) * imgData.height * (imgData.format == IMAGE_FORMAT_PAL8 ? 1 : 4);
+    }
 
     /**
      * Set if an error occurs in the constructor.
@@ -1,8 +1,11 @@
 #include "inspector.hpp"
 #ifdef ENABLE_INSPECTOR
 
+#include <audiostack.hpp>
 #include <blockExecutor.hpp>
+#include <fstream>
 #include <iostream>
+#include <profiler.hpp>
 #include <queue>
 #include <render.hpp>
 #include <runtime.hpp>
@@ -11,6 +14,7 @@
 #include <sstream>
 #include <string>
 #include <thread.hpp>
+#include <tracer.hpp>
 #include <vector>
 
 namespace Inspector {
@@ -30,10 +34,7 @@ static Sprite *findSprite(const std::string &name) {
     if (!name.empty() && name[0] == '@') {
         try {
             int layer = std::stoi(name.substr(1));
-            for (Sprite *s : Scratch::sprites) {
-                if (s->layer == layer) return s;
-            }
-            if (Scratch::stageSprite && Scratch::stageSprite->layer == layer) return Scratch::stageSprite;
+            if (layer >= 0 && layer < (int)Scratch::sprites.size()) return Scratch::sprites[Scratch::sprites.size() - 1 - layer];
         } catch (...) {
         }
     }
@@ -131,6 +132,10 @@ void processCommands() {
                           << "  watch, unwatch, clearwatch - Real-time variable tracking\n"
                           << "[Control]\n"
                           << "  flag, stop               - Start or stop project execution\n"
+                          << "[Performance]\n"
+                          << "  profile start/stop/dump  - Per-block execution counters and timing\n"
+                          << "  trace start/stop/save    - Record frame phases for Perfetto\n"
+                          << "  cache                    - Costume image and decoded sound cache usage\n"
                           << "Syntax: Use 'SpriteName:Var' for locals, '@Layer' for specefic sprite at a certain layer (including stage and clones).\n\n";
             } else if (subCmd == "inspect" || subCmd == "inspectext") {
                 std::cout << "Usage: " << subCmd << " <name or @layer>\n"
@@ -148,6 +153,15 @@ void processCommands() {
             } else if (subCmd == "listset" || subCmd == "listadd" || subCmd == "listremove" || subCmd == "listclear") {
                 std::cout << "List commands use 1-based indexing.\n"
                           << "Example: listset Sprite1:myList 1 newItem\n";
+            } else if (subCmd == "profile") {
+                std::cout << "Usage: profile start [interval] | profile stop | profile dump [time|calls|avg|yields] [limit] | profile dump json [file]\n"
+                          << "Counts every block call and times one call out of every [interval] (default 16).\n"
+                          << "Requires a build configured with -DSE_PROFILE=ON.\n";
+            } else if (subCmd == "trace") {
+                std::cout << "Usage: trace start | trace stop | trace save <file>\n"
+                          << "Records frame phases, threads, clones and asset loads into a ring buffer of the last " << Tracer::CAPACITY << " events.\n"
+                          << "'trace save' writes a Chrome trace_event JSON file that can be opened in Perfetto.\n"
+                          << "Requires a build configured with -DSE_PROFILE=ON.\n";
             } else {
                 std::cout << "No extra info for '" << subCmd << "'.\n";
             }
@@ -157,7 +171,7 @@ void processCommands() {
             SpeechManager *sm = Render::getSpeechManager();
             for (Sprite *s : Scratch::sprites) {
                 if (onlyClones && !s->isClone) continue;
-                std::cout << s->name << " | Vis: " << (s->visible ? "true" : "false") << " | Pos: (" << s->xPosition << ", " << s->yPosition << ") | Layer: " << s->layer;
+                std::cout << s->name << " | Vis: " << (s->visible ? "true" : "false") << " | Pos: (" << s->xPosition << ", " << s->yPosition << ") | Layer: " << Scratch::getLayer(s);
                 if (sm) {
                     std::string text = sm->getSpeechText(s);
                     if (!text.empty()) {
@@ -187,7 +201,7 @@ void processCommands() {
                           << "Rotation: " << target->rotation << "\n"
                           << "Size: " << target->size << "%\n"
                           << "Visible: " << (target->visible ? "true" : "false") << "\n"
-                          << "Layer: " << target->layer << "\n"
+                          << "Layer: " << Scratch::getLayer(target) << "\n"
                           << "Is Clone: " << (target->isClone ? "true" : "false") << "\n"
                           << "Costumes: " << target->costumes.size() << " (Current: " << target->currentCostume << ")\n"
                           << "Sounds: " << target->sounds.size() << "\n";
@@ -298,6 +312,77 @@ void processCommands() {
             }
         } else if (cmd == "clearwatch") {
             watchedVars.clear();
+        } else if (cmd == "cache") {
+            const Scratch::CostumeCacheStats &stats = Scratch::costumeCacheStats;
+            std::cout << "Costume images: " << Scratch::costumeImages.size() << "\n"
+                      << "Resident: " << stats.residentBytes / 1024 << " KiB of " << Scratch::costumeCacheBudget / 1024 << " KiB\n"
+                      << "Hits: " << stats.hits << ", misses: " << stats.misses << ", evictions: " << stats.evictions << "\n";
+#ifdef ENABLE_AUDIO
+            const SoundCache::Stats &soundStats = SoundCache::stats;
+            std::cout << "Decoded sounds: " << soundStats.residentBytes / 1024 << " KiB of " << SoundCache::budget / 1024 << " KiB\n"
+                      << "Hits: " << soundStats.hits << ", misses: " << soundStats.misses << ", evictions: " << soundStats.evictions << "\n";
+#endif
+        } else if (cmd == "profile") {
+#ifdef ENABLE_PROFILER
+            std::string subCmd = parseArg(ss, false);
+            if (subCmd == "start") {
+                std::string interval = parseArg(ss, false);
+                Profiler::start(interval.empty() ? 16 : static_cast<uint32_t>(std::strtoul(interval.c_str(), nullptr, 10)));
+                std::cout << "Profiling started (timing 1 in " << Profiler::sampleInterval << " calls).\n";
+            } else if (subCmd == "stop") {
+                Profiler::stop();
+                std::cout << "Profiling stopped.\n";
+            } else if (subCmd == "dump") {
+                std::string format = parseArg(ss, false);
+                if (format == "json") {
+                    std::string path = parseArg(ss, true);
+                    const std::string json = Profiler::dumpJson().dump(2);
+                    if (path.empty()) {
+                        std::cout << json << "\n";
+                    } else {
+                        std::ofstream file(path);
+                        if (file) {
+                            file << json << "\n";
+                            std::cout << "Wrote profile to " << path << "\n";
+                        } else {
+                            std::cout << "Failed to open '" << path << "' for writing.\n";
+                        }
+                    }
+                } else {
+                    Profiler::SortKey key = Profiler::SortKey::TIME;
+                    if (format == "calls") key = Profiler::SortKey::CALLS;
+                    else if (format == "avg") key = Profiler::SortKey::AVERAGE;
+                    else if (format == "yields") key = Profiler::SortKey::YIELDS;
+                    std::string limit = parseArg(ss, false);
+                    Profiler::dumpText(std::cout, key, limit.empty() ? 30 : std::strtoul(limit.c_str(), nullptr, 10));
+                }
+            } else {
+                std::cout << "Usage: profile start [interval] | stop | dump [time|calls|avg|yields|json]\n";
+            }
+#else
+            std::cout << "Profiling is not available in this build. Configure with -DSE_PROFILE=ON.\n";
+#endif
+        } else if (cmd == "trace") {
+#ifdef ENABLE_PROFILER
+            std::string subCmd = parseArg(ss, false);
+            if (subCmd == "start") {
+                Tracer::start();
+                std::cout << "Tracing started.\n";
+            } else if (subCmd == "stop") {
+                Tracer::stop();
+                std::cout << "Tracing stopped.\n";
+            } else if (subCmd == "save") {
+                std::string path = parseArg(ss, true);
+                if (path.empty()) path = "trace.json";
+                auto written = Tracer::write(path);
+                if (written.has_value()) std::cout << "Wrote trace to " << path << "\n";
+                else std::cout << written.error() << "\n";
+            } else {
+                std::cout << "Usage: trace start | stop | save <file>\n";
+            }
+#else
+            std::cout << "Tracing is not available in this build. Configure with -DSE_PROFILE=ON.\n";
+#endif
         } else if (cmd == "flag") {
             Scratch::greenFlagClicked();
         } else if (cmd == "stop") {
@@ -0,0 +1,314 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * A sequence of distinct items that can be inserted, removed and moved anywhere, and asked for their position, in
+ * O(log n). Kept as a treap ordered by position, with subtree sizes to count positions and parent links to walk up
+ * from an item. Iterating it in order costs O(1) per step on average.
+ */
+template <typename T>
+class LayerList {
+    struct Node {
+        T value;
+        Node *left = nullptr;
+        Node *right = nullptr;
+        Node *parent = nullptr;
+        size_t size = 1;
+        uint32_t priority = 0;
+    };
+
+  public:
+    class iterator {
+      public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        iterator() = default;
+
+        reference operator*() const { return node->value; }
+        pointer operator->() const { return &node->value; }
+
+        iterator &operator++() {
+            node = next(node);
+            return *this;
+        }
+        iterator operator++(int) {
+            iterator old = *this;
+            ++*this;
+            return old;
+        }
+        iterator &operator--() {
+            node = node ? previous(node) : rightmost(list->root);
+            return *this;
+        }
+        iterator operator--(int) {
+            iterator old = *this;
+            --*this;
+            return old;
+        }
+
+        bool operator==(const iterator &other) const { return node == other.node; }
+        bool operator!=(const iterator &other) const { return node != other.node; }
+
+      private:
+        friend class LayerList;
+        iterator(const LayerList *list, Node *node) : list(list), node(node) {}
+
+        const LayerList *list = nullptr;
+        Node *node = nullptr;
+    };
+    using const_iterator = iterator;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+
+    LayerList() = default;
+    LayerList(const LayerList &) = delete;
+    LayerList &operator=(const LayerList &) = delete;
+    ~LayerList() { clear(); }
+
+    size_t size() const { return sizeOf(root); }
+    bool empty() const { return root == nullptr; }
+
+    iterator begin() const { return iterator(this, leftmost(root)); }
+    iterator end() const { return iterator(this, nullptr); }
+    reverse_iterator rbegin() const { return reverse_iterator(end()); }
+    reverse_iterator rend() const { return reverse_iterator(begin()); }
+
+    /**
+     * Where `value` is, or `end()` if it isn't in the list.
+     */
+    iterator find(const T &value) const {
+        auto it = nodes.find(value);
+        return iterator(this, it == nodes.end() ? nullptr : it->second);
+    }
+
+    bool contains(const T &value) const { return nodes.count(value) != 0; }
+
+    /**
+     * The item at `index`, which has to be less than `size()`.
+     */
+    const T &operator[](size_t index) const {
+        Node *node = root;
+        while (true) {
+            const size_t before = sizeOf(node->left);
+            if (index == before) return node->value;
+            if (index < before) node = node->left;
+            else {
+                index -= before + 1;
+                node = node->right;
+            }
+        }
+    }
+
+    const T &front() const { return leftmost(root)->value; }
+    const T &back() const { return rightmost(root)->value; }
+
+    /**
+     * Where `value` is, counted from the front. It has to be in the list.
+     */
+    size_t indexOf(const T &value) const { return position(nodes.at(value)); }
+
+    void reserve(size_t count) { nodes.reserve(count); }
+
+    void push_back(const T &value) { insert(size(), value); }
+
+    /**
+     * Puts `value`, which mustn't be in the list yet, at `index` (clamped to `size()`).
+     */
+    void insert(size_t index, const T &value) {
+        Node *node = new Node{value};
+        node->priority = nextPriority();
+        nodes.emplace(value, node);
+        attach(node, index);
+    }
+
+    /**
+     * Moves `value` to `index` (clamped to the last position).
+     */
+    void move(const T &value, size_t index) {
+        Node *node = detach(nodes.at(value));
+        attach(node, index);
+    }
+
+    void erase(const T &value) {
+        auto it = nodes.find(value);
+        if (it == nodes.end()) return;
+        delete detach(it->second);
+        nodes.erase(it);
+    }
+
+    /**
+     * Removes every item `remove` returns true for, in one pass. `remove` sees the items in order and may free them.
+     */
+    template <typename Predicate>
+    void eraseIf(Predicate remove) {
+        std::vector<Node *> kept = inOrder();
+        size_t count = 0;
+        for (Node *node : kept) {
+            if (remove(node->value)) {
+                nodes.erase(node->value);
+                delete node;
+            } else {
+                kept[count++] = node;
+            }
+        }
+        kept.resize(count);
+        root = build(kept);
+    }
+
+    void clear() {
+        for (Node *node : inOrder())
+            delete node;
+        root = nullptr;
+        nodes.clear();
+    }
+
+  private:
+    Node *root = nullptr;
+    std::unordered_map<T, Node *> nodes;
+    uint32_t seed = 2463534242u;
+
+    uint32_t nextPriority() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+    static size_t sizeOf(const Node *node) { return node ? node->size : 0; }
+
+    static size_t position(const Node *node) {
+        size_t index = sizeOf(node->left);
+        for (; node->parent; node = node->parent) {
+            if (node == node->parent->right) index += sizeOf(node->parent->left) + 1;
+        }
+        return index;
+    }
+
+    static void update(Node *node) {
+        node->size = 1 + sizeOf(node->left) + sizeOf(node->right);
+        if (node->left) node->left->parent = node;
+        if (node->right) node->right->parent = node;
+    }
+
+    static Node *leftmost(Node *node) {
+        if (!node) return nullptr;
+        while (node->left)
+            node = node->left;
+        return node;
+    }
+
+    static Node *rightmost(Node *node) {
+        if (!node) return nullptr;
+        while (node->right)
+            node = node->right;
+        return node;
+    }
+
+    static Node *next(Node *node) {
+        if (node->right) return leftmost(node->right);
+        while (node->parent && node == node->parent->right)
+            node = node->parent;
+        return node->parent;
+    }
+
+    static Node *previous(Node *node) {
+        if (node->left) return rightmost(node->left);
+        while (node->parent && node == node->parent->left)
+            node = node->parent;
+        return node->parent;
+    }
+
+    // every node from front to back, collected before any of them is unlinked or freed
+    std::vector<Node *> inOrder() const {
+        std::vector<Node *> ordered;
+        ordered.reserve(size());
+        for (Node *node = leftmost(root); node; node = next(node))
+            ordered.push_back(node);
+        return ordered;
+    }
+
+    // splits `node` into its first `count` items and the rest
+    static void split(Node *node, size_t count, Node *&first, Node *&rest) {
+        if (!node) {
+            first = rest = nullptr;
+            return;
+        }
+        if (sizeOf(node->left) < count) {
+            split(node->right, count - sizeOf(node->left) - 1, node->right, rest);
+            first = node;
+        } else {
+            split(node->left, count, first, node->left);
+            rest = node;
+        }
+        update(node);
+    }
+
+    static Node *merge(Node *first, Node *rest) {
+        if (!first || !rest) return first ? first : rest;
+        if (first->priority > rest->priority) {
+            first->right = merge(first->right, rest);
+            update(first);
+            return first;
+        }
+        rest->left = merge(first, rest->left);
+        update(rest);
+        return rest;
+    }
+
+    void setRoot(Node *node) {
+        root = node;
+        if (root) root->parent = nullptr;
+    }
+
+    void attach(Node *node, size_t index) {
+        node->left = node->right = nullptr;
+        node->size = 1;
+        Node *first, *rest;
+        split(root, index, first, rest);
+        setRoot(merge(merge(first, node), rest));
+    }
+
+    Node *detach(Node *node) {
+        Node *first, *middle, *rest;
+        split(root, position(node), first, middle);
+        split(middle, 1, middle, rest);
+        setRoot(merge(first, rest));
+        return middle;
+    }
+
+    // links `ordered` into a treap in O(n), keeping each node's priority
+    Node *build(const std::vector<Node *> &ordered) {
+        std::vector<Node *> spine; // the right edge of the tree so far, root first
+        for (Node *node : ordered) {
+            node->left = node->right = nullptr;
+            Node *below = nullptr;
+            while (!spine.empty() && spine.back()->priority < node->priority) {
+                below = spine.back();
+                spine.pop_back();
+            }
+            node->left = below;
+            if (!spine.empty()) spine.back()->right = node;
+            spine.push_back(node);
+        }
+        if (spine.empty()) return nullptr;
+
+        fixUp(spine.front());
+        spine.front()->parent = nullptr;
+        return spine.front();
+    }
+
+    // sets sizes and parents, children first
+    static void fixUp(Node *node) {
+        if (node->left) fixUp(node->left);
+        if (node->right) fixUp(node->right);
+        update(node);
+    }
+};
@@ -5,11 +5,16 @@
 #ifdef ENABLE_MENU
 #include <menus/mainMenu.hpp>
 #endif
+#include <audioRender.hpp>
 #include <cstdlib>
+#include <golden.hpp>
 #include <inspector.hpp>
 #include <menus/mainMenu.hpp>
 #include <render.hpp>
+#include <replay.hpp>
 #include <runtime.hpp>
+#include <svgCache.hpp>
+#include <tracer.hpp>
 #include <unzip.hpp>
 
 #ifdef ENABLE_AUDIO
@@ -27,6 +32,7 @@
 #endif
 
 static void exitApp() {
+    Tracer::shutdown();
     Render::deInit();
     OS::deinit();
 }
@@ -107,10 +113,52 @@ int main(int argc, char **argv) {
     srand(time(NULL));
 
     bool enableInspector = false;
+    bool goldenMode = false;
+    bool warmCache = false;
+    std::string recordPath;
+    std::string replayPath;
+    Golden::Options goldenOptions;
+    bool renderAudio = false;
+    AudioRender::Options audioOptions;
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg == "--inspector") {
             enableInspector = true;
+        } else if (arg == "--golden" && i + 1 < argc) {
+            goldenMode = true;
+            goldenOptions.goldenDir = argv[++i];
+        } else if (arg == "--frames" && i + 1 < argc) {
+            goldenOptions.frames = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--snapshot" && i + 1 < argc) {
+            std::string frames = argv[++i];
+            size_t start = 0;
+            while (start < frames.size()) {
+                size_t end = frames.find(',', start);
+                if (end == std::string::npos) end = frames.size();
+                if (end > start) goldenOptions.snapshotFrames.push_back(static_cast<unsigned int>(std::strtoul(frames.substr(start, end - start).c_str(), nullptr, 10)));
+                start = end + 1;
+            }
+        } else if (arg == "--seed" && i + 1 < argc) {
+            goldenOptions.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--trace" && i + 1 < argc) {
+            Tracer::setExitPath(argv[++i]);
+            Tracer::start();
+        } else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (arg == "--warm-cache") {
+            warmCache = true;
+        } else if (arg == "--render-audio" && i + 1 < argc) {
+            renderAudio = true;
+            audioOptions.outputPath = argv[++i];
+        } else if (arg == "--audio-reference" && i + 1 < argc) {
+            renderAudio = true;
+            audioOptions.referencePath = argv[++i];
+        } else if (arg == "--update-goldens") {
+            goldenOptions.updateGoldens = true;
+        } else if (arg == "--capture-frames") {
+            goldenOptions.captureFrames = true;
         } else if (Unzip::filePath.empty()) {
 #if defined(__PC__)
             Unzip::filePath = arg;
@@ -134,6 +182,75 @@ int main(int argc, char **argv) {
     }
 #endif
 
+#ifdef __PC__
+    if (!replayPath.empty()) {
+#ifdef WINDOWING_HEADLESS
+        auto loaded = Replay::loadReplay(replayPath);
+        if (!loaded.has_value()) {
+            Log::logError(loaded.error());
+            exitApp();
+            return 1;
+        }
+        if (Unzip::filePath.empty()) Unzip::filePath = Replay::getProjectPath();
+        if (!Unzip::load()) {
+            Log::logError("Failed to load project for replay: " + Unzip::filePath);
+            exitApp();
+            return 1;
+        }
+        const int result = Replay::run();
+        exitApp();
+        return result;
+#else
+        Log::logError("Replaying input requires the headless windowing backend (-DSE_WINDOWING=headless).");
+        exitApp();
+        return 1;
+#endif
+    }
+
+    if (warmCache) {
+        if (!Unzip::load()) {
+            Log::logError("Failed to load project to warm the cache for: " + Unzip::filePath);
+            exitApp();
+            return 1;
+        }
+        const size_t rasterised = SVGCache::warm();
+        Log::log("Rasterised " + std::to_string(rasterised) + " SVG costumes into the cache.");
+        exitApp();
+        return 0;
+    }
+
+    if (goldenMode) {
+        if (!Unzip::load()) {
+            Log::logError("Failed to load project for golden run: " + Unzip::filePath);
+            exitApp();
+            return 1;
+        }
+        const int result = Golden::run(goldenOptions);
+        exitApp();
+        return result;
+    }
+
+    if (renderAudio) {
+#ifdef AUDIO_HEADLESS
+        if (!Unzip::load()) {
+            Log::logError("Failed to load project to render audio for: " + Unzip::filePath);
+            exitApp();
+            return 1;
+        }
+        audioOptions.frames = goldenOptions.frames;
+        audioOptions.seed = goldenOptions.seed;
+        const int result = AudioRender::run(audioOptions);
+        exitApp();
+        return result;
+#else
+        // a real device would keep pulling from the mixer on its own thread while the render does too
+        Log::logError("Rendering audio requires the headless audio backend (-DSE_AUDIO_ENGINE=headless).");
+        exitApp();
+        return 1;
+#endif
+    }
+#endif
+
     if (!Unzip::load()) {
         if (Unzip::projectOpened == -3) {
 #ifdef __EMSCRIPTEN__
@@ -162,6 +279,13 @@ int main(int argc, char **argv) {
         }
     }
 
+#ifdef __PC__
+    if (!recordPath.empty()) {
+        auto started = Replay::startRecording(recordPath);
+        if (!started.has_value()) Log::logError(started.error());
+    }
+#endif
+
 #ifdef __EMSCRIPTEN__
     emscripten_set_main_loop(mainLoop, 0, 1);
 #else
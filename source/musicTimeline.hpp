@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * The timing rules for notes and rests on the music timeline (see `Mixer::musicPosition`). They only look at the
+ * positions passed in, so they can be checked without a mixer.
+ */
+namespace MusicTimeline {
+
+/**
+ * Whether a script waiting for `time` may go on, with the mixer at `position` and a project frame lasting
+ * `frameLength` timeline frames. This turns true at most one project frame early: the script would otherwise only
+ * notice on the frame after, and a note it queues next starts on `time` anyway (see `nextStart`).
+ */
+inline bool reached(uint64_t position, uint64_t time, uint64_t frameLength) {
+    return position + frameLength >= time;
+}
+
+/**
+ * Where a note or rest should start when the thread's previous one ends at `musicTime` and the mixer is at `position`.
+ * It follows right on from the previous one as long as the mixer is at most `slack` frames past it, even though the
+ * start is then already mixed, so back-to-back notes stay on the beat. After a longer pause it starts at `position`.
+ */
+inline uint64_t nextStart(uint64_t musicTime, uint64_t position, uint64_t slack) {
+    return musicTime + slack >= position ? musicTime : position;
+}
+
+} // namespace MusicTimeline
@@ -0,0 +1,106 @@
+#include "penBuffer.hpp"
+#include <algorithm>
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static bool sameColor(PenBuffer::Color a, PenBuffer::Color b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+int PenBuffer::capSegments(float radius) {
+    constexpr float tolerance = 1.0f / 3.0f;
+    if (radius <= tolerance) return 2;
+    // the widest step that keeps the chord within `tolerance` of the circle
+    const float step = 2.0f * std::acos(1.0f - tolerance / radius);
+    return std::clamp(static_cast<int>(std::ceil(M_PI / step)), 2, 64);
+}
+
+void PenBuffer::line(float x1, float y1, float x2, float y2, float radius, Color color, bool rounded) {
+    if (!strokes.empty()) {
+        Stroke &last = strokes.back();
+        if (color.a == 255 && sameColor(last.color, color) && last.radius == radius && last.rounded == rounded && last.x2 == x1 && last.y2 == y1) {
+            const float ax = last.x2 - last.x1, ay = last.y2 - last.y1;
+            const float bx = x2 - x1, by = y2 - y1;
+            const float lengths = std::sqrt((ax * ax + ay * ay) * (bx * bx + by * by));
+            const float cross = ax * by - ay * bx;
+            const float dot = ax * bx + ay * by;
+            if (lengths > 0.0f && std::fabs(cross) <= lengths * 1e-5f && dot > 0.0f) {
+                last.x2 = x2;
+                last.y2 = y2;
+                return;
+            }
+        }
+    }
+    strokes.push_back({x1, y1, x2, y2, radius, color, rounded});
+}
+
+void PenBuffer::dot(float x, float y, float radius, Color color, bool rounded) {
+    if (!strokes.empty()) {
+        const Stroke &last = strokes.back();
+        if (color.a == 255 && sameColor(last.color, color) && last.radius >= radius && last.rounded && rounded && last.x2 == x && last.y2 == y)
+            return;
+    }
+    strokes.push_back({x, y, x, y, radius, color, rounded});
+}
+
+void PenBuffer::arc(float cx, float cy, float radius, float startAngle, float sweep, int segments, Color color) {
+    const float step = sweep / segments;
+    float px = cx + std::cos(startAngle) * radius;
+    float py = cy + std::sin(startAngle) * radius;
+    for (int i = 1; i <= segments; i++) {
+        const float angle = startAngle + step * i;
+        const float nx = cx + std::cos(angle) * radius;
+        const float ny = cy + std::sin(angle) * radius;
+        vertices.push_back({cx, cy, color.r, color.g, color.b, color.a});
+        vertices.push_back({px, py, color.r, color.g, color.b, color.a});
+        vertices.push_back({nx, ny, color.r, color.g, color.b, color.a});
+        px = nx;
+        py = ny;
+    }
+}
+
+void PenBuffer::quad(float ax, float ay, float bx, float by, float cx, float cy, float dx, float dy, Color color) {
+    const PenVertex a = {ax, ay, color.r, color.g, color.b, color.a};
+    const PenVertex b = {bx, by, color.r, color.g, color.b, color.a};
+    const PenVertex c = {cx, cy, color.r, color.g, color.b, color.a};
+    const PenVertex d = {dx, dy, color.r, color.g, color.b, color.a};
+    vertices.insert(vertices.end(), {a, b, c, a, c, d});
+}
+
+const std::vector<PenVertex> &PenBuffer::tessellate() {
+    vertices.clear();
+    for (const Stroke &stroke : strokes) {
+        const float r = stroke.radius;
+        const float dx = stroke.x2 - stroke.x1;
+        const float dy = stroke.y2 - stroke.y1;
+        const float length = std::sqrt(dx * dx + dy * dy);
+
+        if (length <= 0.001f) {
+            if (stroke.rounded)
+                arc(stroke.x1, stroke.y1, r, 0.0f, 2.0f * M_PI, capSegments(r) * 2, stroke.color);
+            else
+                quad(stroke.x1 - r, stroke.y1 - r, stroke.x1 + r, stroke.y1 - r, stroke.x1 + r, stroke.y1 + r, stroke.x1 - r, stroke.y1 + r, stroke.color);
+            continue;
+        }
+
+        // the body, then half circles on the outside of each end so nothing is covered twice
+        const float nx = -dy / length * r;
+        const float ny = dx / length * r;
+        quad(stroke.x1 + nx, stroke.y1 + ny, stroke.x2 + nx, stroke.y2 + ny, stroke.x2 - nx, stroke.y2 - ny, stroke.x1 - nx, stroke.y1 - ny, stroke.color);
+        if (!stroke.rounded) continue;
+
+        const int segments = capSegments(r);
+        const float phi = std::atan2(dy, dx);
+        arc(stroke.x2, stroke.y2, r, phi - M_PI / 2.0f, M_PI, segments, stroke.color);
+        arc(stroke.x1, stroke.y1, r, phi + M_PI / 2.0f, M_PI, segments, stroke.color);
+    }
+    return vertices;
+}
+
+void PenBuffer::clear() {
+    strokes.clear();
+    vertices.clear();
+}
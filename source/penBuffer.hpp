@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * A vertex of the pen triangle list, in pen layer pixels.
+ */
+struct PenVertex {
+    float x;
+    float y;
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+};
+
+/**
+ * Queues the pen lines and dots drawn while threads run, so a renderer can put them on the pen layer with a single
+ * draw instead of one per move.
+ *
+ * Lines that continue an opaque line of the same color and size in the same direction are merged into it, and dots
+ * that an opaque line's end already covers are dropped; this doesn't change what ends up on the pen layer.
+ * Translucent strokes are kept apart, since their overlapping ends are visibly darker.
+ * Doesn't touch a graphics API.
+ */
+class PenBuffer {
+  public:
+    struct Color {
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+        uint8_t a;
+    };
+
+    /**
+     * Queue at most this many strokes before flushing, so a frame that never gets rendered can't grow the buffer
+     * forever.
+     */
+    static constexpr size_t flushThreshold = 16384;
+
+    /**
+     * Queues a line from (x1, y1) to (x2, y2).
+     * @param rounded Whether the ends get round caps. Without them the line is a plain quad.
+     */
+    void line(float x1, float y1, float x2, float y2, float radius, Color color, bool rounded = true);
+
+    /**
+     * Queues a dot at (x, y).
+     * @param rounded Whether the dot is a circle. Without it the dot is a square.
+     */
+    void dot(float x, float y, float radius, Color color, bool rounded = true);
+
+    /**
+     * Triangles (three vertices each) for everything queued, in the order it was queued.
+     */
+    const std::vector<PenVertex> &tessellate();
+
+    void clear();
+
+    bool empty() const { return strokes.empty(); }
+    size_t size() const { return strokes.size(); }
+
+    /**
+     * Segments in a half circle of `radius`, so no point of the outline is more than a third of a pixel off.
+     */
+    static int capSegments(float radius);
+
+  private:
+    struct Stroke {
+        float x1, y1, x2, y2;
+        float radius;
+        Color color;
+        bool rounded;
+    };
+
+    std::vector<Stroke> strokes;
+    std::vector<PenVertex> vertices;
+
+    void arc(float cx, float cy, float radius, float startAngle, float sweep, int segments, Color color);
+    void quad(float ax, float ay, float bx, float by, float cx, float cy, float dx, float dy, Color color);
+};
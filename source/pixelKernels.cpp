@@ -0,0 +1,453 @@
+#include "pixelKernels.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define SE_KERNELS_X86
+#include <immintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SE_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace PixelKernels {
+
+// ---- scalar ----
+
+static void unpremultiplyScalar(const uint8_t *src, uint8_t *dst, size_t pixelCount) {
+    for (size_t i = 0; i < pixelCount * 4; i += 4) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        unsigned char a = src[i + 0];
+        unsigned char r = src[i + 1];
+        unsigned char g = src[i + 2];
+        unsigned char b = src[i + 3];
+#else
+        unsigned char b = src[i + 0];
+        unsigned char g = src[i + 1];
+        unsigned char r = src[i + 2];
+        unsigned char a = src[i + 3];
+#endif
+        // LunaSVG multiplies the colors when there's alpha present, so we gotta un-mulitply it
+        if (a > 0 && a < 255) {
+            r = (unsigned char)((r * 255) / a);
+            g = (unsigned char)((g * 255) / a);
+            b = (unsigned char)((b * 255) / a);
+        }
+
+        dst[i + 0] = r;
+        dst[i + 1] = g;
+        dst[i + 2] = b;
+        dst[i + 3] = a;
+    }
+}
+
+// Colors are averaged weighted by alpha, so the color of transparent pixels doesn't bleed into the edges of what's
+// drawn: each is the sum of c * a over the sum of a, rounded. Blocks that are transparent throughout come out black.
+static void downsampleRowScalar(const uint8_t *row0, const uint8_t *row1, int srcWidth, uint8_t *dst, int x, int dstWidth) {
+    for (; x < dstWidth; x++) {
+        const int x0 = x * 2 * 4;
+        const int x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+        const uint8_t *block[4] = {row0 + x0, row0 + x1, row1 + x0, row1 + x1};
+
+        const int alpha = block[0][3] + block[1][3] + block[2][3] + block[3][3];
+        for (int c = 0; c < 3; c++) {
+            const int weighted = block[0][c] * block[0][3] + block[1][c] * block[1][3] + block[2][c] * block[2][3] + block[3][c] * block[3][3];
+            dst[x * 4 + c] = static_cast<uint8_t>(alpha > 0 ? (weighted + alpha / 2) / alpha : 0);
+        }
+        dst[x * 4 + 3] = static_cast<uint8_t>((alpha + 2) >> 2);
+    }
+}
+
+static void downsampleRowScalar(const uint8_t *row0, const uint8_t *row1, int srcWidth, uint8_t *dst, int dstWidth) {
+    downsampleRowScalar(row0, row1, srcWidth, dst, 0, dstWidth);
+}
+
+static void extractAlphaScalar(const uint8_t *src, uint8_t *dst, size_t count) {
+    for (size_t i = 0; i < count; i++)
+        dst[i] = src[i * 4 + 3];
+}
+
+#if defined(SE_KERNELS_X86) || defined(SE_KERNELS_NEON)
+// Multiplying by these and truncating gives exactly (c * 255) / a for every c and every 0 < a < 255; the slight bias
+// keeps results that should be whole numbers from landing just below them. a = 0 and a = 255 leave colors as they are.
+static float colorScale[256];
+static constexpr float alphaScale = 1.0f + 1.0f / (1 << 18);
+
+static void initColorScale() {
+    colorScale[0] = alphaScale;
+    colorScale[255] = alphaScale;
+    for (int a = 1; a < 255; a++)
+        colorScale[a] = 255.0f / a * alphaScale;
+}
+#endif
+
+#ifdef SE_KERNELS_X86
+
+// ---- SSE2 ----
+
+static inline __m128i swizzleSSE2(__m128i px) {
+    const __m128i ag = _mm_and_si128(px, _mm_set1_epi32(static_cast<int>(0xFF00FF00)));
+    const __m128i rb = _mm_and_si128(px, _mm_set1_epi32(0x00FF00FF));
+    return _mm_or_si128(ag, _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16)));
+}
+
+// all four pixels are fully opaque or fully transparent, so only the channels need swapping
+static inline bool solidSSE2(__m128i px) {
+    const __m128i alpha = _mm_srli_epi32(px, 24);
+    const __m128i solid = _mm_or_si128(_mm_cmpeq_epi32(alpha, _mm_set1_epi32(0xFF)), _mm_cmpeq_epi32(alpha, _mm_setzero_si128()));
+    return _mm_movemask_epi8(solid) == 0xFFFF;
+}
+
+static inline __m128i unpremultiplyPixelSSE2(__m128i bgra, uint8_t a) {
+    const float scale = colorScale[a];
+    const __m128 factors = _mm_setr_ps(scale, scale, scale, alphaScale);
+    const __m128i q = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(bgra), factors));
+    return _mm_shuffle_epi32(_mm_and_si128(q, _mm_set1_epi32(0xFF)), _MM_SHUFFLE(3, 0, 1, 2));
+}
+
+static inline __m128i unpremultiplyBlockSSE2(__m128i px, const uint8_t *src) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = _mm_unpacklo_epi8(px, zero);
+    const __m128i hi = _mm_unpackhi_epi8(px, zero);
+    const __m128i p0 = unpremultiplyPixelSSE2(_mm_unpacklo_epi16(lo, zero), src[3]);
+    const __m128i p1 = unpremultiplyPixelSSE2(_mm_unpackhi_epi16(lo, zero), src[7]);
+    const __m128i p2 = unpremultiplyPixelSSE2(_mm_unpacklo_epi16(hi, zero), src[11]);
+    const __m128i p3 = unpremultiplyPixelSSE2(_mm_unpackhi_epi16(hi, zero), src[15]);
+    return _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+}
+
+static void unpremultiplySSE2(const uint8_t *src, uint8_t *dst, size_t pixelCount) {
+    size_t i = 0;
+    for (; i + 4 <= pixelCount; i += 4) {
+        const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+        const __m128i out = solidSSE2(px) ? swizzleSSE2(px) : unpremultiplyBlockSSE2(px, src + i * 4);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), out);
+    }
+    unpremultiplyScalar(src + i * 4, dst + i * 4, pixelCount - i);
+}
+
+// Averages one 2×2 block like the scalar version, from its two rows of two pixels as 16-bit channels. Returns the pixel
+// as four 32-bit lanes.
+static inline __m128i boxAverageSSE2(__m128i top, __m128i bottom) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i topAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(top, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128i bottomAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(bottom, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+    // c * a still fits 16 unsigned bits, the sum of four doesn't
+    const __m128i topWeighted = _mm_mullo_epi16(top, topAlpha);
+    const __m128i bottomWeighted = _mm_mullo_epi16(bottom, bottomAlpha);
+    const __m128i colors = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(topWeighted, zero), _mm_unpackhi_epi16(topWeighted, zero)),
+                                         _mm_add_epi32(_mm_unpacklo_epi16(bottomWeighted, zero), _mm_unpackhi_epi16(bottomWeighted, zero)));
+    const __m128i alphaPairs = _mm_add_epi16(topAlpha, bottomAlpha);
+    const __m128i alphas = _mm_unpacklo_epi16(_mm_add_epi16(alphaPairs, _mm_srli_si128(alphaPairs, 8)), zero);
+
+    // both sums are exact as floats and the quotient is below 256, so truncating the float division is exact
+    const __m128 numerator = _mm_cvtepi32_ps(_mm_add_epi32(colors, _mm_srli_epi32(alphas, 1)));
+    const __m128i color = _mm_cvttps_epi32(_mm_div_ps(numerator, _mm_cvtepi32_ps(alphas)));
+    const __m128i visible = _mm_andnot_si128(_mm_cmpeq_epi32(alphas, zero), color);
+    const __m128i alpha = _mm_srli_epi32(_mm_add_epi32(alphas, _mm_set1_epi32(2)), 2);
+    const __m128i alphaLane = _mm_setr_epi32(0, 0, 0, -1);
+    return _mm_or_si128(_mm_andnot_si128(alphaLane, visible), _mm_and_si128(alphaLane, alpha));
+}
+
+static void downsampleRowSSE2(const uint8_t *row0, const uint8_t *row1, int srcWidth, uint8_t *dst, int dstWidth) {
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 2 <= dstWidth; x += 2) {
+        const __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 8));
+        const __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 8));
+
+        const __m128i p0 = boxAverageSSE2(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+        const __m128i p1 = boxAverageSSE2(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+        const __m128i packed = _mm_packs_epi32(p0, p1);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x * 4), _mm_packus_epi16(packed, packed));
+    }
+    downsampleRowScalar(row0, row1, srcWidth, dst, x, dstWidth);
+}
+
+static void extractAlphaSSE2(const uint8_t *src, uint8_t *dst, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i *in = reinterpret_cast<const __m128i *>(src + i * 4);
+        const __m128i a0 = _mm_srli_epi32(_mm_loadu_si128(in + 0), 24);
+        const __m128i a1 = _mm_srli_epi32(_mm_loadu_si128(in + 1), 24);
+        const __m128i a2 = _mm_srli_epi32(_mm_loadu_si128(in + 2), 24);
+        const __m128i a3 = _mm_srli_epi32(_mm_loadu_si128(in + 3), 24);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(_mm_packs_epi32(a0, a1), _mm_packs_epi32(a2, a3)));
+    }
+    extractAlphaScalar(src + i * 4, dst + i, count - i);
+}
+
+// ---- SSSE3 ----
+
+__attribute__((target("ssse3"))) static void unpremultiplySSSE3(const uint8_t *src, uint8_t *dst, size_t pixelCount) {
+    const __m128i swizzle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    size_t i = 0;
+    for (; i + 4 <= pixelCount; i += 4) {
+        const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+        const __m128i out = solidSSE2(px) ? _mm_shuffle_epi8(px, swizzle) : unpremultiplyBlockSSE2(px, src + i * 4);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), out);
+    }
+    unpremultiplyScalar(src + i * 4, dst + i * 4, pixelCount - i);
+}
+
+// ---- AVX2 ----
+
+__attribute__((target("avx2"))) static inline __m256i unpremultiplyPixelsAVX2(__m256i bgra, uint8_t a0, uint8_t a1) {
+    const float scale0 = colorScale[a0];
+    const float scale1 = colorScale[a1];
+    const __m256 factors = _mm256_setr_ps(scale0, scale0, scale0, alphaScale, scale1, scale1, scale1, alphaScale);
+    const __m256i q = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(bgra), factors));
+    return _mm256_shuffle_epi32(_mm256_and_si256(q, _mm256_set1_epi32(0xFF)), _MM_SHUFFLE(3, 0, 1, 2));
+}
+
+__attribute__((target("avx2"))) static void unpremultiplyAVX2(const uint8_t *src, uint8_t *dst, size_t pixelCount) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i swizzle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                             2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    size_t i = 0;
+    for (; i + 8 <= pixelCount; i += 8) {
+        const uint8_t *in = src + i * 4;
+        const __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in));
+
+        const __m256i alpha = _mm256_srli_epi32(px, 24);
+        const __m256i solid = _mm256_or_si256(_mm256_cmpeq_epi32(alpha, _mm256_set1_epi32(0xFF)), _mm256_cmpeq_epi32(alpha, zero));
+        if (_mm256_movemask_epi8(solid) == -1) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), _mm256_shuffle_epi8(px, swizzle));
+            continue;
+        }
+
+        // unpacking works within each 128-bit lane, so every vector holds pixel n and pixel n + 4
+        const __m256i lo = _mm256_unpacklo_epi8(px, zero);
+        const __m256i hi = _mm256_unpackhi_epi8(px, zero);
+        const __m256i p0 = unpremultiplyPixelsAVX2(_mm256_unpacklo_epi16(lo, zero), in[3], in[19]);
+        const __m256i p1 = unpremultiplyPixelsAVX2(_mm256_unpackhi_epi16(lo, zero), in[7], in[23]);
+        const __m256i p2 = unpremultiplyPixelsAVX2(_mm256_unpacklo_epi16(hi, zero), in[11], in[27]);
+        const __m256i p3 = unpremultiplyPixelsAVX2(_mm256_unpackhi_epi16(hi, zero), in[15], in[31]);
+        const __m256i out = _mm256_packus_epi16(_mm256_packs_epi32(p0, p1), _mm256_packs_epi32(p2, p3));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), out);
+    }
+    unpremultiplySSSE3(src + i * 4, dst + i * 4, pixelCount - i);
+}
+
+// boxAverageSSE2 for a block in each 128-bit lane
+__attribute__((target("avx2"))) static inline __m256i boxAverageAVX2(__m256i top, __m256i bottom) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i topAlpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(top, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    const __m256i bottomAlpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(bottom, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+    const __m256i topWeighted = _mm256_mullo_epi16(top, topAlpha);
+    const __m256i bottomWeighted = _mm256_mullo_epi16(bottom, bottomAlpha);
+    const __m256i colors = _mm256_add_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(topWeighted, zero), _mm256_unpackhi_epi16(topWeighted, zero)),
+                                            _mm256_add_epi32(_mm256_unpacklo_epi16(bottomWeighted, zero), _mm256_unpackhi_epi16(bottomWeighted, zero)));
+    const __m256i alphaPairs = _mm256_add_epi16(topAlpha, bottomAlpha);
+    const __m256i alphas = _mm256_unpacklo_epi16(_mm256_add_epi16(alphaPairs, _mm256_srli_si256(alphaPairs, 8)), zero);
+
+    const __m256 numerator = _mm256_cvtepi32_ps(_mm256_add_epi32(colors, _mm256_srli_epi32(alphas, 1)));
+    const __m256i color = _mm256_cvttps_epi32(_mm256_div_ps(numerator, _mm256_cvtepi32_ps(alphas)));
+    const __m256i visible = _mm256_andnot_si256(_mm256_cmpeq_epi32(alphas, zero), color);
+    const __m256i alpha = _mm256_srli_epi32(_mm256_add_epi32(alphas, _mm256_set1_epi32(2)), 2);
+    return _mm256_blend_epi32(visible, alpha, 0x88);
+}
+
+__attribute__((target("avx2"))) static void downsampleRowAVX2(const uint8_t *row0, const uint8_t *row1, int srcWidth, uint8_t *dst, int dstWidth) {
+    const __m256i zero = _mm256_setzero_si256();
+    int x = 0;
+    for (; x + 4 <= dstWidth; x += 4) {
+        const __m256i top = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row0 + x * 8));
+        const __m256i bottom = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row1 + x * 8));
+
+        // unpacking works within each 128-bit lane, so p0 holds output pixels 0 and 2, p1 pixels 1 and 3
+        const __m256i p0 = boxAverageAVX2(_mm256_unpacklo_epi8(top, zero), _mm256_unpacklo_epi8(bottom, zero));
+        const __m256i p1 = boxAverageAVX2(_mm256_unpackhi_epi8(top, zero), _mm256_unpackhi_epi8(bottom, zero));
+        const __m256i packed = _mm256_packs_epi32(p0, p1);
+        const __m256i out = _mm256_permute4x64_epi64(_mm256_packus_epi16(packed, packed), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), _mm256_castsi256_si128(out));
+    }
+    downsampleRowSSE2(row0 + x * 8, row1 + x * 8, srcWidth - x * 2, dst + x * 4, dstWidth - x);
+}
+
+__attribute__((target("avx2"))) static void extractAlphaAVX2(const uint8_t *src, uint8_t *dst, size_t count) {
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        const __m256i *in = reinterpret_cast<const __m256i *>(src + i * 4);
+        const __m256i a0 = _mm256_srli_epi32(_mm256_loadu_si256(in + 0), 24);
+        const __m256i a1 = _mm256_srli_epi32(_mm256_loadu_si256(in + 1), 24);
+        const __m256i a2 = _mm256_srli_epi32(_mm256_loadu_si256(in + 2), 24);
+        const __m256i a3 = _mm256_srli_epi32(_mm256_loadu_si256(in + 3), 24);
+        const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(a0, a1), _mm256_packs_epi32(a2, a3));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_permutevar8x32_epi32(packed, order));
+    }
+    extractAlphaSSE2(src + i * 4, dst + i, count - i);
+}
+
+#endif // SE_KERNELS_X86
+
+#ifdef SE_KERNELS_NEON
+
+// ---- NEON ----
+
+static void unpremultiplyNEON(const uint8_t *src, uint8_t *dst, size_t pixelCount) {
+    size_t i = 0;
+    for (; i + 16 <= pixelCount; i += 16) {
+        const uint8x16x4_t px = vld4q_u8(src + i * 4);
+        const uint8x16_t a = px.val[3];
+        const uint8x16_t solid = vorrq_u8(vceqq_u8(a, vdupq_n_u8(0)), vceqq_u8(a, vdupq_n_u8(0xFF)));
+
+        uint8x16x4_t out;
+        out.val[0] = px.val[2];
+        out.val[1] = px.val[1];
+        out.val[2] = px.val[0];
+        out.val[3] = a;
+
+        const uint64x2_t solid64 = vreinterpretq_u64_u8(solid);
+        if ((vgetq_lane_u64(solid64, 0) & vgetq_lane_u64(solid64, 1)) != ~uint64_t(0)) {
+            float scales[16];
+            for (int p = 0; p < 16; p++)
+                scales[p] = colorScale[src[(i + p) * 4 + 3]];
+
+            for (int c = 0; c < 3; c++) {
+                const uint16x8_t wide[2] = {vmovl_u8(vget_low_u8(out.val[c])), vmovl_u8(vget_high_u8(out.val[c]))};
+                uint16x4_t narrow[4];
+                for (int q = 0; q < 4; q++) {
+                    const uint32x4_t channel = vmovl_u16(q % 2 == 0 ? vget_low_u16(wide[q / 2]) : vget_high_u16(wide[q / 2]));
+                    const float32x4_t scaled = vmulq_f32(vcvtq_f32_u32(channel), vld1q_f32(scales + q * 4));
+                    // narrowing keeps the low bits, which wraps values over 255 like the scalar code
+                    narrow[q] = vmovn_u32(vcvtq_u32_f32(scaled));
+                }
+                out.val[c] = vcombine_u8(vmovn_u16(vcombine_u16(narrow[0], narrow[1])), vmovn_u16(vcombine_u16(narrow[2], narrow[3])));
+            }
+        }
+        vst4q_u8(dst + i * 4, out);
+    }
+    unpremultiplyScalar(src + i * 4, dst + i * 4, pixelCount - i);
+}
+
+// Averages one 2×2 block like the scalar version, from its two rows of two pixels. Returns the pixel as four 32-bit
+// lanes.
+static inline uint32x4_t boxAverageNEON(uint8x8_t top, uint8x8_t bottom) {
+    // bytes 3, 3, 3, 3, 7, 7, 7, 7: each pixel's alpha in all its channels
+    const uint8x8_t broadcastAlpha = vcreate_u8(0x0707070703030303ull);
+    const uint8x8_t topAlpha = vtbl1_u8(top, broadcastAlpha);
+    const uint8x8_t bottomAlpha = vtbl1_u8(bottom, broadcastAlpha);
+
+    const uint16x8_t topWeighted = vmull_u8(top, topAlpha);
+    const uint16x8_t bottomWeighted = vmull_u8(bottom, bottomAlpha);
+    const uint32x4_t colors = vaddq_u32(vaddl_u16(vget_low_u16(topWeighted), vget_high_u16(topWeighted)),
+                                        vaddl_u16(vget_low_u16(bottomWeighted), vget_high_u16(bottomWeighted)));
+    const uint16x8_t alphaPairs = vaddl_u8(topAlpha, bottomAlpha);
+    const uint32x4_t alphas = vmovl_u16(vadd_u16(vget_low_u16(alphaPairs), vget_high_u16(alphaPairs)));
+
+    // ARMv7 can't divide floats: a reciprocal estimate refined twice gets within one of the quotient, and the
+    // remainder corrects that
+    const uint32x4_t numerator = vaddq_u32(colors, vshrq_n_u32(alphas, 1));
+    const float32x4_t divisor = vcvtq_f32_u32(alphas);
+    float32x4_t reciprocal = vrecpeq_f32(divisor);
+    reciprocal = vmulq_f32(reciprocal, vrecpsq_f32(divisor, reciprocal));
+    reciprocal = vmulq_f32(reciprocal, vrecpsq_f32(divisor, reciprocal));
+    uint32x4_t color = vcvtq_u32_f32(vmulq_f32(vcvtq_f32_u32(numerator), reciprocal));
+    const int32x4_t remainder = vreinterpretq_s32_u32(vsubq_u32(numerator, vmulq_u32(color, alphas)));
+    color = vsubq_u32(color, vcgeq_s32(remainder, vreinterpretq_s32_u32(alphas)));
+    color = vaddq_u32(color, vcltq_s32(remainder, vdupq_n_s32(0)));
+
+    const uint32x4_t visible = vbicq_u32(color, vceqq_u32(alphas, vdupq_n_u32(0)));
+    const uint32x4_t alpha = vshrq_n_u32(vaddq_u32(alphas, vdupq_n_u32(2)), 2);
+    const uint32x4_t alphaLane = vsetq_lane_u32(0xFFFFFFFFu, vdupq_n_u32(0), 3);
+    return vbslq_u32(alphaLane, alpha, visible);
+}
+
+static void downsampleRowNEON(const uint8_t *row0, const uint8_t *row1, int srcWidth, uint8_t *dst, int dstWidth) {
+    int x = 0;
+    for (; x + 2 <= dstWidth; x += 2) {
+        const uint8x16_t top = vld1q_u8(row0 + x * 8);
+        const uint8x16_t bottom = vld1q_u8(row1 + x * 8);
+
+        const uint32x4_t p0 = boxAverageNEON(vget_low_u8(top), vget_low_u8(bottom));
+        const uint32x4_t p1 = boxAverageNEON(vget_high_u8(top), vget_high_u8(bottom));
+        vst1_u8(dst + x * 4, vmovn_u16(vcombine_u16(vmovn_u32(p0), vmovn_u32(p1))));
+    }
+    downsampleRowScalar(row0, row1, srcWidth, dst, x, dstWidth);
+}
+
+static void extractAlphaNEON(const uint8_t *src, uint8_t *dst, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+        vst1q_u8(dst + i, vld4q_u8(src + i * 4).val[3]);
+    extractAlphaScalar(src + i * 4, dst + i, count - i);
+}
+
+#endif // SE_KERNELS_NEON
+
+struct Kernels {
+    const char *name;
+    void (*unpremultiply)(const uint8_t *src, uint8_t *dst, size_t pixelCount);
+    void (*downsampleRow)(const uint8_t *row0, const uint8_t *row1, int srcWidth, uint8_t *dst, int dstWidth);
+    void (*extractAlpha)(const uint8_t *src, uint8_t *dst, size_t count);
+};
+
+// every version this CPU can run, slowest first
+static std::vector<Kernels> supported() {
+    std::vector<Kernels> all = {{"scalar", unpremultiplyScalar, downsampleRowScalar, extractAlphaScalar}};
+#if defined(SE_KERNELS_X86)
+    initColorScale();
+    __builtin_cpu_init();
+    all.push_back({"sse2", unpremultiplySSE2, downsampleRowSSE2, extractAlphaSSE2});
+    if (__builtin_cpu_supports("ssse3")) all.push_back({"ssse3", unpremultiplySSSE3, downsampleRowSSE2, extractAlphaSSE2});
+    if (__builtin_cpu_supports("avx2")) all.push_back({"avx2", unpremultiplyAVX2, downsampleRowAVX2, extractAlphaAVX2});
+#elif defined(SE_KERNELS_NEON)
+    initColorScale();
+    all.push_back({"neon", unpremultiplyNEON, downsampleRowNEON, extractAlphaNEON});
+#endif
+    return all;
+}
+
+static Kernels &kernels() {
+    static Kernels selected = supported().back();
+    return selected;
+}
+
+void unpremultiply(const uint8_t *src, uint8_t *dst, size_t pixelCount) {
+    kernels().unpremultiply(src, dst, pixelCount);
+}
+
+void downsample2x(const uint8_t *src, int srcWidth, int srcHeight, uint8_t *dst, int dstWidth, int dstHeight) {
+    const size_t srcStride = static_cast<size_t>(srcWidth) * 4;
+    const size_t dstStride = static_cast<size_t>(dstWidth) * 4;
+    for (int y = 0; y < dstHeight; y++) {
+        const uint8_t *row0 = src + static_cast<size_t>(y) * 2 * srcStride;
+        const uint8_t *row1 = src + std::min(y * 2 + 1, srcHeight - 1) * srcStride;
+        kernels().downsampleRow(row0, row1, srcWidth, dst + y * dstStride, dstWidth);
+    }
+}
+
+void extractAlpha(const uint8_t *src, size_t pixelStride, uint8_t *dst, size_t count) {
+    if (pixelStride == 1) {
+        kernels().extractAlpha(src, dst, count);
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+        dst[i] = src[i * pixelStride * 4 + 3];
+}
+
+const char *backend() {
+    return kernels().name;
+}
+
+std::vector<const char *> backends() {
+    std::vector<const char *> names;
+    for (const Kernels &candidate : supported())
+        names.push_back(candidate.name);
+    return names;
+}
+
+bool useBackend(const char *name) {
+    for (const Kernels &candidate : supported()) {
+        if (std::strcmp(candidate.name, name) != 0) continue;
+        kernels() = candidate;
+        return true;
+    }
+    return false;
+}
+
+} // namespace PixelKernels
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Pixel conversion loops used when decoding images.
+ *
+ * On x86, SSE2, SSSE3 or AVX2 versions are picked at runtime depending on what the CPU supports. On ARM, NEON versions
+ * are used when the compiler targets it. Everything else uses plain scalar loops. Every version produces exactly the
+ * same bytes as the scalar one.
+ */
+namespace PixelKernels {
+
+/**
+ * Converts LunaSVG's premultiplied pixels (BGRA on little endian, ARGB on big endian) to straight RGBA.
+ * `src` and `dst` may not overlap.
+ */
+void unpremultiply(const uint8_t *src, uint8_t *dst, size_t pixelCount);
+
+/**
+ * Halves a straight alpha RGBA image, averaging each 2×2 block of pixels. Colors are weighted by alpha, so transparent
+ * pixels don't darken or tint the edges next to them. The last row or column is repeated when the source has an odd
+ * size.
+ * @param dstWidth Must be `max(1, srcWidth / 2)`.
+ * @param dstHeight Must be `max(1, srcHeight / 2)`.
+ */
+void downsample2x(const uint8_t *src, int srcWidth, int srcHeight, uint8_t *dst, int dstWidth, int dstHeight);
+
+/**
+ * Copies the alpha channel of `count` RGBA pixels, taking every `pixelStride`th pixel of `src`.
+ */
+void extractAlpha(const uint8_t *src, size_t pixelStride, uint8_t *dst, size_t count);
+
+/**
+ * The name of the instruction set the kernels were picked for ("scalar", "sse2", "ssse3", "avx2" or "neon").
+ */
+const char *backend();
+
+/**
+ * The names of every version of the kernels this CPU can run, starting with "scalar". The fastest is the one in use
+ * unless `useBackend` picked another.
+ */
+std::vector<const char *> backends();
+
+/**
+ * Switches every kernel to the `name` version, so tests can compare them with the scalar ones. Not thread safe.
+ * @return false if `name` isn't one of `backends()`.
+ */
+bool useBackend(const char *name);
+
+} // namespace PixelKernels
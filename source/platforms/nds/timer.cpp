@@ -1,6 +1,11 @@
 #include <nds.h>
 #include <timer.hpp>
 
+// No virtual clock here; the fixed timestep runners are PC only.
+void Timer::setFixedClock(bool enabled) {}
+
+void Timer::advanceFixedClock(double ms) {}
+
 Timer::Timer(const bool autoStart) {
     if (autoStart) start();
 }
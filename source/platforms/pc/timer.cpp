@@ -1,28 +1,40 @@
-
 #include <chrono>
+#include <cmath>
 #include <timer.hpp>
 
+static bool fixedClock = false;
+static uint64_t fixedClockNs = 0;
+
+static uint64_t getCurrentTimeNs() {
+    if (fixedClock) return fixedClockNs;
+    auto now = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+}
+
+void Timer::setFixedClock(bool enabled) {
+    // start the virtual clock where the real one is so timers that are already running stay valid
+    if (enabled && !fixedClock) fixedClockNs = getCurrentTimeNs();
+    fixedClock = enabled;
+}
+
+void Timer::advanceFixedClock(double ms) {
+    fixedClockNs += static_cast<uint64_t>(std::llround(ms * 1000000.0));
+}
+
 Timer::Timer(const bool autoStart) {
     if (autoStart) start();
 }
 
 void Timer::start() {
-    auto now = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch());
-    startTime = duration.count();
+    startTime = getCurrentTimeNs();
 }
 
 uint64_t Timer::getTimeMs() {
-    auto now = std::chrono::high_resolution_clock::now();
-    uint64_t currentTime = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
-    uint64_t diffNs = currentTime - startTime;
+    uint64_t diffNs = getCurrentTimeNs() - startTime;
     return diffNs / 1000000;
 }
 
 double Timer::getTimeMsDouble() {
-    auto now = std::chrono::high_resolution_clock::now();
-    uint64_t currentTime = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
-
-    uint64_t diffNs = currentTime - startTime;
+    uint64_t diffNs = getCurrentTimeNs() - startTime;
     return static_cast<double>(diffNs) / 1000000.0;
 }
@@ -2,6 +2,11 @@
 #include <orbis/libkernel.h>
 #include <timer.hpp>
 
+// No virtual clock here; the fixed timestep runners are PC only.
+void Timer::setFixedClock(bool enabled) {}
+
+void Timer::advanceFixedClock(double ms) {}
+
 Timer::Timer(const bool autoStart) {
     if (autoStart) start();
 }
@@ -6,6 +6,18 @@ class Timer {
     uint64_t startTime;
 
   public:
+    /**
+     * When enabled, every Timer reads from a virtual clock that only moves forward through `advanceFixedClock()`.
+     * Used to step projects with a fixed timestep so runs are reproducible.
+     */
+    static void setFixedClock(bool enabled);
+
+    /**
+     * Moves the virtual clock forward. No-op on platforms without a virtual clock (NDS, PS4).
+     * @param ms Amount of time to advance (in ms)
+     */
+    static void advanceFixedClock(double ms);
+
     Timer(const bool autoStart = true);
     /**
      * Starts the clock.
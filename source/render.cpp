@@ -12,16 +12,17 @@ std::unordered_map<std::string, Monitor> Render::monitors;
 void Render::calculateRenderPosition(Sprite *sprite, const bool isSVG) {
     const int screenWidth = getWidth();
     const int screenHeight = getHeight();
-    const Costume &costume = sprite->costumes[sprite->currentCostume];
+    const int costumeIndex = Scratch::getRenderedCostume(sprite);
+    const Costume &costume = sprite->costumes[costumeIndex];
 
     // If the window size changed, or if the sprite changed costumes
-    if (sprite->renderInfo.forceUpdate || sprite->currentCostume != sprite->renderInfo.oldCostumeID) {
+    if (sprite->renderInfo.forceUpdate || costumeIndex != sprite->renderInfo.oldCostumeID) {
         // change all renderinfo a bit to update position for all
         sprite->renderInfo.oldX++;
         sprite->renderInfo.oldY++;
         sprite->renderInfo.oldRotation++;
         sprite->renderInfo.oldSize++;
-        sprite->renderInfo.oldCostumeID = sprite->currentCostume;
+        sprite->renderInfo.oldCostumeID = costumeIndex;
         sprite->renderInfo.forceUpdate = false;
     }
 
@@ -136,8 +137,10 @@ void Render::resizeSVGs(Sprite *sprite) {
         float scale = sprite->size / 100;
         scale *= std::min(static_cast<float>(screenWidth) / Scratch::projectWidth, static_cast<float>(screenHeight) / Scratch::projectHeight);
 
+        const size_t oldSize = imgFind->second->getMemorySize();
         auto potentialError = imgFind->second->resizeSVG(scale);
         if (!potentialError.has_value()) Log::logWarning("Error resizing SVG: " + costume.id);
+        Scratch::costumeCacheStats.residentBytes += imgFind->second->getMemorySize() - oldSize;
     }
 }
 
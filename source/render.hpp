@@ -200,4 +200,17 @@ class Render {
      * Called when the pen canvas needs to be cleared.
      */
     static void penClear();
+
+    /**
+     * [Headless] Writes the most recently rendered frame to a PNG file.
+     * @param path Where to write the image.
+     */
+    static nonstd::expected<void, std::string> captureFrame(const std::string &path);
+
+    /**
+     * [Headless] Returns the RGBA8 pixels of the most recently rendered frame, or nullptr if nothing has been rendered.
+     * @param width Set to the width of the frame.
+     * @param height Set to the height of the frame.
+     */
+    static const uint8_t *getFramebuffer(int &width, int &height);
 };
\ No newline at end of file
@@ -78,7 +78,7 @@ void Image_C2D::render(ImageRenderParams &params) {
     } else C2D_AlphaImageTint(&tinty, 1.0f);
 
     C2D_DrawImageAtRotated({texture.tex, &subtex}, x, y, 1, rotation, &tinty, scaleX / imgData.scale, scaleY / imgData.scale);
-    freeTimer = maxFreeTimer;
+    markUsed();
 }
 
 void Image_C2D::renderSubrect(C2D_Image img, uint16_t srcX, uint16_t srcY, uint16_t srcW, uint16_t srcH, float destX, float destY, float destW, float destH, C2D_ImageTint *tint) {
@@ -127,7 +127,7 @@ void Image_C2D::renderNineslice(double xPos, double yPos, double width, double h
     renderSubrect(texture, 0, this->imgData.height - padding, padding, padding, renderPositionX, renderPositionY + height - padding, padding, padding, nullptr);                                                               // Bottom Left
     renderSubrect(texture, padding, this->imgData.height - padding, this->imgData.width - padding * 2, padding, renderPositionX + padding, renderPositionY + height - padding, width - padding * 2, padding, nullptr);         // Bottom
     renderSubrect(texture, this->imgData.width - padding, this->imgData.height - padding, padding, padding, renderPositionX + width - padding, renderPositionY + height - padding, padding, padding, nullptr);                 // Bottom Right
-    freeTimer = maxFreeTimer;
+    markUsed();
 }
 
 nonstd::expected<void, std::string> Image_C2D::setInitialTexture() {
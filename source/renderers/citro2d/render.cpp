@@ -393,7 +393,7 @@ void renderImage(Sprite *currentSprite, const std::string &costumeId, const bool
     }
 
     Image *image = imgFind->second.get();
-    const bool isSVG = currentSprite->costumes[currentSprite->currentCostume].isSVG;
+    const bool isSVG = currentSprite->costumes[Scratch::getRenderedCostume(currentSprite)].isSVG;
 
     Render::calculateRenderPosition(currentSprite, isSVG);
 
@@ -470,7 +470,7 @@ void Render::renderSprites() {
 
             int costumeIndex = 0;
             for (const auto &costume : currentSprite->costumes) {
-                if (costumeIndex == currentSprite->currentCostume) {
+                if (costumeIndex == Scratch::getRenderedCostume(currentSprite)) {
 
                     if (!is_top_screen) {
                         renderImage(
@@ -111,7 +111,7 @@ void Image_GL2D::render(ImageRenderParams &params) {
         glSpriteRotateScaleXY(x, y, rotation, renderScale / imgData.scale, renderScale / imgData.scale, flip_mode, &texture);
     }
 
-    freeTimer = maxFreeTimer;
+    markUsed();
 }
 
 void Image_GL2D::renderNineslice(double xPos, double yPos, double width, double height, double padding, bool centered) {
@@ -124,12 +124,12 @@ void Render::renderSprites() {
         Sprite *currentSprite = *it;
         if (!currentSprite->visible || currentSprite->ghostEffect > 70) continue;
 
-        auto imgFind = Scratch::costumeImages.find(currentSprite->costumes[currentSprite->currentCostume].fullName);
+        auto imgFind = Scratch::costumeImages.find(currentSprite->costumes[Scratch::getRenderedCostume(currentSprite)].fullName);
         if (imgFind != Scratch::costumeImages.end()) {
             Image_GL2D *image = reinterpret_cast<Image_GL2D *>(imgFind->second.get());
             glBindTexture(GL_TEXTURE_2D, image->textureID);
 
-            const bool isSVG = currentSprite->costumes[currentSprite->currentCostume].isSVG;
+            const bool isSVG = currentSprite->costumes[Scratch::getRenderedCostume(currentSprite)].isSVG;
             calculateRenderPosition(currentSprite, isSVG);
             if (!currentSprite->visible) continue;
 
@@ -1,31 +1,181 @@
 #include "image_headless.hpp"
 #include "nonstd/expected.hpp"
+#include "render.hpp"
+#include <algorithm>
+#include <cmath>
 
 Image_Headless::Image_Headless(std::string filePath, bool fromScratchProject, bool bitmapHalfQuality, float scale) : Image(filePath, fromScratchProject, bitmapHalfQuality, scale) {
-    if (imgData.pixels) {
-        free(imgData.pixels);
-        imgData.pixels = nullptr;
-    }
 }
 
 Image_Headless::Image_Headless(std::string filePath, mz_zip_archive *zip, bool bitmapHalfQuality, float scale) : Image(filePath, zip, bitmapHalfQuality, scale) {
-    if (imgData.pixels) {
-        free(imgData.pixels);
-        imgData.pixels = nullptr;
-    }
 }
 
 Image_Headless::~Image_Headless() {
 }
 
+// Scratch's color effect rotates the hue by `effect / 200` of a full turn.
+static inline void applyColorEffect(uint8_t &r, uint8_t &g, uint8_t &b, float effect) {
+    float rf = r / 255.0f, gf = g / 255.0f, bf = b / 255.0f;
+    const float maxC = std::max(rf, std::max(gf, bf));
+    const float minC = std::min(rf, std::min(gf, bf));
+    const float delta = maxC - minC;
+    if (delta <= 0.0f) return;
+
+    float h;
+    if (maxC == rf) h = std::fmod((gf - bf) / delta, 6.0f);
+    else if (maxC == gf) h = (bf - rf) / delta + 2.0f;
+    else h = (rf - gf) / delta + 4.0f;
+    h /= 6.0f;
+
+    h += effect / 200.0f;
+    h -= std::floor(h);
+
+    const float s = delta / maxC;
+    const float v = maxC;
+    const float h6 = h * 6.0f;
+    const int sector = static_cast<int>(h6) % 6;
+    const float f = h6 - std::floor(h6);
+    const float p = v * (1.0f - s);
+    const float q = v * (1.0f - s * f);
+    const float t = v * (1.0f - s * (1.0f - f));
+
+    switch (sector) {
+    case 0: rf = v, gf = t, bf = p; break;
+    case 1: rf = q, gf = v, bf = p; break;
+    case 2: rf = p, gf = v, bf = t; break;
+    case 3: rf = p, gf = q, bf = v; break;
+    case 4: rf = t, gf = p, bf = v; break;
+    default: rf = v, gf = p, bf = q; break;
+    }
+
+    r = static_cast<uint8_t>(rf * 255.0f + 0.5f);
+    g = static_cast<uint8_t>(gf * 255.0f + 0.5f);
+    b = static_cast<uint8_t>(bf * 255.0f + 0.5f);
+}
+
 void Image_Headless::render(ImageRenderParams &params) {
+    markUsed();
+    if (!imgData.pixels || !renderTarget || imgData.width <= 0 || imgData.height <= 0) return;
+
+    int srcX = 0, srcY = 0, srcW = imgData.width, srcH = imgData.height;
+    if (params.subrect != nullptr) {
+        srcX = std::clamp(params.subrect->x, 0, imgData.width);
+        srcY = std::clamp(params.subrect->y, 0, imgData.height);
+        srcW = std::clamp(params.subrect->w, 0, imgData.width - srcX);
+        srcH = std::clamp(params.subrect->h, 0, imgData.height - srcY);
+    }
+    if (srcW <= 0 || srcH <= 0) return;
+
+    const float dstW = srcW / imgData.scale * params.scale;
+    const float dstH = srcH / imgData.scale * params.scale;
+    if (dstW <= 0.0f || dstH <= 0.0f) return;
+
+    const float centerX = params.centered ? params.x : params.x + dstW / 2.0f;
+    const float centerY = params.centered ? params.y : params.y + dstH / 2.0f;
+
+    const float rotCos = std::cos(params.rotation);
+    const float rotSin = std::sin(params.rotation);
+
+    // bounding box of the rotated destination rectangle
+    const float extentX = (std::fabs(rotCos) * dstW + std::fabs(rotSin) * dstH) / 2.0f;
+    const float extentY = (std::fabs(rotSin) * dstW + std::fabs(rotCos) * dstH) / 2.0f;
+    const int minX = std::max(0, static_cast<int>(std::floor(centerX - extentX)));
+    const int minY = std::max(0, static_cast<int>(std::floor(centerY - extentY)));
+    const int maxX = std::min(renderTarget->width, static_cast<int>(std::ceil(centerX + extentX)));
+    const int maxY = std::min(renderTarget->height, static_cast<int>(std::ceil(centerY + extentY)));
+
+    const int opacity = static_cast<int>(std::clamp(params.opacity, 0.0f, 1.0f) * 255.0f + 0.5f);
+    if (opacity == 0) return;
+    const int brightness = static_cast<int>(std::clamp(params.brightness, -100, 100) * 2.55f);
+    const bool hasColorEffect = std::fmod(params.colorEffect, 200.0f) != 0.0f;
+
+    const uint8_t *src = static_cast<const uint8_t *>(imgData.pixels);
+    const float invW = srcW / dstW;
+    const float invH = srcH / dstH;
+
+    for (int py = minY; py < maxY; py++) {
+        const float dy = (py + 0.5f) - centerY;
+        for (int px = minX; px < maxX; px++) {
+            const float dx = (px + 0.5f) - centerX;
+
+            // map the screen pixel back into the unrotated image
+            const float localX = dx * rotCos + dy * rotSin + dstW / 2.0f;
+            const float localY = -dx * rotSin + dy * rotCos + dstH / 2.0f;
+            if (localX < 0.0f || localY < 0.0f || localX >= dstW || localY >= dstH) continue;
+
+            int sx = static_cast<int>(localX * invW);
+            const int sy = static_cast<int>(localY * invH);
+            if (params.flip) sx = srcW - 1 - sx;
+
+            const uint8_t *texel = src + (srcY + std::min(sy, srcH - 1)) * imgData.pitch + (srcX + std::clamp(sx, 0, srcW - 1)) * 4;
+            if (texel[3] == 0) continue;
+
+            uint8_t r = texel[0], g = texel[1], b = texel[2];
+            if (hasColorEffect) applyColorEffect(r, g, b, params.colorEffect);
+            if (brightness != 0) {
+                r = static_cast<uint8_t>(std::clamp(r + brightness, 0, 255));
+                g = static_cast<uint8_t>(std::clamp(g + brightness, 0, 255));
+                b = static_cast<uint8_t>(std::clamp(b + brightness, 0, 255));
+            }
+
+            renderTarget->blendPixel(px, py, r, g, b, static_cast<uint8_t>((texel[3] * opacity + 127) / 255));
+        }
+    }
+}
+
+void Image_Headless::blitScaled(int srcX, int srcY, int srcW, int srcH, int dstX, int dstY, int dstW, int dstH) {
+    if (srcW <= 0 || srcH <= 0 || dstW <= 0 || dstH <= 0) return;
+
+    const uint8_t *src = static_cast<const uint8_t *>(imgData.pixels);
+    const int x0 = std::max(0, dstX);
+    const int y0 = std::max(0, dstY);
+    const int x1 = std::min(renderTarget->width, dstX + dstW);
+    const int y1 = std::min(renderTarget->height, dstY + dstH);
+
+    for (int py = y0; py < y1; py++) {
+        const int sy = srcY + (py - dstY) * srcH / dstH;
+        for (int px = x0; px < x1; px++) {
+            const int sx = srcX + (px - dstX) * srcW / dstW;
+            const uint8_t *texel = src + sy * imgData.pitch + sx * 4;
+            renderTarget->blendPixel(px, py, texel[0], texel[1], texel[2], texel[3]);
+        }
+    }
 }
 
 void Image_Headless::renderNineslice(double xPos, double yPos, double width, double height, double padding, bool centered) {
+    markUsed();
+    if (!imgData.pixels || !renderTarget) return;
+
+    const int iDestX = static_cast<int>(xPos - (centered ? width / 2 : 0));
+    const int iDestY = static_cast<int>(yPos - (centered ? height / 2 : 0));
+    const int iWidth = static_cast<int>(width);
+    const int iHeight = static_cast<int>(height);
+    const int p = std::max(1, static_cast<int>(std::min(std::min(padding, static_cast<double>(imgData.width) / 2), static_cast<double>(imgData.height) / 2)));
+
+    const int srcCenterW = std::max(0, imgData.width - 2 * p);
+    const int srcCenterH = std::max(0, imgData.height - 2 * p);
+    const int dstCenterW = std::max(0, iWidth - 2 * p);
+    const int dstCenterH = std::max(0, iHeight - 2 * p);
+
+    const int srcCols[3] = {0, p, imgData.width - p};
+    const int srcWidths[3] = {p, srcCenterW, p};
+    const int srcRows[3] = {0, p, imgData.height - p};
+    const int srcHeights[3] = {p, srcCenterH, p};
+    const int dstCols[3] = {iDestX, iDestX + p, iDestX + p + dstCenterW};
+    const int dstWidths[3] = {p, dstCenterW, p};
+    const int dstRows[3] = {iDestY, iDestY + p, iDestY + p + dstCenterH};
+    const int dstHeights[3] = {p, dstCenterH, p};
+
+    for (int row = 0; row < 3; row++) {
+        for (int col = 0; col < 3; col++) {
+            blitScaled(srcCols[col], srcRows[row], srcWidths[col], srcHeights[row],
+                       dstCols[col], dstRows[row], dstWidths[col], dstHeights[row]);
+        }
+    }
 }
 
 void *Image_Headless::getNativeTexture() {
-    return nullptr;
+    return imgData.pixels;
 }
 
 nonstd::expected<void, std::string> Image_Headless::refreshTexture() {
@@ -3,6 +3,12 @@
 #include <image.hpp>
 
 class Image_Headless : public Image {
+  private:
+    /**
+     * Copies a source rectangle of the image into a destination rectangle on the current render target, without rotation or effects.
+     */
+    void blitScaled(int srcX, int srcY, int srcW, int srcH, int dstX, int dstY, int dstW, int dstH);
+
   public:
     Image_Headless(std::string filePath, bool fromScratchProject = true, bool bitmapHalfQuality = false, float scale = 1);
 
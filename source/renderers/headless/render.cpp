@@ -1,4 +1,13 @@
+#include "render.hpp"
+#include "speech_manager_headless.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <image.hpp>
+#include <log.hpp>
+#include <miniz.h>
 #include <render.hpp>
+#include <runtime.hpp>
 #include <speech_manager.hpp>
 #include <unordered_map>
 #include <window.hpp>
@@ -6,13 +15,38 @@
 
 WindowSE *globalWindow = nullptr;
 
+SoftwareSurface screenSurface;
+SoftwareSurface penSurface;
+SoftwareSurface *renderTarget = &screenSurface;
+
+SpeechManagerHeadless *speechManager = nullptr;
+
+// Makes sure the screen surface matches the window, in case it was resized since the last frame.
+static void syncScreenSurface() {
+    if (screenSurface.width != Render::getWidth() || screenSurface.height != Render::getHeight()) {
+        screenSurface.resize(Render::getWidth(), Render::getHeight());
+    }
+}
+
 bool Render::Init() {
     globalWindow = new WindowHeadless();
-    globalWindow->init(0, 0, "");
+    globalWindow->init(480, 360, "");
+    screenSurface.resize(globalWindow->getWidth(), globalWindow->getHeight());
+    screenSurface.clear(255, 255, 255, 255);
     return true;
 }
 
 void Render::deInit() {
+    if (speechManager) {
+        delete speechManager;
+        speechManager = nullptr;
+    }
+
+    TextObject::cleanupText();
+
+    screenSurface.resize(0, 0);
+    penSurface.resize(0, 0);
+
     if (globalWindow) {
         globalWindow->cleanup();
         delete globalWindow;
@@ -25,60 +59,328 @@ void *Render::getRenderer() {
 }
 
 bool Render::createSpeechManager() {
-    return false;
+    if (speechManager == nullptr) speechManager = new SpeechManagerHeadless();
+    return speechManager != nullptr;
 }
 
 void Render::destroySpeechManager() {
+    delete speechManager;
+    speechManager = nullptr;
 }
 
 SpeechManager *Render::getSpeechManager() {
-    return nullptr;
+    return speechManager;
 }
 
 void Render::beginFrame(int screen, int colorR, int colorG, int colorB) {
+    if (!hasFrameBegan) {
+        syncScreenSurface();
+        renderTarget = &screenSurface;
+        screenSurface.clear(colorR, colorG, colorB, 255);
+        hasFrameBegan = true;
+    }
 }
 
 void Render::endFrame(bool shouldFlush) {
+    hasFrameBegan = false;
 }
 
 bool Render::initPen() {
-    return false;
+    if (!penSurface.pixels.empty()) return true;
+
+    if (Scratch::hqpen) {
+        if (Scratch::projectWidth / static_cast<double>(getWidth()) < Scratch::projectHeight / static_cast<double>(getHeight()))
+            penSurface.resize(Scratch::projectWidth * (getHeight() / static_cast<double>(Scratch::projectHeight)), getHeight());
+        else
+            penSurface.resize(getWidth(), Scratch::projectHeight * (getWidth() / static_cast<double>(Scratch::projectWidth)));
+    } else penSurface.resize(Scratch::projectWidth, Scratch::projectHeight);
+
+    return true;
+}
+
+/**
+ * Fills every pen pixel within `radius` of the segment (x1, y1) -> (x2, y2).
+ * Without round caps the segment is treated as a rectangle, matching the "fast" pen.
+ */
+static void penFillSegment(float x1, float y1, float x2, float y2, float radius, bool roundCaps, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    radius = std::max(radius, 0.5f);
+
+    const float dx = x2 - x1;
+    const float dy = y2 - y1;
+    const float lengthSq = dx * dx + dy * dy;
+
+    const int minX = std::max(0, static_cast<int>(std::floor(std::min(x1, x2) - radius)));
+    const int minY = std::max(0, static_cast<int>(std::floor(std::min(y1, y2) - radius)));
+    const int maxX = std::min(penSurface.width, static_cast<int>(std::ceil(std::max(x1, x2) + radius)));
+    const int maxY = std::min(penSurface.height, static_cast<int>(std::ceil(std::max(y1, y2) + radius)));
+    const float radiusSq = radius * radius;
+
+    for (int py = minY; py < maxY; py++) {
+        const float cy = py + 0.5f;
+        for (int px = minX; px < maxX; px++) {
+            const float cx = px + 0.5f;
+
+            float t = lengthSq > 0.0f ? ((cx - x1) * dx + (cy - y1) * dy) / lengthSq : 0.0f;
+            if (!roundCaps && (t < 0.0f || t > 1.0f)) continue;
+            t = std::clamp(t, 0.0f, 1.0f);
+
+            const float ox = cx - (x1 + t * dx);
+            const float oy = cy - (y1 + t * dy);
+            if (ox * ox + oy * oy <= radiusSq) penSurface.blendPixel(px, py, r, g, b, a);
+        }
+    }
 }
 
 void Render::penMoveFast(double x1, double y1, double x2, double y2, Sprite *sprite) {
+    if (penSurface.pixels.empty()) return;
+
+    const ColorRGBA rgbColor = CSBT2RGBA(sprite->penData.color);
+    const uint8_t alpha = (100.0 - sprite->penData.color.transparency) / 100.0 * 255.0;
+
+    const double scale = (penSurface.height / static_cast<double>(Scratch::projectHeight));
+
+    const float sx1 = static_cast<float>(x1 * scale + penSurface.width / 2.0);
+    const float sy1 = static_cast<float>(-y1 * scale + penSurface.height / 2.0);
+    const float sx2 = static_cast<float>(x2 * scale + penSurface.width / 2.0);
+    const float sy2 = static_cast<float>(-y2 * scale + penSurface.height / 2.0);
+
+    if (sx1 == sx2 && sy1 == sy2) return;
+
+    const float drawWidth = static_cast<float>((sprite->penData.size / 2.0f) * scale);
+    penFillSegment(sx1, sy1, sx2, sy2, drawWidth, false, rgbColor.r, rgbColor.g, rgbColor.b, alpha);
 }
 
 void Render::penDotFast(Sprite *sprite) {
+    if (penSurface.pixels.empty()) return;
+
+    const ColorRGBA rgbColor = CSBT2RGBA(sprite->penData.color);
+    const uint8_t alpha = (100.0 - sprite->penData.color.transparency) / 100.0 * 255.0;
+
+    const double scale = (penSurface.height / static_cast<double>(Scratch::projectHeight));
+
+    const float sx = static_cast<float>(sprite->xPosition * scale + penSurface.width / 2.0);
+    const float sy = static_cast<float>(-sprite->yPosition * scale + penSurface.height / 2.0);
+    const float halfSize = std::max(0.5f, static_cast<float>((sprite->penData.size / 2.0f) * scale));
+
+    penSurface.fillRect(static_cast<int>(std::floor(sx - halfSize)), static_cast<int>(std::floor(sy - halfSize)),
+                        static_cast<int>(std::ceil(halfSize * 2)), static_cast<int>(std::ceil(halfSize * 2)),
+                        rgbColor.r, rgbColor.g, rgbColor.b, alpha);
 }
 
 void Render::penMoveAccurate(double x1, double y1, double x2, double y2, Sprite *sprite) {
+    if (penSurface.pixels.empty()) return;
+
+    const ColorRGBA rgbColor = CSBT2RGBA(sprite->penData.color);
+    const uint8_t alpha = (100.0 - sprite->penData.color.transparency) / 100.0 * 255.0;
+
+    const double scale = (penSurface.height / static_cast<double>(Scratch::projectHeight));
+
+    const float sx1 = static_cast<float>(x1 * scale + penSurface.width / 2.0);
+    const float sy1 = static_cast<float>(-y1 * scale + penSurface.height / 2.0);
+    const float sx2 = static_cast<float>(x2 * scale + penSurface.width / 2.0);
+    const float sy2 = static_cast<float>(-y2 * scale + penSurface.height / 2.0);
+
+    const float drawWidth = static_cast<float>((sprite->penData.size / 2.0f) * scale);
+    penFillSegment(sx1, sy1, sx2, sy2, drawWidth, true, rgbColor.r, rgbColor.g, rgbColor.b, alpha);
 }
 
 void Render::penDotAccurate(Sprite *sprite) {
+    if (penSurface.pixels.empty()) return;
+
+    const ColorRGBA rgbColor = CSBT2RGBA(sprite->penData.color);
+    const uint8_t alpha = (100.0 - sprite->penData.color.transparency) / 100.0 * 255.0;
+
+    const double scale = (penSurface.height / static_cast<double>(Scratch::projectHeight));
+
+    const float sx = static_cast<float>(sprite->xPosition * scale + penSurface.width / 2.0);
+    const float sy = static_cast<float>(-sprite->yPosition * scale + penSurface.height / 2.0);
+    const float radius = static_cast<float>((sprite->penData.size / 2.0f) * scale);
+
+    penFillSegment(sx, sy, sx, sy, radius, true, rgbColor.r, rgbColor.g, rgbColor.b, alpha);
 }
 
 void Render::penStamp(Sprite *sprite) {
+    if (penSurface.pixels.empty()) return;
+
+    auto imgFind = Scratch::costumeImages.find(sprite->costumes[sprite->currentCostume].fullName);
+    if (imgFind == Scratch::costumeImages.end()) {
+        Log::logWarning("Invalid Image for Stamp");
+        return;
+    }
+
+    const Costume &costume = sprite->costumes[sprite->currentCostume];
+
+    Image *image = imgFind->second.get();
+
+    const bool isSVG = costume.isSVG;
+    calculateRenderPosition(sprite, isSVG);
+
+    // Pen mapping stuff
+    const auto &cords = Scratch::screenToScratchCoords(sprite->renderInfo.renderX, sprite->renderInfo.renderY, getWidth(), getHeight());
+    int penX = cords.first + Scratch::projectWidth / 2;
+    int penY = -cords.second + Scratch::projectHeight / 2;
+
+    float penScale;
+    if (Scratch::hqpen) {
+        const double scale = (penSurface.height / static_cast<double>(Scratch::projectHeight));
+
+        penX *= scale;
+        penY *= scale;
+        penScale = sprite->renderInfo.renderScaleY;
+    } else {
+        penScale = (sprite->size / 100.0f) / costume.bitmapResolution;
+    }
+
+    ImageRenderParams params;
+    params.centered = true;
+    params.x = penX;
+    params.y = penY;
+    params.rotation = sprite->renderInfo.renderRotation;
+    params.scale = penScale;
+    params.flip = (sprite->rotationStyle == sprite->LEFT_RIGHT && sprite->rotation < 0);
+    params.opacity = 1.0f - (std::clamp(sprite->ghostEffect, 0.0f, 100.0f) * 0.01f);
+    params.brightness = sprite->brightnessEffect;
+    params.colorEffect = sprite->colorEffect;
+
+    renderTarget = &penSurface;
+    image->render(params);
+    renderTarget = &screenSurface;
 }
 
 void Render::penClear() {
+    if (penSurface.pixels.empty()) return;
+    penSurface.clear(0, 0, 0, 0);
 }
 
 int Render::getWidth() {
-    return 0;
+    if (globalWindow) return globalWindow->getWidth();
+    return 480;
 }
 
 int Render::getHeight() {
-    return 0;
+    if (globalWindow) return globalWindow->getHeight();
+    return 360;
 }
 
 float Render::getPixelDensity() {
     return 1.0f;
 }
 
+static void drawBlackBars(int screenWidth, int screenHeight) {
+    float screenAspect = static_cast<float>(screenWidth) / screenHeight;
+    float projectAspect = static_cast<float>(Scratch::projectWidth) / Scratch::projectHeight;
+
+    if (screenAspect > projectAspect) {
+        float scale = static_cast<float>(screenHeight) / Scratch::projectHeight;
+        float barWidth = (screenWidth - Scratch::projectWidth * scale) / 2.0f;
+
+        screenSurface.fillRect(0, 0, static_cast<int>(std::ceil(barWidth)), screenHeight, 0, 0, 0, 255);
+        screenSurface.fillRect(static_cast<int>(std::floor(screenWidth - barWidth)), 0, static_cast<int>(std::ceil(barWidth)), screenHeight, 0, 0, 0, 255);
+    } else if (screenAspect < projectAspect) {
+        float scale = static_cast<float>(screenWidth) / Scratch::projectWidth;
+        float barHeight = (screenHeight - Scratch::projectHeight * scale) / 2.0f;
+
+        screenSurface.fillRect(0, 0, screenWidth, static_cast<int>(std::ceil(barHeight)), 0, 0, 0, 255);
+        screenSurface.fillRect(0, static_cast<int>(std::floor(screenHeight - barHeight)), screenWidth, static_cast<int>(std::ceil(barHeight)), 0, 0, 0, 255);
+    }
+}
+
 void Render::renderSprites() {
+    syncScreenSurface();
+    renderTarget = &screenSurface;
+    screenSurface.clear(255, 255, 255, 255);
+
+    for (auto it = Scratch::sprites.rbegin(); it != Scratch::sprites.rend(); ++it) {
+        Sprite *currentSprite = *it;
+        auto imgFind = Scratch::costumeImages.find(currentSprite->costumes[Scratch::getRenderedCostume(currentSprite)].fullName);
+        if (imgFind != Scratch::costumeImages.end()) {
+            Image *image = imgFind->second.get();
+
+            const bool isSVG = currentSprite->costumes[Scratch::getRenderedCostume(currentSprite)].isSVG;
+            calculateRenderPosition(currentSprite, isSVG);
+            if (!currentSprite->visible) continue;
+
+            ImageRenderParams params;
+            params.centered = true;
+            params.x = currentSprite->renderInfo.renderX;
+            params.y = currentSprite->renderInfo.renderY;
+            params.rotation = currentSprite->renderInfo.renderRotation;
+            params.scale = currentSprite->renderInfo.renderScaleY;
+            params.flip = (currentSprite->rotationStyle == currentSprite->LEFT_RIGHT && currentSprite->rotation < 0);
+            params.opacity = 1.0f - (std::clamp(currentSprite->ghostEffect, 0.0f, 100.0f) * 0.01f);
+            params.brightness = currentSprite->brightnessEffect;
+            params.colorEffect = currentSprite->colorEffect;
+
+            image->render(params);
+        }
+
+        if (currentSprite->isStage) renderPenLayer();
+    }
+
+    if (speechManager) {
+        speechManager->render();
+    }
+
+    drawBlackBars(getWidth(), getHeight());
+    renderMonitors();
+}
+
+void Render::renderPenLayer() {
+    if (penSurface.pixels.empty()) return;
+
+    int rectX = 0, rectY = 0, rectW, rectH;
+    if (static_cast<float>(getWidth()) / getHeight() > static_cast<float>(Scratch::projectWidth) / Scratch::projectHeight) {
+        rectX = std::ceil((getWidth() - Scratch::projectWidth * (static_cast<float>(getHeight()) / Scratch::projectHeight)) / 2.0f);
+        rectW = getWidth() - rectX * 2;
+        rectH = getHeight();
+    } else {
+        rectY = std::ceil((getHeight() - Scratch::projectHeight * (static_cast<float>(getWidth()) / Scratch::projectWidth)) / 2.0f);
+        rectH = getHeight() - rectY * 2;
+        rectW = getWidth();
+    }
+    if (rectW <= 0 || rectH <= 0) return;
+
+    for (int py = 0; py < rectH; py++) {
+        const int sy = py * penSurface.height / rectH;
+        const uint8_t *srcRow = &penSurface.pixels[static_cast<size_t>(sy) * penSurface.width * 4];
+        for (int px = 0; px < rectW; px++) {
+            const uint8_t *texel = srcRow + (px * penSurface.width / rectW) * 4;
+            if (texel[3] == 0) continue;
+            screenSurface.blendPixel(rectX + px, rectY + py, texel[0], texel[1], texel[2], texel[3]);
+        }
+    }
 }
 
 void Render::drawBox(int w, int h, int x, int y, uint8_t colorR, uint8_t colorG, uint8_t colorB, uint8_t colorA) {
+    if (!renderTarget) return;
+    renderTarget->fillRect(x - (w / 2), y - (h / 2), w, h, colorR, colorG, colorB, colorA);
+}
+
+nonstd::expected<void, std::string> Render::captureFrame(const std::string &path) {
+    if (screenSurface.pixels.empty()) return nonstd::make_unexpected("Nothing has been rendered yet.");
+
+    size_t pngSize = 0;
+    void *png = tdefl_write_image_to_png_file_in_memory_ex(screenSurface.pixels.data(), screenSurface.width, screenSurface.height, 4, &pngSize, MZ_DEFAULT_LEVEL, MZ_FALSE);
+    if (!png) return nonstd::make_unexpected("Failed to encode PNG.");
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) {
+        mz_free(png);
+        return nonstd::make_unexpected("Failed to open file: " + path);
+    }
+
+    const bool written = fwrite(png, 1, pngSize, file) == pngSize;
+    fclose(file);
+    mz_free(png);
+
+    if (!written) return nonstd::make_unexpected("Failed to write file: " + path);
+    return {};
+}
+
+const uint8_t *Render::getFramebuffer(int &width, int &height) {
+    width = screenSurface.width;
+    height = screenSurface.height;
+    return screenSurface.pixels.empty() ? nullptr : screenSurface.pixels.data();
 }
 
 bool Render::appShouldRun() {
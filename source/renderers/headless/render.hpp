@@ -0,0 +1,81 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/**
+ * A CPU side RGBA8 buffer that the headless renderer rasterizes into.
+ * Pixels are stored row-major with straight (non-premultiplied) alpha.
+ */
+struct SoftwareSurface {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+
+    void resize(int w, int h) {
+        width = std::max(0, w);
+        height = std::max(0, h);
+        pixels.assign(static_cast<size_t>(width) * height * 4, 0);
+    }
+
+    void clear(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+        for (size_t i = 0; i < pixels.size(); i += 4) {
+            pixels[i + 0] = r;
+            pixels[i + 1] = g;
+            pixels[i + 2] = b;
+            pixels[i + 3] = a;
+        }
+    }
+
+    /**
+     * Composites a straight alpha color over the pixel at (x, y) using the standard "over" operator.
+     */
+    inline void blendPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+        if (a == 0 || x < 0 || y < 0 || x >= width || y >= height) return;
+        uint8_t *dst = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+
+        if (a == 255 || dst[3] == 0) {
+            dst[0] = r;
+            dst[1] = g;
+            dst[2] = b;
+            dst[3] = a;
+            return;
+        }
+
+        const int srcA = a;
+        const int dstA = (dst[3] * (255 - srcA) + 127) / 255;
+        const int outA = srcA + dstA;
+
+        dst[0] = static_cast<uint8_t>((r * srcA + dst[0] * dstA + outA / 2) / outA);
+        dst[1] = static_cast<uint8_t>((g * srcA + dst[1] * dstA + outA / 2) / outA);
+        dst[2] = static_cast<uint8_t>((b * srcA + dst[2] * dstA + outA / 2) / outA);
+        dst[3] = static_cast<uint8_t>(outA);
+    }
+
+    void fillRect(int x, int y, int w, int h, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+        const int x0 = std::max(0, x);
+        const int y0 = std::max(0, y);
+        const int x1 = std::min(width, x + w);
+        const int y1 = std::min(height, y + h);
+        for (int py = y0; py < y1; py++) {
+            for (int px = x0; px < x1; px++) {
+                blendPixel(px, py, r, g, b, a);
+            }
+        }
+    }
+};
+
+/**
+ * The window sized surface every frame is composed into.
+ */
+extern SoftwareSurface screenSurface;
+
+/**
+ * The project sized surface pen lines and stamps are drawn onto.
+ */
+extern SoftwareSurface penSurface;
+
+/**
+ * The surface draw calls currently write to. Either `screenSurface` or `penSurface`.
+ */
+extern SoftwareSurface *renderTarget;
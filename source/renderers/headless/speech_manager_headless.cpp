@@ -0,0 +1,137 @@
+#include "speech_manager_headless.hpp"
+#include "speech_text_headless.hpp"
+#include <algorithm>
+#include <image.hpp>
+#include <render.hpp>
+#include <runtime.hpp>
+
+SpeechManagerHeadless::SpeechManagerHeadless() {
+}
+
+SpeechManagerHeadless::~SpeechManagerHeadless() {
+    cleanup();
+}
+
+double SpeechManagerHeadless::getCurrentTime() {
+    return clock.getTimeMsDouble() / 1000.0;
+}
+
+void SpeechManagerHeadless::createSpeechObject(Sprite *sprite, const std::string &message) {
+    speechObjects[sprite] = std::make_unique<SpeechTextObjectHeadless>(message, 200);
+}
+
+void SpeechManagerHeadless::render(int offsetX, int offsetY) {
+    int windowWidth = Render::getWidth();
+    int windowHeight = Render::getHeight();
+    double scaleX = static_cast<double>(windowWidth) / static_cast<double>(Scratch::projectWidth);
+    double scaleY = static_cast<double>(windowHeight) / static_cast<double>(Scratch::projectHeight);
+    double scale = std::min(scaleX, scaleY);
+
+    size_t visibleObjects = 0;
+    for (auto &[sprite, obj] : speechObjects) {
+        if (obj && sprite->visible) {
+            visibleObjects++;
+            if (visibleObjects == 1) {
+                if (bubbleImage == nullptr) {
+                    auto img = createImageFromFile("gfx/ingame/speechbubble.svg", false);
+                    if (img.has_value()) bubbleImage = img.value();
+                }
+                if (speechIndicatorImage == nullptr) {
+                    auto img = createImageFromFile("gfx/ingame/speech.svg", false);
+                    if (img.has_value()) speechIndicatorImage = img.value();
+                }
+            }
+            int spriteCenterX = static_cast<int>((sprite->xPosition * scale) + (windowWidth / 2));
+            int spriteCenterY = static_cast<int>((sprite->yPosition * -scale) + (windowHeight / 2));
+
+            int spriteWidth = static_cast<int>((sprite->spriteWidth * sprite->size / 100.0) * scale);
+            int spriteHeight = static_cast<int>((sprite->spriteHeight * sprite->size / 100.0) * scale);
+
+            int spriteTop = spriteCenterY - (spriteHeight / 2);
+            int spriteLeft = spriteCenterX - (spriteWidth / 2);
+            int spriteRight = spriteCenterX + (spriteWidth / 2);
+
+            SpeechTextObjectHeadless *speechObj = static_cast<SpeechTextObjectHeadless *>(obj.get());
+            speechObj->setScale(static_cast<float>(scale) * (16.0f / 33.3f));
+
+            auto textSize = speechObj->getSize();
+            int textWidth = static_cast<int>(textSize[0]);
+            int textHeight = static_cast<int>(textSize[1]);
+
+            int textX;
+            int textY = spriteTop - static_cast<int>(20 * scale) - textHeight;
+            textY -= static_cast<int>(4 * scale);
+            int screenCenter = windowWidth / 2;
+
+            if (spriteCenterX < screenCenter) {
+                textX = spriteRight + static_cast<int>(10 * scale);
+            } else {
+                textX = spriteLeft - static_cast<int>(10 * scale) - textWidth;
+            }
+
+            textX = std::max(0, std::min(textX, windowWidth - textWidth));
+            textY = std::max(textHeight, textY);
+
+            int bubblePadding = static_cast<int>(8 * scale);
+            int bubbleX = textX - bubblePadding;
+            int bubbleY = textY - bubblePadding;
+            int bubbleWidth = textWidth + (bubblePadding * 2);
+            int bubbleHeight = textHeight + (bubblePadding * 2) - (4 * scale);
+
+            if (bubbleImage) {
+                bubbleImage->renderNineslice(bubbleX, bubbleY, bubbleWidth, bubbleHeight, bubblePadding, false);
+            } else {
+                // No SVG support, so fall back to a plain outlined box
+                Render::drawBox(bubbleWidth, bubbleHeight, bubbleX + bubbleWidth / 2, bubbleY + bubbleHeight / 2, 204, 204, 204);
+                Render::drawBox(bubbleWidth - 2, bubbleHeight - 2, bubbleX + bubbleWidth / 2, bubbleY + bubbleHeight / 2, 255, 255, 255);
+            }
+
+            if (speechIndicatorImage) renderSpeechIndicator(sprite, spriteCenterX, spriteCenterY, spriteTop, spriteLeft, spriteRight, bubbleX, bubbleY, bubbleWidth, bubbleHeight, scale);
+
+            speechObj->render(textX, textY - static_cast<int>(2 * scale));
+        }
+    }
+    if (visibleObjects == 0) {
+        if (bubbleImage != nullptr) bubbleImage.reset();
+        if (speechIndicatorImage != nullptr) speechIndicatorImage.reset();
+    }
+}
+
+void SpeechManagerHeadless::renderSpeechIndicator(Sprite *sprite, int spriteCenterX, int spriteCenterY, int spriteTop, int spriteLeft, int spriteRight, int bubbleX, int bubbleY, int bubbleWidth, int bubbleHeight, double scale) {
+    auto styleIt = speechStyles.find(sprite);
+    if (styleIt == speechStyles.end()) return;
+
+    std::string style = styleIt->second;
+
+    int cornerSize = static_cast<int>(8 * scale);
+    int indicatorSize = static_cast<int>(16 * scale);
+    int windowWidth = Render::getWidth();
+    int screenCenter = windowWidth / 2;
+
+    int indicatorX;
+    int indicatorY = bubbleY + bubbleHeight - (indicatorSize / 2);
+
+    if (spriteCenterX < screenCenter) {
+        indicatorX = bubbleX + cornerSize;
+    } else {
+        indicatorX = bubbleX + bubbleWidth - cornerSize - indicatorSize;
+    }
+
+    ImageRenderParams params;
+    params.x = indicatorX;
+    params.y = indicatorY;
+    params.scale = static_cast<float>(indicatorSize) / (speechIndicatorImage->getWidth() / 2.0f);
+    params.opacity = 1.0f;
+    params.centered = false;
+    params.flip = (spriteCenterX >= screenCenter);
+
+    int halfWidth = speechIndicatorImage->getWidth() / 2;
+    ImageSubrect subrect = {
+        .x = (style == "think") ? halfWidth : 0,
+        .y = 0,
+        .w = halfWidth,
+        .h = speechIndicatorImage->getHeight()};
+    params.subrect = &subrect;
+
+    speechIndicatorImage->render(params);
+}
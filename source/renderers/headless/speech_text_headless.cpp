@@ -0,0 +1,34 @@
+#include "speech_text_headless.hpp"
+#include "text_headless.hpp"
+
+SpeechTextObjectHeadless::SpeechTextObjectHeadless(const std::string &text, int maxWidth)
+    : TextObjectHeadless(text, 0, 0, "gfx/ingame/fonts/NotoSans-Medium"),
+      SpeechText(text, maxWidth) {
+    setColor(0x000000FF);
+    setCenterAligned(false);
+    platformSetText(wrapText());
+}
+
+SpeechTextObjectHeadless::~SpeechTextObjectHeadless() {}
+
+float SpeechTextObjectHeadless::measureTextWidth(const std::string &text) {
+    float maxW = 0.0f;
+    std::string cur;
+    for (char c : text) {
+        if (c == '\n') {
+            maxW = std::max(maxW, measureLine(cur));
+            cur.clear();
+        } else {
+            cur += c;
+        }
+    }
+    return std::max(maxW, measureLine(cur));
+}
+
+void SpeechTextObjectHeadless::platformSetText(const std::string &text) {
+    TextObjectHeadless::setText(text);
+}
+
+void SpeechTextObjectHeadless::setText(std::string txt) {
+    SpeechText::setText(txt);
+}
@@ -1,23 +1,230 @@
 #include "text_headless.hpp"
+#include "render.hpp"
+#include <cmath>
+#include <cstdio>
+#include <log.hpp>
+#include <os.hpp>
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "stb_truetype.h"
+
+#ifdef USE_CMAKERC
+#include <cmrc/cmrc.hpp>
+CMRC_DECLARE(romfs);
+#endif
+
+std::unordered_map<std::string, FontDataHeadless *> TextObjectHeadless::fonts;
+
+static std::vector<std::string> splitLines(const std::string &text) {
+    std::vector<std::string> lines;
+    std::string cur;
+    for (char c : text) {
+        if (c == '\n') {
+            lines.push_back(cur);
+            cur.clear();
+        } else cur += c;
+    }
+    lines.push_back(cur);
+    return lines;
+}
 
 TextObjectHeadless::TextObjectHeadless(std::string txt, double posX, double posY, std::string fontPath)
     : TextObject(txt, posX, posY, fontPath) {
+
+    if (fontPath.empty()) fontPath = "gfx/ingame/fonts/NotoSans-Medium";
+    std::string fullPath = OS::getRomFSLocation() + fontPath + ".ttf";
+
+    loadFont(fullPath);
+    setText(txt);
 }
 
 TextObjectHeadless::~TextObjectHeadless() {
+    if (!font) return;
+    font->usageCount--;
+    if (font->usageCount == 0) {
+        fonts.erase(font->fontName);
+        delete font;
+    }
+    font = nullptr;
+}
+
+bool TextObjectHeadless::loadFont(std::string fontPath) {
+    auto it = fonts.find(fontPath);
+    if (it != fonts.end()) {
+        font = it->second;
+        font->usageCount++;
+        return true;
+    }
+
+#ifdef USE_CMAKERC
+    const auto &file = cmrc::romfs::get_filesystem().open(fontPath);
+    std::vector<unsigned char> fontBuffer(file.begin(), file.end());
+#else
+    FILE *fontFile = fopen(fontPath.c_str(), "rb");
+    if (!fontFile) {
+        Log::logError("[Headless Text] Failed to open font: " + fontPath);
+        return false;
+    }
+    fseek(fontFile, 0, SEEK_END);
+    const size_t size = static_cast<size_t>(ftell(fontFile));
+    fseek(fontFile, 0, SEEK_SET);
+    std::vector<unsigned char> fontBuffer(size);
+    if (fread(fontBuffer.data(), 1, size, fontFile) != size) {
+        fclose(fontFile);
+        Log::logError("[Headless Text] Failed to read font: " + fontPath);
+        return false;
+    }
+    fclose(fontFile);
+#endif
+
+    if (fontBuffer.empty()) return false;
+
+    // Same atlas layout and size as the GL Core renderer so text metrics line up between the two.
+    font = new FontDataHeadless();
+    font->fontName = fontPath;
+    font->atlasWidth = 512;
+    font->atlasHeight = 512;
+    font->fontSize = 33.3f;
+    font->firstChar = 32;
+    font->numChars = 96;
+    font->usageCount = 1;
+    font->charData.resize(font->numChars);
+    font->atlas.resize(font->atlasWidth * font->atlasHeight);
+
+    stbtt_BakeFontBitmap(fontBuffer.data(), 0, font->fontSize,
+                         font->atlas.data(), font->atlasWidth, font->atlasHeight,
+                         font->firstChar, font->numChars, font->charData.data());
+
+    stbtt_fontinfo info;
+    if (stbtt_InitFont(&info, fontBuffer.data(), 0)) {
+        int ascent, descent, lineGap;
+        stbtt_GetFontVMetrics(&info, &ascent, &descent, &lineGap);
+        const float sc = stbtt_ScaleForPixelHeight(&info, font->fontSize);
+        font->ascent = static_cast<float>(ascent) * sc;
+        font->descent = static_cast<float>(descent) * sc;
+        font->lineGap = static_cast<float>(lineGap) * sc;
+    } else {
+        font->ascent = font->fontSize * 0.8f;
+        font->descent = -font->fontSize * 0.2f;
+        font->lineGap = 0.0f;
+    }
+
+    fonts[fontPath] = font;
+    return true;
+}
+
+float TextObjectHeadless::measureLine(const std::string &line) {
+    if (!font) return 0.0f;
+
+    float x = 0, y = 0;
+    for (unsigned char c : line) {
+        if (c < font->firstChar || c >= font->firstChar + font->numChars) c = 'x';
+        stbtt_aligned_quad q;
+        stbtt_GetBakedQuad(font->charData.data(), font->atlasWidth, font->atlasHeight,
+                           c - font->firstChar, &x, &y, &q, 1);
+    }
+    return x;
+}
+
+void TextObjectHeadless::setDimensions() {
+    if (!font) {
+        width = height = 0;
+        return;
+    }
+
+    const auto lines = splitLines(text);
+    float maxWidth = 0;
+    for (const auto &line : lines) {
+        maxWidth = std::max(maxWidth, measureLine(line));
+    }
+
+    width = maxWidth;
+    height = (font->ascent - font->descent + font->lineGap) * static_cast<float>(lines.size());
 }
 
 void TextObjectHeadless::setText(std::string txt) {
     text = txt;
+    setDimensions();
 }
 
 void TextObjectHeadless::render(int xPos, int yPos) {
+    if (!font || !renderTarget) return;
+
+    const uint8_t cr = (color >> 24) & 0xFF;
+    const uint8_t cg = (color >> 16) & 0xFF;
+    const uint8_t cb = (color >> 8) & 0xFF;
+    const uint8_t ca = color & 0xFF;
+
+    float drawX = static_cast<float>(xPos);
+    float drawY = static_cast<float>(yPos);
+    if (centerAligned) {
+        drawX -= (width * scale) / 2.0f;
+        drawY -= (height * scale) / 2.0f;
+    }
+
+    const auto lines = splitLines(text);
+    const float lineHeight = font->ascent - font->descent + font->lineGap;
+
+    for (size_t li = 0; li < lines.size(); li++) {
+        float x = 0.0f, y = 0.0f;
+        const float lineY = drawY + (static_cast<float>(li) * lineHeight + font->ascent) * scale;
+
+        for (unsigned char c : lines[li]) {
+            if (c < font->firstChar || c >= font->firstChar + font->numChars) c = 'x';
+
+            stbtt_aligned_quad q;
+            stbtt_GetBakedQuad(font->charData.data(), font->atlasWidth, font->atlasHeight,
+                               c - font->firstChar, &x, &y, &q, 1);
+
+            const float qx0 = drawX + q.x0 * scale;
+            const float qy0 = lineY + q.y0 * scale;
+            const float qx1 = drawX + q.x1 * scale;
+            const float qy1 = lineY + q.y1 * scale;
+            if (qx1 <= qx0 || qy1 <= qy0) continue;
+
+            const int px0 = static_cast<int>(std::floor(qx0));
+            const int py0 = static_cast<int>(std::floor(qy0));
+            const int px1 = static_cast<int>(std::ceil(qx1));
+            const int py1 = static_cast<int>(std::ceil(qy1));
+
+            for (int py = py0; py < py1; py++) {
+                const float v = ((py + 0.5f) - qy0) / (qy1 - qy0);
+                if (v < 0.0f || v >= 1.0f) continue;
+                const int ay = std::min(font->atlasHeight - 1, static_cast<int>((q.t0 + v * (q.t1 - q.t0)) * font->atlasHeight));
+
+                for (int px = px0; px < px1; px++) {
+                    const float u = ((px + 0.5f) - qx0) / (qx1 - qx0);
+                    if (u < 0.0f || u >= 1.0f) continue;
+                    const int ax = std::min(font->atlasWidth - 1, static_cast<int>((q.s0 + u * (q.s1 - q.s0)) * font->atlasWidth));
+
+                    const uint8_t coverage = font->atlas[ay * font->atlasWidth + ax];
+                    if (coverage == 0) continue;
+                    renderTarget->blendPixel(px, py, cr, cg, cb, static_cast<uint8_t>((coverage * ca) / 255));
+                }
+            }
+        }
+    }
 }
 
 std::vector<float> TextObjectHeadless::getSize() {
-    return {0.0f, 0.0f};
+    return {width * scale, height * scale};
 }
 
 std::vector<float> TextObjectHeadless::getStringSize(const std::string &txt) {
-    return {0.0f, 0.0f};
+    if (!font) return {0.0f, 0.0f};
+
+    const auto lines = splitLines(txt);
+    float maxWidth = 0;
+    for (const auto &line : lines) {
+        maxWidth = std::max(maxWidth, measureLine(line));
+    }
+    const float lineHeight = font->ascent - font->descent + font->lineGap;
+    return {maxWidth * scale, lineHeight * static_cast<float>(lines.size()) * scale};
+}
+
+void TextObjectHeadless::cleanupText() {
+    for (auto &[name, data] : fonts) {
+        delete data;
+    }
+    fonts.clear();
 }
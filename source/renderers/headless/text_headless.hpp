@@ -1,7 +1,39 @@
 #pragma once
+#include <stb_truetype.h>
+#include <string>
 #include <text.hpp>
+#include <unordered_map>
+#include <vector>
+
+struct FontDataHeadless {
+    std::string fontName;
+    size_t usageCount = 0;
+    std::vector<unsigned char> atlas;
+    int atlasWidth = 0;
+    int atlasHeight = 0;
+    float fontSize = 0.0f;
+    int firstChar = 0;
+    int numChars = 0;
+    float ascent = 0.0f;
+    float descent = 0.0f;
+    float lineGap = 0.0f;
+    std::vector<stbtt_bakedchar> charData;
+};
 
 class TextObjectHeadless : public TextObject {
+  private:
+    static std::unordered_map<std::string, FontDataHeadless *> fonts;
+    float width = 0.0f;
+    float height = 0.0f;
+
+    void setDimensions();
+    bool loadFont(std::string fontPath);
+
+  protected:
+    FontDataHeadless *font = nullptr;
+
+    float measureLine(const std::string &line);
+
   public:
     TextObjectHeadless(std::string txt, double posX, double posY, std::string fontPath = "");
     ~TextObjectHeadless() override;
@@ -10,4 +42,5 @@ class TextObjectHeadless : public TextObject {
     void render(int xPos, int yPos) override;
     std::vector<float> getSize() override;
     std::vector<float> getStringSize(const std::string &txt) override;
+    static void cleanupText();
 };
@@ -76,7 +76,7 @@ void Image_GL::render(ImageRenderParams &params) {
 
     glPopMatrix();
 
-    freeTimer = maxFreeTimer;
+    markUsed();
 }
 
 // FIXME: destination width/height are used as source here...
@@ -137,7 +137,7 @@ void Image_GL::renderNineslice(double xPos, double yPos, double width, double he
     drawSubRect(imgW - p, imgH - p, p, p, destX + w - p, destY + h - p, p, p);
 
     glEnd();
-    freeTimer = maxFreeTimer;
+    markUsed();
 }
 
 void *Image_GL::getNativeTexture() {
@@ -489,12 +489,12 @@ void Render::renderSprites() {
     for (auto it = Scratch::sprites.rbegin(); it != Scratch::sprites.rend(); ++it) {
         Sprite *currentSprite = *it;
 
-        auto imgFind = Scratch::costumeImages.find(currentSprite->costumes[currentSprite->currentCostume].fullName);
+        auto imgFind = Scratch::costumeImages.find(currentSprite->costumes[Scratch::getRenderedCostume(currentSprite)].fullName);
         if (imgFind != Scratch::costumeImages.end()) {
             Image_GL *image = reinterpret_cast<Image_GL *>(imgFind->second.get());
             glBindTexture(GL_TEXTURE_2D, image->textureID);
 
-            const bool isSVG = currentSprite->costumes[currentSprite->currentCostume].isSVG;
+            const bool isSVG = currentSprite->costumes[Scratch::getRenderedCostume(currentSprite)].isSVG;
             calculateRenderPosition(currentSprite, isSVG);
             if (!currentSprite->visible) continue;
 
@@ -0,0 +1,126 @@
+#include "atlas_gl_core.hpp"
+#include "image_gl_core.hpp"
+#include "render.hpp"
+#include <algorithm>
+#include <atlasPacker.hpp>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace CostumeAtlas {
+
+// Costumes up to this size on both sides are packed; bigger ones would fill pages too quickly to be worth it.
+constexpr int maxImageSize = 256;
+constexpr int preferredPageSize = 2048;
+// Every image gets a one pixel border copied from its edge, so filtering at the edge never reaches a neighbour.
+constexpr int border = 1;
+
+static std::unique_ptr<AtlasPacker> packer;
+static std::vector<GLuint> pages;
+static std::unordered_map<uint32_t, Image_GLCore *> images;
+
+static GLuint createPage(int size) {
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    return texture;
+}
+
+static void upload(Image_GLCore *image, const AtlasPacker::Allocation &allocation) {
+    while (pages.size() <= static_cast<size_t>(allocation.page))
+        pages.push_back(createPage(packer->getPageWidth()));
+
+    const ImageData data = image->getPixels();
+    const int width = data.width;
+    const int height = data.height;
+    const int paddedWidth = width + border * 2;
+    const uint8_t *source = static_cast<const uint8_t *>(data.pixels);
+    const size_t sourcePitch = data.pitch > 0 ? data.pitch : static_cast<size_t>(width) * 4;
+
+    std::vector<uint32_t> padded(static_cast<size_t>(paddedWidth) * (height + border * 2));
+    for (int y = 0; y < height + border * 2; y++) {
+        const uint8_t *row = source + std::clamp(y - border, 0, height - 1) * sourcePitch;
+        uint32_t *out = padded.data() + static_cast<size_t>(y) * paddedWidth;
+        memcpy(out + border, row, static_cast<size_t>(width) * 4);
+        out[0] = out[border];
+        out[paddedWidth - 1] = out[paddedWidth - 1 - border];
+    }
+
+    glBindTexture(GL_TEXTURE_2D, pages[allocation.page]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, allocation.rect.x, allocation.rect.y, allocation.rect.w, allocation.rect.h,
+                    GL_RGBA, GL_UNSIGNED_BYTE, padded.data());
+}
+
+bool place(Image_GLCore *image) {
+    const ImageData data = image->getPixels();
+    const int width = data.width;
+    const int height = data.height;
+    if (data.pixels == nullptr || data.format != IMAGE_FORMAT_RGBA32) return false;
+    if (width <= 0 || height <= 0 || width > maxImageSize || height > maxImageSize) return false;
+
+    if (!packer) {
+        GLint maxTextureSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+        const int size = std::min(preferredPageSize, static_cast<int>(maxTextureSize));
+        if (size < (maxImageSize + border * 2) * 2) return false;
+        packer = std::make_unique<AtlasPacker>(size, size);
+    }
+
+    const auto slot = packer->allocate(width + border * 2, height + border * 2);
+    if (!slot) return false;
+
+    image->atlasSlot = *slot;
+    images[*slot] = image;
+    upload(image, packer->get(*slot));
+    return true;
+}
+
+void release(Image_GLCore *image) {
+    if (!image->atlasSlot) return;
+    if (packer) packer->release(*image->atlasSlot);
+    images.erase(*image->atlasSlot);
+    image->atlasSlot.reset();
+}
+
+void repackIfNeeded() {
+    if (!packer || !packer->needsRepack()) return;
+
+    for (const AtlasPacker::Move &move : packer->repack())
+        upload(images.at(move.id), move.to);
+
+    if (pages.size() > packer->getPageCount()) {
+        glDeleteTextures(static_cast<GLsizei>(pages.size() - packer->getPageCount()), pages.data() + packer->getPageCount());
+        pages.resize(packer->getPageCount());
+    }
+}
+
+unsigned int getTexture(const Image_GLCore *image) {
+    return pages[packer->get(*image->atlasSlot).page];
+}
+
+void getRect(const Image_GLCore *image, float rect[4]) {
+    const AtlasPacker::Rect &placed = packer->get(*image->atlasSlot).rect;
+    const float pageWidth = static_cast<float>(packer->getPageWidth());
+    const float pageHeight = static_cast<float>(packer->getPageHeight());
+    rect[0] = (placed.x + border) / pageWidth;
+    rect[1] = (placed.y + border) / pageHeight;
+    rect[2] = (placed.w - border * 2) / pageWidth;
+    rect[3] = (placed.h - border * 2) / pageHeight;
+}
+
+void cleanup() {
+    if (!pages.empty()) glDeleteTextures(static_cast<GLsizei>(pages.size()), pages.data());
+    pages.clear();
+    images.clear();
+    packer.reset();
+}
+
+} // namespace CostumeAtlas
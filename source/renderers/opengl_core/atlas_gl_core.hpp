@@ -0,0 +1,43 @@
+#pragma once
+
+class Image_GLCore;
+
+/**
+ * Shared textures that small costumes are packed into, so sprites wearing different costumes can still be drawn in
+ * one batch. Placement is tracked by `AtlasPacker`; this side owns the GL page textures and the pixel copies.
+ */
+namespace CostumeAtlas {
+
+/**
+ * Packs `image` onto a page if it is small enough and there is room, setting its `atlasSlot`.
+ * @return Whether the image was placed. If not, it needs a texture of its own.
+ */
+bool place(Image_GLCore *image);
+
+/**
+ * Frees the spot of `image`, if it has one. The space is reclaimed by the next `repackIfNeeded`.
+ */
+void release(Image_GLCore *image);
+
+/**
+ * Moves images off pages that releases left mostly empty and deletes pages that are no longer needed.
+ * Only call this between batches, since it changes where images live.
+ */
+void repackIfNeeded();
+
+/**
+ * The texture the page of `image` is on.
+ */
+unsigned int getTexture(const Image_GLCore *image);
+
+/**
+ * Where `image` sits on its page, as the offset and scale that map its own texture coordinates to the page's.
+ */
+void getRect(const Image_GLCore *image, float rect[4]);
+
+/**
+ * Deletes all pages. Images still placed on them keep a stale slot, so this is only for shutdown.
+ */
+void cleanup();
+
+} // namespace CostumeAtlas
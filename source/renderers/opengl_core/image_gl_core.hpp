@@ -1,21 +1,41 @@
 #pragma once
 #include "nonstd/expected.hpp"
+#include "sprite_batch_gl_core.hpp"
 #include <image.hpp>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 class Image_GLCore : public Image {
   private:
+    /**
+     * Whether the image is a costume, and so may share an atlas page instead of getting its own texture.
+     */
+    bool packable = false;
+
     void setInitialTexture();
 
   public:
+    /**
+     * The image's own texture, or 0 when it lives on an atlas page.
+     */
     unsigned int textureID = 0;
 
+    /**
+     * Where the image is in `CostumeAtlas`, if it was packed.
+     */
+    std::optional<uint32_t> atlasSlot;
+
     Image_GLCore(std::string filePath, bool fromScratchProject = true, bool bitmapHalfQuality = false, float scale = 1);
     Image_GLCore(std::string filePath, mz_zip_archive *zip, bool bitmapHalfQuality = false, float scale = 1);
     ~Image_GLCore() override;
 
+    /**
+     * The quad `render` would draw, for drawing it as part of a batch instead.
+     */
+    SpriteInstance makeInstance(const ImageRenderParams &params);
+
     void render(ImageRenderParams &params) override;
     void renderNineslice(double xPos, double yPos, double width, double height, double padding, bool centered = false) override;
 
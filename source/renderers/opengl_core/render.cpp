@@ -1,4 +1,5 @@
 #include "render.hpp"
+#include "atlas_gl_core.hpp"
 #include "speech_manager_gl_core.hpp"
 #include <image_gl_core.hpp>
 #include <log.hpp>
@@ -22,9 +23,11 @@
 #include <cmath>
 #include <color.hpp>
 #include <cstdlib>
+#include <cstring>
 #include <downloader.hpp>
 #include <image.hpp>
 #include <math.hpp>
+#include <penBuffer.hpp>
 #include <render.hpp>
 #include <runtime.hpp>
 #include <sprite.hpp>
@@ -51,12 +54,58 @@ static GLuint penTexture = 0;
 static int penWidth = 0;
 static int penHeight = 0;
 
-GLuint spriteProgram = 0;
+// Pen lines and dots wait here until the pen layer is next drawn, then go to the pen FBO in one draw.
+static PenBuffer penBuffer;
+static GLuint penVAO = 0;
+static GLuint penVBO = 0;
+
+// Uniform locations are looked up once when a program is linked. The projection is only uploaded when it changes.
+struct SpriteShader {
+    GLuint program = 0;
+    GLint projection = -1;
+    float currentProjection[16] = {};
+};
+
+struct SolidShader {
+    GLuint program = 0;
+    GLint projection = -1;
+    GLint color = -1;
+    float currentProjection[16] = {};
+};
+
+struct PenShader {
+    GLuint program = 0;
+    GLint projection = -1;
+    float currentProjection[16] = {};
+};
+
+static SpriteShader spriteShader;
+static SolidShader solidShader;
+static PenShader penShader;
 
-static GLuint solidProgram = 0;
-
-GLuint quadVAO = 0;
 static GLuint quadVBO = 0;
+static GLuint quadEBO = 0;
+
+// Every sprite quad is drawn from one instance buffer that is refilled front to back and orphaned once full.
+static GLuint spriteVAO = 0;
+static GLuint instanceVBO = 0;
+static size_t instanceCapacity = 0;
+static size_t instanceCursor = 0;
+
+static SpriteBatch frameBatch;
+static SpriteBatch immediateBatch;
+
+// The stage and sprites of the last frame stay in their own framebuffer, so a frame only has to draw them again
+// where something changed. Speech, black bars and monitors go on top of the copy every frame.
+static GLuint sceneFBO = 0;
+static GLuint sceneTexture = 0;
+static int sceneWidth = 0;
+static int sceneHeight = 0;
+static bool sceneUnavailable = false;
+static SpriteDamage sceneDamage;
+static std::vector<const void *> frameKeys;
+// The pen layer is drawn as one quad, so anything drawn on it has to redraw the whole stage.
+static bool penLayerChanged = false;
 
 static GLuint compileShader(GLenum type, const char *src) {
     GLuint shader = glCreateShader(type);
@@ -108,16 +157,32 @@ static const char *kSpriteVert = R"glsl(
 #version 410 core
 
 layout(location = 0) in vec2 a_pos;
-layout(location = 1) in vec2 a_uv;
+
+// one SpriteInstance per quad
+layout(location = 2) in vec4 i_transform;
+layout(location = 3) in vec2 i_translate;
+layout(location = 4) in vec4 i_uv_rect;
+layout(location = 5) in vec2 i_tex_size;
+layout(location = 6) in vec4 i_effects;  // opacity, brightness, color, fisheye
+layout(location = 7) in vec3 i_effects2; // whirl, pixelate, mosaic
+layout(location = 8) in vec4 i_atlas_rect;
 
 out vec2 v_uv;
+flat out vec4 v_effects;
+flat out vec3 v_effects2;
+flat out vec2 v_tex_size;
+flat out vec4 v_atlas_rect;
 
-uniform mat4 u_model;
 uniform mat4 u_projection;
 
 void main() {
-    gl_Position = u_projection * u_model * vec4(a_pos, 0.0, 1.0);
-    v_uv = a_uv;
+    vec2 pos = mat2(i_transform.xy, i_transform.zw) * a_pos + i_translate;
+    gl_Position = u_projection * vec4(pos, 0.0, 1.0);
+    v_uv = mix(i_uv_rect.xy, i_uv_rect.zw, a_pos);
+    v_effects = i_effects;
+    v_effects2 = i_effects2;
+    v_tex_size = i_tex_size;
+    v_atlas_rect = i_atlas_rect;
 }
 )glsl";
 
@@ -125,17 +190,13 @@ static const char *kSpriteFrag = R"glsl(
 #version 410 core
 
 in  vec2 v_uv;
+flat in vec4 v_effects;
+flat in vec3 v_effects2;
+flat in vec2 v_tex_size;
+flat in vec4 v_atlas_rect;
 out vec4 frag_color;
 
 uniform sampler2D u_tex;
-uniform float u_opacity;
-uniform float u_brightness;
-uniform float u_color;
-uniform float u_fisheye;
-uniform float u_whirl;
-uniform float u_pixelate;
-uniform float u_mosaic;
-uniform vec2  u_tex_size;
 
 const float epsilon = 1e-3;
 const vec2 kCenter = vec2(0.5, 0.5);
@@ -156,6 +217,15 @@ vec3 hsv2rgb(vec3 c) {
 }
 
 void main() {
+    float u_opacity = v_effects.x;
+    float u_brightness = v_effects.y;
+    float u_color = v_effects.z;
+    float u_fisheye = v_effects.w;
+    float u_whirl = v_effects2.x;
+    float u_pixelate = v_effects2.y;
+    float u_mosaic = v_effects2.z;
+    vec2 u_tex_size = v_tex_size;
+
     vec2 uv = v_uv;
 
     if (abs(u_mosaic) > 0.001) {
@@ -200,7 +270,8 @@ void main() {
         discard;
     }
 
-    vec4 color = texture(u_tex, uv);
+    // effects work in the image's own coordinates; only the lookup knows where it sits on an atlas page
+    vec4 color = texture(u_tex, v_atlas_rect.xy + uv * v_atlas_rect.zw);
     if (color.a < 0.001) discard;
 
     if (abs(u_color) > 0.001) {
@@ -249,6 +320,33 @@ void main() {
 }
 )glsl";
 
+static const char *kPenVert = R"glsl(
+#version 410 core
+
+layout(location = 0) in vec2 a_pos;
+layout(location = 1) in vec4 a_color;
+
+out vec4 v_color;
+
+uniform mat4 u_projection;
+
+void main() {
+    gl_Position = u_projection * vec4(a_pos, 0.0, 1.0);
+    v_color = a_color;
+}
+)glsl";
+
+static const char *kPenFrag = R"glsl(
+#version 410 core
+
+in vec4 v_color;
+out vec4 frag_color;
+
+void main() {
+    frag_color = v_color;
+}
+)glsl";
+
 static void buildOrtho(float out[16], float l, float r, float b, float t) {
     for (int i = 0; i < 16; ++i)
         out[i] = 0.0f;
@@ -261,46 +359,120 @@ static void buildOrtho(float out[16], float l, float r, float b, float t) {
 }
 
 static void setupQuadGeometry() {
-    const float verts[] = {
-        0.0f,
-        0.0f,
-        0.0f,
-        0.0f,
-        1.0f,
-        0.0f,
-        1.0f,
-        0.0f,
-        1.0f,
-        1.0f,
-        1.0f,
-        1.0f,
-        0.0f,
-        1.0f,
-        0.0f,
-        1.0f,
-    };
+    static const float verts[] = {
+        0.0f, 0.0f,
+        1.0f, 0.0f,
+        1.0f, 1.0f,
+        0.0f, 1.0f};
     static const GLuint indices[] = {0, 1, 2, 2, 3, 0};
 
-    GLuint ebo = 0;
-    glGenVertexArrays(1, &quadVAO);
+    glGenVertexArrays(1, &spriteVAO);
     glGenBuffers(1, &quadVBO);
-    glGenBuffers(1, &ebo);
+    glGenBuffers(1, &quadEBO);
+    glGenBuffers(1, &instanceVBO);
 
-    glBindVertexArray(quadVAO);
+    glBindVertexArray(spriteVAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(0));
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (GLuint location = 2; location <= 8; location++) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+
+    glBindVertexArray(0);
+}
+
+// Points the instance attributes at `first` in the instance buffer. GL 4.1 has no base instance, so this is done
+// before every draw call instead. Expects spriteVAO and instanceVBO to be bound.
+static void pointInstanceAttributes(size_t first) {
+    const size_t base = first * sizeof(SpriteInstance);
+    const GLsizei stride = sizeof(SpriteInstance);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void *)(base + offsetof(SpriteInstance, transform)));
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (void *)(base + offsetof(SpriteInstance, translate)));
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, stride, (void *)(base + offsetof(SpriteInstance, uvRect)));
+    glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, stride, (void *)(base + offsetof(SpriteInstance, texSize)));
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride, (void *)(base + offsetof(SpriteInstance, opacity)));
+    glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, stride, (void *)(base + offsetof(SpriteInstance, whirl)));
+    glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, stride, (void *)(base + offsetof(SpriteInstance, atlasRect)));
+}
+
+// Copies `count` instances into the instance buffer and returns where they start. Expects instanceVBO to be bound.
+static size_t uploadInstances(const SpriteInstance *instances, size_t count) {
+    if (count > instanceCapacity) {
+        instanceCapacity = std::max<size_t>({count, instanceCapacity * 2, 256});
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(SpriteInstance), nullptr, GL_STREAM_DRAW);
+        instanceCursor = 0;
+    } else if (instanceCursor + count > instanceCapacity) {
+        // orphan the buffer instead of waiting for the GPU to finish with it
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(SpriteInstance), nullptr, GL_STREAM_DRAW);
+        instanceCursor = 0;
+    }
+
+    const size_t first = instanceCursor;
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(SpriteInstance), count * sizeof(SpriteInstance), instances);
+    instanceCursor += count;
+    return first;
+}
+
+template <typename Shader>
+static void setProjection(Shader &shader, const float proj[16]) {
+    if (memcmp(shader.currentProjection, proj, sizeof(shader.currentProjection)) == 0) return;
+    memcpy(shader.currentProjection, proj, sizeof(shader.currentProjection));
+    glUniformMatrix4fv(shader.projection, 1, GL_FALSE, proj);
+}
+
+unsigned int getSpriteProgram() {
+    return spriteShader.program;
+}
+
+void drawSpriteBatch(SpriteBatch &batch, const float proj[16]) {
+    batch.build();
+    const std::vector<SpriteInstance> &instances = batch.getInstances();
+    if (instances.empty()) return;
+
+    glUseProgram(spriteShader.program);
+    setProjection(spriteShader, proj);
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glBindVertexArray(spriteVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    const size_t first = uploadInstances(instances.data(), instances.size());
 
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
+    GLuint program = spriteShader.program;
+    for (const SpriteDrawCall &call : batch.getDrawCalls()) {
+        if (call.program != program) {
+            program = call.program;
+            glUseProgram(program);
+        }
+        glBindTexture(GL_TEXTURE_2D, call.texture);
+        pointInstanceAttributes(first + call.first);
+        glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, (GLsizei)call.count);
+    }
 
     glBindVertexArray(0);
+    if (program != spriteShader.program) glUseProgram(spriteShader.program);
+}
+
+void drawSprites(const SpriteInstance *instances, size_t count) {
+    GLint vp[4];
+    glGetIntegerv(GL_VIEWPORT, vp);
+    float proj[16];
+    buildOrtho(proj, 0.0f, (float)vp[2], (float)vp[3], 0.0f);
+
+    immediateBatch.clear();
+    for (size_t i = 0; i < count; i++)
+        immediateBatch.add(instances[i]);
+    drawSpriteBatch(immediateBatch, proj);
 }
 
 static GLuint getMainFBO() {
@@ -355,6 +527,54 @@ static bool createPenFBO() {
     glClear(GL_COLOR_BUFFER_BIT);
     glBindFramebuffer(GL_FRAMEBUFFER, getMainFBO());
 
+    penLayerChanged = true;
+    return true;
+}
+
+static void destroySceneFBO() {
+    if (sceneFBO) {
+        glDeleteFramebuffers(1, &sceneFBO);
+        sceneFBO = 0;
+    }
+    if (sceneTexture) {
+        glDeleteTextures(1, &sceneTexture);
+        sceneTexture = 0;
+    }
+    sceneWidth = sceneHeight = 0;
+}
+
+// Makes sure the scene framebuffer matches the window. If it can't be made, the stage is drawn straight to the
+// screen every frame instead.
+static bool ensureSceneFBO() {
+    if (sceneUnavailable) return false;
+    if (sceneFBO != 0 && sceneWidth == Render::getWidth() && sceneHeight == Render::getHeight()) return true;
+
+    destroySceneFBO();
+    sceneWidth = Render::getWidth();
+    sceneHeight = Render::getHeight();
+    sceneDamage.invalidate();
+
+    glGenTextures(1, &sceneTexture);
+    glBindTexture(GL_TEXTURE_2D, sceneTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, sceneWidth, sceneHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    glGenFramebuffers(1, &sceneFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneTexture, 0);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, getMainFBO());
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        Log::logWarning("[GL Core] Scene FBO incomplete, redrawing the whole stage every frame");
+        destroySceneFBO();
+        sceneUnavailable = true;
+        return false;
+    }
     return true;
 }
 
@@ -389,9 +609,9 @@ static void drawSolidRect(float x, float y, float w, float h,
                           const float proj[16]) {
     ensureDynamicBuffers();
 
-    glUseProgram(solidProgram);
-    glUniformMatrix4fv(glGetUniformLocation(solidProgram, "u_projection"), 1, GL_FALSE, proj);
-    glUniform4f(glGetUniformLocation(solidProgram, "u_color"), r, g, b, a);
+    glUseProgram(solidShader.program);
+    setProjection(solidShader, proj);
+    glUniform4f(solidShader.color, r, g, b, a);
 
     float verts[] = {
         x, y,
@@ -407,82 +627,6 @@ static void drawSolidRect(float x, float y, float w, float h,
     glBindVertexArray(0);
 }
 
-static void drawSolidCircle(float cx, float cy, float radius,
-                            float r, float g, float b, float a,
-                            const float proj[16], int segments = 24) {
-    ensureDynamicBuffers();
-
-    glUseProgram(solidProgram);
-    glUniformMatrix4fv(glGetUniformLocation(solidProgram, "u_projection"), 1, GL_FALSE, proj);
-    glUniform4f(glGetUniformLocation(solidProgram, "u_color"), r, g, b, a);
-
-    std::vector<float> verts;
-    verts.reserve((segments + 2) * 2);
-    verts.push_back(cx);
-    verts.push_back(cy);
-    for (int i = 0; i <= segments; ++i) {
-        float angle = i * 2.0f * (float)M_PI / segments;
-        verts.push_back(cx + std::cos(angle) * radius);
-        verts.push_back(cy + std::sin(angle) * radius);
-    }
-
-    glBindVertexArray(dynamicVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, dynamicVBO);
-    glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_STREAM_DRAW);
-
-    glDrawArrays(GL_TRIANGLE_FAN, 0, (GLsizei)(verts.size() / 2));
-    glBindVertexArray(0);
-}
-
-static void drawSolidCapsule(float x1, float y1, float x2, float y2, float radius,
-                             float r, float g, float b, float a,
-                             const float proj[16], int capSegments = 12) {
-    float dx = x2 - x1, dy = y2 - y1;
-    float length = std::sqrt(dx * dx + dy * dy);
-
-    if (length <= 0.001f) {
-        drawSolidCircle(x1, y1, radius, r, g, b, a, proj, capSegments * 2);
-        return;
-    }
-
-    ensureDynamicBuffers();
-
-    glUseProgram(solidProgram);
-    glUniformMatrix4fv(glGetUniformLocation(solidProgram, "u_projection"), 1, GL_FALSE, proj);
-    glUniform4f(glGetUniformLocation(solidProgram, "u_color"), r, g, b, a);
-
-    float phi = std::atan2(dy, dx);
-    std::vector<float> verts;
-    verts.reserve(((capSegments + 1) * 2 + 2) * 2);
-
-    verts.push_back((x1 + x2) * 0.5f);
-    verts.push_back((y1 + y2) * 0.5f);
-
-    float startAngle2 = phi - (float)M_PI_2;
-    for (int i = 0; i <= capSegments; ++i) {
-        float angle = startAngle2 + (i * (float)M_PI / capSegments);
-        verts.push_back(x2 + std::cos(angle) * radius);
-        verts.push_back(y2 + std::sin(angle) * radius);
-    }
-
-    float startAngle1 = phi + (float)M_PI_2;
-    for (int i = 0; i <= capSegments; ++i) {
-        float angle = startAngle1 + (i * (float)M_PI / capSegments);
-        verts.push_back(x1 + std::cos(angle) * radius);
-        verts.push_back(y1 + std::sin(angle) * radius);
-    }
-
-    verts.push_back(verts[2]);
-    verts.push_back(verts[3]);
-
-    glBindVertexArray(dynamicVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, dynamicVBO);
-    glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_STREAM_DRAW);
-
-    glDrawArrays(GL_TRIANGLE_FAN, 0, (GLsizei)(verts.size() / 2));
-    glBindVertexArray(0);
-}
-
 bool Render::Init() {
 #if defined(WINDOWING_GLFW)
     globalWindow = new WindowGLFW();
@@ -532,10 +676,11 @@ bool Render::Init() {
     glDisable(GL_DEPTH_TEST);
     glDisable(GL_CULL_FACE);
 
-    spriteProgram = linkProgram(kSpriteVert, kSpriteFrag);
-    solidProgram = linkProgram(kSolidVert, kSolidFrag);
+    spriteShader.program = linkProgram(kSpriteVert, kSpriteFrag);
+    solidShader.program = linkProgram(kSolidVert, kSolidFrag);
+    penShader.program = linkProgram(kPenVert, kPenFrag);
 
-    if (!spriteProgram || !solidProgram) {
+    if (!spriteShader.program || !solidShader.program || !penShader.program) {
         Log::logError("[GL Core] Failed to compile/link shaders");
         globalWindow->cleanup();
         delete globalWindow;
@@ -543,6 +688,20 @@ bool Render::Init() {
         return false;
     }
 
+    spriteShader.projection = glGetUniformLocation(spriteShader.program, "u_projection");
+    glUseProgram(spriteShader.program);
+    glUniform1i(glGetUniformLocation(spriteShader.program, "u_tex"), 0);
+    glUniformMatrix4fv(spriteShader.projection, 1, GL_FALSE, spriteShader.currentProjection);
+
+    solidShader.projection = glGetUniformLocation(solidShader.program, "u_projection");
+    solidShader.color = glGetUniformLocation(solidShader.program, "u_color");
+    glUseProgram(solidShader.program);
+    glUniformMatrix4fv(solidShader.projection, 1, GL_FALSE, solidShader.currentProjection);
+
+    penShader.projection = glGetUniformLocation(penShader.program, "u_projection");
+    glUseProgram(penShader.program);
+    glUniformMatrix4fv(penShader.projection, 1, GL_FALSE, penShader.currentProjection);
+
     setupQuadGeometry();
     setRenderScale();
 
@@ -552,23 +711,36 @@ bool Render::Init() {
 
 void Render::deInit() {
     destroyPenFBO();
-
-    if (spriteProgram) {
-        glDeleteProgram(spriteProgram);
-        spriteProgram = 0;
+    destroySceneFBO();
+    sceneUnavailable = false;
+    sceneDamage.invalidate();
+    CostumeAtlas::cleanup();
+
+    if (spriteShader.program) glDeleteProgram(spriteShader.program);
+    if (solidShader.program) glDeleteProgram(solidShader.program);
+    if (penShader.program) glDeleteProgram(penShader.program);
+    spriteShader = SpriteShader();
+    solidShader = SolidShader();
+    penShader = PenShader();
+    if (spriteVAO) {
+        glDeleteVertexArrays(1, &spriteVAO);
+        spriteVAO = 0;
     }
-    if (solidProgram) {
-        glDeleteProgram(solidProgram);
-        solidProgram = 0;
+    const GLuint buffers[] = {quadVBO, quadEBO, instanceVBO};
+    glDeleteBuffers(3, buffers);
+    quadVBO = quadEBO = instanceVBO = 0;
+    instanceCapacity = instanceCursor = 0;
+    if (dynamicVAO) {
+        glDeleteVertexArrays(1, &dynamicVAO);
+        glDeleteBuffers(1, &dynamicVBO);
+        dynamicVAO = dynamicVBO = 0;
     }
-    if (quadVAO) {
-        glDeleteVertexArrays(1, &quadVAO);
-        quadVAO = 0;
-    }
-    if (quadVBO) {
-        glDeleteBuffers(1, &quadVBO);
-        quadVBO = 0;
+    if (penVAO) {
+        glDeleteVertexArrays(1, &penVAO);
+        glDeleteBuffers(1, &penVBO);
+        penVAO = penVBO = 0;
     }
+    penBuffer.clear();
 
     SoundPlayer::deinit();
     TextObject::cleanupText();
@@ -612,7 +784,9 @@ bool Render::initPen() {
 }
 
 void Render::penClear() {
+    penBuffer.clear();
     if (penFBO == getMainFBO()) return;
+    penLayerChanged = true;
     glBindFramebuffer(GL_FRAMEBUFFER, penFBO);
     glViewport(0, 0, penWidth, penHeight);
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
@@ -632,6 +806,51 @@ static void penEnd() {
     glViewport(0, 0, Render::getWidth(), Render::getHeight());
 }
 
+// Draws every queued pen line and dot into the pen FBO.
+static void flushPen() {
+    if (penBuffer.empty()) return;
+    if (penFBO == 0) {
+        penBuffer.clear();
+        return;
+    }
+
+    const std::vector<PenVertex> &vertices = penBuffer.tessellate();
+
+    if (penVAO == 0) {
+        glGenVertexArrays(1, &penVAO);
+        glGenBuffers(1, &penVBO);
+        glBindVertexArray(penVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, penVBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(PenVertex), (void *)offsetof(PenVertex, x));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PenVertex), (void *)offsetof(PenVertex, r));
+    }
+
+    float proj[16];
+    buildOrtho(proj, 0.0f, (float)penWidth, (float)penHeight, 0.0f);
+
+    penBegin();
+    glUseProgram(penShader.program);
+    setProjection(penShader, proj);
+    glBindVertexArray(penVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, penVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(PenVertex), vertices.data(), GL_STREAM_DRAW);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+    glBindVertexArray(0);
+    penEnd();
+
+    penBuffer.clear();
+    penLayerChanged = true;
+}
+
+static PenBuffer::Color penColor(const Sprite *sprite) {
+    const ColorRGBA rgbColor = CSBT2RGBA(sprite->penData.color);
+    const double alpha = (100.0 - sprite->penData.color.transparency) / 100.0;
+    return {static_cast<uint8_t>(rgbColor.r), static_cast<uint8_t>(rgbColor.g), static_cast<uint8_t>(rgbColor.b),
+            static_cast<uint8_t>(std::clamp(alpha, 0.0, 1.0) * 255.0 + 0.5)};
+}
+
 void Render::penMoveFast(double x1, double y1, double x2, double y2, Sprite *sprite) {
     penMoveAccurate(x1, y1, x2, y2, sprite);
 }
@@ -643,10 +862,6 @@ void Render::penDotFast(Sprite *sprite) {
 void Render::penMoveAccurate(double x1, double y1, double x2, double y2, Sprite *sprite) {
     if (penFBO == 0) return;
 
-    const ColorRGBA rgbColor = CSBT2RGBA(sprite->penData.color);
-    float alpha = (100.0f - (float)sprite->penData.color.transparency) / 100.0f;
-    float r = rgbColor.r / 255.0f, g = rgbColor.g / 255.0f, b = rgbColor.b / 255.0f;
-
     const double scale = penHeight / static_cast<double>(Scratch::projectHeight);
     float px1 = (float)(x1 * scale + penWidth / 2.0);
     float py1 = (float)(-y1 * scale + penHeight / 2.0);
@@ -654,32 +869,20 @@ void Render::penMoveAccurate(double x1, double y1, double x2, double y2, Sprite
     float py2 = (float)(-y2 * scale + penHeight / 2.0);
     float radius = (float)((sprite->penData.size / 2.0) * scale);
 
-    float proj[16];
-    buildOrtho(proj, 0.0f, (float)penWidth, (float)penHeight, 0.0f);
-
-    penBegin();
-    drawSolidCapsule(px1, py1, px2, py2, radius, r, g, b, alpha, proj);
-    penEnd();
+    penBuffer.line(px1, py1, px2, py2, radius, penColor(sprite));
+    if (penBuffer.size() >= PenBuffer::flushThreshold) flushPen();
 }
 
 void Render::penDotAccurate(Sprite *sprite) {
     if (penFBO == 0) return;
 
-    const ColorRGBA rgbColor = CSBT2RGBA(sprite->penData.color);
-    float alpha = (100.0f - (float)sprite->penData.color.transparency) / 100.0f;
-    float r = rgbColor.r / 255.0f, g = rgbColor.g / 255.0f, b = rgbColor.b / 255.0f;
-
     const double scale = penHeight / static_cast<double>(Scratch::projectHeight);
     float px = (float)(sprite->xPosition * scale + penWidth / 2.0);
     float py = (float)(-sprite->yPosition * scale + penHeight / 2.0);
     float radius = (float)((sprite->penData.size / 2.0) * scale);
 
-    float proj[16];
-    buildOrtho(proj, 0.0f, (float)penWidth, (float)penHeight, 0.0f);
-
-    penBegin();
-    drawSolidCircle(px, py, radius, r, g, b, alpha, proj);
-    penEnd();
+    penBuffer.dot(px, py, radius, penColor(sprite));
+    if (penBuffer.size() >= PenBuffer::flushThreshold) flushPen();
 }
 
 void Render::penStamp(Sprite *sprite) {
@@ -718,9 +921,13 @@ void Render::penStamp(Sprite *sprite) {
     params.opacity = 1.0f - std::clamp(sprite->ghostEffect, 0.0f, 100.0f) * 0.01f;
     params.brightness = sprite->brightnessEffect;
 
+    // the stamp has to land on top of everything drawn before it
+    flushPen();
+
     penBegin();
     image->render(params);
     penEnd();
+    penLayerChanged = true;
 }
 
 void Render::beginFrame(int /*screen*/, int colorR, int colorG, int colorB) {
@@ -747,57 +954,42 @@ void Render::drawBox(int w, int h, int x, int y,
                   proj);
 }
 
-void Render::renderPenLayer() {
-    if (penTexture == 0) return;
-
+// The pen layer as a quad covering the stage, flipped since the pen framebuffer is upside down.
+static SpriteInstance penLayerInstance() {
     float projectAspect = (float)Scratch::projectWidth / Scratch::projectHeight;
-    float windowAspect = (float)getWidth() / getHeight();
+    float windowAspect = (float)Render::getWidth() / Render::getHeight();
 
     float drawW, drawH, drawX, drawY;
     if (windowAspect > projectAspect) {
-        drawH = (float)getHeight();
+        drawH = (float)Render::getHeight();
         drawW = drawH * projectAspect;
-        drawX = (getWidth() - drawW) / 2.0f;
+        drawX = (Render::getWidth() - drawW) / 2.0f;
         drawY = 0;
     } else {
-        drawW = (float)getWidth();
+        drawW = (float)Render::getWidth();
         drawH = drawW / projectAspect;
         drawX = 0;
-        drawY = (getHeight() - drawH) / 2.0f;
+        drawY = (Render::getHeight() - drawH) / 2.0f;
     }
 
-    float proj[16];
-    buildOrtho(proj, 0.0f, (float)getWidth(), (float)getHeight(), 0.0f);
-
-    float model[16] = {};
-    model[0] = drawW;
-    model[5] = -drawH;
-    model[10] = 1.0f;
-    model[12] = drawX;
-    model[13] = drawY + drawH;
-    model[15] = 1.0f;
-
-    glUseProgram(spriteProgram);
-    glUniformMatrix4fv(glGetUniformLocation(spriteProgram, "u_projection"), 1, GL_FALSE, proj);
-    glUniformMatrix4fv(glGetUniformLocation(spriteProgram, "u_model"), 1, GL_FALSE, model);
-    glUniform1i(glGetUniformLocation(spriteProgram, "u_tex"), 0);
-    glUniform1f(glGetUniformLocation(spriteProgram, "u_opacity"), 1.0f);
-    glUniform1f(glGetUniformLocation(spriteProgram, "u_brightness"), 0.0f);
-    glUniform1f(glGetUniformLocation(spriteProgram, "u_color"), 0.0f);
-    glUniform1f(glGetUniformLocation(spriteProgram, "u_fisheye"), 0.0f);
-    glUniform1f(glGetUniformLocation(spriteProgram, "u_whirl"), 0.0f);
-    glUniform1f(glGetUniformLocation(spriteProgram, "u_pixelate"), 0.0f);
-    glUniform1f(glGetUniformLocation(spriteProgram, "u_mosaic"), 0.0f);
-    glUniform2f(glGetUniformLocation(spriteProgram, "u_tex_size"), (float)penWidth, (float)penHeight);
+    ImageRenderParams params;
+    params.centered = false;
+    SpriteInstance instance = SpriteBatch::makeInstance(params, (float)penWidth, (float)penHeight, (float)penWidth, (float)penHeight, penTexture, spriteShader.program);
+    instance.transform[0] = drawW;
+    instance.transform[1] = 0.0f;
+    instance.transform[2] = 0.0f;
+    instance.transform[3] = -drawH;
+    instance.translate[0] = drawX;
+    instance.translate[1] = drawY + drawH;
+    return instance;
+}
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, penTexture);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+void Render::renderPenLayer() {
+    if (penTexture == 0) return;
+    flushPen();
 
-    glBindVertexArray(quadVAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-    glBindVertexArray(0);
+    const SpriteInstance instance = penLayerInstance();
+    drawSprites(&instance, 1);
 }
 
 static void drawBlackBars(int screenWidth, int screenHeight, const float proj[16]) {
@@ -821,24 +1013,72 @@ static void drawBlackBars(int screenWidth, int screenHeight, const float proj[16
     }
 }
 
+void invalidateScene() {
+    sceneDamage.invalidate();
+}
+
+// Draws the collected stage and sprites, into the scene framebuffer only where they changed if there is one.
+static void drawScene(const float proj[16]) {
+    const int width = Render::getWidth();
+    const int height = Render::getHeight();
+
+    if (!ensureSceneFBO()) {
+        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        drawSpriteBatch(frameBatch, proj);
+        return;
+    }
+
+    if (penLayerChanged) sceneDamage.invalidate();
+    penLayerChanged = false;
+
+    const SpriteDamage::Rect damage = sceneDamage.update(frameKeys, frameBatch.getInstances());
+    const int left = std::max(0, (int)std::floor(damage.left));
+    const int top = std::max(0, (int)std::floor(damage.top));
+    const int right = std::min(width, (int)std::ceil(damage.right));
+    const int bottom = std::min(height, (int)std::ceil(damage.bottom));
+
+    if (left < right && top < bottom) {
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(left, height - bottom, right - left, bottom - top);
+        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        drawSpriteBatch(frameBatch, proj);
+        glDisable(GL_SCISSOR_TEST);
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, getMainFBO());
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, getMainFBO());
+}
+
 void Render::renderSprites() {
+    flushPen();
+
     glViewport(0, 0, getWidth(), getHeight());
-    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     float proj[16];
     buildOrtho(proj, 0.0f, (float)getWidth(), (float)getHeight(), 0.0f);
 
+    // costumes freed since the last frame may have left atlas pages mostly empty
+    CostumeAtlas::repackIfNeeded();
+
+    // collect every quad back to front first, then draw runs that share a texture together
+    frameBatch.clear();
+    frameKeys.clear();
+    uint32_t order = 0;
     for (auto it = Scratch::sprites.rbegin(); it != Scratch::sprites.rend(); ++it) {
         Sprite *currentSprite = *it;
 
-        auto imgFind = Scratch::costumeImages.find(currentSprite->costumes[currentSprite->currentCostume].fullName);
+        auto imgFind = Scratch::costumeImages.find(currentSprite->costumes[Scratch::getRenderedCostume(currentSprite)].fullName);
         if (imgFind != Scratch::costumeImages.end()) {
             Image_GLCore *image = reinterpret_cast<Image_GLCore *>(imgFind->second.get());
 
-            const bool isSVG = currentSprite->costumes[currentSprite->currentCostume].isSVG;
+            const bool isSVG = currentSprite->costumes[Scratch::getRenderedCostume(currentSprite)].isSVG;
             calculateRenderPosition(currentSprite, isSVG);
             if (!currentSprite->visible) continue;
 
@@ -857,11 +1097,20 @@ void Render::renderSprites() {
             params.pixelateEffect = currentSprite->pixelateEffect;
             params.mosaicEffect = currentSprite->mosaicEffect;
 
-            image->render(params);
+            SpriteInstance instance = image->makeInstance(params);
+            instance.order = order++;
+            frameBatch.add(instance);
+            frameKeys.push_back(currentSprite);
         }
 
-        if (currentSprite->isStage) renderPenLayer();
+        if (currentSprite->isStage && penTexture != 0) {
+            SpriteInstance instance = penLayerInstance();
+            instance.order = order++;
+            frameBatch.add(instance);
+            frameKeys.push_back(&penTexture);
+        }
     }
+    drawScene(proj);
 
     if (speechManager) speechManager->render();
 
@@ -5,3 +5,26 @@
 #else
 #include <glad/glad.h>
 #endif
+
+#include "sprite_batch_gl_core.hpp"
+
+/**
+ * The program sprite quads are drawn with.
+ */
+unsigned int getSpriteProgram();
+
+/**
+ * Builds `batch` and draws it with one instanced call per run of quads that share a texture and program.
+ */
+void drawSpriteBatch(SpriteBatch &batch, const float proj[16]);
+
+/**
+ * Draws `instances` right away, in the coordinates of the current viewport.
+ */
+void drawSprites(const SpriteInstance *instances, size_t count);
+
+/**
+ * Makes the next frame draw the whole stage again instead of only what moved, for when a texture's pixels changed
+ * without any quad changing.
+ */
+void invalidateScene();
@@ -0,0 +1,150 @@
+#include "sprite_batch_gl_core.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+SpriteInstance SpriteBatch::makeInstance(const ImageRenderParams &params, float width, float height, float textureWidth, float textureHeight, unsigned int texture, unsigned int program) {
+    SpriteInstance instance;
+
+    float renderWidth = width;
+    float renderHeight = height;
+    float u0 = 0.0f, v0 = 0.0f, u1 = 1.0f, v1 = 1.0f;
+    if (params.subrect) {
+        renderWidth = (float)params.subrect->w;
+        renderHeight = (float)params.subrect->h;
+        u0 = params.subrect->x / textureWidth;
+        v0 = params.subrect->y / textureHeight;
+        u1 = (params.subrect->x + params.subrect->w) / textureWidth;
+        v1 = (params.subrect->y + params.subrect->h) / textureHeight;
+    }
+
+    const float scaleX = params.flip ? -std::abs(params.scale) : std::abs(params.scale);
+    const float scaleY = params.scale;
+    const float sx = renderWidth * scaleX;
+    const float sy = renderHeight * scaleY;
+    const float pivotX = params.centered ? 0.5f : 0.0f;
+    const float pivotY = params.centered ? 0.5f : 0.0f;
+
+    float drawX = params.x;
+    if (params.flip) drawX += renderWidth * std::abs(scaleX);
+
+    // rotate and scale the unit quad around the pivot, then move it into place
+    const float c = std::cos(-params.rotation);
+    const float s = std::sin(-params.rotation);
+    instance.transform[0] = c * sx;
+    instance.transform[1] = s * sx;
+    instance.transform[2] = -s * sy;
+    instance.transform[3] = c * sy;
+    instance.translate[0] = drawX + pivotX - (c * sx * pivotX - s * sy * pivotY);
+    instance.translate[1] = params.y + pivotY - (s * sx * pivotX + c * sy * pivotY);
+
+    instance.uvRect[0] = u0;
+    instance.uvRect[1] = v0;
+    instance.uvRect[2] = u1;
+    instance.uvRect[3] = v1;
+    instance.texSize[0] = width;
+    instance.texSize[1] = height;
+
+    instance.opacity = params.opacity;
+    instance.brightness = (float)params.brightness;
+    instance.color = params.colorEffect;
+    instance.fisheye = params.fisheyeEffect;
+    instance.whirl = params.whirlEffect;
+    instance.pixelate = params.pixelateEffect;
+    instance.mosaic = params.mosaicEffect;
+    instance.atlasRect[0] = 0.0f;
+    instance.atlasRect[1] = 0.0f;
+    instance.atlasRect[2] = 1.0f;
+    instance.atlasRect[3] = 1.0f;
+
+    instance.texture = texture;
+    instance.program = program;
+    instance.order = 0;
+    return instance;
+}
+
+void SpriteBatch::add(const SpriteInstance &instance) {
+    instances.push_back(instance);
+}
+
+void SpriteBatch::build() {
+    std::stable_sort(instances.begin(), instances.end(), [](const SpriteInstance &a, const SpriteInstance &b) {
+        return a.order < b.order;
+    });
+
+    drawCalls.clear();
+    for (size_t i = 0; i < instances.size(); i++) {
+        const SpriteInstance &instance = instances[i];
+        if (!drawCalls.empty() && drawCalls.back().texture == instance.texture && drawCalls.back().program == instance.program) {
+            drawCalls.back().count++;
+            continue;
+        }
+        drawCalls.push_back({instance.texture, instance.program, i, 1});
+    }
+}
+
+void SpriteBatch::clear() {
+    instances.clear();
+    drawCalls.clear();
+}
+
+SpriteDamage::Rect SpriteDamage::bounds(const SpriteInstance &instance) {
+    Rect rect = {FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX};
+    const float corners[4][2] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}};
+    for (const auto &corner : corners) {
+        const float x = instance.transform[0] * corner[0] + instance.transform[2] * corner[1] + instance.translate[0];
+        const float y = instance.transform[1] * corner[0] + instance.transform[3] * corner[1] + instance.translate[1];
+        rect.left = std::min(rect.left, x);
+        rect.top = std::min(rect.top, y);
+        rect.right = std::max(rect.right, x);
+        rect.bottom = std::max(rect.bottom, y);
+    }
+    rect.left -= 1.0f;
+    rect.top -= 1.0f;
+    rect.right += 1.0f;
+    rect.bottom += 1.0f;
+    return rect;
+}
+
+static void extend(SpriteDamage::Rect &rect, const SpriteDamage::Rect &other) {
+    rect.left = std::min(rect.left, other.left);
+    rect.top = std::min(rect.top, other.top);
+    rect.right = std::max(rect.right, other.right);
+    rect.bottom = std::max(rect.bottom, other.bottom);
+}
+
+SpriteDamage::Rect SpriteDamage::update(const std::vector<const void *> &keys, const std::vector<SpriteInstance> &instances) {
+    Rect damage = {FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX};
+    if (!valid) damage = {-FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX};
+
+    std::unordered_map<const void *, Drawn> current;
+    current.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        SpriteInstance instance = instances[i];
+        instance.order = 0;
+        current[keys[i]] = {i, instance};
+
+        if (!valid) continue;
+        auto it = previous.find(keys[i]);
+        if (it != previous.end() && it->second.index == i && memcmp(&it->second.instance, &instance, sizeof(instance)) == 0) {
+            previous.erase(it);
+            continue;
+        }
+        extend(damage, bounds(instance));
+        if (it != previous.end()) {
+            extend(damage, bounds(it->second.instance));
+            previous.erase(it);
+        }
+    }
+
+    // whatever is left was drawn last frame but not this one
+    if (valid) {
+        for (const auto &[key, drawn] : previous)
+            extend(damage, bounds(drawn.instance));
+    }
+
+    previous = std::move(current);
+    valid = true;
+    return damage;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <image.hpp>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * One textured quad, laid out exactly as the sprite shader reads it from the instance buffer.
+ * The unit quad (0..1) is mapped to the screen with `transform` (a column-major 2x2 matrix) followed by `translate`.
+ */
+struct SpriteInstance {
+    float transform[4];
+    float translate[2];
+    float uvRect[4]; // u0, v0, u1, v1
+    float texSize[2];
+    float opacity;
+    float brightness;
+    float color;
+    float fisheye;
+    float whirl;
+    float pixelate;
+    float mosaic;
+    float atlasRect[4]; // offset and scale from the image's texture coordinates to its atlas page, identity if unpacked
+
+    // not read by the shader
+    unsigned int texture;
+    unsigned int program;
+    uint32_t order;
+};
+
+/**
+ * A run of instances that share a texture and program, drawn with a single instanced call.
+ */
+struct SpriteDrawCall {
+    unsigned int texture;
+    unsigned int program;
+    size_t first;
+    size_t count;
+};
+
+/**
+ * Collects the quads of a frame and turns them into as few draw calls as possible.
+ * Doesn't touch GL, so the draw calls it produces can be checked without a context.
+ */
+class SpriteBatch {
+  public:
+    /**
+     * Builds the instance for an image drawn with `params`, the same way `Image::render` places it.
+     * @param width Size the image is drawn at before `params.scale`.
+     * @param textureWidth Size of the texture, used to turn `params.subrect` into texture coordinates.
+     */
+    static SpriteInstance makeInstance(const ImageRenderParams &params, float width, float height, float textureWidth, float textureHeight, unsigned int texture, unsigned int program);
+
+    /**
+     * Queues `instance` to be drawn after everything with a lower `order`, and after everything already queued with
+     * the same `order`.
+     */
+    void add(const SpriteInstance &instance);
+
+    /**
+     * Sorts the queued instances by `order` and merges neighbours with the same texture and program into draw calls.
+     * Instances are never reordered past each other otherwise, so blending stays the same as drawing them one by one.
+     */
+    void build();
+
+    void clear();
+
+    const std::vector<SpriteInstance> &getInstances() const { return instances; }
+    const std::vector<SpriteDrawCall> &getDrawCalls() const { return drawCalls; }
+
+  private:
+    std::vector<SpriteInstance> instances;
+    std::vector<SpriteDrawCall> drawCalls;
+};
+
+/**
+ * Works out which part of the screen changed between frames from the quads drawn in each, so a renderer that keeps
+ * the last frame around only has to draw that part again.
+ * Doesn't touch GL either.
+ */
+class SpriteDamage {
+  public:
+    struct Rect {
+        float left;
+        float top;
+        float right;
+        float bottom;
+
+        bool empty() const { return right <= left || bottom <= top; }
+    };
+
+    /**
+     * The screen space box `instance` covers, one pixel larger on each side for filtering.
+     */
+    static Rect bounds(const SpriteInstance &instance);
+
+    /**
+     * Compares this frame's quads with the last call's and returns a box around every quad that appeared, went away,
+     * changed, or moved in the draw order, both where it was and where it is now.
+     * @param keys Identifies each quad (the sprite it belongs to), in the same order as `instances`.
+     * @param instances The quads back to front.
+     */
+    Rect update(const std::vector<const void *> &keys, const std::vector<SpriteInstance> &instances);
+
+    /**
+     * Makes the next `update` return the whole screen, for when the kept frame can't be trusted.
+     */
+    void invalidate() { valid = false; }
+
+  private:
+    struct Drawn {
+        size_t index;
+        SpriteInstance instance;
+    };
+
+    std::unordered_map<const void *, Drawn> previous;
+    bool valid = false;
+};
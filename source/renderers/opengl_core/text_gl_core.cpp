@@ -1,5 +1,7 @@
 #include "text_gl_core.hpp"
 #include "render.hpp"
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -16,8 +18,19 @@
 CMRC_DECLARE(romfs);
 #endif
 
-static GLuint textProgram = 0;
+// Uniform locations are looked up once when the program is linked.
+struct TextShader {
+    GLuint program = 0;
+    GLint projection = -1;
+    GLint color = -1;
+    GLint origin = -1;
+    GLint scale = -1;
+};
+
+static TextShader textShader;
 static GLuint textVAO = 0;
+static GLuint textVBO = 0;
+static std::vector<float> textVertices;
 
 static const char *kTextVert = R"glsl(
 #version 410 core
@@ -25,8 +38,10 @@ layout(location = 0) in vec2 a_pos;
 layout(location = 1) in vec2 a_uv;
 out vec2 v_uv;
 uniform mat4 u_projection;
+uniform vec2 u_origin;
+uniform float u_scale;
 void main() {
-    gl_Position = u_projection * vec4(a_pos, 0.0, 1.0);
+    gl_Position = u_projection * vec4(u_origin + a_pos * u_scale, 0.0, 1.0);
     v_uv = a_uv;
 }
 )glsl";
@@ -60,18 +75,33 @@ static GLuint compileTextShader(GLenum type, const char *src) {
 }
 
 static void ensureTextProgram() {
-    if (textProgram) return;
+    if (textShader.program) return;
 
     GLuint v = compileTextShader(GL_VERTEX_SHADER, kTextVert);
     GLuint f = compileTextShader(GL_FRAGMENT_SHADER, kTextFrag);
-    textProgram = glCreateProgram();
-    glAttachShader(textProgram, v);
-    glAttachShader(textProgram, f);
-    glLinkProgram(textProgram);
+    textShader.program = glCreateProgram();
+    glAttachShader(textShader.program, v);
+    glAttachShader(textShader.program, f);
+    glLinkProgram(textShader.program);
     glDeleteShader(v);
     glDeleteShader(f);
 
+    textShader.projection = glGetUniformLocation(textShader.program, "u_projection");
+    textShader.color = glGetUniformLocation(textShader.program, "u_color");
+    textShader.origin = glGetUniformLocation(textShader.program, "u_origin");
+    textShader.scale = glGetUniformLocation(textShader.program, "u_scale");
+    glUseProgram(textShader.program);
+    glUniform1i(glGetUniformLocation(textShader.program, "u_tex"), 0);
+
     glGenVertexArrays(1, &textVAO);
+    glGenBuffers(1, &textVBO);
+    glBindVertexArray(textVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
+    glBindVertexArray(0);
 }
 
 std::unordered_map<std::string, FontDataCore *> TextObjectGLCore::fonts;
@@ -87,6 +117,38 @@ static void buildOrthoText(float out[16], float l, float r, float b, float t) {
     out[15] = 1.0f;
 }
 
+// Reads the UTF-8 sequence at `i` and moves past it. Broken sequences read as U+FFFD.
+static uint32_t nextCodepoint(const std::string &text, size_t &i) {
+    const unsigned char first = text[i++];
+    if (first < 0x80) return first;
+
+    int length;
+    uint32_t codepoint;
+    if ((first & 0xE0) == 0xC0) {
+        length = 1;
+        codepoint = first & 0x1F;
+    } else if ((first & 0xF0) == 0xE0) {
+        length = 2;
+        codepoint = first & 0x0F;
+    } else if ((first & 0xF8) == 0xF0) {
+        length = 3;
+        codepoint = first & 0x07;
+    } else {
+        return 0xFFFD;
+    }
+
+    for (int n = 0; n < length; n++) {
+        if (i >= text.size() || (static_cast<unsigned char>(text[i]) & 0xC0) != 0x80) return 0xFFFD;
+        codepoint = (codepoint << 6) | (static_cast<unsigned char>(text[i++]) & 0x3F);
+    }
+    return codepoint;
+}
+
+static void destroyFont(FontDataCore *font) {
+    if (!font->pageTextures.empty()) glDeleteTextures((GLsizei)font->pageTextures.size(), font->pageTextures.data());
+    delete font;
+}
+
 static std::vector<std::string> splitLines(const std::string &text) {
     std::vector<std::string> lines;
     std::string cur;
@@ -115,10 +177,8 @@ TextObjectGLCore::~TextObjectGLCore() {
     if (!font) return;
     font->usageCount--;
     if (font->usageCount == 0) {
-        glDeleteTextures(1, &font->textureID);
-        free(font->charData);
         fonts.erase(font->fontName);
-        delete font;
+        destroyFont(font);
     }
     font = nullptr;
 }
@@ -155,59 +215,40 @@ bool TextObjectGLCore::loadFont(std::string fontPath) {
 
     font = new FontDataCore();
     font->fontName = fontPath;
-    font->atlasWidth = 512;
-    font->atlasHeight = 512;
     font->fontSize = 33.3f;
-    font->firstChar = 32;
-    font->numChars = 96;
     font->usageCount = 1;
-    font->charData = (stbtt_bakedchar *)malloc(sizeof(stbtt_bakedchar) * 96);
+    font->fontBuffer.assign(fontBuffer, fontBuffer + size);
+    free(fontBuffer);
 
-    auto *bitmap = (unsigned char *)malloc(font->atlasWidth * font->atlasHeight);
-    if (!bitmap) {
-        free(fontBuffer);
-        free(font->charData);
+    if (!stbtt_InitFont(&font->info, font->fontBuffer.data(), stbtt_GetFontOffsetForIndex(font->fontBuffer.data(), 0))) {
+        Log::logError("[GL Core Text] Failed to read font: " + fontPath);
         delete font;
         font = nullptr;
         return false;
     }
 
-    stbtt_BakeFontBitmap(fontBuffer, 0, font->fontSize,
-                         bitmap, font->atlasWidth, font->atlasHeight,
-                         font->firstChar, font->numChars, font->charData);
-
-    stbtt_fontinfo info;
-    if (stbtt_InitFont(&info, fontBuffer, 0)) {
-        int ascent, descent, lineGap;
-        stbtt_GetFontVMetrics(&info, &ascent, &descent, &lineGap);
-        float sc = stbtt_ScaleForPixelHeight(&info, font->fontSize);
-        font->ascent = (float)ascent * sc;
-        font->descent = (float)descent * sc;
-        font->lineGap = (float)lineGap * sc;
-    } else {
-        font->ascent = font->fontSize * 0.8f;
-        font->descent = -font->fontSize * 0.2f;
-        font->lineGap = 0.0f;
-    }
-    free(fontBuffer);
+    int ascent, descent, lineGap;
+    stbtt_GetFontVMetrics(&font->info, &ascent, &descent, &lineGap);
+    font->baseScale = stbtt_ScaleForPixelHeight(&font->info, font->fontSize);
+    font->ascent = (float)ascent * font->baseScale;
+    font->descent = (float)descent * font->baseScale;
+    font->lineGap = (float)lineGap * font->baseScale;
 
     ensureTextProgram();
-    glGenTextures(1, &font->textureID);
-    glBindTexture(GL_TEXTURE_2D, font->textureID);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED,
-                 font->atlasWidth, font->atlasHeight,
-                 0, GL_RED, GL_UNSIGNED_BYTE, bitmap);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    free(bitmap);
     fonts[fontPath] = font;
     return true;
 }
 
+float TextObjectGLCore::lineWidth(const std::string &line) const {
+    float width = 0.0f;
+    for (size_t i = 0; i < line.size();) {
+        int advance, leftBearing;
+        stbtt_GetCodepointHMetrics(&font->info, nextCodepoint(line, i), &advance, &leftBearing);
+        width += advance * font->baseScale;
+    }
+    return width;
+}
+
 void TextObjectGLCore::setDimensions() {
     if (!font) {
         width = height = minY = 0;
@@ -218,16 +259,8 @@ void TextObjectGLCore::setDimensions() {
     float lineHeight = font->ascent - font->descent + font->lineGap;
     float maxWidth = 0;
 
-    for (const auto &line : lines) {
-        float x = 0, y = 0;
-        for (unsigned char c : line) {
-            if (c < font->firstChar || c >= font->firstChar + font->numChars) c = 'x';
-            stbtt_aligned_quad q;
-            stbtt_GetBakedQuad(font->charData, font->atlasWidth, font->atlasHeight,
-                               c - font->firstChar, &x, &y, &q, 1);
-        }
-        if (x > maxWidth) maxWidth = x;
-    }
+    for (const auto &line : lines)
+        maxWidth = std::max(maxWidth, lineWidth(line));
 
     width = maxWidth;
     height = lineHeight * (float)lines.size();
@@ -239,6 +272,91 @@ void TextObjectGLCore::setText(std::string txt) {
     setDimensions();
 }
 
+// Lays out `text` at scale 1 with glyphs rasterised at `pixelSize`, putting any glyph not on the atlas yet on it.
+TextRun TextObjectGLCore::layoutRun(int pixelSize) {
+    TextRun run;
+    GlyphAtlas &atlas = font->atlas;
+    atlas.begin();
+
+    const float rasterScale = stbtt_ScaleForPixelHeight(&font->info, (float)pixelSize);
+    const float toLayout = font->baseScale / rasterScale;
+    const float pageSize = (float)atlas.getPageSize();
+    const int border = atlas.getBorder();
+    const float lineHeight = font->ascent - font->descent + font->lineGap;
+
+    auto lines = splitLines(text);
+    for (size_t li = 0; li < lines.size(); ++li) {
+        const std::string &line = lines[li];
+        const float baseline = (float)li * lineHeight + font->ascent;
+        float x = 0.0f;
+
+        for (size_t i = 0; i < line.size();) {
+            const uint32_t codepoint = nextCodepoint(line, i);
+            const int glyphIndex = stbtt_FindGlyphIndex(&font->info, codepoint);
+            int advance, leftBearing;
+            stbtt_GetGlyphHMetrics(&font->info, glyphIndex, &advance, &leftBearing);
+
+            int x0, y0, x1, y1;
+            stbtt_GetGlyphBitmapBox(&font->info, glyphIndex, rasterScale, rasterScale, &x0, &y0, &x1, &y1);
+
+            if (x1 > x0 && y1 > y0) {
+                const GlyphAtlas::Glyph *found = atlas.find(codepoint, pixelSize);
+                std::optional<GlyphAtlas::Glyph> glyph;
+                if (found) {
+                    glyph = *found;
+                } else if ((glyph = atlas.insert(codepoint, pixelSize, x1 - x0, y1 - y0))) {
+                    while (font->pageTextures.size() <= (size_t)glyph->page) {
+                        const std::vector<unsigned char> empty(atlas.getPageSize() * atlas.getPageSize(), 0);
+                        GLuint texture = 0;
+                        glGenTextures(1, &texture);
+                        glBindTexture(GL_TEXTURE_2D, texture);
+                        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas.getPageSize(), atlas.getPageSize(), 0, GL_RED, GL_UNSIGNED_BYTE, empty.data());
+                        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                        font->pageTextures.push_back(texture);
+                    }
+
+                    // the border goes up too, since the spot may still hold pixels of an evicted glyph
+                    const int paddedWidth = glyph->rect.w + border * 2;
+                    const int paddedHeight = glyph->rect.h + border * 2;
+                    std::vector<unsigned char> pixels(paddedWidth * paddedHeight, 0);
+                    stbtt_MakeGlyphBitmap(&font->info, pixels.data() + border * paddedWidth + border,
+                                          glyph->rect.w, glyph->rect.h, paddedWidth, rasterScale, rasterScale, glyphIndex);
+                    glBindTexture(GL_TEXTURE_2D, font->pageTextures[glyph->page]);
+                    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                    glTexSubImage2D(GL_TEXTURE_2D, 0, glyph->rect.x - border, glyph->rect.y - border, paddedWidth, paddedHeight,
+                                    GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+                }
+
+                if (glyph) {
+                    run.quads.push_back({x + x0 * toLayout, baseline + y0 * toLayout,
+                                         x + x1 * toLayout, baseline + y1 * toLayout,
+                                         glyph->rect.x / pageSize, glyph->rect.y / pageSize,
+                                         (glyph->rect.x + glyph->rect.w) / pageSize, (glyph->rect.y + glyph->rect.h) / pageSize,
+                                         glyph->page});
+                } else {
+                    run.complete = false;
+                }
+            }
+
+            x += advance * font->baseScale;
+        }
+    }
+
+    // group the quads by page so each page is one draw
+    std::stable_sort(run.quads.begin(), run.quads.end(), [](const TextQuad &a, const TextQuad &b) {
+        return a.page < b.page;
+    });
+    for (const TextQuad &quad : run.quads) {
+        if (run.pages.empty() || run.pages.back() != quad.page) run.pages.push_back(quad.page);
+    }
+    run.atlasEvictions = atlas.getEvictions();
+    return run;
+}
+
 void TextObjectGLCore::render(int xPos, int yPos) {
     if (!font) return;
 
@@ -261,73 +379,55 @@ void TextObjectGLCore::render(int xPos, int yPos) {
         drawY -= (height * scale) / 2.0f;
     }
 
-    auto lines = splitLines(text);
-    float lineHeight = font->ascent - font->descent + font->lineGap;
+    // rasterise at the size the text ends up on screen, so it stays sharp at any scale
+    const int pixelSize = std::clamp((int)std::lround(font->fontSize * scale), 4, 200);
+    const TextRun *run = font->runs.find(text, pixelSize, font->atlas.getEvictions());
+    TextRun uncached;
+    if (run) {
+        for (int page : run->pages)
+            font->atlas.touch(page);
+    } else {
+        uncached = layoutRun(pixelSize);
+        // a run missing a glyph is laid out again next time, once the atlas may have room for it
+        run = uncached.complete ? &font->runs.insert(text, pixelSize, std::move(uncached)) : &uncached;
+    }
+    if (run->quads.empty()) return;
+
+    textVertices.clear();
+    for (const TextQuad &q : run->quads) {
+        textVertices.insert(textVertices.end(), {q.x0, q.y0, q.s0, q.t0,
+                                                 q.x1, q.y0, q.s1, q.t0,
+                                                 q.x1, q.y1, q.s1, q.t1,
+                                                 q.x1, q.y1, q.s1, q.t1,
+                                                 q.x0, q.y1, q.s0, q.t1,
+                                                 q.x0, q.y0, q.s0, q.t0});
+    }
 
-    glUseProgram(textProgram);
-    glUniformMatrix4fv(glGetUniformLocation(textProgram, "u_projection"), 1, GL_FALSE, proj);
-    glUniform1i(glGetUniformLocation(textProgram, "u_tex"), 0);
-    glUniform4f(glGetUniformLocation(textProgram, "u_color"), cr, cg, cb, ca);
+    glUseProgram(textShader.program);
+    glUniformMatrix4fv(textShader.projection, 1, GL_FALSE, proj);
+    glUniform4f(textShader.color, cr, cg, cb, ca);
+    glUniform2f(textShader.origin, drawX, drawY);
+    glUniform1f(textShader.scale, scale);
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, font->textureID);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    for (size_t li = 0; li < lines.size(); ++li) {
-        float x = 0.0f, y = 0.0f;
-        float lineX = drawX;
-        float lineY = drawY + ((float)li * lineHeight + font->ascent) * scale;
-
-        std::vector<float> verts;
-        verts.reserve(lines[li].size() * 4 * 4);
-        std::vector<GLuint> indices;
-        indices.reserve(lines[li].size() * 6);
-        GLuint vi = 0;
-
-        for (unsigned char c : lines[li]) {
-            if (c < font->firstChar || c >= font->firstChar + font->numChars) c = 'x';
-
-            stbtt_aligned_quad q;
-            stbtt_GetBakedQuad(font->charData, font->atlasWidth, font->atlasHeight,
-                               c - font->firstChar, &x, &y, &q, 1);
-
-            float qx0 = lineX + q.x0 * scale;
-            float qy0 = lineY + q.y0 * scale;
-            float qx1 = lineX + q.x1 * scale;
-            float qy1 = lineY + q.y1 * scale;
-
-            verts.insert(verts.end(), {qx0, qy0, q.s0, q.t0,
-                                       qx1, qy0, q.s1, q.t0,
-                                       qx1, qy1, q.s1, q.t1,
-                                       qx0, qy1, q.s0, q.t1});
-            indices.insert(indices.end(), {vi, vi + 1, vi + 2, vi + 2, vi + 3, vi});
-            vi += 4;
-        }
-
-        if (verts.empty()) continue;
-
-        GLuint vao = 0, vbo = 0, ebo = 0;
-        glGenVertexArrays(1, &vao);
-        glGenBuffers(1, &vbo);
-        glGenBuffers(1, &ebo);
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_STREAM_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STREAM_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
-
-        glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, nullptr);
-
-        glBindVertexArray(0);
-        glDeleteVertexArrays(1, &vao);
-        glDeleteBuffers(1, &vbo);
-        glDeleteBuffers(1, &ebo);
+    glBindVertexArray(textVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
+    glBufferData(GL_ARRAY_BUFFER, textVertices.size() * sizeof(float), textVertices.data(), GL_STREAM_DRAW);
+
+    size_t first = 0;
+    while (first < run->quads.size()) {
+        const int page = run->quads[first].page;
+        size_t last = first;
+        while (last < run->quads.size() && run->quads[last].page == page)
+            last++;
+        glBindTexture(GL_TEXTURE_2D, font->pageTextures[page]);
+        glDrawArrays(GL_TRIANGLES, (GLint)(first * 6), (GLsizei)((last - first) * 6));
+        first = last;
     }
+    glBindVertexArray(0);
 }
 
 std::vector<float> TextObjectGLCore::getSize() {
@@ -343,19 +443,18 @@ std::vector<float> TextObjectGLCore::getStringSize(const std::string &txt) {
 }
 
 void TextObjectGLCore::cleanupText() {
-    for (auto &[id, data] : fonts) {
-        glDeleteTextures(1, &data->textureID);
-        free(data->charData);
-        delete data;
-    }
+    for (auto &[id, data] : fonts)
+        destroyFont(data);
     fonts.clear();
 
-    if (textProgram) {
-        glDeleteProgram(textProgram);
-        textProgram = 0;
+    if (textShader.program) {
+        glDeleteProgram(textShader.program);
+        textShader = TextShader();
     }
     if (textVAO) {
         glDeleteVertexArrays(1, &textVAO);
-        textVAO = 0;
+        glDeleteBuffers(1, &textVBO);
+        textVAO = textVBO = 0;
     }
+    textVertices.clear();
 }
@@ -1,23 +1,29 @@
 #pragma once
+#include <glyphAtlas.hpp>
 #include <stb_truetype.h>
 #include <string>
 #include <text.hpp>
+#include <textRunCache.hpp>
 #include <unordered_map>
 #include <vector>
 
 struct FontDataCore {
     std::string fontName;
     size_t usageCount = 0;
-    unsigned int textureID = 0;
-    int atlasWidth = 0;
-    int atlasHeight = 0;
     float fontSize = 0.0f;
-    int firstChar = 0;
-    int numChars = 0;
     float ascent = 0.0f;
     float descent = 0.0f;
     float lineGap = 0.0f;
-    stbtt_bakedchar *charData = nullptr;
+
+    // `info` points into `fontBuffer`, which is kept so glyphs can be rasterised whenever they are first drawn
+    std::vector<unsigned char> fontBuffer;
+    stbtt_fontinfo info;
+    float baseScale = 0.0f; // font units to pixels at `fontSize`
+
+    // glyphs are rasterised at the size they end up on screen, one texture per atlas page
+    GlyphAtlas atlas{512, 4};
+    std::vector<unsigned int> pageTextures;
+    TextRunCache runs{256};
 };
 
 class TextObjectGLCore : public TextObject {
@@ -29,10 +35,16 @@ class TextObjectGLCore : public TextObject {
 
     void setDimensions();
     bool loadFont(std::string fontPath);
+    TextRun layoutRun(int pixelSize);
 
   protected:
     FontDataCore *font = nullptr;
 
+    /**
+     * How wide `line` is at scale 1, in pixels.
+     */
+    float lineWidth(const std::string &line) const;
+
   public:
     TextObjectGLCore(std::string txt, double posX, double posY, std::string fontPath = "");
     ~TextObjectGLCore() override;
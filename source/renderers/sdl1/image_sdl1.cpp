@@ -89,7 +89,7 @@ void Image_SDL1::render(ImageRenderParams &params) {
     SDL_BlitSurface(finalSurface, NULL, reinterpret_cast<SDL_Surface *>(Render::getRenderer()), &dest);
     SDL_FreeSurface(finalSurface);
 
-    freeTimer = maxFreeTimer;
+    markUsed();
 }
 
 // FIXME: SDL_BlitSurface doesn't have support for scaling. Omit 9-slice rendering for now.
@@ -143,7 +143,7 @@ void Image_SDL1::renderNineslice(double xPos, double yPos, double width, double
     SDL_Rect dstBottom = {static_cast<Sint16>(iDestX + iSrcPadding), static_cast<Sint16>(iDestY + iSrcPadding + dstCenterHeight), dstCenterWidth, iSrcPadding};
     SDL_Rect dstBottomRight = {static_cast<Sint16>(iDestX + iSrcPadding + dstCenterWidth), static_cast<Sint16>(iDestY + iSrcPadding + dstCenterHeight), iSrcPadding, iSrcPadding};
 
-    image->freeTimer = image->maxFreeTime;
+    image->markUsed();
 
     SDL_Surface *renderer = static_cast<SDL_Surface *>(Render::getRenderer());
 
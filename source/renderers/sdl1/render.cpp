@@ -309,11 +309,11 @@ void Render::renderSprites() {
 
     for (auto it = Scratch::sprites.rbegin(); it != Scratch::sprites.rend(); ++it) {
         Sprite *currentSprite = *it;
-        auto imgFind = Scratch::costumeImages.find(currentSprite->costumes[currentSprite->currentCostume].fullName);
+        auto imgFind = Scratch::costumeImages.find(currentSprite->costumes[Scratch::getRenderedCostume(currentSprite)].fullName);
         if (imgFind != Scratch::costumeImages.end()) {
             Image *image = imgFind->second.get();
 
-            const bool isSVG = currentSprite->costumes[currentSprite->currentCostume].isSVG;
+            const bool isSVG = currentSprite->costumes[Scratch::getRenderedCostume(currentSprite)].isSVG;
             calculateRenderPosition(currentSprite, isSVG);
             if (!currentSprite->visible) continue;
 
@@ -74,7 +74,7 @@ void Image_SDL2::render(ImageRenderParams &params) {
         SDL_SetTextureColorMod(texture, 255, 255, 255);
         SDL_RenderCopyEx(renderer, texture, &subRect, &renderRect, rotation, &center, flip);
     }
-    freeTimer = maxFreeTimer;
+    markUsed();
 }
 
 // I doubt you want to mess with this...
@@ -128,7 +128,7 @@ void Image_SDL2::renderNineslice(double xPos, double yPos, double width, double
     SDL_RenderCopy(renderer, originalTexture, &srcBottomRight, &dstBottomRight);
 
     SDL_SetTextureScaleMode(originalTexture, originalScaleMode);
-    freeTimer = maxFreeTimer;
+    markUsed();
 }
 
 void *Image_SDL2::getNativeTexture() {
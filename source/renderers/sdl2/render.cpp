@@ -9,6 +9,7 @@
 #include <image.hpp>
 #include <input.hpp>
 #include <log.hpp>
+#include <penBuffer.hpp>
 #include <render.hpp>
 #include <runtime.hpp>
 #include <string>
@@ -59,7 +60,8 @@ SDL_Texture *penTexture = nullptr;
 
 SpeechManagerSDL2 *speechManager = nullptr;
 
-static std::vector<SDL_Vertex> penVerts;
+// Pen lines and dots wait here until the pen layer is next drawn, then go to the pen texture in one draw.
+static PenBuffer penBuffer;
 
 bool Render::Init() {
 #ifdef __WIIU__
@@ -204,93 +206,33 @@ bool Render::initPen() {
     return true;
 }
 
-void Render::penMoveFast(double x1, double y1, double x2, double y2, Sprite *sprite) {
-    const ColorRGBA rgbColor = CSBT2RGBA(sprite->penData.color);
-    const uint8_t alpha = (100.0 - sprite->penData.color.transparency) / 100.0 * 255.0;
-
-    int penWidth = 640;
-    int penHeight = 480;
-    SDL_QueryTexture(penTexture, nullptr, nullptr, &penWidth, &penHeight);
-
-    const double scale = (penHeight / static_cast<double>(Scratch::projectHeight));
-
-    const float sx1 = static_cast<float>(x1 * scale + penWidth / 2.0);
-    const float sy1 = static_cast<float>(-y1 * scale + penHeight / 2.0);
-    const float sx2 = static_cast<float>(x2 * scale + penWidth / 2.0);
-    const float sy2 = static_cast<float>(-y2 * scale + penHeight / 2.0);
-
-    const double dx = sx2 - sx1;
-    const double dy = sy2 - sy1;
-
-    const double length = sqrt(dx * dx + dy * dy);
-    const double drawWidth = (sprite->penData.size / 2.0f) * scale;
-
-    if (length <= 0) return;
-
-    const float nx = static_cast<float>((-dy / length) * drawWidth);
-    const float ny = static_cast<float>((dx / length) * drawWidth);
-
-    const SDL_Color sdlColor = {
-        static_cast<Uint8>(rgbColor.r),
-        static_cast<Uint8>(rgbColor.g),
-        static_cast<Uint8>(rgbColor.b),
-        static_cast<Uint8>(alpha)};
-
-    const SDL_Vertex v0 = {{sx1 + nx, sy1 + ny}, sdlColor, {0.0f, 0.0f}}; // top left
-    const SDL_Vertex v1 = {{sx1 - nx, sy1 - ny}, sdlColor, {0.0f, 0.0f}}; // bottom left
-    const SDL_Vertex v2 = {{sx2 + nx, sy2 + ny}, sdlColor, {0.0f, 0.0f}}; // top right
-    const SDL_Vertex v3 = {{sx2 - nx, sy2 - ny}, sdlColor, {0.0f, 0.0f}}; // bottom right
+static void flushPen() {
+    if (penBuffer.empty()) return;
+    if (penTexture == nullptr) {
+        penBuffer.clear();
+        return;
+    }
 
-    // squarey
-    penVerts.push_back(v0);
-    penVerts.push_back(v1);
-    penVerts.push_back(v2);
+    const std::vector<PenVertex> &vertices = penBuffer.tessellate();
+    SDL_SetRenderTarget(renderer, penTexture);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_RenderGeometryRaw(renderer, nullptr,
+                          &vertices[0].x, sizeof(PenVertex),
+                          reinterpret_cast<const SDL_Color *>(&vertices[0].r), sizeof(PenVertex),
+                          nullptr, 0, static_cast<int>(vertices.size()), nullptr, 0, 0);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderTarget(renderer, nullptr);
 
-    penVerts.push_back(v1);
-    penVerts.push_back(v3);
-    penVerts.push_back(v2);
+    penBuffer.clear();
 }
 
-void Render::penDotFast(Sprite *sprite) {
+static PenBuffer::Color penColor(const Sprite *sprite) {
     const ColorRGBA rgbColor = CSBT2RGBA(sprite->penData.color);
     const uint8_t alpha = (100.0 - sprite->penData.color.transparency) / 100.0 * 255.0;
-
-    int penWidth = 640;
-    int penHeight = 480;
-    SDL_QueryTexture(penTexture, nullptr, nullptr, &penWidth, &penHeight);
-
-    const double scale = (penHeight / static_cast<double>(Scratch::projectHeight));
-
-    const float sx = static_cast<float>(sprite->xPosition * scale + penWidth / 2.0);
-    const float sy = static_cast<float>(-sprite->yPosition * scale + penHeight / 2.0);
-
-    const float halfSize = static_cast<float>((sprite->penData.size / 2.0f) * scale);
-
-    const SDL_Color sdlColor = {
-        static_cast<Uint8>(rgbColor.r),
-        static_cast<Uint8>(rgbColor.g),
-        static_cast<Uint8>(rgbColor.b),
-        alpha};
-
-    const SDL_Vertex v0 = {{sx - halfSize, sy - halfSize}, sdlColor, {0.0f, 0.0f}}; // top left
-    const SDL_Vertex v1 = {{sx - halfSize, sy + halfSize}, sdlColor, {0.0f, 0.0f}}; // bottom left
-    const SDL_Vertex v2 = {{sx + halfSize, sy - halfSize}, sdlColor, {0.0f, 0.0f}}; // top right
-    const SDL_Vertex v3 = {{sx + halfSize, sy + halfSize}, sdlColor, {0.0f, 0.0f}}; // bottom right
-
-    // squarey
-    penVerts.push_back(v0);
-    penVerts.push_back(v1);
-    penVerts.push_back(v2);
-
-    penVerts.push_back(v1);
-    penVerts.push_back(v3);
-    penVerts.push_back(v2);
+    return {static_cast<uint8_t>(rgbColor.r), static_cast<uint8_t>(rgbColor.g), static_cast<uint8_t>(rgbColor.b), alpha};
 }
 
-void Render::penMoveAccurate(double x1, double y1, double x2, double y2, Sprite *sprite) {
-    const ColorRGBA rgbColor = CSBT2RGBA(sprite->penData.color);
-    const uint8_t alpha = (100.0 - sprite->penData.color.transparency) / 100.0 * 255.0;
-
+static void queuePenLine(double x1, double y1, double x2, double y2, Sprite *sprite, bool rounded) {
     int penWidth = 640;
     int penHeight = 480;
     SDL_QueryTexture(penTexture, nullptr, nullptr, &penWidth, &penHeight);
@@ -301,76 +243,13 @@ void Render::penMoveAccurate(double x1, double y1, double x2, double y2, Sprite
     const float sy1 = static_cast<float>(-y1 * scale + penHeight / 2.0);
     const float sx2 = static_cast<float>(x2 * scale + penWidth / 2.0);
     const float sy2 = static_cast<float>(-y2 * scale + penHeight / 2.0);
+    const float radius = static_cast<float>((sprite->penData.size / 2.0f) * scale);
 
-    const double dx = sx2 - sx1;
-    const double dy = sy2 - sy1;
-
-    const double length = sqrt(dx * dx + dy * dy);
-    const double drawWidth = (sprite->penData.size / 2.0f) * scale;
-
-    const SDL_Color sdlColor = {
-        static_cast<uint8_t>(rgbColor.r),
-        static_cast<uint8_t>(rgbColor.g),
-        static_cast<uint8_t>(rgbColor.b),
-        static_cast<uint8_t>(alpha)};
-
-    if (length > 0) {
-        const float nx = static_cast<float>((-dy / length) * drawWidth);
-        const float ny = static_cast<float>((dx / length) * drawWidth);
-
-        const SDL_Vertex v0 = {{sx1 + nx, sy1 + ny}, sdlColor, {0.0f, 0.0f}};
-        const SDL_Vertex v1 = {{sx1 - nx, sy1 - ny}, sdlColor, {0.0f, 0.0f}};
-        const SDL_Vertex v2 = {{sx2 + nx, sy2 + ny}, sdlColor, {0.0f, 0.0f}};
-        const SDL_Vertex v3 = {{sx2 - nx, sy2 - ny}, sdlColor, {0.0f, 0.0f}};
-
-        penVerts.push_back(v0);
-        penVerts.push_back(v1);
-        penVerts.push_back(v2);
-
-        penVerts.push_back(v1);
-        penVerts.push_back(v3);
-        penVerts.push_back(v2);
-    }
-
-    const unsigned int circleSegments = std::max(8.0, 8.0f * (sprite->penData.size / 150.0f));
-    const double angleStep = 2.0 * M_PI / circleSegments;
-
-    for (int i = 0; i < circleSegments; ++i) {
-        const double angle1 = i * angleStep;
-        const double angle2 = (i + 1) * angleStep;
-
-        float x1_c = sx1 + static_cast<float>(cos(angle1) * drawWidth);
-        float y1_c = sy1 + static_cast<float>(sin(angle1) * drawWidth);
-        float x2_c = sx1 + static_cast<float>(cos(angle2) * drawWidth);
-        float y2_c = sy1 + static_cast<float>(sin(angle2) * drawWidth);
-
-        const SDL_Vertex cv0 = {{sx1, sy1}, sdlColor, {0.0f, 0.0f}};
-        const SDL_Vertex cv1 = {{x1_c, y1_c}, sdlColor, {0.0f, 0.0f}};
-        const SDL_Vertex cv2 = {{x2_c, y2_c}, sdlColor, {0.0f, 0.0f}};
-
-        penVerts.push_back(cv0);
-        penVerts.push_back(cv1);
-        penVerts.push_back(cv2);
-
-        x1_c = sx2 + static_cast<float>(cos(angle1) * drawWidth);
-        y1_c = sy2 + static_cast<float>(sin(angle1) * drawWidth);
-        x2_c = sx2 + static_cast<float>(cos(angle2) * drawWidth);
-        y2_c = sy2 + static_cast<float>(sin(angle2) * drawWidth);
-
-        const SDL_Vertex cv3 = {{sx2, sy2}, sdlColor, {0.0f, 0.0f}};
-        const SDL_Vertex cv4 = {{x1_c, y1_c}, sdlColor, {0.0f, 0.0f}};
-        const SDL_Vertex cv5 = {{x2_c, y2_c}, sdlColor, {0.0f, 0.0f}};
-
-        penVerts.push_back(cv3);
-        penVerts.push_back(cv4);
-        penVerts.push_back(cv5);
-    }
+    penBuffer.line(sx1, sy1, sx2, sy2, radius, penColor(sprite), rounded);
+    if (penBuffer.size() >= PenBuffer::flushThreshold) flushPen();
 }
 
-void Render::penDotAccurate(Sprite *sprite) {
-    const ColorRGBA rgbColor = CSBT2RGBA(sprite->penData.color);
-    const uint8_t alpha = static_cast<Uint8>((100.0 - sprite->penData.color.transparency) / 100.0 * 255.0);
-
+static void queuePenDot(Sprite *sprite, bool rounded) {
     int penWidth = 640;
     int penHeight = 480;
     SDL_QueryTexture(penTexture, nullptr, nullptr, &penWidth, &penHeight);
@@ -379,35 +258,28 @@ void Render::penDotAccurate(Sprite *sprite) {
 
     const float sx = static_cast<float>(sprite->xPosition * scale + penWidth / 2.0);
     const float sy = static_cast<float>(-sprite->yPosition * scale + penHeight / 2.0);
-
     const float radius = static_cast<float>((sprite->penData.size / 2.0f) * scale);
 
-    const SDL_Color sdlColor = {
-        static_cast<uint8_t>(rgbColor.r),
-        static_cast<uint8_t>(rgbColor.g),
-        static_cast<uint8_t>(rgbColor.b),
-        static_cast<uint8_t>(alpha)};
-
-    const unsigned int circleSegments = std::max(16.0, 16.0f * (sprite->penData.size / 150.0f));
-    const double angleStep = 2.0 * M_PI / circleSegments;
+    penBuffer.dot(sx, sy, radius, penColor(sprite), rounded);
+    if (penBuffer.size() >= PenBuffer::flushThreshold) flushPen();
+}
 
-    for (int i = 0; i < circleSegments; ++i) {
-        const double angle1 = i * angleStep;
-        const double angle2 = (i + 1) * angleStep;
+void Render::penMoveFast(double x1, double y1, double x2, double y2, Sprite *sprite) {
+    // a zero length line without caps covers nothing
+    if (x1 == x2 && y1 == y2) return;
+    queuePenLine(x1, y1, x2, y2, sprite, false);
+}
 
-        const float x1 = sx + static_cast<float>(cos(angle1) * radius);
-        const float y1 = sy + static_cast<float>(sin(angle1) * radius);
-        const float x2 = sx + static_cast<float>(cos(angle2) * radius);
-        const float y2 = sy + static_cast<float>(sin(angle2) * radius);
+void Render::penDotFast(Sprite *sprite) {
+    queuePenDot(sprite, false);
+}
 
-        const SDL_Vertex v0 = {{sx, sy}, sdlColor, {0.0f, 0.0f}};
-        const SDL_Vertex v1 = {{x1, y1}, sdlColor, {0.0f, 0.0f}};
-        const SDL_Vertex v2 = {{x2, y2}, sdlColor, {0.0f, 0.0f}};
+void Render::penMoveAccurate(double x1, double y1, double x2, double y2, Sprite *sprite) {
+    queuePenLine(x1, y1, x2, y2, sprite, true);
+}
 
-        penVerts.push_back(v0);
-        penVerts.push_back(v1);
-        penVerts.push_back(v2);
-    }
+void Render::penDotAccurate(Sprite *sprite) {
+    queuePenDot(sprite, true);
 }
 
 void Render::penStamp(Sprite *sprite) {
@@ -419,15 +291,10 @@ void Render::penStamp(Sprite *sprite) {
 
     const Costume &costume = sprite->costumes[sprite->currentCostume];
 
-    SDL_SetRenderTarget(renderer, penTexture);
-
     // clear line draw queue so stamp can be rendered on top
-    if (!penVerts.empty()) {
-        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-        SDL_RenderGeometry(renderer, nullptr, penVerts.data(), penVerts.size(), nullptr, 0);
-        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
-        penVerts.clear();
-    }
+    flushPen();
+
+    SDL_SetRenderTarget(renderer, penTexture);
 
     Image *image = imgFind->second.get();
 
@@ -474,7 +341,7 @@ void Render::penClear() {
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
     SDL_RenderClear(renderer);
     SDL_SetRenderTarget(renderer, nullptr);
-    if (!penVerts.empty()) penVerts.clear();
+    penBuffer.clear();
 }
 
 void Render::beginFrame(int screen, int colorR, int colorG, int colorB) {
@@ -534,11 +401,11 @@ void Render::renderSprites() {
 
     for (auto it = Scratch::sprites.rbegin(); it != Scratch::sprites.rend(); ++it) {
         Sprite *currentSprite = *it;
-        auto imgFind = Scratch::costumeImages.find(currentSprite->costumes[currentSprite->currentCostume].fullName);
+        auto imgFind = Scratch::costumeImages.find(currentSprite->costumes[Scratch::getRenderedCostume(currentSprite)].fullName);
         if (imgFind != Scratch::costumeImages.end()) {
             Image *image = imgFind->second.get();
 
-            const bool isSVG = currentSprite->costumes[currentSprite->currentCostume].isSVG;
+            const bool isSVG = currentSprite->costumes[Scratch::getRenderedCostume(currentSprite)].isSVG;
             calculateRenderPosition(currentSprite, isSVG);
             if (!currentSprite->visible) continue;
 
@@ -598,16 +465,7 @@ void Render::renderSprites() {
 }
 
 void Render::renderPenLayer() {
-    if (!penVerts.empty()) {
-        SDL_SetRenderTarget(renderer, penTexture);
-        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-
-        SDL_RenderGeometry(renderer, nullptr, penVerts.data(), penVerts.size(), nullptr, 0);
-        penVerts.clear();
-
-        SDL_SetRenderTarget(renderer, nullptr);
-        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
-    }
+    flushPen();
 
     SDL_Rect renderRect = {0, 0, 0, 0};
 
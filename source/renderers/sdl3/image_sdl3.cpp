@@ -80,7 +80,7 @@ void Image_SDL3::render(ImageRenderParams &params) {
         SDL_SetTextureColorMod(texture, 255, 255, 255);
         SDL_RenderTextureRotated(renderer, texture, &subRect, &renderRect, rotation, &center, flip);
     }
-    freeTimer = maxFreeTimer;
+    markUsed();
 }
 
 // I doubt you want to mess with this...
@@ -131,7 +131,7 @@ void Image_SDL3::renderNineslice(double xPos, double yPos, double width, double
     SDL_RenderTexture(renderer, texture, &srcBottomRight, &dstBottomRight);
 
     SDL_SetTextureScaleMode(texture, originalScaleMode);
-    freeTimer = maxFreeTimer;
+    markUsed();
 }
 
 void *Image_SDL3::getNativeTexture() {
@@ -0,0 +1,508 @@
+#include "replay.hpp"
+#ifdef __PC__
+
+#include <blockExecutor.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <golden.hpp>
+#include <input.hpp>
+#include <iterator>
+#include <log.hpp>
+#include <runtime.hpp>
+#include <stdexcept>
+#include <timer.hpp>
+#include <unzip.hpp>
+#include <vector>
+
+namespace Replay {
+
+bool recording = false;
+bool replaying = false;
+
+// File layout (little endian, varints are LEB128):
+//   "SERP" u8 version u32 seed  string projectPath
+//   then records, each starting with a tag byte:
+//     TAG_FRAME: varint deltaUs  u8 flags  [changed fields, see FrameFlags]
+//     TAG_END:   u64 final state hash
+static constexpr char MAGIC[4] = {'S', 'E', 'R', 'P'};
+static constexpr uint8_t VERSION = 1;
+static constexpr uint8_t TAG_FRAME = 1;
+static constexpr uint8_t TAG_END = 2;
+
+enum FrameFlags : uint8_t {
+    MOUSE_PRESSED = 1 << 0,
+    MOUSE_MOVING = 1 << 1,
+    MOUSE_POSITION = 1 << 2,
+    MOUSE_BUTTON = 1 << 3,
+    KEYS = 1 << 4,
+    BUTTONS = 1 << 5,
+    JOYSTICKS = 1 << 6,
+    ANSWERS = 1 << 7
+};
+
+struct Frame {
+    uint64_t deltaUs = 0;
+    int mouseX = 0;
+    int mouseY = 0;
+    bool mousePressed = false;
+    bool mouseMoving = false;
+    uint8_t mouseButton = 0;
+    std::vector<std::string> keys;
+    std::vector<std::string> buttons;
+    float joysticks[4] = {0, 0, 0, 0};
+    std::vector<std::string> answers;
+};
+
+static unsigned int seed = 0;
+static std::string projectPath;
+
+// recording
+static std::ofstream output;
+static std::vector<uint8_t> buffer;
+static Frame previousFrame;
+static Frame pendingFrame;
+static bool hasPendingFrame = false;
+static uint64_t pendingDeltaUs = 0;
+static std::chrono::steady_clock::time_point lastSync;
+
+// replaying
+static std::vector<Frame> frames;
+static size_t currentFrame = 0;
+static size_t currentAnswer = 0;
+static bool hasExpectedHash = false;
+static uint64_t expectedHash = 0;
+static bool hasFinalHash = false;
+static uint64_t finalHash = 0;
+
+static void writeVarint(uint64_t value) {
+    while (value >= 0x80) {
+        buffer.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<uint8_t>(value));
+}
+
+static void writeSigned(int64_t value) {
+    writeVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+static void writeRaw(const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+static void writeU32(uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        buffer.push_back(static_cast<uint8_t>(value >> (i * 8)));
+}
+
+static void writeU64(uint64_t value) {
+    for (int i = 0; i < 8; i++)
+        buffer.push_back(static_cast<uint8_t>(value >> (i * 8)));
+}
+
+static void writeFloat(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    writeU32(bits);
+}
+
+static void writeString(const std::string &str) {
+    writeVarint(str.size());
+    writeRaw(str.data(), str.size());
+}
+
+static void writeStrings(const std::vector<std::string> &strings) {
+    writeVarint(strings.size());
+    for (const std::string &str : strings) {
+        writeString(str);
+    }
+}
+
+static void flush() {
+    output.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    buffer.clear();
+}
+
+class Reader {
+  public:
+    Reader(const std::vector<uint8_t> &data) : data(data) {}
+
+    bool eof() const { return pos >= data.size(); }
+
+    uint8_t byte() {
+        if (pos >= data.size()) throw std::runtime_error("Unexpected end of recording");
+        return data[pos++];
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const uint8_t b = byte();
+            value |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return value;
+        }
+        throw std::runtime_error("Malformed varint in recording");
+    }
+
+    int64_t signedVarint() {
+        const uint64_t value = varint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    void raw(void *out, size_t size) {
+        if (data.size() - pos < size) throw std::runtime_error("Unexpected end of recording");
+        memcpy(out, data.data() + pos, size);
+        pos += size;
+    }
+
+    uint32_t u32() {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++)
+            value |= static_cast<uint32_t>(byte()) << (i * 8);
+        return value;
+    }
+
+    uint64_t u64() {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++)
+            value |= static_cast<uint64_t>(byte()) << (i * 8);
+        return value;
+    }
+
+    float f32() {
+        const uint32_t bits = u32();
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::string string() {
+        const uint64_t size = varint();
+        if (data.size() - pos < size) throw std::runtime_error("Unexpected end of recording");
+        std::string str(reinterpret_cast<const char *>(data.data() + pos), size);
+        pos += size;
+        return str;
+    }
+
+    std::vector<std::string> strings() {
+        std::vector<std::string> out(varint());
+        for (std::string &str : out) {
+            str = string();
+        }
+        return out;
+    }
+
+  private:
+    const std::vector<uint8_t> &data;
+    size_t pos = 0;
+};
+
+uint64_t stateHash() {
+    // FNV-1a over the same canonical snapshot the golden runner compares
+    const std::string state = Golden::snapshot().dump();
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : state) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+nonstd::expected<void, std::string> startRecording(const std::string &path) {
+    output.open(path, std::ios::binary | std::ios::trunc);
+    if (!output) return nonstd::make_unexpected("Failed to open " + path + " for writing.");
+
+    seed = static_cast<unsigned int>(time(nullptr));
+    srand(seed);
+
+    writeRaw(MAGIC, sizeof(MAGIC));
+    buffer.push_back(VERSION);
+    writeU32(seed);
+    writeString(Unzip::filePath);
+    flush();
+
+    previousFrame = Frame();
+    hasPendingFrame = false;
+    pendingDeltaUs = 0;
+    lastSync = std::chrono::steady_clock::now();
+    Timer::setFixedClock(true);
+    Scratch::streamCostumes = false;
+    recording = true;
+
+    Log::log("Recording input to " + path);
+    return {};
+}
+
+static void writePendingFrame() {
+    if (!hasPendingFrame) return;
+    hasPendingFrame = false;
+
+    const Frame &frame = pendingFrame;
+    uint8_t flags = 0;
+    if (frame.mousePressed) flags |= MOUSE_PRESSED;
+    if (frame.mouseMoving) flags |= MOUSE_MOVING;
+    if (frame.mouseX != previousFrame.mouseX || frame.mouseY != previousFrame.mouseY) flags |= MOUSE_POSITION;
+    if (frame.mouseButton != previousFrame.mouseButton) flags |= MOUSE_BUTTON;
+    if (frame.keys != previousFrame.keys) flags |= KEYS;
+    if (frame.buttons != previousFrame.buttons) flags |= BUTTONS;
+    if (memcmp(frame.joysticks, previousFrame.joysticks, sizeof(frame.joysticks)) != 0) flags |= JOYSTICKS;
+    if (!frame.answers.empty()) flags |= ANSWERS;
+
+    buffer.push_back(TAG_FRAME);
+    writeVarint(frame.deltaUs);
+    buffer.push_back(flags);
+    if (flags & MOUSE_POSITION) {
+        writeSigned(frame.mouseX - previousFrame.mouseX);
+        writeSigned(frame.mouseY - previousFrame.mouseY);
+    }
+    if (flags & MOUSE_BUTTON) buffer.push_back(frame.mouseButton);
+    if (flags & KEYS) writeStrings(frame.keys);
+    if (flags & BUTTONS) writeStrings(frame.buttons);
+    if (flags & JOYSTICKS) {
+        for (float axis : frame.joysticks)
+            writeFloat(axis);
+    }
+    if (flags & ANSWERS) writeStrings(frame.answers);
+
+    previousFrame = frame;
+    previousFrame.answers.clear();
+
+    // keep the file mostly up to date in case the app crashes, without a write for every frame
+    if (buffer.size() >= 4096) flush();
+}
+
+void beginStep() {
+    if (!recording) return;
+    writePendingFrame();
+
+    const auto now = std::chrono::steady_clock::now();
+    const uint64_t deltaUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - lastSync).count());
+    lastSync += std::chrono::microseconds(deltaUs);
+
+    Timer::advanceFixedClock(static_cast<double>(deltaUs) / 1000.0);
+    pendingDeltaUs += deltaUs;
+}
+
+void recordInput() {
+    if (!recording) return;
+
+    pendingFrame = Frame();
+    pendingFrame.deltaUs = pendingDeltaUs;
+    pendingFrame.mouseX = Input::mousePointer.x;
+    pendingFrame.mouseY = Input::mousePointer.y;
+    pendingFrame.mousePressed = Input::mousePointer.isPressed;
+    pendingFrame.mouseMoving = Input::mousePointer.isMoving;
+    pendingFrame.mouseButton = static_cast<uint8_t>(Input::mousePointer.mouseButton);
+    pendingFrame.keys = Input::inputKeys;
+    pendingFrame.buttons = Input::inputButtons;
+    pendingFrame.joysticks[0] = Input::leftJoystick.first;
+    pendingFrame.joysticks[1] = Input::leftJoystick.second;
+    pendingFrame.joysticks[2] = Input::rightJoystick.first;
+    pendingFrame.joysticks[3] = Input::rightJoystick.second;
+    hasPendingFrame = true;
+    pendingDeltaUs = 0;
+}
+
+void recordAnswer(const std::string &answer) {
+    if (!recording || !hasPendingFrame) return;
+    pendingFrame.answers.push_back(answer);
+}
+
+nonstd::expected<void, std::string> loadReplay(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return nonstd::make_unexpected("Failed to open recording: " + path);
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    frames.clear();
+    hasExpectedHash = false;
+
+    try {
+        Reader reader(data);
+        char magic[4];
+        reader.raw(magic, sizeof(magic));
+        if (memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) return nonstd::make_unexpected("Not a recording: " + path);
+        const uint8_t version = reader.byte();
+        if (version != VERSION) return nonstd::make_unexpected("Unsupported recording version " + std::to_string(version));
+        seed = reader.u32();
+        projectPath = reader.string();
+
+        Frame previous;
+        while (!reader.eof()) {
+            const uint8_t tag = reader.byte();
+            if (tag == TAG_END) {
+                expectedHash = reader.u64();
+                hasExpectedHash = true;
+                break;
+            }
+            if (tag != TAG_FRAME) return nonstd::make_unexpected("Corrupt recording: unknown record " + std::to_string(tag));
+
+            Frame frame = previous;
+            frame.answers.clear();
+            frame.deltaUs = reader.varint();
+            const uint8_t flags = reader.byte();
+            frame.mousePressed = flags & MOUSE_PRESSED;
+            frame.mouseMoving = flags & MOUSE_MOVING;
+            if (flags & MOUSE_POSITION) {
+                frame.mouseX += static_cast<int>(reader.signedVarint());
+                frame.mouseY += static_cast<int>(reader.signedVarint());
+            }
+            if (flags & MOUSE_BUTTON) frame.mouseButton = reader.byte();
+            if (flags & KEYS) frame.keys = reader.strings();
+            if (flags & BUTTONS) frame.buttons = reader.strings();
+            if (flags & JOYSTICKS) {
+                for (float &axis : frame.joysticks)
+                    axis = reader.f32();
+            }
+            if (flags & ANSWERS) frame.answers = reader.strings();
+
+            frames.push_back(frame);
+            previous = frame;
+        }
+    } catch (const std::runtime_error &e) {
+        // a recording cut off by a crash is still useful up to the last complete frame
+        Log::logWarning(std::string(e.what()) + ", replaying the first " + std::to_string(frames.size()) + " frames.");
+    }
+
+    if (!hasExpectedHash) Log::logWarning("Recording has no final state hash, the replay will not be verified.");
+    Log::log("Loaded " + std::to_string(frames.size()) + " frames from " + path);
+    return {};
+}
+
+const std::string &getProjectPath() {
+    return projectPath;
+}
+
+bool applyInput() {
+    if (!replaying || currentFrame >= frames.size()) return false;
+
+    const Frame &frame = frames[currentFrame++];
+    currentAnswer = 0;
+
+    Input::mousePointer.x = frame.mouseX;
+    Input::mousePointer.y = frame.mouseY;
+    Input::mousePointer.isPressed = frame.mousePressed;
+    Input::mousePointer.isMoving = frame.mouseMoving;
+    Input::mousePointer.mouseButton = static_cast<decltype(Input::mousePointer.mouseButton)>(frame.mouseButton);
+    Input::inputKeys = frame.keys;
+    Input::inputButtons = frame.buttons;
+    Input::leftJoystick = {frame.joysticks[0], frame.joysticks[1]};
+    Input::rightJoystick = {frame.joysticks[2], frame.joysticks[3]};
+    return true;
+}
+
+std::string nextAnswer() {
+    if (currentFrame == 0) return "";
+    const Frame &frame = frames[currentFrame - 1];
+    if (currentAnswer >= frame.answers.size()) {
+        Log::logWarning("Replay asked for an answer that was not recorded.");
+        return "";
+    }
+    return frame.answers[currentAnswer++];
+}
+
+void onProjectCleanup() {
+    if (recording) {
+        writePendingFrame();
+        const uint64_t hash = stateHash();
+        buffer.push_back(TAG_END);
+        writeU64(hash);
+        flush();
+        output.close();
+
+        recording = false;
+        Timer::setFixedClock(false);
+        Scratch::streamCostumes = true;
+        Log::log("Finished recording.");
+    } else if (replaying && !hasFinalHash) {
+        finalHash = stateHash();
+        hasFinalHash = true;
+    }
+}
+
+int run() {
+    srand(seed);
+    Timer::setFixedClock(true);
+    Scratch::streamCostumes = false;
+    replaying = true;
+    currentFrame = 0;
+    hasFinalHash = false;
+
+    Scratch::initializeScratchProject();
+    ScriptThread monitorDisplayThread;
+
+    bool running = true;
+    while (running && currentFrame < frames.size()) {
+        const size_t frame = currentFrame;
+        Timer::advanceFixedClock(static_cast<double>(frames[frame].deltaUs) / 1000.0);
+        running = Scratch::stepScratchProject(monitorDisplayThread).first;
+
+        if (currentFrame == frame && running) {
+            Log::logWarning("Replay desynced at frame " + std::to_string(frame) + ": the frame was not rendered.");
+            currentFrame++;
+        }
+    }
+
+    if (running) {
+        if (currentFrame < frames.size()) Log::logWarning("Project stopped before the recording ended.");
+        Scratch::cleanupScratchProject();
+    }
+
+    replaying = false;
+    Timer::setFixedClock(false);
+
+    Log::log("Replayed " + std::to_string(currentFrame) + "/" + std::to_string(frames.size()) + " frames.");
+    if (!hasExpectedHash) return 0;
+
+    char hashes[64];
+    snprintf(hashes, sizeof(hashes), "expected %016llx, got %016llx", static_cast<unsigned long long>(expectedHash), static_cast<unsigned long long>(finalHash));
+    if (!hasFinalHash || finalHash != expectedHash) {
+        Log::logError(std::string("Replay FAILED: final state hash mismatch (") + hashes + ")");
+        return 1;
+    }
+    Log::log(std::string("Replay OK: final state hash matches (") + hashes + ")");
+    return 0;
+}
+
+} // namespace Replay
+
+#else
+
+namespace Replay {
+bool recording = false;
+bool replaying = false;
+
+static const std::string empty;
+
+nonstd::expected<void, std::string> startRecording(const std::string &path) {
+    return nonstd::make_unexpected("Input recording is not supported on this platform.");
+}
+nonstd::expected<void, std::string> loadReplay(const std::string &path) {
+    return nonstd::make_unexpected("Input replay is not supported on this platform.");
+}
+const std::string &getProjectPath() {
+    return empty;
+}
+int run() {
+    return 1;
+}
+void beginStep() {}
+void recordInput() {}
+void recordAnswer(const std::string &answer) {}
+bool applyInput() {
+    return false;
+}
+std::string nextAnswer() {
+    return "";
+}
+void onProjectCleanup() {}
+uint64_t stateHash() {
+    return 0;
+}
+} // namespace Replay
+
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <nonstd/expected.hpp>
+#include <string>
+
+/**
+ * [PC] Records the per-frame input of a session (keys, buttons, mouse, joysticks and `ask` answers) together with the
+ * RNG seed and frame timings, and replays it through the headless windowing backend.
+ *
+ * While recording or replaying, every Timer reads a virtual clock that only moves between interpreter steps, and the
+ * interpreter runs exactly one step per frame, so a replay goes through the same steps with the same inputs and timer
+ * values as the recording did.
+ */
+namespace Replay {
+
+extern bool recording;
+extern bool replaying;
+
+/**
+ * Starts recording to `path`. Seeds the RNG and switches Timers to the virtual clock.
+ * Should be called right before the project starts.
+ */
+nonstd::expected<void, std::string> startRecording(const std::string &path);
+
+/**
+ * Reads a recording into memory. Call `run()` once the project is loaded to play it back.
+ */
+nonstd::expected<void, std::string> loadReplay(const std::string &path);
+
+/**
+ * The project path stored in the loaded recording.
+ */
+const std::string &getProjectPath();
+
+/**
+ * Steps the loaded project through every recorded frame, then compares the final state hash against the recording.
+ * @return 0 if the replay finished with the same state as the recording, 1 otherwise.
+ */
+int run();
+
+/**
+ * Called at the start of every interpreter step. While recording, this moves the virtual clock to the real time.
+ */
+void beginStep();
+
+/**
+ * Called after the windowing backend has polled input for a frame. While recording, this stores the input state.
+ */
+void recordInput();
+
+/**
+ * Stores the answer to an `ask and wait` block in the current frame.
+ */
+void recordAnswer(const std::string &answer);
+
+/**
+ * [Headless] Restores the input state of the next recorded frame.
+ * @return False if there are no frames left.
+ */
+bool applyInput();
+
+/**
+ * [Headless] Returns the next recorded `ask and wait` answer of the current frame.
+ */
+std::string nextAnswer();
+
+/**
+ * Called right before the project is cleaned up, while its state is still intact.
+ * Finishes the recording (writing the final state hash), or remembers the final state hash of a replay.
+ */
+void onProjectCleanup();
+
+/**
+ * Hashes the canonical project state snapshot.
+ */
+uint64_t stateHash();
+
+} // namespace Replay
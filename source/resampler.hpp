@@ -0,0 +1,113 @@
+#pragma once
+#include <algorithm>
+
+/**
+ * Plays a sound back at another rate, for the mixer's voices. Each voice keeps a `Resampler::State`, so the output is
+ * continuous across mixing blocks and audio callbacks.
+ */
+namespace Resampler {
+
+// Input frames kept from the end of the previous block, so interpolation can look across block boundaries.
+constexpr int historyFrames = 4;
+constexpr int maxChannels = 8;
+
+struct State {
+    // where the next output frame falls, in input frames from the start of `history`
+    double phase = historyFrames;
+    float history[historyFrames * maxChannels] = {};
+};
+
+// Catmull-Rom spline through four neighbouring frames, at `t` between x0 and x1.
+inline float cubic(float xm1, float x0, float x1, float x2, float t) {
+    return x0 + 0.5f * t * (x1 - xm1 + t * (2.0f * xm1 - 5.0f * x0 + 4.0f * x1 - x2 + t * (3.0f * (x0 - x1) + x2 - xm1)));
+}
+
+// The resampling loops read `window` at frames floor(phase) - 1 up to floor(phase + (frames - 1) * step) + 2, and add
+// to the stereo `out`.
+template <bool Cubic>
+void resampleMono(const float *window, double phase, double step, int frames, float gainL, float gainR, float *out) {
+    for (int n = 0; n < frames; n++) {
+        const double pos = phase + n * step;
+        const int i = (int)pos;
+        const float t = (float)(pos - i);
+        const float *x = window + i;
+
+        const float sample = Cubic ? cubic(x[-1], x[0], x[1], x[2], t) : x[0] + (x[1] - x[0]) * t;
+        out[2 * n + 0] += sample * gainL;
+        out[2 * n + 1] += sample * gainR;
+    }
+}
+
+// Plays the first two channels of an interleaved window.
+template <bool Cubic>
+void resampleStereo(const float *window, int channels, double phase, double step, int frames, float gainL, float gainR, float *out) {
+    for (int n = 0; n < frames; n++) {
+        const double pos = phase + n * step;
+        const int i = (int)pos;
+        const float t = (float)(pos - i);
+        const float *x = window + i * channels;
+        const float *xm1 = x - channels;
+        const float *x1 = x + channels;
+        const float *x2 = x1 + channels;
+
+        float left, right;
+        if (Cubic) {
+            left = cubic(xm1[0], x[0], x1[0], x2[0], t);
+            right = cubic(xm1[1], x[1], x1[1], x2[1], t);
+        } else {
+            left = x[0] + (x1[0] - x[0]) * t;
+            right = x[1] + (x1[1] - x[1]) * t;
+        }
+        out[2 * n + 0] += left * gainL;
+        out[2 * n + 1] += right * gainR;
+    }
+}
+
+/**
+ * Adds `frames` frames of a sound with `channels` channels, played `step` input frames per output frame, to the stereo
+ * `out`. The fractional position and the last few input frames are carried over in `state` to the next call.
+ * @param read Called as `read(float *dst, int frames)` to decode the next interleaved input frames; returns how many it
+ * decoded, fewer once the sound is over.
+ * @param window Scratch space of `windowSamples` floats the input is decoded into.
+ * @return false once the sound has run out.
+ */
+template <typename Read>
+bool mix(State &state, Read &&read, int channels, double step, bool cubic, float gainL, float gainR, float *window, int windowSamples, float *out, int frames) {
+    // decode in pieces small enough for the scratch buffer, which matters for high pitches
+    const int windowFrames = windowSamples / channels;
+    const int maxChunk = std::max(1, (int)((windowFrames - historyFrames - 4) / step));
+    const int historySamples = historyFrames * channels;
+    bool ended = false;
+
+    for (int done = 0; done < frames && !ended;) {
+        const int chunk = std::min(frames - done, maxChunk);
+        // read just enough input for the last frame of the chunk to have all its taps
+        const int lastIndex = (int)(state.phase + (chunk - 1) * step);
+        const int wanted = std::max(0, lastIndex + 3 - historyFrames);
+
+        std::copy(state.history, state.history + historySamples, window);
+        int decoded = wanted > 0 ? read(window + historySamples, wanted) : 0;
+        if (decoded < wanted) {
+            // the sound is over; let its end ring out through the interpolator, then stop
+            decoded = std::max(decoded, 0);
+            std::fill(window + historySamples + decoded * channels, window + historySamples + wanted * channels, 0.0f);
+            ended = true;
+        }
+
+        float *chunkOut = out + done * 2;
+        if (channels == 1) {
+            if (cubic) resampleMono<true>(window, state.phase, step, chunk, gainL, gainR, chunkOut);
+            else resampleMono<false>(window, state.phase, step, chunk, gainL, gainR, chunkOut);
+        } else {
+            if (cubic) resampleStereo<true>(window, channels, state.phase, step, chunk, gainL, gainR, chunkOut);
+            else resampleStereo<false>(window, channels, state.phase, step, chunk, gainL, gainR, chunkOut);
+        }
+
+        std::copy(window + wanted * channels, window + wanted * channels + historySamples, state.history);
+        state.phase += chunk * step - wanted;
+        done += chunk;
+    }
+    return !ended;
+}
+
+} // namespace Resampler
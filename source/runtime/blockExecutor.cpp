@@ -8,10 +8,12 @@
 #include <iterator>
 #include <log.hpp>
 #include <os.hpp>
+#include <profiler.hpp>
 #include <render.hpp>
 #include <runtime.hpp>
 #include <speech_manager.hpp>
 #include <string>
+#include <tracer.hpp>
 #include <utility>
 #include <vector>
 
@@ -24,7 +26,6 @@ extern std::unique_ptr<MistConnection> cloudConnection;
 Timer BlockExecutor::timer;
 int BlockExecutor::dragPositionOffsetX;
 int BlockExecutor::dragPositionOffsetY;
-bool BlockExecutor::sortSprites = false;
 bool BlockExecutor::stopClicked = false;
 std::vector<ScriptThread *> BlockExecutor::threads;
 
@@ -84,8 +85,10 @@ ScriptThread *BlockExecutor::startThread(Sprite *sprite, Block *block, bool shou
     newThread->nextBlock = block;
     newThread->parentThread = nullptr;
     newThread->finished = false;
+    newThread->musicTime = 0;
     newThread->id = ++id;
     newThread->sprite = sprite;
+    SE_TRACE_INSTANT("thread start", "threads", sprite->name + ": " + block->opcode);
 
     if (restartThreadIndex == -1) {
         threads.push_back(newThread);
@@ -107,43 +110,40 @@ void BlockExecutor::runThreads() {
         BlockResult var;
 
         if (thread->finished) {
+            SE_TRACE_INSTANT("thread finish", "threads", thread->sprite->name + ": " + thread->blockHat->opcode);
             thread->clear();
             Pools::threads.push_back(thread);
             threads.erase(threads.begin() + i);
             continue;
         }
 
+#ifdef ENABLE_PROFILER
+        const Profiler::Sample sample = Profiler::beginSample();
+#endif
         var = runThread(*thread, *thread->sprite, nullptr);
+#ifdef ENABLE_PROFILER
+        Profiler::endScriptSample(thread, sample);
+#endif
 
         if (Scratch::shouldStop) return;
         i++;
     }
 
-    Scratch::sprites.erase(
-        std::remove_if(Scratch::sprites.begin(), Scratch::sprites.end(),
-                       [](Sprite *s) {
-                           if (s->toDelete) {
-                               for (auto &thread : threads) {
-                                   if (thread->sprite == s) {
-                                       thread->finished = true;
-                                   }
-                               }
-                               SpeechManager *speechManager = Render::getSpeechManager();
-                               if (speechManager) speechManager->clearSpeech(s);
-                               sortSprites = true;
-                               delete s;
-                               return true;
-                           }
-                           return false;
-                       }),
-        Scratch::sprites.end());
-
-    if (sortSprites) {
-        for (unsigned int i = 0; i < Scratch::sprites.size(); i++) {
-            Scratch::sprites[i]->layer = (Scratch::sprites.size() - 1) - i;
+    Scratch::sprites.eraseIf([](Sprite *s) {
+        if (s->toDelete) {
+            SE_TRACE_INSTANT("clone delete", "clones", s->name);
+            for (auto &thread : threads) {
+                if (thread->sprite == s) {
+                    thread->finished = true;
+                }
+            }
+            SpeechManager *speechManager = Render::getSpeechManager();
+            if (speechManager) speechManager->clearSpeech(s);
+            delete s;
+            return true;
         }
-        sortSprites = false;
-    }
+        return false;
+    });
     if (stopClicked) {
         Scratch::stopClicked();
     }
@@ -159,7 +159,13 @@ BlockResult BlockExecutor::runThread(ScriptThread &thread, Sprite &sprite, Value
         currentBlock = thread.nextBlock;
         thread.nextBlock = currentBlock->nextBlock;
 
+#ifdef ENABLE_PROFILER
+        const Profiler::Sample sample = Profiler::beginSample();
+#endif
         var = currentBlock->blockFunction(currentBlock, &thread, &sprite, outValue);
+#ifdef ENABLE_PROFILER
+        Profiler::endBlockSample(currentBlock, sample);
+#endif
         if (var == BlockResult::REPEAT) thread.nextBlock = currentBlock;
         else {
             Scratch::resetInput(currentBlock);
@@ -171,6 +177,9 @@ BlockResult BlockExecutor::runThread(ScriptThread &thread, Sprite &sprite, Value
 
     } while ((var == BlockResult::CONTINUE_IMMEDIATELY || (var == BlockResult::CONTINUE && (!currentBlock->isEndBlock || thread.withoutScreenRefresh))) && !thread.finished && thread.nextBlock != nullptr && !Scratch::shouldStop);
     if (currentBlock == nullptr || var == BlockResult::RETURN || (var != BlockResult::REPEAT && currentBlock->nextBlock == nullptr)) thread.finished = true;
+#ifdef ENABLE_PROFILER
+    if (!thread.finished && currentBlock != nullptr) Profiler::recordYield(currentBlock);
+#endif
     return var;
 }
 
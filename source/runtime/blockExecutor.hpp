@@ -72,9 +72,6 @@ class BlockExecutor {
     static BlockResult runThread(ScriptThread &thread, Sprite &sprite, Value *outValue);
     static std::vector<ScriptThread *> threads;
 
-    // If true, all sprites will be sorted at the end of the frame.
-    static bool sortSprites;
-
     // If true, the project will stop at the end of the frame.
     static bool stopClicked;
 
@@ -9,6 +9,7 @@
 #include <os.hpp>
 #include <ostream>
 #include <sprite.hpp>
+#include <tracer.hpp>
 #include <value.hpp>
 
 SCRATCH_BLOCK(control, if) {
@@ -69,6 +70,7 @@ SCRATCH_BLOCK(control, create_clone_of) {
     }
 
     if (!original) return BlockResult::CONTINUE;
+    SE_TRACE_INSTANT("clone create", "clones", original->name);
     Sprite *spriteToClone = new Sprite();
     spriteToClone->name = original->name;
     spriteToClone->isStage = false;
@@ -82,7 +84,6 @@ SCRATCH_BLOCK(control, create_clone_of) {
     spriteToClone->yPosition = original->yPosition;
     spriteToClone->size = original->size;
     spriteToClone->rotation = original->rotation;
-    spriteToClone->layer = original->layer;
     spriteToClone->rotationStyle = original->rotationStyle;
     spriteToClone->spriteWidth = original->spriteWidth;
     spriteToClone->spriteHeight = original->spriteHeight;
@@ -106,16 +107,7 @@ SCRATCH_BLOCK(control, create_clone_of) {
     BlockExecutor::linkPointers(spriteToClone);
 #endif
 
-    int sourceIndex = (Scratch::sprites.size() - 1) - original->layer;
-    if (sourceIndex < 0) sourceIndex = 0;
-    if (sourceIndex >= (int)Scratch::sprites.size()) sourceIndex = Scratch::sprites.size() - 1;
-
-    auto it = Scratch::sprites.insert(Scratch::sprites.begin() + sourceIndex + 1, spriteToClone);
-
-    for (size_t i = 0; i < sourceIndex + 1; i++) {
-        Scratch::sprites[i]->layer = (Scratch::sprites.size() - 1) - i;
-    }
-    BlockExecutor::sortSprites = true;
+    Scratch::insertClone(spriteToClone, original);
 
     BlockExecutor::runAllBlocksByOpcodeInSprite("control_start_as_clone", spriteToClone);
     Scratch::cloneCount++;
@@ -125,6 +117,7 @@ SCRATCH_BLOCK(control, create_clone_of) {
 SCRATCH_BLOCK(control, delete_this_clone) {
     if (!sprite->isClone) return BlockResult::CONTINUE;
     sprite->toDelete = true;
+    Mixer::stopSounds(sprite);
     for (ScriptThread *t : BlockExecutor::threads) {
         if (t->sprite == sprite) t->finished = true;
     }
@@ -155,8 +148,7 @@ SCRATCH_BLOCK(control, stop) {
             if (thread == t || thread->parentThread == t || t->sprite != sprite) continue;
             t->finished = true;
         }
-        for (Sound sound : sprite->sounds)
-            Mixer::stopSound(sound.fullName);
+        Mixer::stopSounds(sprite);
     }
     return BlockResult::CONTINUE;
 }
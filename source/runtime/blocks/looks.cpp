@@ -282,23 +282,7 @@ SCRATCH_BLOCK(looks, goforwardbackwardlayers) {
     int shift = floor(num.asDouble());
     if (forwardBackward == "backward") shift = -shift;
 
-    const int currentIndex = (Scratch::sprites.size() - 1) - sprite->layer;
-    const int targetIndex = std::clamp<int>(currentIndex - shift, 0, Scratch::sprites.size() - 2);
-
-    if (targetIndex == currentIndex) return BlockResult::CONTINUE;
-
-    if (targetIndex < currentIndex) {
-        std::rotate(Scratch::sprites.begin() + targetIndex, Scratch::sprites.begin() + currentIndex, Scratch::sprites.begin() + currentIndex + 1);
-    } else {
-        std::rotate(Scratch::sprites.begin() + currentIndex, Scratch::sprites.begin() + currentIndex + 1, Scratch::sprites.begin() + targetIndex + 1);
-    }
-
-    for (int i = std::min(currentIndex, targetIndex); i <= std::max(currentIndex, targetIndex); i++) {
-        Scratch::sprites[i]->layer = (Scratch::sprites.size() - 1) - i;
-    }
-
-    BlockExecutor::sortSprites = true;
-
+    Scratch::moveSpriteToIndex(sprite, Scratch::getSpriteIndex(sprite) - shift);
     return BlockResult::CONTINUE;
 }
 
@@ -307,25 +291,7 @@ SCRATCH_BLOCK(looks, gotofrontback) {
 
     const std::string value = Scratch::getFieldValue(*block, "FRONT_BACK");
 
-    const int currentIndex = (Scratch::sprites.size() - 1) - sprite->layer;
-    const int targetIndex = value == "front" ? 0 : (Scratch::sprites.size() - 2);
-
-    if (currentIndex == targetIndex) return BlockResult::CONTINUE;
-
-    if (targetIndex < currentIndex) {
-        std::rotate(Scratch::sprites.begin() + targetIndex,
-                    Scratch::sprites.begin() + currentIndex,
-                    Scratch::sprites.begin() + currentIndex + 1);
-    } else {
-        std::rotate(Scratch::sprites.begin() + currentIndex,
-                    Scratch::sprites.begin() + currentIndex + 1,
-                    Scratch::sprites.begin() + targetIndex + 1);
-    }
-
-    for (int i = std::min(currentIndex, targetIndex); i <= std::max(currentIndex, targetIndex); i++) {
-        Scratch::sprites[i]->layer = (Scratch::sprites.size() - 1) - i;
-    }
-    BlockExecutor::sortSprites = true;
+    Scratch::moveSpriteToIndex(sprite, value == "front" ? 0 : Scratch::sprites.size() - 2);
     return BlockResult::CONTINUE;
 }
 
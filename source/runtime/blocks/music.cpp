@@ -25,15 +25,19 @@ SCRATCH_BLOCK(music, playNoteForBeats) {
 
     Mixer::initMusic();
     if (state->completedSteps == 0) {
-        if ((state->musicChannel = Mixer::note(sprite->instrument, note.asDouble(), sprite->volume / 100.0, beats.asDouble())) == -1) {
+        // follow right on from the thread's previous note if it only just ended
+        const uint64_t start = Mixer::musicStart(thread->musicTime);
+        const uint64_t end = start + Mixer::beatsToFrames(beats.asDouble());
+        if (!Mixer::note(sprite->instrument, note.asDouble(), sprite->volume / 100.0, start, end)) {
             thread->eraseState(block);
             return BlockResult::CONTINUE;
         }
 
+        thread->musicTime = end;
         state->completedSteps = 1;
         return BlockResult::REPEAT;
     } else if (state->completedSteps == 1) {
-        if (Mixer::isInstrumentPlaying(state->musicChannel)) return BlockResult::REPEAT;
+        if (!Mixer::musicReached(thread->musicTime)) return BlockResult::REPEAT;
     }
 
     thread->eraseState(block);
@@ -51,15 +55,18 @@ SCRATCH_BLOCK(music, playDrumForBeats) {
 
     Mixer::initMusic();
     if (state->completedSteps == 0) {
-        if ((state->musicChannel = Mixer::drum(drum.asDouble(), sprite->volume / 100.0, beats.asDouble())) == -1) {
+        const uint64_t start = Mixer::musicStart(thread->musicTime);
+        const uint64_t end = start + Mixer::beatsToFrames(beats.asDouble());
+        if (!Mixer::drum(drum.asDouble(), sprite->volume / 100.0, start, end)) {
             thread->eraseState(block);
             return BlockResult::CONTINUE;
         }
 
+        thread->musicTime = end;
         state->completedSteps = 1;
         return BlockResult::REPEAT;
     } else if (state->completedSteps == 1) {
-        if (Mixer::isInstrumentPlaying(state->musicChannel)) return BlockResult::REPEAT;
+        if (!Mixer::musicReached(thread->musicTime)) return BlockResult::REPEAT;
     }
 
     thread->eraseState(block);
@@ -93,6 +100,11 @@ SCRATCH_BLOCK(music, changeTempo) {
 
 SCRATCH_BLOCK(music, restForBeats) {
     BlockState *state = thread->getState(block);
+    if (state->completedSteps == 2) {
+        if (!Mixer::musicReached(thread->musicTime)) return BlockResult::REPEAT;
+        thread->eraseState(block);
+        return BlockResult::CONTINUE;
+    }
     if (state->completedSteps == 1) {
         if (state->waitTimer.hasElapsed(state->waitDuration)) {
             thread->eraseState(block);
@@ -102,6 +114,15 @@ SCRATCH_BLOCK(music, restForBeats) {
     }
     Value beats;
     if (!Scratch::getInputValue(block, "BEATS", thread, sprite, beats)) return BlockResult::REPEAT;
+
+    if (Mixer::isMusicScheduled()) {
+        // keep the notes around the rest on the beat
+        thread->musicTime = Mixer::musicStart(thread->musicTime) + Mixer::beatsToFrames(beats.asDouble());
+        Scratch::forceRedraw = true;
+        state->completedSteps = 2;
+        return BlockResult::REPEAT;
+    }
+
     state->waitDuration = Mixer::beatsToSec(beats.asDouble()) * 1000;
 
     state->waitTimer.start();
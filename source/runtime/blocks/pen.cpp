@@ -14,6 +14,7 @@ SCRATCH_BLOCK(pen, penDown) {
         Render::penDotAccurate(sprite);
     else Render::penDotFast(sprite);
 
+    Scratch::markSceneChanged();
     Scratch::forceRedraw = true;
     return BlockResult::CONTINUE;
 }
@@ -133,6 +134,7 @@ SCRATCH_BLOCK(pen, clear) {
 
     Render::penClear();
 
+    Scratch::markSceneChanged();
     Scratch::forceRedraw = true;
     return BlockResult::CONTINUE;
 }
@@ -144,6 +146,7 @@ SCRATCH_BLOCK(pen, stamp) {
 
     Render::penStamp(sprite);
 
+    Scratch::markSceneChanged();
     Scratch::forceRedraw = true;
     return BlockResult::CONTINUE;
 }
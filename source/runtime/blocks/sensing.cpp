@@ -1,6 +1,7 @@
 #include "blockUtils.hpp"
 #include <cmath>
 #include <input.hpp>
+#include <replay.hpp>
 #include <sprite.hpp>
 #include <utility>
 #include <value.hpp>
@@ -15,6 +16,9 @@ SCRATCH_BLOCK(sensing, askandwait) {
     Value input;
     if (!Scratch::getInputValue(block, "QUESTION", thread, sprite, input)) return BlockResult::REPEAT;
     Scratch::answer = Input::openSoftwareKeyboard(input.asString().c_str());
+    // the keyboard drew over the stage
+    Scratch::markSceneChanged();
+    Replay::recordAnswer(Scratch::answer);
 
     return BlockResult::CONTINUE;
 }
@@ -160,8 +164,7 @@ SCRATCH_BLOCK(sensing, touchingobject) {
         *outValue = Value(Scratch::isColliding("edge", sprite));
     else {
         *outValue = Value(false);
-        for (size_t i = 0; i < Scratch::sprites.size(); i++) {
-            Sprite *currentSprite = Scratch::sprites[i];
+        for (Sprite *currentSprite : Scratch::sprites) {
             if (currentSprite == sprite) continue;
             if (currentSprite->name == touchingObject.asString() &&
                 Scratch::isColliding("sprite", sprite, currentSprite, touchingObject.asString())) {
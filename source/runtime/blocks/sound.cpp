@@ -40,15 +40,13 @@ SCRATCH_BLOCK(sound, playuntildone) {
         if (soundFound) {
             SoundStream *strm;
             if (Scratch::projectType == ProjectType::UNZIPPED)
-                strm = new SoundStream(state->name);
+                strm = new SoundStream(state->name, false, false, sprite);
             else
-                strm = new SoundStream(Scratch::sb3InRam ? &Unzip::zipArchive : nullptr, state->name);
+                strm = new SoundStream(Scratch::sb3InRam ? &Unzip::zipArchive : nullptr, state->name, sprite);
             if (strm->error.has_value()) {
                 Log::logError("[Sound] " + strm->error.value());
                 delete strm;
             }
-
-            Mixer::setSoundVolume(state->name, sprite->volume);
         }
 
         state->completedSteps = 1;
@@ -56,13 +54,13 @@ SCRATCH_BLOCK(sound, playuntildone) {
     }
     std::string checkSoundName = state->name;
 
-    if (!checkSoundName.empty() && Mixer::isSoundPlaying(checkSoundName)) {
+    if (!checkSoundName.empty() && Mixer::isSoundPlaying(checkSoundName, sprite)) {
         return BlockResult::REPEAT;
     }
 
-    if (!checkSoundName.empty() && Mixer::isSoundPlaying(checkSoundName)) return BlockResult::REPEAT;
+    if (!checkSoundName.empty() && Mixer::isSoundPlaying(checkSoundName, sprite)) return BlockResult::REPEAT;
 
-    Mixer::setAutoClean(checkSoundName, true);
+    Mixer::setAutoClean(checkSoundName, true, sprite);
 
     thread->eraseState(block);
 #endif
@@ -100,17 +98,16 @@ SCRATCH_BLOCK(sound, play) {
     if (soundFound) {
         SoundStream *strm;
         if (Scratch::projectType == ProjectType::UNZIPPED)
-            strm = new SoundStream(soundFullName, false);
+            strm = new SoundStream(soundFullName, false, false, sprite);
         else
-            strm = new SoundStream(Scratch::sb3InRam ? &Unzip::zipArchive : nullptr, soundFullName);
+            strm = new SoundStream(Scratch::sb3InRam ? &Unzip::zipArchive : nullptr, soundFullName, sprite);
         if (strm->error.has_value()) {
             Log::logError("[Sound] " + strm->error.value());
             delete strm;
             return BlockResult::CONTINUE;
         }
 
-        Mixer::setSoundVolume(soundFullName, sprite->volume);
-        Mixer::setAutoClean(soundFullName, true);
+        strm->auto_clean = true;
     }
 #endif
     return BlockResult::CONTINUE;
@@ -118,12 +115,7 @@ SCRATCH_BLOCK(sound, play) {
 
 SCRATCH_BLOCK(sound, stopallsounds) {
 #ifdef ENABLE_AUDIO
-    for (auto &currentSprite : Scratch::sprites) {
-        for (Sound sound : currentSprite->sounds) {
-            Mixer::setAutoClean(sound.fullName, true);
-            Mixer::stopSound(sound.fullName);
-        }
-    }
+    Mixer::stopAllSounds();
 #endif
     return BlockResult::CONTINUE;
 }
@@ -140,15 +132,11 @@ SCRATCH_BLOCK(sound, changeeffectby) {
     if (effect == "PITCH") {
         sprite->pitch += amount.asDouble();
         sprite->pitch = std::clamp(sprite->pitch, -360.0f, 360.0f);
-        for (Sound sound : sprite->sounds) {
-            Mixer::setPitch(sound.fullName, sprite->pitch);
-        }
+        Mixer::updateSpriteEffects(sprite);
     } else if (effect == "PAN") {
         sprite->pan += amount.asDouble();
         sprite->pan = std::clamp(sprite->pan, -100.0f, 100.0f);
-        for (Sound sound : sprite->sounds) {
-            Mixer::setPan(sound.fullName, sprite->pan);
-        }
+        Mixer::updateSpriteEffects(sprite);
     }
     state->completedSteps = 1;
     return BlockResult::REPEAT;
@@ -163,15 +151,11 @@ SCRATCH_BLOCK(sound, seteffectto) {
     if (effect == "PITCH") {
         sprite->pitch = amount.asDouble();
         sprite->pitch = std::clamp(sprite->pitch, -360.0f, 360.0f);
-        for (Sound sound : sprite->sounds) {
-            Mixer::setPitch(sound.fullName, sprite->pitch);
-        }
+        Mixer::updateSpriteEffects(sprite);
     } else if (effect == "PAN") {
         sprite->pan = amount.asDouble();
         sprite->pan = std::clamp(sprite->pan, -100.0f, 100.0f);
-        for (Sound sound : sprite->sounds) {
-            Mixer::setPan(sound.fullName, sprite->pan);
-        }
+        Mixer::updateSpriteEffects(sprite);
     }
     return BlockResult::CONTINUE;
 }
@@ -179,10 +163,7 @@ SCRATCH_BLOCK(sound, seteffectto) {
 SCRATCH_BLOCK(sound, cleareffects) {
     sprite->pitch = 0.0f;
     sprite->pan = 0.0f;
-    for (Sound sound : sprite->sounds) {
-        Mixer::setPitch(sound.fullName, sprite->pitch);
-        Mixer::setPan(sound.fullName, sprite->pan);
-    }
+    Mixer::updateSpriteEffects(sprite);
     return BlockResult::CONTINUE;
 }
 
@@ -197,9 +178,7 @@ SCRATCH_BLOCK(sound, changevolumeby) {
 
     double inputValue = volume.asDouble();
     sprite->volume = std::clamp(sprite->volume + inputValue, 0.0, 100.0);
-    for (Sound sound : sprite->sounds) {
-        Mixer::setSoundVolume(sound.fullName, sprite->volume + inputValue);
-    }
+    Mixer::updateSpriteEffects(sprite);
     state->completedSteps = 1;
     return BlockResult::REPEAT;
 }
@@ -214,10 +193,8 @@ SCRATCH_BLOCK(sound, setvolumeto) {
     if (!Scratch::getInputValue(block, "VOLUME", thread, sprite, volume)) return BlockResult::REPEAT;
 
     const double inputValue = std::clamp(volume.asDouble(), 0.0, 100.0);
-    for (Sound sound : sprite->sounds) {
-        Mixer::setSoundVolume(sound.fullName, inputValue);
-    }
     sprite->volume = inputValue;
+    Mixer::updateSpriteEffects(sprite);
     state->completedSteps = 1;
     return BlockResult::REPEAT;
 }
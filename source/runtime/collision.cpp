@@ -5,10 +5,16 @@
 #include "sprite.hpp"
 #include <cmath>
 #include <log.hpp>
+#include <pixelKernels.hpp>
 
 std::shared_ptr<CollisionMask> collision::generateCollisionMask(Sprite *sprite, unsigned int scaleFactor) {
     const auto &costume = sprite->costumes[sprite->currentCostume];
     auto imgFind = Scratch::costumeImages.find(costume.fullName);
+    if (imgFind == Scratch::costumeImages.end()) {
+        // the costume may still be streaming in, but collisions can't wait for it
+        Scratch::loadCurrentCostumeImage(sprite);
+        imgFind = Scratch::costumeImages.find(costume.fullName);
+    }
     if (imgFind == Scratch::costumeImages.end()) {
         Log::logWarning("[Collision] Failed to find image for sprite: " + sprite->name);
         return nullptr;
@@ -32,16 +38,11 @@ std::shared_ptr<CollisionMask> collision::generateCollisionMask(Sprite *sprite,
     mask->alphaPixels.resize(mask->width * mask->height, 0);
 
     for (int y = 0; y < (int)mask->height; y++) {
-        for (int x = 0; x < (int)mask->width; x++) {
-            const uint32_t px = pixels[(y * scaleFactor) * imgData.width + (x * scaleFactor)];
-#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
-            const uint8_t alpha = px & 0xFF;
-#else
-            const uint8_t alpha = (px >> 24) & 0xFF;
-#endif
-            if (alpha > 0) {
-                mask->alphaPixels[y * mask->width + x] = alpha;
+        uint8_t *alphaRow = &mask->alphaPixels[y * mask->width];
+        PixelKernels::extractAlpha(reinterpret_cast<const uint8_t *>(pixels + (y * scaleFactor) * imgData.width), scaleFactor, alphaRow, mask->width);
 
+        for (int x = 0; x < (int)mask->width; x++) {
+            if (alphaRow[x] > 0) {
                 const float dx = x - centerX;
                 const float dy = y - centerY;
                 const float distSq = dx * dx + dy * dy;
@@ -82,19 +83,12 @@ static Sprite *getSpriteAbove(Sprite *sprite) {
         return nullptr;
     }
 
-    if (sprite->isStage) {
-        return Scratch::sprites[Scratch::sprites.size() - 2];
-    }
-
-    const int currentIndex = (Scratch::sprites.size() - 1) - sprite->layer;
-
-    if (currentIndex == 0) {
+    auto it = Scratch::sprites.find(sprite);
+    if (it == Scratch::sprites.begin()) {
         return nullptr;
     }
 
-    Sprite *aboveSprite = Scratch::sprites[currentIndex - 1];
-
-    return aboveSprite;
+    return *--it;
 }
 
 bool collision::pointInSprite(Sprite *sprite, float x, float y, bool clickMode) {
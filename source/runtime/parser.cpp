@@ -1,6 +1,7 @@
 #include "parser.hpp"
 #include "sprite.hpp"
 #include <algorithm>
+#include <audiostack.hpp>
 #include <filesystem.hpp>
 #include <input.hpp>
 #include <limits>
@@ -141,6 +142,7 @@ void Parser::loadUsernameFromSettings() {
 }
 
 bool Parser::logParsing = false;
+std::unordered_map<const Block *, const std::string *> Parser::handlerNames;
 
 void Parser::log(const std::string &message) {
     if (Parser::logParsing) {
@@ -148,367 +150,233 @@ void Parser::log(const std::string &message) {
     }
 }
 
-void Parser::loadSprites(const nlohmann::json &json) {
+void Parser::loadSprites(ProjectData &project) {
     Parser::logParsing = false; // ToDo: Activate it via Settings (Only if Logs in general are enabled)
     Parser::log("Loading sprites:");
-    const nlohmann::json &spritesData = json["targets"];
-    int spriteAmount = spritesData.size();
-    Scratch::sprites.reserve(spriteAmount);
+    std::vector<Sprite *> sprites;
+    sprites.reserve(project.targets.size());
 
-    for (const auto &target : spritesData) {
-        Sprite *newSprite = new Sprite();
-
-        // Basic properties
-        if (target.contains("name")) {
-            newSprite->name = target["name"].get<std::string>();
-        }
-        if (target.contains("isStage")) {
-            newSprite->isStage = target["isStage"].get<bool>();
-            if (newSprite->isStage) loadAdvancedProjectSettings(target);
+    for (ProjectTarget &target : project.targets) {
+        Sprite *newSprite = target.sprite;
+        if (newSprite->isStage && target.comments.is_object()) {
+            project.stageSettings = findAdvancedProjectSettings(target.comments);
+            applyAdvancedProjectSettings(*project.stageSettings);
         }
 
         Parser::log(newSprite->name + " (" + std::string(newSprite->isStage ? "Stage" : "Sprite") + ")");
-
-        if (target.contains("draggable")) {
-            newSprite->draggable = target["draggable"].get<bool>();
-        }
-        if (target.contains("visible")) {
-            newSprite->visible = target["visible"].get<bool>();
-        } else {
-            newSprite->visible = true;
-        }
-        if (target.contains("currentCostume")) {
-            newSprite->currentCostume = target["currentCostume"].get<int>();
-        }
-        if (target.contains("volume")) {
-            newSprite->volume = target["volume"].get<int>();
+        for (const auto &[id, variable] : newSprite->variables) {
+            Parser::log("\t\t" + variable.name + " = " + variable.value.asString());
         }
-        if (target.contains("x")) {
-            newSprite->xPosition = target["x"].get<float>();
-        }
-        if (target.contains("y")) {
-            newSprite->yPosition = target["y"].get<float>();
-        }
-        if (target.contains("size")) {
-            newSprite->size = target["size"].get<float>();
-        } else {
-            newSprite->size = 100;
-        }
-        if (target.contains("direction")) {
-            newSprite->rotation = target["direction"].get<float>();
-        } else {
-            newSprite->rotation = 90;
-        }
-        if (target.contains("layerOrder")) {
-            newSprite->layer = target["layerOrder"].get<int>();
-        } else {
-            newSprite->layer = 0;
-        }
-        if (target.contains("rotationStyle")) {
-            std::string style = target["rotationStyle"].get<std::string>();
-            if (style == "all around")
-                newSprite->rotationStyle = newSprite->ALL_AROUND;
-            else if (style == "left-right")
-                newSprite->rotationStyle = newSprite->LEFT_RIGHT;
-            else
-                newSprite->rotationStyle = newSprite->NONE;
-        }
-        newSprite->isClone = false;
-
-        // Variables
-        if (target.contains("variables") && !target["variables"].empty()) {
-            Parser::log("\tVariables:");
-            for (const auto &[id, data] : target["variables"].items()) {
-                Variable newVariable;
-                newVariable.id = id;
-                newVariable.name = data[0];
-                newVariable.value = Value::fromJson(data[1]);
-#ifdef ENABLE_CLOUDVARS
-                newVariable.cloud = data.size() == 3;
-                Scratch::cloudProject = Scratch::cloudProject || newVariable.cloud;
-#endif
-                newSprite->variables[newVariable.id] = newVariable;
-                Parser::log("\t\t" + newVariable.name + " = " + newVariable.value.asString());
-            }
+        for (const auto &[id, list] : newSprite->lists) {
+            Parser::log("\t\t" + list.name + " [" + std::to_string(list.items.size()) + " items]");
         }
 
-        // Lists
-        if (target.contains("lists") && !target["lists"].empty()) {
-            Parser::log("\tLists:");
-            for (const auto &[id, data] : target["lists"].items()) {
-                auto result = newSprite->lists.try_emplace(id).first;
-                List &newList = result->second;
-                newList.id = id;
-                newList.name = data[0];
-                newList.items.reserve(data[1].size());
-                Parser::log("\t\t" + newList.name + " [" + std::to_string(data[1].size()) + " items]");
-                for (const auto &listItem : data[1]) {
-                    newList.items.push_back(Value::fromJson(listItem));
-                }
-            }
-        }
-
-        // Sounds
-        if (target.contains("sounds") && !target["sounds"].empty()) {
-            Parser::log("\tSounds:");
-            for (const auto &[id, data] : target["sounds"].items()) {
-                Sound newSound;
-                newSound.id = data["assetId"];
-                newSound.name = data["name"];
-                newSound.fullName = data["md5ext"];
-                newSound.dataFormat = data["dataFormat"];
-                newSound.sampleRate = data.value("rate", -1); // We don't actually use these values so -1 should be fine
-                newSound.sampleCount = data.value("sampleCount", -1);
-                newSprite->sounds.push_back(newSound);
-                Parser::log("\t\t" + newSound.name);
-            }
-        }
-
-        // Costumes
-        if (target.contains("costumes") && !target["costumes"].empty()) {
-            Parser::log("\tCostumes:");
-            for (const auto &[id, data] : target["costumes"].items()) {
-                Costume newCostume;
-                newCostume.id = data["assetId"];
-                if (data.contains("name")) {
-                    newCostume.name = data["name"];
-                }
-                if (data.contains("bitmapResolution")) {
-                    newCostume.bitmapResolution = data["bitmapResolution"];
-                } else newCostume.bitmapResolution = 1;
-                if (data.contains("dataFormat")) {
-                    newCostume.dataFormat = data["dataFormat"];
-                    newCostume.isSVG = (newCostume.dataFormat == "svg" || newCostume.dataFormat == "SVG");
-                }
-                if (data.contains("md5ext")) {
-                    newCostume.fullName = data["md5ext"];
-                }
-                if (data.contains("rotationCenterX")) {
-                    newCostume.rotationCenterX = data["rotationCenterX"];
-                    if (Scratch::bitmapHalfQuality && !newCostume.isSVG && newCostume.bitmapResolution == 2) newCostume.rotationCenterX /= 2;
-                } else newCostume.rotationCenterX = -6767.6767; // will get changed once costume image is loaded
-                if (data.contains("rotationCenterY")) {
-                    newCostume.rotationCenterY = data["rotationCenterY"];
-                    if (Scratch::bitmapHalfQuality && !newCostume.isSVG && newCostume.bitmapResolution == 2) newCostume.rotationCenterY /= 2;
-                } else newCostume.rotationCenterY = -6767.6767; // will get changed once costume image is loaded
-                newSprite->costumes.push_back(newCostume);
-                Parser::log("\t\t" + newCostume.name);
-            }
-        }
+        loadBlocks(newSprite, target.blocks);
+        target.blocks = BlockTable();
 
-        // Broadcasts
-        if (target.contains("broadcasts") && !target["broadcasts"].empty()) {
-            for (const auto &[id, data] : target["broadcasts"].items()) {
-                Broadcast newBroadcast;
-                newBroadcast.id = id;
-                newBroadcast.name = data;
-                newSprite->broadcasts[newBroadcast.id] = newBroadcast;
-            }
-        }
+        sprites.push_back(newSprite);
+    }
+    project.targets.clear();
 
-        std::vector<std::string> procedureCallBlocks;
+    Scratch::setSprites(std::move(sprites));
 
-        if (target.contains("blocks") && !target["blocks"].empty()) {
-            Parser::log("\tBlocks:");
+    if (project.monitors.is_array()) {
+        loadMonitors(project.monitors);
 
-            for (const auto &[id, data] : target["blocks"].items()) {
-                if (data.contains("opcode") && data["opcode"].get<std::string>() == "procedures_definition") {
-                    procedureCallBlocks.push_back(id);
-                    continue;
-                }
+        Unzip::loadingState = "Finishing up!";
 
-                if (!data.contains("topLevel") || !data["topLevel"].get<bool>()) continue;
-                if (!data.contains("opcode")) continue;
+        Input::applyControls(Unzip::filePath + ".json");
+        Parser::log("Loaded " + std::to_string(Scratch::sprites.size()) + " sprites.");
+    }
+}
 
-                std::string opcode = data["opcode"].get<std::string>();
-                Block *newBlock = new Block();
+void Parser::loadBlocks(Sprite *newSprite, const BlockTable &blockDatas) {
+    if (blockDatas.blocks.empty()) return;
+    Parser::log("\tBlocks:");
+
+    // walk the scripts in block ID order, the same order the JSON object was stored in
+    std::vector<int32_t> topLevelBlocks;
+    std::vector<int32_t> procedureCallBlocks;
+    for (size_t i = 0; i < blockDatas.blocks.size(); i++) {
+        const RawBlock *data = blockDatas.find(static_cast<int32_t>(i));
+        if (data == nullptr) continue;
+        if (*data->opcode == "procedures_definition") procedureCallBlocks.push_back(static_cast<int32_t>(i));
+        else if (data->topLevel) topLevelBlocks.push_back(static_cast<int32_t>(i));
+    }
+    const auto &byId = [&blockDatas](int32_t a, int32_t b) { return *blockDatas.blocks[a].id < *blockDatas.blocks[b].id; };
+    std::sort(topLevelBlocks.begin(), topLevelBlocks.end(), byId);
+    std::sort(procedureCallBlocks.begin(), procedureCallBlocks.end(), byId);
 
-                newBlock->opcode = opcode;
-                if (newBlock->opcode == "event_whenthisspriteclicked" || newBlock->opcode == "event_whenstageclicked") {
-                    newSprite->shouldDoSpriteClick = true;
-                }
+    for (int32_t index : topLevelBlocks) {
+        const RawBlock &data = blockDatas.blocks[index];
 
-                if (BlockExecutor::getHandlers().count(opcode) > 0) {
-                    newBlock->blockFunction = BlockExecutor::getHandlers()[opcode];
-                } else {
-                    Parser::log("\t\t! Unknown opcode: " + opcode);
-                    newBlock->blockFunction = BlockExecutor::getHandlers()["coreExample_exampleOpcode"];
-                }
+        const std::string &opcode = *data.opcode;
+        Block *newBlock = new Block();
 
-                Parser::log("\t\t" + opcode);
-                loadInputs(*newBlock, newSprite, id, target["blocks"], 2);
-                loadFields(*newBlock, id, target["blocks"], 2);
+        newBlock->opcode = opcode;
+        if (newBlock->opcode == "event_whenthisspriteclicked" || newBlock->opcode == "event_whenstageclicked") {
+            newSprite->shouldDoSpriteClick = true;
+        }
 
-                Scratch::blocks.push_back(newBlock);
-                newSprite->hats[opcode].insert(newBlock);
+        if (BlockExecutor::getHandlers().count(opcode) > 0) {
+            setHandler(newBlock, opcode);
+        } else {
+            Parser::log("\t\t! Unknown opcode: " + opcode);
+            setHandler(newBlock, "coreExample_exampleOpcode");
+        }
 
-                if (!data.contains("next") || data["next"].is_null()) {
-                    Parser::log("\t\t\t! No next block");
-                } else {
-                    std::string nextBlockKey = data["next"].get<std::string>();
-                    newBlock->nextBlock = loadBlock(newSprite, nextBlockKey, target["blocks"], nullptr, 2);
-                }
-                setSubstack(newBlock);
-            }
+        Parser::log("\t\t" + opcode);
+        loadInputs(*newBlock, newSprite, data, blockDatas, 2);
+        loadFields(*newBlock, data, 2);
 
-            for (const std::string &id : procedureCallBlocks) {
-                const auto &data = target["blocks"][id];
+        Scratch::blocks.push_back(newBlock);
+        newSprite->hats[opcode].insert(newBlock);
 
-                if (!data.contains("inputs") || !data["inputs"].contains("custom_block") ||
-                    !data["inputs"]["custom_block"].is_array() || data["inputs"]["custom_block"].size() < 2) {
-                    Parser::log("\t\t! procedures_call without custom_block input");
-                    continue;
-                }
+        if (data.next < 0) {
+            Parser::log("\t\t\t! No next block");
+        } else {
+            newBlock->nextBlock = loadBlock(newSprite, data.next, blockDatas, nullptr, 2);
+        }
+        setSubstack(newBlock);
+    }
 
-                std::string prototypeId;
-                if (data["inputs"]["custom_block"][1].is_string()) {
-                    prototypeId = data["inputs"]["custom_block"][1].get<std::string>();
-                } else {
-                    Parser::log("\t\t! procedures_call prototype block ID is not a string");
-                    continue;
-                }
+    for (int32_t index : procedureCallBlocks) {
+        const RawBlock &data = blockDatas.blocks[index];
 
-                if (!target["blocks"].contains(prototypeId)) {
-                    Parser::log("\t\t! procedures_call prototype block not found");
-                    continue;
-                }
+        const auto customBlock = std::find_if(data.inputs.begin(), data.inputs.end(), [](const RawInput &input) { return *input.name == "custom_block"; });
+        if (customBlock == data.inputs.end() || (customBlock->block < 0 && !customBlock->primitive)) {
+            Parser::log("\t\t! procedures_call without custom_block input");
+            continue;
+        }
 
-                const auto &prototype = target["blocks"][prototypeId];
-                if (!prototype.contains("mutation")) {
-                    Parser::log("\t\t! procedures_call without mutation");
-                    continue;
-                }
-                std::string proccode = prototype["mutation"]["proccode"];
+        if (customBlock->block < 0) {
+            Parser::log("\t\t! procedures_call prototype block ID is not a string");
+            continue;
+        }
 
-                if (newSprite->customHatBlock.find(proccode) == newSprite->customHatBlock.end()) {
-                    newSprite->customHatBlock[proccode] = new Block();
-                    Parser::log("\t\t! Unknown procedure: '" + proccode + "'");
-                }
-                Parser::log("\t\t! Procedure '" + proccode + "' found");
-                Block *definitionBlock = newSprite->customHatBlock[proccode];
-                definitionBlock->blockFunction = BlockExecutor::getHandlers()["procedures_prototype"];
+        const RawBlock *prototype = blockDatas.find(customBlock->block);
+        if (prototype == nullptr) {
+            Parser::log("\t\t! procedures_call prototype block not found");
+            continue;
+        }
 
-                if (prototype["mutation"].contains("argumentnames") &&
-                    prototype["mutation"].contains("argumentids")) {
+        if (!prototype->mutation) {
+            Parser::log("\t\t! procedures_call without mutation");
+            continue;
+        }
+        const RawMutation &mutation = *prototype->mutation;
+        const std::string &proccode = mutation.proccode;
 
-                    std::string rawArgumentIds = prototype["mutation"]["argumentids"];
-                    nlohmann::json parsedArgIds = nlohmann::json::parse(rawArgumentIds);
-                    definitionBlock->argumentIDs = parsedArgIds.get<std::vector<std::string>>();
+        if (newSprite->customHatBlock.find(proccode) == newSprite->customHatBlock.end()) {
+            newSprite->customHatBlock[proccode] = new Block();
+            Parser::log("\t\t! Unknown procedure: '" + proccode + "'");
+        }
+        Parser::log("\t\t! Procedure '" + proccode + "' found");
+        Block *definitionBlock = newSprite->customHatBlock[proccode];
+        setHandler(definitionBlock, "procedures_prototype");
 
-                    std::string rawArgumentNames = prototype["mutation"]["argumentnames"];
-                    nlohmann::json parsedNames = nlohmann::json::parse(rawArgumentNames);
-                    definitionBlock->argumentNames = parsedNames.get<std::vector<std::string>>();
-                }
+        if (mutation.hasArgumentNames && mutation.hasArgumentIds) {
+            nlohmann::json parsedArgIds = nlohmann::json::parse(mutation.argumentIds);
+            definitionBlock->argumentIDs = parsedArgIds.get<std::vector<std::string>>();
 
-                if (prototype["mutation"].contains("argumentdefaults")) {
-                    std::string rawArgumentDefaults = prototype["mutation"]["argumentdefaults"];
-                    nlohmann::json parsedAD = nlohmann::json::parse(rawArgumentDefaults);
-                    definitionBlock->argumentDefaults.clear();
-                    for (const auto &item : parsedAD)
-                        definitionBlock->argumentDefaults.push_back(Value::fromJson(item));
-                }
-                if (prototype["mutation"].contains("warp")) {
-                    const auto &warp = prototype["mutation"]["warp"];
-                    definitionBlock->MyBlockWithoutScreenRefresh = (warp.is_string() && warp.get<std::string>() == "true") || (warp.is_boolean() && warp.get<bool>());
-                } else {
-                    definitionBlock->MyBlockWithoutScreenRefresh = false;
-                }
+            nlohmann::json parsedNames = nlohmann::json::parse(mutation.argumentNames);
+            definitionBlock->argumentNames = parsedNames.get<std::vector<std::string>>();
+        }
 
-                if (data.contains("next") && !data["next"].is_null()) {
-                    std::string nextKey = data["next"].get<std::string>();
-                    definitionBlock->nextBlock = loadBlock(newSprite, nextKey, target["blocks"], nullptr, 2);
-                    Parser::log("\t\t! Procedure body loaded from: " + nextKey);
-                }
-                setSubstack(definitionBlock);
-            }
-            for (Block *block : Scratch::blocks) {
-                if (block->opcode == "procedures_call" && block->MyBlockDefinitionID != nullptr) {
-                    block->MyBlockWithoutScreenRefresh =
-                        block->MyBlockDefinitionID->MyBlockWithoutScreenRefresh;
-                }
-            }
+        if (mutation.hasArgumentDefaults) {
+            nlohmann::json parsedAD = nlohmann::json::parse(mutation.argumentDefaults);
+            definitionBlock->argumentDefaults.clear();
+            for (const auto &item : parsedAD)
+                definitionBlock->argumentDefaults.push_back(Value::fromJson(item));
         }
+        definitionBlock->MyBlockWithoutScreenRefresh = mutation.warp;
 
-        Scratch::sprites.push_back(newSprite);
-        if (newSprite->isStage) Scratch::stageSprite = newSprite;
+        if (data.next >= 0) {
+            definitionBlock->nextBlock = loadBlock(newSprite, data.next, blockDatas, nullptr, 2);
+            Parser::log("\t\t! Procedure body loaded from: " + *blockDatas.blocks[data.next].id);
+        }
+        setSubstack(definitionBlock);
     }
+    for (Block *block : Scratch::blocks) {
+        if (block->opcode == "procedures_call" && block->MyBlockDefinitionID != nullptr) {
+            block->MyBlockWithoutScreenRefresh =
+                block->MyBlockDefinitionID->MyBlockWithoutScreenRefresh;
+        }
+    }
+}
 
-    Scratch::sortSprites();
-
-    if (json.contains("monitors") && json["monitors"].is_array()) {
-        Parser::log("Loading monitors:");
-        for (const auto &monitor : json["monitors"]) { // "monitor" is any variable shown on screen
-            Monitor newMonitor;
+void Parser::loadMonitors(const nlohmann::json &monitors) {
+    Parser::log("Loading monitors:");
+    for (const auto &monitor : monitors) { // "monitor" is any variable shown on screen
+        Monitor newMonitor;
 
-            if (monitor.contains("id") && !monitor["id"].is_null())
-                newMonitor.id = monitor.at("id").get<std::string>();
+        if (monitor.contains("id") && !monitor["id"].is_null())
+            newMonitor.id = monitor.at("id").get<std::string>();
 
-            if (monitor.contains("mode") && !monitor["mode"].is_null())
-                newMonitor.mode = monitor.at("mode").get<std::string>();
+        if (monitor.contains("mode") && !monitor["mode"].is_null())
+            newMonitor.mode = monitor.at("mode").get<std::string>();
 
-            if (monitor.contains("opcode") && !monitor["opcode"].is_null())
-                newMonitor.opcode = monitor.at("opcode").get<std::string>();
+        if (monitor.contains("opcode") && !monitor["opcode"].is_null())
+            newMonitor.opcode = monitor.at("opcode").get<std::string>();
 
-            if (monitor.contains("params") && monitor["params"].is_object()) {
-                for (const auto &param : monitor["params"].items()) {
-                    std::string key = param.key();
-                    std::string value = param.value().dump();
-                    newMonitor.parameters[key] = value;
-                }
+        if (monitor.contains("params") && monitor["params"].is_object()) {
+            for (const auto &param : monitor["params"].items()) {
+                std::string key = param.key();
+                std::string value = param.value().dump();
+                newMonitor.parameters[key] = value;
             }
+        }
 
-            if (monitor.contains("spriteName") && monitor["spriteName"].is_string())
-                newMonitor.spriteName = monitor.at("spriteName").get<std::string>();
-            else
-                newMonitor.spriteName = "";
-
-            if (monitor.contains("value") && !monitor["value"].is_null())
-                newMonitor.value = Value(Math::removeQuotations(monitor.at("value").dump()));
-
-            if (monitor.contains("x") && !monitor["x"].is_null())
-                newMonitor.x = monitor.at("x").get<int>();
+        if (monitor.contains("spriteName") && monitor["spriteName"].is_string())
+            newMonitor.spriteName = monitor.at("spriteName").get<std::string>();
+        else
+            newMonitor.spriteName = "";
 
-            if (monitor.contains("y") && !monitor["y"].is_null())
-                newMonitor.y = monitor.at("y").get<int>();
+        if (monitor.contains("value") && !monitor["value"].is_null())
+            newMonitor.value = Value(Math::removeQuotations(monitor.at("value").dump()));
 
-            if (monitor.contains("width") && !(monitor["width"].is_null() || monitor.at("width").get<int>() == 0))
-                newMonitor.width = monitor.at("width").get<int>();
-            else
-                newMonitor.width = 110;
+        if (monitor.contains("x") && !monitor["x"].is_null())
+            newMonitor.x = monitor.at("x").get<int>();
 
-            if (monitor.contains("height") && !(monitor["height"].is_null() || monitor.at("height").get<int>() == 0))
-                newMonitor.height = monitor.at("height").get<int>();
-            else
-                newMonitor.height = 200;
+        if (monitor.contains("y") && !monitor["y"].is_null())
+            newMonitor.y = monitor.at("y").get<int>();
 
-            if (monitor.contains("visible") && !monitor["visible"].is_null())
-                newMonitor.visible = monitor.at("visible").get<bool>();
+        if (monitor.contains("width") && !(monitor["width"].is_null() || monitor.at("width").get<int>() == 0))
+            newMonitor.width = monitor.at("width").get<int>();
+        else
+            newMonitor.width = 110;
 
-            if (monitor.contains("isDiscrete") && !monitor["isDiscrete"].is_null())
-                newMonitor.isDiscrete = monitor.at("isDiscrete").get<bool>();
+        if (monitor.contains("height") && !(monitor["height"].is_null() || monitor.at("height").get<int>() == 0))
+            newMonitor.height = monitor.at("height").get<int>();
+        else
+            newMonitor.height = 200;
 
-            if (monitor.contains("sliderMin") && !monitor["sliderMin"].is_null())
-                newMonitor.sliderMin = monitor.at("sliderMin").get<double>();
+        if (monitor.contains("visible") && !monitor["visible"].is_null())
+            newMonitor.visible = monitor.at("visible").get<bool>();
 
-            if (monitor.contains("sliderMax") && !monitor["sliderMax"].is_null())
-                newMonitor.sliderMax = monitor.at("sliderMax").get<double>();
+        if (monitor.contains("isDiscrete") && !monitor["isDiscrete"].is_null())
+            newMonitor.isDiscrete = monitor.at("isDiscrete").get<bool>();
 
-            Render::monitors.emplace(newMonitor.id, newMonitor);
-        }
+        if (monitor.contains("sliderMin") && !monitor["sliderMin"].is_null())
+            newMonitor.sliderMin = monitor.at("sliderMin").get<double>();
 
-        Unzip::loadingState = "Finishing up!";
+        if (monitor.contains("sliderMax") && !monitor["sliderMax"].is_null())
+            newMonitor.sliderMax = monitor.at("sliderMax").get<double>();
 
-        Input::applyControls(Unzip::filePath + ".json");
-        Parser::log("Loaded " + std::to_string(Scratch::sprites.size()) + " sprites.");
+        Render::monitors.emplace(newMonitor.id, newMonitor);
     }
 }
 
-void Parser::loadAdvancedProjectSettings(const nlohmann::json &json) {
-    if (!json.contains("comments")) return;
+void Parser::setHandler(Block *block, const std::string &name) {
+    auto handler = BlockExecutor::getHandlers().try_emplace(name).first;
+    block->blockFunction = handler->second;
+    handlerNames[block] = &handler->first;
+}
 
+nlohmann::json Parser::findAdvancedProjectSettings(const nlohmann::json &comments) {
     nlohmann::json config;
 
-    for (const auto &[id, data] : json["comments"].items()) {
+    for (const auto &[id, data] : comments.items()) {
         std::size_t settingsFind = data["text"].get<std::string>().find("_twconfig_");
         if (settingsFind == std::string::npos) continue;
 
@@ -553,6 +421,11 @@ void Parser::loadAdvancedProjectSettings(const nlohmann::json &json) {
         config = nlohmann::json::parse(cleaned_json, nullptr, false);
         if (!config.is_discarded()) break;
     }
+    if (config.is_discarded()) config = nullptr;
+    return config;
+}
+
+void Parser::applyAdvancedProjectSettings(const nlohmann::json &config) {
     // set advanced project settings properties
     bool infClones = false;
     if (!config.is_null()) {
@@ -571,7 +444,7 @@ void Parser::loadAdvancedProjectSettings(const nlohmann::json &json) {
         Scratch::projectWidth = config.value("width", 480);
         Scratch::projectHeight = config.value("height", 360);
 
-        auto &runtimeOptions = config["runtimeOptions"];
+        const auto runtimeOptions = config.value("runtimeOptions", nlohmann::json());
         if (runtimeOptions.is_object()) {
             Scratch::fencing = runtimeOptions.value("fencing", true);
             Scratch::miscellaneousLimits = runtimeOptions.value("miscLimits", true);
@@ -629,13 +502,44 @@ void Parser::loadAdvancedProjectSettings(const nlohmann::json &json) {
         Scratch::warpTimer = withoutScreenRefreshLimit.get<bool>();
     else Scratch::warpTimer = true;
 
+    auto costumeCacheMB = Unzip::getSetting("costumeCacheMB");
+    if (costumeCacheMB.is_number() && costumeCacheMB.get<double>() >= 0)
+        Scratch::costumeCacheBudget = static_cast<size_t>(costumeCacheMB.get<double>() * 1024 * 1024);
+    else Scratch::costumeCacheBudget = Scratch::defaultCostumeCacheBudget;
+
+    auto soundCacheMB = Unzip::getSetting("soundCacheMB");
+    if (soundCacheMB.is_number() && soundCacheMB.get<double>() >= 0)
+        SoundCache::budget = static_cast<size_t>(soundCacheMB.get<double>() * 1024 * 1024);
+    else SoundCache::budget = SoundCache::defaultBudget;
+
+    auto soundCacheSeconds = Unzip::getSetting("soundCacheSeconds");
+    if (soundCacheSeconds.is_number() && soundCacheSeconds.get<double>() >= 0)
+        SoundCache::maxSeconds = soundCacheSeconds.get<float>();
+    else SoundCache::maxSeconds = SoundCache::defaultMaxSeconds;
+
+    auto maxPolyphony = Unzip::getSetting("maxPolyphony");
+    if (maxPolyphony.is_number() && maxPolyphony.get<double>() >= 1)
+        Mixer::polyphony = std::min(static_cast<int>(maxPolyphony.get<double>()), Mixer::maxVoices);
+    else Mixer::polyphony = Mixer::defaultPolyphony;
+
+    auto voiceStealing = Unzip::getSetting("voiceStealing");
+    if (voiceStealing.is_string() && voiceStealing.get<std::string>() == "quietest")
+        Mixer::stealPolicy = Mixer::StealPolicy::Quietest;
+    else Mixer::stealPolicy = Mixer::StealPolicy::Oldest;
+
+    auto audioInterpolation = Unzip::getSetting("audioInterpolation");
+    if (audioInterpolation.is_string() && audioInterpolation.get<std::string>() == "linear")
+        Mixer::interpolation = Mixer::Interpolation::Linear;
+    else if (audioInterpolation.is_string() && audioInterpolation.get<std::string>() == "cubic")
+        Mixer::interpolation = Mixer::Interpolation::Cubic;
+    else Mixer::interpolation = Mixer::defaultInterpolation;
+
     if (infClones) Scratch::maxClones = std::numeric_limits<int>::max();
     else Scratch::maxClones = 300;
 }
 
-void Parser::loadInputs(Block &block, Sprite *newSprite, const std::string &blockKey, const nlohmann::json &blockDatas, int indent) {
-    auto &blockData = blockDatas[blockKey];
-    if (!blockData.contains("inputs") || blockData["inputs"].empty()) return;
+void Parser::loadInputs(Block &block, Sprite *newSprite, const RawBlock &blockData, const BlockTable &blockDatas, int indent) {
+    if (blockData.inputs.empty()) return;
 
     std::string indentStr(indent, '\t');
 
@@ -645,29 +549,20 @@ void Parser::loadInputs(Block &block, Sprite *newSprite, const std::string &bloc
         delete block;
     };
 
-    for (const auto &[inputName, data] : blockData["inputs"].items()) {
-        int type = data[0];
-        auto &inputValue = data[1];
-
-        if (type == 1) {
-            if (inputValue.is_array() || block.opcode == "procedures_definition") {
-                block.inputs.push_back({inputName, ParsedInput(Value::fromJson(inputValue))});
-                // block.inputs[inputName] = ParsedInput(Value::fromJson(inputValue));
-                if (inputValue.is_array() && inputValue.size() > 1) {
-                    std::string valueStr;
-                    if (inputValue[1].is_string()) {
-                        valueStr = inputValue[1].get<std::string>();
-                    } else if (inputValue[1].is_number()) {
-                        valueStr = std::to_string(inputValue[1].get<double>());
-                    } else {
-                        valueStr = inputValue[1].dump();
-                    }
-                    Parser::log(indentStr + "\t" + inputName + ": " + valueStr);
-                }
+    for (const RawInput &input : blockData.inputs) {
+        const std::string &inputName = *input.name;
+
+        if (input.type == 1) {
+            if (input.primitive || block.opcode == "procedures_definition") {
+                Value value = input.primitive ? input.value : Value(0);
+                if (!input.primitive && input.block >= 0) value = Value(*blockDatas.blocks[input.block].id);
+                block.inputs.push_back({inputName, ParsedInput(value)});
+                // block.inputs[inputName] = ParsedInput(value);
+                if (input.primitive) Parser::log(indentStr + "\t" + inputName + ": " + value.asString());
             } else {
-                if (!inputValue.is_null()) {
+                if (input.block >= 0) {
                     Parser::log(indentStr + "\t" + inputName + ":");
-                    Block *newBlock = loadBlock(newSprite, inputValue.get<std::string>(), blockDatas, &block, indent + 2);
+                    Block *newBlock = loadBlock(newSprite, input.block, blockDatas, &block, indent + 2);
 
                     // Check shadow block
                     const auto &it = getShadowBlocks().find(newBlock->opcode);
@@ -682,16 +577,16 @@ void Parser::loadInputs(Block &block, Sprite *newSprite, const std::string &bloc
                     // block.inputs[inputName] = ParsedInput(newBlock);
                 }
             }
-        } else if (type == 2 || type == 3) {
-            if (inputValue.is_array()) {
-                block.inputs.push_back({inputName, ParsedInput(inputValue[2].get<std::string>())});
-                // block.inputs[inputName] = ParsedInput(inputValue[2].get<std::string>());
-                if (inputValue[0].get<int>() == 13) block.inputs.back().second.list = true;
-                Parser::log(indentStr + "\t" + inputName + ": var[" + inputValue[1].get<std::string>() + "]");
+        } else if (input.type == 2 || input.type == 3) {
+            if (input.primitive) {
+                block.inputs.push_back({inputName, ParsedInput(input.primitiveId)});
+                // block.inputs[inputName] = ParsedInput(input.primitiveId);
+                if (input.primitiveType == 13) block.inputs.back().second.list = true;
+                Parser::log(indentStr + "\t" + inputName + ": var[" + input.value.asString() + "]");
             } else {
-                if (!inputValue.is_null()) {
+                if (input.block >= 0) {
                     Parser::log(indentStr + "\t" + inputName + ":");
-                    Block *newBlock = loadBlock(newSprite, inputValue.get<std::string>(), blockDatas, &block, indent + 2);
+                    Block *newBlock = loadBlock(newSprite, input.block, blockDatas, &block, indent + 2);
 
                     // Check shadow block
                     const auto &it = getShadowBlocks().find(newBlock->opcode);
@@ -725,23 +620,20 @@ void Parser::loadInputs(Block &block, Sprite *newSprite, const std::string &bloc
     }
 }
 
-void Parser::loadFields(Block &block, const std::string &blockKey, const nlohmann::json &blockDatas, int indent) {
-    auto &blockData = blockDatas[blockKey];
-    if (!blockData.contains("fields") || blockData["fields"].empty()) return;
+void Parser::loadFields(Block &block, const RawBlock &blockData, int indent) {
+    if (blockData.fields.empty()) return;
 
     std::string indentStr(indent, '\t');
 
-    for (const auto &[name, field] : blockData["fields"].items()) {
+    for (const RawField &field : blockData.fields) {
+        const std::string &name = *field.name;
         ParsedField parsedField;
-        if (field.is_array() && !field.empty()) {
-            parsedField.value = field[0].get<std::string>();
-
-            if (field.size() > 1 && !field[1].is_null()) {
-                parsedField.id = field[1].get<std::string>();
-                Parser::log(indentStr + "\t" + name + ": " + parsedField.value + " [" + parsedField.id + "]");
-            } else {
-                Parser::log(indentStr + "\t" + name + ": " + parsedField.value);
-            }
+        parsedField.value = field.value;
+        parsedField.id = field.id;
+        if (!parsedField.id.empty()) {
+            Parser::log(indentStr + "\t" + name + ": " + parsedField.value + " [" + parsedField.id + "]");
+        } else {
+            Parser::log(indentStr + "\t" + name + ": " + parsedField.value);
         }
         block.fields.push_back({name, parsedField});
         // block.fields[name] = parsedField;
@@ -750,7 +642,7 @@ void Parser::loadFields(Block &block, const std::string &blockKey, const nlohman
 
 static constexpr std::array<std::string_view, 13> builtInExtensions = {"music", "pen", "videoSensing", "text2speech", "translate", "makeymakey", "microbit", "ev3", "boost", "wedo2", "goDirect", "coreExtensions", "nishiowoDectalk"};
 
-bool Parser::loadExtensions(const nlohmann::json &json) {
+bool Parser::loadExtensions(const nlohmann::json &extensions) {
     bool hasNativeExts = false;
 #if defined(ENABLE_NATIVE_EXTENSIONS) || defined(ENABLE_CUSTOM_EXTENSIONS)
     const std::string folder = OS::getScratchFolderLocation() + "extensions/";
@@ -760,8 +652,8 @@ bool Parser::loadExtensions(const nlohmann::json &json) {
 #else
     constexpr const char *libraryExtension = ".so";
 #endif
-    if (!json.contains("extensions")) return false;
-    for (const std::string &targetID : json["extensions"]) {
+    if (!extensions.is_array()) return false;
+    for (const std::string &targetID : extensions) {
         if (std::find(builtInExtensions.begin(), builtInExtensions.end(), targetID) != builtInExtensions.end()) continue;
 
 #ifdef ENABLE_NATIVE_EXTENSIONS
@@ -875,16 +767,16 @@ bool Parser::loadExtensions(const nlohmann::json &json) {
     return hasNativeExts;
 }
 
-Block *Parser::loadBlock(Sprite *newSprite, const std::string &id, const nlohmann::json &blockDatas, Block *parentBlock, int indent) {
-    if (!blockDatas.contains(id)) return parentBlock;
-    if (!blockDatas[id].contains("opcode")) return parentBlock;
+Block *Parser::loadBlock(Sprite *newSprite, int32_t index, const BlockTable &blockDatas, Block *parentBlock, int indent) {
+    if (blockDatas.find(index) == nullptr) return parentBlock;
 
     Block *firstBlock = nullptr;
     Block *currentBlock = nullptr;
-    std::string currentId = id;
+    int32_t currentIndex = index;
 
     while (true) {
-        if (!blockDatas.contains(currentId) || !blockDatas[currentId].contains("opcode")) {
+        const RawBlock *rawBlock = blockDatas.find(currentIndex);
+        if (rawBlock == nullptr) {
             if (currentBlock) {
                 currentBlock->nextBlock = parentBlock;
             }
@@ -894,8 +786,8 @@ Block *Parser::loadBlock(Sprite *newSprite, const std::string &id, const nlohman
         Block *newBlock = new Block();
         if (!firstBlock) firstBlock = newBlock;
 
-        const nlohmann::json &blockData = blockDatas[currentId];
-        newBlock->opcode = blockData["opcode"].get<std::string>();
+        const RawBlock &blockData = *rawBlock;
+        newBlock->opcode = *blockData.opcode;
 
         std::string indentStr(indent, '\t');
         Parser::log(indentStr + newBlock->opcode);
@@ -904,39 +796,37 @@ Block *Parser::loadBlock(Sprite *newSprite, const std::string &id, const nlohman
             newSprite->shouldDoSpriteClick = true;
         }
 
-        loadInputs(*newBlock, newSprite, currentId, blockDatas, indent);
-        loadFields(*newBlock, currentId, blockDatas, indent);
+        loadInputs(*newBlock, newSprite, blockData, blockDatas, indent);
+        loadFields(*newBlock, blockData, indent);
 
         if (BlockExecutor::getHandlers().count(newBlock->opcode) > 0) {
-            newBlock->blockFunction = BlockExecutor::getHandlers()[newBlock->opcode];
+            setHandler(newBlock, newBlock->opcode);
         } else {
             Parser::log(indentStr + "No handler found for opcode: " + newBlock->opcode);
-            newBlock->blockFunction = BlockExecutor::getHandlers()["coreExample_exampleOpcode"];
+            setHandler(newBlock, "coreExample_exampleOpcode");
         }
 
         if (newBlock->opcode == "procedures_call") {
-            if (blockData.contains("mutation") && blockData.is_object() &&
-                blockData["mutation"].contains("tagName") &&
-                blockData["mutation"]["tagName"].get<std::string>() == "mutation") {
-
-                std::string rawArgumentIds = blockData["mutation"]["argumentids"];
-                nlohmann::json parsedArgIds = nlohmann::json::parse(rawArgumentIds);
-                newBlock->argumentIDs = parsedArgIds.get<std::vector<std::string>>();
+            if (blockData.mutation && blockData.mutation->tagName == "mutation") {
+                const RawMutation &mutation = *blockData.mutation;
 
-                if (blockData["mutation"].contains("proccode")) {
-                    Parser::log(indentStr + "\tproccode: " + blockData["mutation"]["proccode"].get<std::string>());
+                if (mutation.hasArgumentIds) {
+                    nlohmann::json parsedArgIds = nlohmann::json::parse(mutation.argumentIds);
+                    newBlock->argumentIDs = parsedArgIds.get<std::vector<std::string>>();
                 }
 
+                Parser::log(indentStr + "\tproccode: " + mutation.proccode);
+
                 if (!newBlock->argumentIDs.empty()) {
                     Parser::log(indentStr + "\targuments: " + std::to_string(newBlock->argumentIDs.size()));
                 }
-                std::string procode = blockData["mutation"]["proccode"];
+                const std::string &procode = mutation.proccode;
 
-                if (procode == "\u200B\u200Blog\u200B\u200B %s") newBlock->blockFunction = BlockExecutor::getHandlers()["logs_log"];
-                else if (procode == "\u200B\u200Bwarn\u200B\u200B %s") newBlock->blockFunction = BlockExecutor::getHandlers()["logs_warn"];
-                else if (procode == "\u200B\u200Berror\u200B\u200B %s") newBlock->blockFunction = BlockExecutor::getHandlers()["logs_error"];
-                else if (procode == "\u200B\u200Bopen\u200B\u200B %s .sb3") newBlock->blockFunction = BlockExecutor::getHandlers()["sceneManager_openSB3"];
-                else if (procode == "\u200B\u200Bopen\u200B\u200B %s .sb3 with data %s") newBlock->blockFunction = BlockExecutor::getHandlers()["sceneManager_openSB3withData"];
+                if (procode == "\u200B\u200Blog\u200B\u200B %s") setHandler(newBlock, "logs_log");
+                else if (procode == "\u200B\u200Bwarn\u200B\u200B %s") setHandler(newBlock, "logs_warn");
+                else if (procode == "\u200B\u200Berror\u200B\u200B %s") setHandler(newBlock, "logs_error");
+                else if (procode == "\u200B\u200Bopen\u200B\u200B %s .sb3") setHandler(newBlock, "sceneManager_openSB3");
+                else if (procode == "\u200B\u200Bopen\u200B\u200B %s .sb3 with data %s") setHandler(newBlock, "sceneManager_openSB3withData");
 
                 else {
                     if (newSprite->customHatBlock.count(procode) == 0) newSprite->customHatBlock[procode] = new Block();
@@ -947,15 +837,15 @@ Block *Parser::loadBlock(Sprite *newSprite, const std::string &id, const nlohman
 
         if (newBlock->opcode == "argument_reporter_boolean") {
             std::string name = Scratch::getFieldValue(*newBlock, "VALUE");
-            if (name == "is Scratch Everywhere!?") newBlock->blockFunction = BlockExecutor::getHandlers()["SE_isScratchEverywhere"];
-            if (name == "is New 3DS?") newBlock->blockFunction = BlockExecutor::getHandlers()["SE_isNew3DS"];
-            if (name == "is DSi?") newBlock->blockFunction = BlockExecutor::getHandlers()["SE_isDSi"];
+            if (name == "is Scratch Everywhere!?") setHandler(newBlock, "SE_isScratchEverywhere");
+            if (name == "is New 3DS?") setHandler(newBlock, "SE_isNew3DS");
+            if (name == "is DSi?") setHandler(newBlock, "SE_isDSi");
         } else if (newBlock->opcode == "argument_reporter_string_number") {
             std::string name = Scratch::getFieldValue(*newBlock, "VALUE");
-            if (name == "Scratch Everywhere! platform") newBlock->blockFunction = BlockExecutor::getHandlers()["SE_platform"];
-            if (name == "Scratch Everywhere! controller") newBlock->blockFunction = BlockExecutor::getHandlers()["SE_controller"];
+            if (name == "Scratch Everywhere! platform") setHandler(newBlock, "SE_platform");
+            if (name == "Scratch Everywhere! controller") setHandler(newBlock, "SE_controller");
 
-            if (name == "\u200B\u200Breceived data\u200B\u200B") newBlock->blockFunction = BlockExecutor::getHandlers()["sceneManager_receivedData"];
+            if (name == "\u200B\u200Breceived data\u200B\u200B") setHandler(newBlock, "sceneManager_receivedData");
         }
 
         Scratch::blocks.push_back(newBlock);
@@ -965,19 +855,12 @@ Block *Parser::loadBlock(Sprite *newSprite, const std::string &id, const nlohman
         }
         currentBlock = newBlock;
 
-        std::string nextId;
-        bool hasNext = false;
-        if (blockData.contains("next") && !blockData["next"].is_null()) {
-            nextId = blockData["next"].get<std::string>();
-            hasNext = true;
-        }
-
-        if (!blockDatas[currentId].contains("shadow") || !blockDatas[currentId]["shadow"].get<bool>()) {
+        if (!blockData.shadow) {
             newBlock->shadow = true;
         }
 
-        if (hasNext) {
-            currentId = nextId;
+        if (blockData.next >= 0) {
+            currentIndex = blockData.next;
         } else {
             newBlock->isEndBlock = true;
             newBlock->nextBlock = parentBlock;
@@ -1,5 +1,6 @@
 #pragma once
 #include <nlohmann/json.hpp>
+#include <projectReader.hpp>
 #include <sprite.hpp>
 #include <unordered_map>
 
@@ -10,8 +11,23 @@ struct Parser {
 
     static void loadUsernameFromSettings();
 
-    static void loadSprites(const nlohmann::json &json);
-    static bool loadExtensions(const nlohmann::json &json);
+    /**
+     * Links the blocks read by `ProjectReader` and adds the project's sprites and monitors to the runtime.
+     * Extensions have to be loaded first so their block handlers can be found.
+     */
+    static void loadSprites(ProjectData &project);
+    static bool loadExtensions(const nlohmann::json &extensions);
+
+    /**
+     * Applies the settings from the project's `_twconfig_` comment (or the defaults if `config` is null), along with the
+     * per-project settings file.
+     */
+    static void applyAdvancedProjectSettings(const nlohmann::json &config);
+
+    /**
+     * Name of the handler each loaded block was linked to, kept until `ProjectCache` has stored it.
+     */
+    static std::unordered_map<const Block *, const std::string *> handlerNames;
 
 #ifdef ENABLE_CLOUDVARS
     static void initMist();
@@ -19,10 +35,13 @@ struct Parser {
   private:
     static void log(const std::string &message);
 
-    static Block *loadBlock(Sprite *newSprite, const std::string &id, const nlohmann::json &blockDatas, Block *parentBlock, int indent);
-    static void loadFields(Block &block, const std::string &blockKey, const nlohmann::json &blockDatas, int indent);
-    static void loadInputs(Block &block, Sprite *newSprite, const std::string &blockKey, const nlohmann::json &blockDatas, int indent);
-    static void loadAdvancedProjectSettings(const nlohmann::json &json);
+    static void loadBlocks(Sprite *newSprite, const BlockTable &blockDatas);
+    static Block *loadBlock(Sprite *newSprite, int32_t index, const BlockTable &blockDatas, Block *parentBlock, int indent);
+    static void loadFields(Block &block, const RawBlock &blockData, int indent);
+    static void loadInputs(Block &block, Sprite *newSprite, const RawBlock &blockData, const BlockTable &blockDatas, int indent);
+    static void loadMonitors(const nlohmann::json &monitors);
+    static void setHandler(Block *block, const std::string &name);
+    static nlohmann::json findAdvancedProjectSettings(const nlohmann::json &comments);
     static void setSubstack(Block *startBlock, Block *stopBlock = nullptr);
 
 }; // namespace Parser
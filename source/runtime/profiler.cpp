@@ -0,0 +1,199 @@
+#include "profiler.hpp"
+#ifdef ENABLE_PROFILER
+
+#include "sprite.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <unordered_map>
+#include <vector>
+
+namespace Profiler {
+
+bool running = false;
+uint32_t sampleInterval = 16;
+uint32_t sampleCounter = 0;
+
+struct Entry {
+    std::string name;
+    Counters counters;
+};
+
+// Keyed by pointer so recording never has to hash a string, opcodes get merged when dumping.
+static std::unordered_map<const Block *, Entry> blockEntries;
+static std::unordered_map<const Block *, Entry> scriptEntries;
+
+static std::chrono::steady_clock::time_point sessionStart;
+static std::chrono::steady_clock::time_point sessionEnd;
+
+void start(uint32_t interval) {
+    blockEntries.clear();
+    scriptEntries.clear();
+    sampleInterval = std::max<uint32_t>(interval, 1);
+    sampleCounter = 0;
+    sessionStart = std::chrono::steady_clock::now();
+    running = true;
+}
+
+void stop() {
+    if (!running) return;
+    sessionEnd = std::chrono::steady_clock::now();
+    running = false;
+}
+
+static void record(Counters &counters, const Sample &sample) {
+    counters.calls++;
+    if (!sample.timed) return;
+    counters.sampledCalls++;
+    counters.sampledNs += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sample.start).count());
+}
+
+static Entry &blockEntry(const Block *block) {
+    auto it = blockEntries.find(block);
+    if (it != blockEntries.end()) return it->second;
+    return blockEntries[block] = Entry{block->opcode, {}};
+}
+
+void endBlockSample(Block *block, const Sample &sample) {
+    if (!sample.active) return;
+    record(blockEntry(block).counters, sample);
+}
+
+void endScriptSample(ScriptThread *thread, const Sample &sample) {
+    if (!sample.active || thread->blockHat == nullptr) return;
+
+    auto it = scriptEntries.find(thread->blockHat);
+    if (it == scriptEntries.end()) {
+        const Block *hat = thread->blockHat;
+        std::string name = (thread->sprite ? thread->sprite->name : "?") + ": " + hat->opcode;
+        if (!hat->fields.empty() && !hat->fields[0].second.value.empty()) name += " [" + hat->fields[0].second.value + "]";
+        it = scriptEntries.emplace(hat, Entry{name, {}}).first;
+    }
+
+    record(it->second.counters, sample);
+    if (!thread->finished) it->second.counters.yields++;
+}
+
+void recordYield(Block *block) {
+    if (!running) return;
+    blockEntry(block).counters.yields++;
+}
+
+static std::vector<Entry> mergedOpcodes() {
+    std::unordered_map<std::string, Counters> merged;
+    for (const auto &[block, entry] : blockEntries) {
+        Counters &counters = merged[entry.name];
+        counters.calls += entry.counters.calls;
+        counters.sampledCalls += entry.counters.sampledCalls;
+        counters.sampledNs += entry.counters.sampledNs;
+        counters.yields += entry.counters.yields;
+    }
+
+    std::vector<Entry> entries;
+    entries.reserve(merged.size());
+    for (const auto &[name, counters] : merged) {
+        entries.push_back({name, counters});
+    }
+    return entries;
+}
+
+static std::vector<Entry> scripts() {
+    std::vector<Entry> entries;
+    entries.reserve(scriptEntries.size());
+    for (const auto &[hat, entry] : scriptEntries) {
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+static double averageUs(const Counters &counters) {
+    if (counters.sampledCalls == 0) return 0.0;
+    return static_cast<double>(counters.sampledNs) / 1e3 / static_cast<double>(counters.sampledCalls);
+}
+
+static void sortEntries(std::vector<Entry> &entries, SortKey key) {
+    std::sort(entries.begin(), entries.end(), [key](const Entry &a, const Entry &b) {
+        switch (key) {
+        case SortKey::CALLS:
+            if (a.counters.calls != b.counters.calls) return a.counters.calls > b.counters.calls;
+            break;
+        case SortKey::AVERAGE:
+            if (averageUs(a.counters) != averageUs(b.counters)) return averageUs(a.counters) > averageUs(b.counters);
+            break;
+        case SortKey::YIELDS:
+            if (a.counters.yields != b.counters.yields) return a.counters.yields > b.counters.yields;
+            break;
+        case SortKey::TIME:
+            break;
+        }
+        if (a.counters.estimatedMs() != b.counters.estimatedMs()) return a.counters.estimatedMs() > b.counters.estimatedMs();
+        return a.name < b.name;
+    });
+}
+
+static double sessionMs() {
+    const auto end = running ? std::chrono::steady_clock::now() : sessionEnd;
+    return std::chrono::duration<double, std::milli>(end - sessionStart).count();
+}
+
+static void printTable(std::ostream &out, const std::string &title, std::vector<Entry> entries, SortKey key, size_t limit) {
+    sortEntries(entries, key);
+
+    out << title << "\n"
+        << std::left << std::setw(48) << "name" << std::right
+        << std::setw(12) << "calls"
+        << std::setw(12) << "est. ms"
+        << std::setw(12) << "avg us"
+        << std::setw(10) << "yields" << "\n";
+
+    size_t rows = 0;
+    for (const Entry &entry : entries) {
+        if (limit != 0 && rows++ >= limit) {
+            out << "  ... and " << (entries.size() - limit) << " more\n";
+            break;
+        }
+        std::string name = entry.name;
+        if (name.size() > 47) name = name.substr(0, 44) + "...";
+        out << std::left << std::setw(48) << name << std::right
+            << std::setw(12) << entry.counters.calls
+            << std::setw(12) << std::fixed << std::setprecision(3) << entry.counters.estimatedMs()
+            << std::setw(12) << std::fixed << std::setprecision(2) << averageUs(entry.counters)
+            << std::setw(10) << entry.counters.yields << "\n";
+    }
+    out << std::defaultfloat;
+}
+
+void dumpText(std::ostream &out, SortKey key, size_t limit) {
+    out << "Profile: " << std::fixed << std::setprecision(1) << sessionMs() << " ms recorded" << std::defaultfloat
+        << ", timing 1 in " << sampleInterval << " calls" << (running ? " (still running)" : "") << "\n"
+        << "Times are inclusive: a block's time contains the reporters and custom blocks it runs.\n\n";
+    printTable(out, "[Opcodes]", mergedOpcodes(), key, limit);
+    out << "\n";
+    printTable(out, "[Scripts]", scripts(), key, limit);
+}
+
+static nlohmann::json entriesToJson(std::vector<Entry> entries) {
+    sortEntries(entries, SortKey::TIME);
+    nlohmann::json out = nlohmann::json::array();
+    for (const Entry &entry : entries) {
+        out.push_back({{"name", entry.name},
+                       {"calls", entry.counters.calls},
+                       {"sampledCalls", entry.counters.sampledCalls},
+                       {"sampledNs", entry.counters.sampledNs},
+                       {"estimatedMs", entry.counters.estimatedMs()},
+                       {"averageUs", averageUs(entry.counters)},
+                       {"yields", entry.counters.yields}});
+    }
+    return out;
+}
+
+nlohmann::json dumpJson() {
+    return {{"durationMs", sessionMs()},
+            {"sampleInterval", sampleInterval},
+            {"running", running},
+            {"opcodes", entriesToJson(mergedOpcodes())},
+            {"scripts", entriesToJson(scripts())}};
+}
+
+} // namespace Profiler
+
+#endif
@@ -0,0 +1,96 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <ostream>
+#include <string>
+
+struct Block;
+struct ScriptThread;
+
+/**
+ * Per-opcode and per-script execution counters for the interpreter.
+ * Only compiled in when the project is configured with `SE_PROFILE`, and only records while started.
+ * Every call is counted, but only every `sampleInterval`th call is timed, so the totals are estimates.
+ */
+namespace Profiler {
+
+struct Counters {
+    uint64_t calls = 0;
+    uint64_t sampledCalls = 0;
+    uint64_t sampledNs = 0;
+    uint64_t yields = 0;
+
+    /**
+     * Estimated inclusive time spent in every call, extrapolated from the sampled calls.
+     */
+    double estimatedMs() const {
+        if (sampledCalls == 0) return 0.0;
+        return static_cast<double>(sampledNs) / 1e6 * (static_cast<double>(calls) / static_cast<double>(sampledCalls));
+    }
+};
+
+struct Sample {
+    bool active = false;
+    bool timed = false;
+    std::chrono::steady_clock::time_point start;
+};
+
+enum class SortKey {
+    TIME,
+    CALLS,
+    AVERAGE,
+    YIELDS
+};
+
+extern bool running;
+extern uint32_t sampleInterval;
+extern uint32_t sampleCounter;
+
+/**
+ * Clears all counters and starts recording.
+ * @param interval Time one call out of every `interval` calls. 1 times every call.
+ */
+void start(uint32_t interval = 16);
+
+/**
+ * Stops recording. Counters are kept until the next `start()`.
+ */
+void stop();
+
+inline Sample beginSample() {
+    Sample sample;
+    if (!running) return sample;
+    sample.active = true;
+    if (++sampleCounter >= sampleInterval) {
+        sampleCounter = 0;
+        sample.timed = true;
+        sample.start = std::chrono::steady_clock::now();
+    }
+    return sample;
+}
+
+/**
+ * Records one call of `block`'s function.
+ */
+void endBlockSample(Block *block, const Sample &sample);
+
+/**
+ * Records one `runThread` call of a top level script.
+ */
+void endScriptSample(ScriptThread *thread, const Sample &sample);
+
+/**
+ * Records that a thread yielded (waited for the next frame) on `block`.
+ */
+void recordYield(Block *block);
+
+/**
+ * Writes a table of opcodes and scripts sorted by `key`.
+ * @param limit Maximum number of rows per table. 0 prints every row.
+ */
+void dumpText(std::ostream &out, SortKey key = SortKey::TIME, size_t limit = 0);
+
+nlohmann::json dumpJson();
+
+} // namespace Profiler
@@ -0,0 +1,657 @@
+#include "projectCache.hpp"
+#include "blockExecutor.hpp"
+#include "parser.hpp"
+#include "runtime.hpp"
+#include "unzip.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem.hpp>
+#include <fstream>
+#include <input.hpp>
+#include <log.hpp>
+#include <os.hpp>
+#include <render.hpp>
+#include <unordered_map>
+#include <vector>
+
+#ifndef SE_BUILD_ID
+#define SE_BUILD_ID __DATE__ " " __TIME__
+#endif
+
+namespace ProjectCache {
+
+static constexpr char MAGIC[4] = {'S', 'E', 'P', 'C'};
+static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+static constexpr uint32_t FORMAT_VERSION = 1;
+static constexpr uint32_t NONE = 0xFFFFFFFF;
+
+enum ValueType : uint8_t {
+    VALUE_DOUBLE,
+    VALUE_STRING,
+    VALUE_BOOL,
+    VALUE_COLOR,
+    VALUE_UNDEFINED,
+};
+
+static std::string cachePath(const Key &key) {
+    char name[48];
+    snprintf(name, sizeof(name), "%08x-%llx.bin", key.crc, static_cast<unsigned long long>(key.size));
+    return OS::getScratchFolderLocation() + "cache/" + name;
+}
+
+bool enabled() {
+    auto setting = Unzip::getSetting("projectCache");
+    return !setting.is_boolean() || setting.get<bool>();
+}
+
+class Writer {
+  public:
+    std::string data;
+
+    template <typename T>
+    void raw(const T &val) {
+        data.append(reinterpret_cast<const char *>(&val), sizeof(T));
+    }
+
+    void u8(uint8_t val) { raw(val); }
+    void u32(uint32_t val) { raw(val); }
+    void i32(int32_t val) { raw(val); }
+
+    void string(const std::string &str) {
+        auto it = stringIndices.find(str);
+        if (it == stringIndices.end()) {
+            it = stringIndices.emplace(str, static_cast<uint32_t>(strings.size())).first;
+            strings.push_back(&it->first);
+        }
+        u32(it->second);
+    }
+
+    void optionalString(const std::string *str) {
+        if (str == nullptr) u32(NONE);
+        else string(*str);
+    }
+
+    void value(const Value &val) {
+        if (val.isDouble()) {
+            u8(VALUE_DOUBLE);
+            raw(val.asDouble());
+        } else if (val.isBoolean()) {
+            u8(VALUE_BOOL);
+            u8(val.asBoolean());
+        } else if (val.isColor()) {
+            u8(VALUE_COLOR);
+            raw(val.asColor());
+        } else if (val.isUndefined()) {
+            u8(VALUE_UNDEFINED);
+        } else {
+            u8(VALUE_STRING);
+            string(val.asString());
+        }
+    }
+
+    void stringTable(std::string &out) const {
+        const uint32_t count = static_cast<uint32_t>(strings.size());
+        out.append(reinterpret_cast<const char *>(&count), sizeof(count));
+        for (const std::string *str : strings) {
+            const uint32_t size = static_cast<uint32_t>(str->size());
+            out.append(reinterpret_cast<const char *>(&size), sizeof(size));
+            out.append(*str);
+        }
+    }
+
+  private:
+    std::unordered_map<std::string, uint32_t> stringIndices;
+    std::vector<const std::string *> strings;
+};
+
+class Reader {
+  public:
+    Reader(const char *data, size_t size) : pos(data), end(data + size) {}
+
+    bool ok = true;
+
+    template <typename T>
+    T raw() {
+        T val{};
+        if (static_cast<size_t>(end - pos) < sizeof(T)) {
+            ok = false;
+            return val;
+        }
+        memcpy(&val, pos, sizeof(T));
+        pos += sizeof(T);
+        return val;
+    }
+
+    uint8_t u8() { return raw<uint8_t>(); }
+    uint32_t u32() { return raw<uint32_t>(); }
+    int32_t i32() { return raw<int32_t>(); }
+
+    std::string bytes(uint32_t size) {
+        if (static_cast<size_t>(end - pos) < size) {
+            ok = false;
+            return {};
+        }
+        std::string str(pos, size);
+        pos += size;
+        return str;
+    }
+
+    bool stringTable() {
+        const uint32_t count = u32();
+        if (!ok || count > static_cast<size_t>(end - pos) / sizeof(uint32_t)) return ok = false;
+        strings.reserve(count);
+        for (uint32_t i = 0; i < count && ok; i++) {
+            strings.push_back(bytes(u32()));
+        }
+        return ok;
+    }
+
+    const std::string &string() {
+        static const std::string empty;
+        const uint32_t index = u32();
+        if (index >= strings.size()) {
+            ok = false;
+            return empty;
+        }
+        return strings[index];
+    }
+
+    const std::string *optionalString() {
+        const uint32_t index = u32();
+        if (index == NONE) return nullptr;
+        if (index >= strings.size()) {
+            ok = false;
+            return nullptr;
+        }
+        return &strings[index];
+    }
+
+    Value value() {
+        switch (u8()) {
+        case VALUE_DOUBLE:
+            return Value(raw<double>());
+        case VALUE_STRING:
+            return Value(string());
+        case VALUE_BOOL:
+            return Value(u8() != 0);
+        case VALUE_COLOR:
+            return Value(raw<Color>());
+        case VALUE_UNDEFINED:
+            return Value(Undefined{});
+        default:
+            ok = false;
+            return Value();
+        }
+    }
+
+    // Reads an element count, rejecting counts that can't possibly fit in the rest of the file.
+    uint32_t count() {
+        const uint32_t val = u32();
+        if (val > static_cast<size_t>(end - pos)) ok = false;
+        return ok ? val : 0;
+    }
+
+  private:
+    const char *pos;
+    const char *end;
+    std::vector<std::string> strings;
+};
+
+static void writeBlock(Writer &out, const Block *block, const std::unordered_map<const Block *, int32_t> &indices) {
+    const auto &indexOf = [&indices](const Block *target) -> int32_t {
+        if (target == nullptr) return -1;
+        auto it = indices.find(target);
+        return it != indices.end() ? it->second : -1;
+    };
+
+    auto handler = Parser::handlerNames.find(block);
+    out.string(block->opcode);
+    out.optionalString(handler != Parser::handlerNames.end() ? handler->second : nullptr);
+    out.i32(indexOf(block->nextBlock));
+    out.i32(indexOf(block->MyBlockDefinitionID));
+    out.u8(block->MyBlockWithoutScreenRefresh | block->hasReturnValue << 1 | block->isEndBlock << 2 | block->shadow << 3);
+
+    out.u32(block->argumentIDs.size());
+    for (const std::string &id : block->argumentIDs)
+        out.string(id);
+    out.u32(block->argumentNames.size());
+    for (const std::string &name : block->argumentNames)
+        out.string(name);
+    out.u32(block->argumentDefaults.size());
+    for (const Value &val : block->argumentDefaults)
+        out.value(val);
+
+    out.u32(block->inputs.size());
+    for (const auto &[name, input] : block->inputs) {
+        out.string(name);
+        out.u8(input.inputType);
+        out.value(input.value);
+        out.i32(indexOf(input.block));
+        out.string(input.variableId);
+        out.u8(input.list);
+    }
+    out.u32(block->fields.size());
+    for (const auto &[name, field] : block->fields) {
+        out.string(name);
+        out.string(field.value);
+        out.string(field.id);
+    }
+}
+
+static void readBlock(Reader &in, Block *block, const std::vector<Block *> &blocks, const std::string *&handler) {
+    const auto &blockAt = [&in, &blocks](int32_t index) -> Block * {
+        if (index < 0) return nullptr;
+        if (static_cast<size_t>(index) >= blocks.size()) {
+            in.ok = false;
+            return nullptr;
+        }
+        return blocks[index];
+    };
+
+    block->opcode = in.string();
+    handler = in.optionalString();
+    block->nextBlock = blockAt(in.i32());
+    block->MyBlockDefinitionID = blockAt(in.i32());
+    const uint8_t flags = in.u8();
+    block->MyBlockWithoutScreenRefresh = flags & 1;
+    block->hasReturnValue = flags & 2;
+    block->isEndBlock = flags & 4;
+    block->shadow = flags & 8;
+
+    block->argumentIDs.resize(in.count());
+    for (std::string &id : block->argumentIDs)
+        id = in.string();
+    block->argumentNames.resize(in.count());
+    for (std::string &name : block->argumentNames)
+        name = in.string();
+    block->argumentDefaults.resize(in.count());
+    for (Value &val : block->argumentDefaults)
+        val = in.value();
+
+    block->inputs.resize(in.count());
+    for (auto &[name, input] : block->inputs) {
+        name = in.string();
+        input.inputType = static_cast<ParsedInput::InputType>(in.u8());
+        input.value = in.value();
+        input.block = blockAt(in.i32());
+        input.variableId = in.string();
+        input.list = in.u8() != 0;
+    }
+    block->fields.resize(in.count());
+    for (auto &[name, field] : block->fields) {
+        name = in.string();
+        field.value = in.string();
+        field.id = in.string();
+    }
+}
+
+static void writeSprite(Writer &out, Sprite *sprite, const std::unordered_map<const Block *, int32_t> &indices) {
+    out.string(sprite->name);
+    out.u8(sprite->isStage | sprite->draggable << 1 | sprite->visible << 2 | sprite->shouldDoSpriteClick << 3);
+    out.i32(sprite->currentCostume);
+    out.raw(sprite->xPosition);
+    out.raw(sprite->yPosition);
+    out.raw(sprite->size);
+    out.raw(sprite->rotation);
+    out.i32(Scratch::getLayer(sprite));
+    out.u8(sprite->rotationStyle);
+    out.raw(sprite->volume);
+
+    out.u32(sprite->variables.size());
+    for (const auto &[id, variable] : sprite->variables) {
+        out.string(id);
+        out.string(variable.name);
+        out.value(variable.value);
+#ifdef ENABLE_CLOUDVARS
+        out.u8(variable.cloud);
+#else
+        out.u8(0);
+#endif
+    }
+
+    out.u32(sprite->lists.size());
+    for (const auto &[id, list] : sprite->lists) {
+        out.string(id);
+        out.string(list.name);
+        out.u32(list.items.size());
+        for (const Value &item : list.items)
+            out.value(item);
+    }
+
+    out.u32(sprite->sounds.size());
+    for (const Sound &sound : sprite->sounds) {
+        out.string(sound.id);
+        out.string(sound.name);
+        out.string(sound.dataFormat);
+        out.string(sound.fullName);
+        out.i32(sound.sampleRate);
+        out.i32(sound.sampleCount);
+    }
+
+    out.u32(sprite->costumes.size());
+    for (const Costume &costume : sprite->costumes) {
+        out.string(costume.id);
+        out.string(costume.name);
+        out.string(costume.fullName);
+        out.string(costume.dataFormat);
+        out.i32(costume.bitmapResolution);
+        out.u8(costume.isSVG);
+        out.raw(costume.rotationCenterX);
+        out.raw(costume.rotationCenterY);
+    }
+
+    out.u32(sprite->broadcasts.size());
+    for (const auto &[id, broadcast] : sprite->broadcasts) {
+        out.string(id);
+        out.string(broadcast.name);
+    }
+
+    out.u32(sprite->hats.size());
+    for (const auto &[opcode, hats] : sprite->hats) {
+        out.string(opcode);
+        out.u32(hats.size());
+        for (const Block *hat : hats)
+            out.i32(indices.at(hat));
+    }
+
+    out.u32(sprite->customHatBlock.size());
+    for (const auto &[proccode, block] : sprite->customHatBlock) {
+        out.string(proccode);
+        out.i32(indices.at(block));
+    }
+}
+
+static void readSprite(Reader &in, Sprite *sprite, const std::vector<Block *> &blocks, size_t firstCustomHat, std::vector<bool> &ownedHats) {
+    const auto &blockAt = [&in, &blocks](int32_t index) -> Block * {
+        if (index < 0 || static_cast<size_t>(index) >= blocks.size()) {
+            in.ok = false;
+            return nullptr;
+        }
+        return blocks[index];
+    };
+
+    sprite->name = in.string();
+    const uint8_t flags = in.u8();
+    sprite->isStage = flags & 1;
+    sprite->draggable = flags & 2;
+    sprite->visible = flags & 4;
+    sprite->shouldDoSpriteClick = flags & 8;
+    sprite->isClone = false;
+    sprite->currentCostume = in.i32();
+    sprite->xPosition = in.raw<float>();
+    sprite->yPosition = in.raw<float>();
+    sprite->size = in.raw<float>();
+    sprite->rotation = in.raw<float>();
+    sprite->layer = in.i32();
+    sprite->rotationStyle = static_cast<Sprite::RotationStyle>(in.u8());
+    sprite->volume = in.raw<float>();
+
+    for (uint32_t i = in.count(); i > 0 && in.ok; i--) {
+        Variable variable;
+        variable.id = in.string();
+        variable.name = in.string();
+        variable.value = in.value();
+        const bool cloud = in.u8() != 0;
+#ifdef ENABLE_CLOUDVARS
+        variable.cloud = cloud;
+        Scratch::cloudProject = Scratch::cloudProject || cloud;
+#else
+        (void)cloud;
+#endif
+        sprite->variables[variable.id] = std::move(variable);
+    }
+
+    for (uint32_t i = in.count(); i > 0 && in.ok; i--) {
+        const std::string &id = in.string();
+        List &list = sprite->lists[id];
+        list.id = id;
+        list.name = in.string();
+        list.items.resize(in.count());
+        for (Value &item : list.items)
+            item = in.value();
+    }
+
+    sprite->sounds.resize(in.count());
+    for (Sound &sound : sprite->sounds) {
+        sound.id = in.string();
+        sound.name = in.string();
+        sound.dataFormat = in.string();
+        sound.fullName = in.string();
+        sound.sampleRate = in.i32();
+        sound.sampleCount = in.i32();
+    }
+
+    sprite->costumes.resize(in.count());
+    for (Costume &costume : sprite->costumes) {
+        costume.id = in.string();
+        costume.name = in.string();
+        costume.fullName = in.string();
+        costume.dataFormat = in.string();
+        costume.bitmapResolution = in.i32();
+        costume.isSVG = in.u8() != 0;
+        costume.rotationCenterX = in.raw<double>();
+        costume.rotationCenterY = in.raw<double>();
+    }
+
+    for (uint32_t i = in.count(); i > 0 && in.ok; i--) {
+        Broadcast broadcast;
+        broadcast.id = in.string();
+        broadcast.name = in.string();
+        sprite->broadcasts[broadcast.id] = broadcast;
+    }
+
+    for (uint32_t i = in.count(); i > 0 && in.ok; i--) {
+        auto &hats = sprite->hats[in.string()];
+        for (uint32_t j = in.count(); j > 0 && in.ok; j--) {
+            Block *hat = blockAt(in.i32());
+            if (hat != nullptr) hats.insert(hat);
+        }
+    }
+
+    for (uint32_t i = in.count(); i > 0 && in.ok; i--) {
+        const std::string &proccode = in.string();
+        const int32_t index = in.i32();
+        // custom block definitions are owned by their sprite, every one of them has to be claimed exactly once
+        if (index < 0 || static_cast<size_t>(index) < firstCustomHat || static_cast<size_t>(index) >= blocks.size() || ownedHats[index - firstCustomHat]) {
+            in.ok = false;
+            break;
+        }
+        ownedHats[index - firstCustomHat] = true;
+        sprite->customHatBlock[proccode] = blocks[index];
+    }
+}
+
+static void writeMonitor(Writer &out, const Monitor &monitor) {
+    out.string(monitor.id);
+    out.string(monitor.mode);
+    out.string(monitor.opcode);
+    out.u32(monitor.parameters.size());
+    for (const auto &[key, val] : monitor.parameters) {
+        out.string(key);
+        out.string(val);
+    }
+    out.string(monitor.spriteName);
+    out.value(monitor.value);
+    out.i32(monitor.x);
+    out.i32(monitor.y);
+    out.i32(monitor.width);
+    out.i32(monitor.height);
+    out.u8(monitor.visible | monitor.isDiscrete << 1);
+    out.raw(monitor.sliderMin);
+    out.raw(monitor.sliderMax);
+}
+
+static Monitor readMonitor(Reader &in) {
+    Monitor monitor;
+    monitor.id = in.string();
+    monitor.mode = in.string();
+    monitor.opcode = in.string();
+    for (uint32_t i = in.count(); i > 0 && in.ok; i--) {
+        const std::string &key = in.string();
+        monitor.parameters[key] = in.string();
+    }
+    monitor.spriteName = in.string();
+    monitor.value = in.value();
+    monitor.x = in.i32();
+    monitor.y = in.i32();
+    monitor.width = in.i32();
+    monitor.height = in.i32();
+    const uint8_t flags = in.u8();
+    monitor.visible = flags & 1;
+    monitor.isDiscrete = flags & 2;
+    monitor.sliderMin = in.raw<double>();
+    monitor.sliderMax = in.raw<double>();
+    return monitor;
+}
+
+static void writeHeader(std::string &out, const Key &key) {
+    const std::string buildId = SE_BUILD_ID;
+    const uint32_t buildIdSize = static_cast<uint32_t>(buildId.size());
+    out.append(MAGIC, sizeof(MAGIC));
+    out.append(reinterpret_cast<const char *>(&BYTE_ORDER_MARK), sizeof(BYTE_ORDER_MARK));
+    out.append(reinterpret_cast<const char *>(&FORMAT_VERSION), sizeof(FORMAT_VERSION));
+    out.append(reinterpret_cast<const char *>(&buildIdSize), sizeof(buildIdSize));
+    out.append(buildId);
+    out.append(reinterpret_cast<const char *>(&key.crc), sizeof(key.crc));
+    out.append(reinterpret_cast<const char *>(&key.size), sizeof(key.size));
+}
+
+nonstd::expected<void, std::string> save(const Key &key, const ProjectData &project) {
+    // custom block definitions aren't in Scratch::blocks, they go after it
+    std::unordered_map<const Block *, int32_t> indices;
+    std::vector<const Block *> blocks(Scratch::blocks.begin(), Scratch::blocks.end());
+    for (const Block *block : blocks)
+        indices.emplace(block, static_cast<int32_t>(indices.size()));
+    const size_t blockCount = blocks.size();
+    for (const Sprite *sprite : Scratch::sprites) {
+        for (const auto &[proccode, block] : sprite->customHatBlock) {
+            if (indices.emplace(block, static_cast<int32_t>(blocks.size())).second) blocks.push_back(block);
+        }
+    }
+
+    Writer body;
+    body.string(project.extensions.is_array() ? project.extensions.dump() : "[]");
+    body.u8(project.stageSettings.has_value());
+    body.string(project.stageSettings.has_value() ? project.stageSettings->dump() : "");
+
+    body.u32(blockCount);
+    body.u32(blocks.size() - blockCount);
+    for (const Block *block : blocks)
+        writeBlock(body, block, indices);
+
+    body.u32(Scratch::sprites.size());
+    for (Sprite *sprite : Scratch::sprites)
+        writeSprite(body, sprite, indices);
+
+    body.u8(project.monitors.is_array());
+    body.u32(Render::monitors.size());
+    for (const auto &[id, monitor] : Render::monitors)
+        writeMonitor(body, monitor);
+
+    std::string file;
+    writeHeader(file, key);
+    body.stringTable(file);
+    file.append(body.data);
+
+    const std::string path = cachePath(key);
+    auto created = FileSystem::createDirectory(FileSystem::parentPath(path) + "/");
+    if (!created.has_value()) return nonstd::make_unexpected(created.error());
+
+    // write to a temporary file first so an interrupted write never leaves a truncated cache behind
+    const std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out) return nonstd::make_unexpected("Failed to open " + tempPath + " for writing.");
+    out.write(file.data(), static_cast<std::streamsize>(file.size()));
+    out.close();
+    if (!out) return nonstd::make_unexpected("Failed to write " + tempPath);
+    remove(path.c_str());
+    FileSystem::renameFile(tempPath, path);
+
+    Log::log("Wrote project cache to " + path);
+    return {};
+}
+
+nonstd::expected<void, std::string> load(const Key &key) {
+    const std::string path = cachePath(key);
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return nonstd::make_unexpected("No project cache at " + path);
+
+    std::vector<char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0, std::ios::beg);
+    if (!file.read(data.data(), static_cast<std::streamsize>(data.size()))) return nonstd::make_unexpected("Failed to read " + path);
+    file.close();
+
+    Reader in(data.data(), data.size());
+    char magic[sizeof(MAGIC)];
+    for (char &c : magic)
+        c = static_cast<char>(in.u8());
+    if (!in.ok || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) return nonstd::make_unexpected("Not a project cache: " + path);
+    if (in.u32() != BYTE_ORDER_MARK || in.u32() != FORMAT_VERSION) return nonstd::make_unexpected("Project cache was written in a different format.");
+    if (in.bytes(in.u32()) != SE_BUILD_ID) return nonstd::make_unexpected("Project cache was written by a different build.");
+    const uint32_t crc = in.u32();
+    const uint64_t size = in.raw<uint64_t>();
+    if (!in.ok || crc != key.crc || size != key.size) return nonstd::make_unexpected("Project cache is for a different project.json.");
+    if (!in.stringTable()) return nonstd::make_unexpected("Project cache is truncated.");
+
+    const std::string extensions = in.string();
+    const bool hasSettings = in.u8() != 0;
+    const std::string settings = in.string();
+
+    // allocate every block first so references can be fixed up while reading
+    const uint32_t blockCount = in.count();
+    const uint32_t customHatCount = in.count();
+    std::vector<Block *> blocks;
+    std::vector<const std::string *> handlers(in.ok ? blockCount + customHatCount : 0, nullptr);
+    blocks.reserve(handlers.size());
+    for (size_t i = 0; i < handlers.size(); i++)
+        blocks.push_back(new Block());
+    for (size_t i = 0; i < blocks.size() && in.ok; i++)
+        readBlock(in, blocks[i], blocks, handlers[i]);
+
+    std::vector<Sprite *> sprites;
+    std::vector<bool> ownedHats(customHatCount, false);
+    for (uint32_t i = in.count(); i > 0 && in.ok; i--) {
+        sprites.push_back(new Sprite());
+        readSprite(in, sprites.back(), blocks, blockCount, ownedHats);
+    }
+
+    const bool hasMonitors = in.u8() != 0;
+    std::vector<Monitor> monitors;
+    for (uint32_t i = in.count(); i > 0 && in.ok; i--)
+        monitors.push_back(readMonitor(in));
+
+    const bool allHatsOwned = std::find(ownedHats.begin(), ownedHats.end(), false) == ownedHats.end();
+    nlohmann::json extensionList = nlohmann::json::parse(extensions, nullptr, false);
+    nlohmann::json config = hasSettings ? nlohmann::json::parse(settings, nullptr, false) : nlohmann::json();
+    if (!in.ok || !allHatsOwned || extensionList.is_discarded() || config.is_discarded()) {
+        // sprites delete the custom block definitions they claimed
+        for (size_t i = 0; i < blockCount; i++)
+            delete blocks[i];
+        for (size_t i = 0; i < customHatCount; i++) {
+            if (!ownedHats[i]) delete blocks[blockCount + i];
+        }
+        for (Sprite *sprite : sprites)
+            delete sprite;
+        return nonstd::make_unexpected("Project cache is corrupted: " + path);
+    }
+
+    Scratch::hasNativeExtensions = Parser::loadExtensions(extensionList);
+    auto &handlerMap = BlockExecutor::getHandlers();
+    for (size_t i = 0; i < blocks.size(); i++) {
+        if (handlers[i] != nullptr) blocks[i]->blockFunction = handlerMap[*handlers[i]];
+    }
+    if (hasSettings) Parser::applyAdvancedProjectSettings(config);
+
+    Scratch::blocks.insert(Scratch::blocks.end(), blocks.begin(), blocks.begin() + blockCount);
+    Scratch::setSprites(std::move(sprites));
+
+    for (Monitor &monitor : monitors)
+        Render::monitors.emplace(monitor.id, monitor);
+    if (hasMonitors) Input::applyControls(Unzip::filePath + ".json");
+
+    Log::log("Loaded project from cache " + path);
+    return {};
+}
+
+} // namespace ProjectCache
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <nonstd/expected.hpp>
+#include <projectReader.hpp>
+#include <string>
+
+/**
+ * Stores the fully linked runtime graph of a project (blocks, sprites with their variables, lists and hats, and
+ * monitors) in a binary file, so later launches can skip parsing and linking project.json.
+ *
+ * Cache files live in the `cache/` folder of the Scratch Everywhere! folder, and are only used when both the CRC-32
+ * and size of project.json and the runtime's build ID match. Disable it per project with the `projectCache` setting.
+ */
+namespace ProjectCache {
+
+/**
+ * Identifies a project.json.
+ */
+struct Key {
+    uint32_t crc = 0;
+    uint64_t size = 0;
+};
+
+/**
+ * Whether the current project may use the cache.
+ */
+bool enabled();
+
+/**
+ * Loads the project cached for `key` into the runtime, loading its extensions and applying its settings too.
+ * Nothing is loaded if there is no usable cache file.
+ */
+nonstd::expected<void, std::string> load(const Key &key);
+
+/**
+ * Writes the project that was just loaded from `project` to the cache.
+ * Should be called right after `Parser::loadSprites`.
+ */
+nonstd::expected<void, std::string> save(const Key &key, const ProjectData &project);
+
+} // namespace ProjectCache
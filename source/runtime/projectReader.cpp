@@ -0,0 +1,475 @@
+#include "projectReader.hpp"
+#include <algorithm>
+#include <runtime.hpp>
+
+int32_t BlockTable::indexOf(const std::string &id) {
+    auto it = indices.find(id);
+    if (it != indices.end()) return it->second;
+
+    const int32_t index = static_cast<int32_t>(blocks.size());
+    it = indices.emplace(id, index).first;
+    blocks.emplace_back();
+    blocks.back().id = &it->first;
+    return index;
+}
+
+const RawBlock *BlockTable::find(int32_t index) const {
+    if (index < 0 || static_cast<size_t>(index) >= blocks.size()) return nullptr;
+    const RawBlock &block = blocks[index];
+    if (!block.defined || block.opcode == nullptr) return nullptr;
+    return &block;
+}
+
+nonstd::expected<void, std::string> ProjectReader::read(const char *data, size_t size, ProjectData &out) {
+    ProjectReader reader(out);
+    bool success = false;
+    try {
+        success = nlohmann::json::sax_parse(data, data + size, &reader);
+        if (!success && reader.error.empty()) reader.error = "Unexpected end of project.json";
+    } catch (const nlohmann::json::exception &e) {
+        reader.error = e.what();
+    }
+
+    if (!success) {
+        for (ProjectTarget &target : out.targets) {
+            delete target.sprite;
+        }
+        out.targets.clear();
+        return nonstd::make_unexpected(reader.error);
+    }
+    return {};
+}
+
+const std::string *ProjectReader::intern(const std::string &str) {
+    return &*out.strings.insert(str).first;
+}
+
+bool ProjectReader::null() {
+    return value(nullptr);
+}
+
+bool ProjectReader::boolean(bool val) {
+    return value(val);
+}
+
+bool ProjectReader::number_integer(nlohmann::json::number_integer_t val) {
+    return value(val);
+}
+
+bool ProjectReader::number_unsigned(nlohmann::json::number_unsigned_t val) {
+    return value(val);
+}
+
+bool ProjectReader::number_float(nlohmann::json::number_float_t val, const std::string &s) {
+    return value(val);
+}
+
+bool ProjectReader::string(std::string &val) {
+    return value(std::move(val));
+}
+
+bool ProjectReader::binary(nlohmann::json::binary_t &val) {
+    return value(nullptr);
+}
+
+bool ProjectReader::key(std::string &val) {
+    currentKey = std::move(val);
+    return true;
+}
+
+bool ProjectReader::start_object(std::size_t elements) {
+    return start(true);
+}
+
+bool ProjectReader::end_object() {
+    return end();
+}
+
+bool ProjectReader::start_array(std::size_t elements) {
+    return start(false);
+}
+
+bool ProjectReader::end_array() {
+    return end();
+}
+
+bool ProjectReader::parse_error(std::size_t position, const std::string &lastToken, const nlohmann::detail::exception &ex) {
+    error = ex.what();
+    return false;
+}
+
+static nlohmann::json *insertInto(nlohmann::json *parent, const std::string &key, nlohmann::json &&val) {
+    if (parent->is_object()) {
+        nlohmann::json &slot = (*parent)[key];
+        slot = std::move(val);
+        return &slot;
+    }
+    parent->push_back(std::move(val));
+    return &parent->back();
+}
+
+bool ProjectReader::value(nlohmann::json &&val) {
+    if (skipDepth > 0) return true;
+    if (!captureStack.empty()) {
+        insertInto(captureStack.back(), currentKey, std::move(val));
+        return true;
+    }
+    if (stack.empty()) return true;
+
+    Frame &frame = stack.back();
+    const size_t index = frame.index++;
+
+    switch (frame.context) {
+    case Context::TARGET:
+        setTargetProperty(currentKey, val);
+        break;
+    case Context::VARIABLE:
+        if (index == 0) variable.name = val.get<std::string>();
+        else if (index == 1) variable.value = Value::fromJson(val);
+        break;
+    case Context::LIST:
+        if (index == 0) list->name = val.get<std::string>();
+        break;
+    case Context::LIST_ITEMS:
+        list->items.push_back(Value::fromJson(val));
+        break;
+    case Context::BROADCASTS: {
+        Broadcast newBroadcast;
+        newBroadcast.id = currentKey;
+        newBroadcast.name = val.get<std::string>();
+        target().sprite->broadcasts[newBroadcast.id] = newBroadcast;
+        break;
+    }
+    case Context::BLOCK:
+        if (currentKey == "opcode") {
+            currentBlock().opcode = intern(val.get<std::string>());
+        } else if (currentKey == "next") {
+            // indexOf can grow the table, so don't hold on to the current block across it
+            const int32_t next = val.is_string() ? target().blocks.indexOf(val.get<std::string>()) : -1;
+            currentBlock().next = next;
+        } else if (currentKey == "topLevel") {
+            currentBlock().topLevel = val.is_boolean() && val.get<bool>();
+        } else if (currentKey == "shadow") {
+            currentBlock().shadow = val.is_boolean() && val.get<bool>();
+        }
+        break;
+    case Context::INPUT:
+        if (index == 0) {
+            currentBlock().inputs.back().type = val.get<int>();
+        } else if (index == 1 && val.is_string()) {
+            const int32_t block = target().blocks.indexOf(val.get<std::string>());
+            currentBlock().inputs.back().block = block;
+        }
+        break;
+    case Context::PRIMITIVE: {
+        RawInput &input = currentBlock().inputs.back();
+        if (index == 0) input.primitiveType = val.get<int>();
+        else if (index == 1) input.value = Value::fromJson(val);
+        else if (index == 2 && val.is_string()) input.primitiveId = val.get<std::string>();
+        break;
+    }
+    case Context::FIELD: {
+        RawField &field = currentBlock().fields.back();
+        if (index == 0) field.value = val.is_string() ? val.get<std::string>() : val.dump();
+        else if (index == 1 && !val.is_null()) field.id = val.get<std::string>();
+        break;
+    }
+    case Context::MUTATION: {
+        RawMutation &mutation = *currentBlock().mutation;
+        if (currentKey == "tagName") {
+            mutation.tagName = val.get<std::string>();
+        } else if (currentKey == "proccode") {
+            mutation.proccode = val.get<std::string>();
+        } else if (currentKey == "argumentids") {
+            mutation.argumentIds = val.get<std::string>();
+            mutation.hasArgumentIds = true;
+        } else if (currentKey == "argumentnames") {
+            mutation.argumentNames = val.get<std::string>();
+            mutation.hasArgumentNames = true;
+        } else if (currentKey == "argumentdefaults") {
+            mutation.argumentDefaults = val.get<std::string>();
+            mutation.hasArgumentDefaults = true;
+        } else if (currentKey == "warp") {
+            mutation.warp = (val.is_string() && val.get<std::string>() == "true") || (val.is_boolean() && val.get<bool>());
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return true;
+}
+
+bool ProjectReader::start(bool object) {
+    if (skipDepth > 0) {
+        skipDepth++;
+        return true;
+    }
+    if (!captureStack.empty()) {
+        captureStack.push_back(insertInto(captureStack.back(), currentKey, object ? nlohmann::json::object() : nlohmann::json::array()));
+        return true;
+    }
+    if (stack.empty()) {
+        if (object) stack.push_back({Context::ROOT});
+        else skipDepth = 1;
+        return true;
+    }
+
+    Frame &frame = stack.back();
+    const size_t index = frame.index++;
+    const auto push = [this](Context context) {
+        stack.push_back({context});
+        return true;
+    };
+    const auto startCapture = [this](bool object) {
+        capture = object ? nlohmann::json::object() : nlohmann::json::array();
+        captureStack.push_back(&capture);
+        captureKey = currentKey;
+        return true;
+    };
+
+    switch (frame.context) {
+    case Context::ROOT:
+        if (currentKey == "targets" && !object) return push(Context::TARGETS);
+        if (currentKey == "monitors" || currentKey == "extensions") return startCapture(object);
+        break;
+    case Context::TARGETS:
+        if (object) {
+            out.targets.emplace_back();
+            Sprite *newSprite = new Sprite();
+            newSprite->visible = true;
+            newSprite->size = 100;
+            newSprite->rotation = 90;
+            newSprite->layer = 0;
+            newSprite->isClone = false;
+            target().sprite = newSprite;
+            return push(Context::TARGET);
+        }
+        break;
+    case Context::TARGET:
+        if (object) {
+            if (currentKey == "variables") return push(Context::VARIABLES);
+            if (currentKey == "lists") return push(Context::LISTS);
+            if (currentKey == "broadcasts") return push(Context::BROADCASTS);
+            if (currentKey == "blocks") return push(Context::BLOCKS);
+            if (currentKey == "comments") return startCapture(object);
+        } else {
+            if (currentKey == "costumes") return push(Context::COSTUMES);
+            if (currentKey == "sounds") return push(Context::SOUNDS);
+        }
+        break;
+    case Context::VARIABLES:
+        if (!object) {
+            variable = Variable();
+            variable.id = currentKey;
+            return push(Context::VARIABLE);
+        }
+        break;
+    case Context::LISTS:
+        if (!object) {
+            list = &target().sprite->lists.try_emplace(currentKey).first->second;
+            list->id = currentKey;
+            list->items.clear();
+            return push(Context::LIST);
+        }
+        break;
+    case Context::LIST:
+        if (index == 1 && !object) return push(Context::LIST_ITEMS);
+        break;
+    case Context::LIST_ITEMS:
+        return startCapture(object);
+    case Context::COSTUMES:
+    case Context::SOUNDS:
+        if (object) return startCapture(object);
+        break;
+    case Context::BLOCKS:
+        // top level variable and list reporters are stored as arrays, nothing references them by ID
+        if (object) {
+            blockIndex = target().blocks.indexOf(currentKey);
+            RawBlock &block = currentBlock();
+            block = RawBlock{block.id};
+            block.defined = true;
+            return push(Context::BLOCK);
+        }
+        break;
+    case Context::BLOCK:
+        if (object) {
+            if (currentKey == "inputs") return push(Context::INPUTS);
+            if (currentKey == "fields") return push(Context::FIELDS);
+            if (currentKey == "mutation") {
+                currentBlock().mutation = std::make_unique<RawMutation>();
+                return push(Context::MUTATION);
+            }
+        }
+        break;
+    case Context::INPUTS:
+        if (!object) {
+            RawInput &input = currentBlock().inputs.emplace_back();
+            input.name = intern(currentKey);
+            return push(Context::INPUT);
+        }
+        break;
+    case Context::INPUT:
+        if (index == 1 && !object) {
+            RawInput &input = currentBlock().inputs.back();
+            input.primitive = true;
+            input.value = Value(0);
+            return push(Context::PRIMITIVE);
+        }
+        break;
+    case Context::FIELDS:
+        if (!object) {
+            RawField &field = currentBlock().fields.emplace_back();
+            field.name = intern(currentKey);
+            return push(Context::FIELD);
+        }
+        break;
+    default:
+        break;
+    }
+
+    skipDepth = 1;
+    return true;
+}
+
+bool ProjectReader::end() {
+    if (skipDepth > 0) {
+        skipDepth--;
+        return true;
+    }
+    if (!captureStack.empty()) {
+        captureStack.pop_back();
+        if (captureStack.empty()) captured(std::move(capture));
+        return true;
+    }
+    if (stack.empty()) return true;
+
+    const Frame frame = stack.back();
+    stack.pop_back();
+
+    switch (frame.context) {
+    case Context::TARGET:
+        finishTarget();
+        break;
+    case Context::VARIABLE:
+#ifdef ENABLE_CLOUDVARS
+        variable.cloud = frame.index == 3;
+        Scratch::cloudProject = Scratch::cloudProject || variable.cloud;
+#endif
+        target().sprite->variables[variable.id] = std::move(variable);
+        break;
+    case Context::BLOCK: {
+        // keep inputs and fields in the order a parsed JSON object would iterate them
+        RawBlock &block = currentBlock();
+        std::stable_sort(block.inputs.begin(), block.inputs.end(), [](const RawInput &a, const RawInput &b) { return *a.name < *b.name; });
+        std::stable_sort(block.fields.begin(), block.fields.end(), [](const RawField &a, const RawField &b) { return *a.name < *b.name; });
+        blockIndex = -1;
+        break;
+    }
+    default:
+        break;
+    }
+    return true;
+}
+
+void ProjectReader::captured(nlohmann::json &&val) {
+    switch (stack.back().context) {
+    case Context::ROOT:
+        if (captureKey == "monitors") out.monitors = std::move(val);
+        else if (captureKey == "extensions") out.extensions = std::move(val);
+        break;
+    case Context::TARGET:
+        target().comments = std::move(val);
+        break;
+    case Context::LIST_ITEMS:
+        list->items.push_back(Value::fromJson(val));
+        break;
+    case Context::COSTUMES:
+        loadCostume(val);
+        break;
+    case Context::SOUNDS:
+        loadSound(val);
+        break;
+    default:
+        break;
+    }
+}
+
+void ProjectReader::setTargetProperty(const std::string &name, const nlohmann::json &val) {
+    Sprite *newSprite = target().sprite;
+
+    if (name == "name") {
+        newSprite->name = val.get<std::string>();
+    } else if (name == "isStage") {
+        newSprite->isStage = val.get<bool>();
+    } else if (name == "draggable") {
+        newSprite->draggable = val.get<bool>();
+    } else if (name == "visible") {
+        newSprite->visible = val.get<bool>();
+    } else if (name == "currentCostume") {
+        newSprite->currentCostume = val.get<int>();
+    } else if (name == "volume") {
+        newSprite->volume = val.get<int>();
+    } else if (name == "x") {
+        newSprite->xPosition = val.get<float>();
+    } else if (name == "y") {
+        newSprite->yPosition = val.get<float>();
+    } else if (name == "size") {
+        newSprite->size = val.get<float>();
+    } else if (name == "direction") {
+        newSprite->rotation = val.get<float>();
+    } else if (name == "layerOrder") {
+        newSprite->layer = val.get<int>();
+    } else if (name == "rotationStyle") {
+        std::string style = val.get<std::string>();
+        if (style == "all around")
+            newSprite->rotationStyle = newSprite->ALL_AROUND;
+        else if (style == "left-right")
+            newSprite->rotationStyle = newSprite->LEFT_RIGHT;
+        else
+            newSprite->rotationStyle = newSprite->NONE;
+    }
+}
+
+void ProjectReader::finishTarget() {
+    ProjectTarget &current = target();
+    if (!current.sprite->isStage) current.comments = nullptr;
+}
+
+void ProjectReader::loadCostume(const nlohmann::json &data) {
+    Costume newCostume;
+    newCostume.id = data["assetId"];
+    if (data.contains("name")) {
+        newCostume.name = data["name"];
+    }
+    if (data.contains("bitmapResolution")) {
+        newCostume.bitmapResolution = data["bitmapResolution"];
+    } else newCostume.bitmapResolution = 1;
+    if (data.contains("dataFormat")) {
+        newCostume.dataFormat = data["dataFormat"];
+        newCostume.isSVG = (newCostume.dataFormat == "svg" || newCostume.dataFormat == "SVG");
+    }
+    if (data.contains("md5ext")) {
+        newCostume.fullName = data["md5ext"];
+    }
+    if (data.contains("rotationCenterX")) {
+        newCostume.rotationCenterX = data["rotationCenterX"];
+        if (Scratch::bitmapHalfQuality && !newCostume.isSVG && newCostume.bitmapResolution == 2) newCostume.rotationCenterX /= 2;
+    } else newCostume.rotationCenterX = -6767.6767; // will get changed once costume image is loaded
+    if (data.contains("rotationCenterY")) {
+        newCostume.rotationCenterY = data["rotationCenterY"];
+        if (Scratch::bitmapHalfQuality && !newCostume.isSVG && newCostume.bitmapResolution == 2) newCostume.rotationCenterY /= 2;
+    } else newCostume.rotationCenterY = -6767.6767; // will get changed once costume image is loaded
+    target().sprite->costumes.push_back(newCostume);
+}
+
+void ProjectReader::loadSound(const nlohmann::json &data) {
+    Sound newSound;
+    newSound.id = data["assetId"];
+    newSound.name = data["name"];
+    newSound.fullName = data["md5ext"];
+    newSound.dataFormat = data["dataFormat"];
+    newSound.sampleRate = data.value("rate", -1); // We don't actually use these values so -1 should be fine
+    newSound.sampleCount = data.value("sampleCount", -1);
+    target().sprite->sounds.push_back(newSound);
+}
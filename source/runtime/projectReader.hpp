@@ -0,0 +1,176 @@
+#pragma once
+#include "sprite.hpp"
+#include <cstdint>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <nonstd/expected.hpp>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Compact, unlinked form of a block as it appears in project.json.
+ * Block references are indices into the target's `BlockTable`, and opcodes and input/field names point into the
+ * project's interned strings.
+ */
+struct RawInput {
+    const std::string *name = nullptr;
+    int type = 0;           // 1 = shadow, 2 = no shadow, 3 = obscured shadow
+    int32_t block = -1;     // referenced block, if the input holds a block ID
+    bool primitive = false; // the input holds a primitive array like [4, "10"] or [12, "my variable", "id"]
+    int primitiveType = 0;
+    Value value;
+    std::string primitiveId;
+};
+
+struct RawField {
+    const std::string *name = nullptr;
+    std::string value;
+    std::string id;
+};
+
+struct RawMutation {
+    std::string tagName;
+    std::string proccode;
+    std::string argumentIds;
+    std::string argumentNames;
+    std::string argumentDefaults;
+    bool hasArgumentIds = false;
+    bool hasArgumentNames = false;
+    bool hasArgumentDefaults = false;
+    bool warp = false;
+};
+
+struct RawBlock {
+    const std::string *id = nullptr;
+    const std::string *opcode = nullptr;
+    int32_t next = -1;
+    bool defined = false; // false for IDs that were referenced but never declared
+    bool topLevel = false;
+    bool shadow = false;
+    std::vector<RawInput> inputs;
+    std::vector<RawField> fields;
+    std::unique_ptr<RawMutation> mutation;
+};
+
+/**
+ * The blocks of one target, with a temporary ID to index table used to resolve references while streaming.
+ */
+struct BlockTable {
+    std::vector<RawBlock> blocks;
+    std::unordered_map<std::string, int32_t> indices;
+
+    /**
+     * Returns the index of the block with the given ID, reserving one if the ID hasn't been seen yet.
+     */
+    int32_t indexOf(const std::string &id);
+
+    /**
+     * Returns the block at `index`, or nullptr if it doesn't exist or has no opcode.
+     */
+    const RawBlock *find(int32_t index) const;
+};
+
+struct ProjectTarget {
+    Sprite *sprite = nullptr;
+    BlockTable blocks;
+    nlohmann::json comments; // only kept for the stage
+};
+
+struct ProjectData {
+    std::vector<ProjectTarget> targets;
+    nlohmann::json monitors;
+    nlohmann::json extensions;
+    std::unordered_set<std::string> strings;
+
+    // set by Parser::loadSprites, unset if the stage had no comments at all
+    std::optional<nlohmann::json> stageSettings;
+};
+
+/**
+ * Streams project.json through `nlohmann::json::sax_parse`, building sprites, variables, lists, costumes and sounds
+ * directly. Blocks are kept in their raw form so the parser can link them once extensions are loaded.
+ * Only small parts of the project (monitors, extensions, comments, single costumes and sounds) are ever held as JSON.
+ */
+class ProjectReader {
+  public:
+    static nonstd::expected<void, std::string> read(const char *data, size_t size, ProjectData &out);
+
+    // nlohmann::json SAX interface
+    bool null();
+    bool boolean(bool val);
+    bool number_integer(nlohmann::json::number_integer_t val);
+    bool number_unsigned(nlohmann::json::number_unsigned_t val);
+    bool number_float(nlohmann::json::number_float_t val, const std::string &s);
+    bool string(std::string &val);
+    bool binary(nlohmann::json::binary_t &val);
+    bool start_object(std::size_t elements);
+    bool end_object();
+    bool start_array(std::size_t elements);
+    bool end_array();
+    bool key(std::string &val);
+    bool parse_error(std::size_t position, const std::string &lastToken, const nlohmann::detail::exception &ex);
+
+  private:
+    enum class Context : uint8_t {
+        ROOT,
+        TARGETS,
+        TARGET,
+        VARIABLES,
+        VARIABLE,
+        LISTS,
+        LIST,
+        LIST_ITEMS,
+        BROADCASTS,
+        COSTUMES,
+        SOUNDS,
+        BLOCKS,
+        BLOCK,
+        INPUTS,
+        INPUT,
+        PRIMITIVE,
+        FIELDS,
+        FIELD,
+        MUTATION,
+    };
+
+    struct Frame {
+        Context context;
+        size_t index = 0;
+    };
+
+    explicit ProjectReader(ProjectData &out) : out(out) {}
+
+    bool value(nlohmann::json &&val);
+    bool start(bool object);
+    bool end();
+    void captured(nlohmann::json &&val);
+    const std::string *intern(const std::string &str);
+
+    void setTargetProperty(const std::string &name, const nlohmann::json &val);
+    void finishTarget();
+    void loadCostume(const nlohmann::json &data);
+    void loadSound(const nlohmann::json &data);
+
+    RawBlock &currentBlock() { return target().blocks.blocks[blockIndex]; }
+    ProjectTarget &target() { return out.targets.back(); }
+
+    ProjectData &out;
+    std::vector<Frame> stack;
+    std::string currentKey;
+    std::string error;
+
+    // containers nobody reads are skipped without building anything
+    int skipDepth = 0;
+
+    // small subtrees that are read as JSON
+    nlohmann::json capture;
+    std::vector<nlohmann::json *> captureStack;
+    std::string captureKey;
+
+    int32_t blockIndex = -1;
+    Variable variable;
+    List *list = nullptr;
+};
@@ -12,6 +12,7 @@
 #include <cmath>
 #include <cstddef>
 #include <cstring>
+#include <decodePool.hpp>
 #include <downloader.hpp>
 #include <image.hpp>
 #include <input.hpp>
@@ -19,11 +20,17 @@
 #include <math.h>
 #include <memory>
 #include <os.hpp>
+#include <profiler.hpp>
+#include <tracer.hpp>
 #include <render.hpp>
+#include <replay.hpp>
 #include <set>
 #include <speech_manager.hpp>
 #include <string>
+#include <svgCache.hpp>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #ifdef ENABLE_MENU
@@ -51,7 +58,7 @@ std::vector<std::unique_ptr<extensions::Extension>> Scratch::extensions;
 #endif
 
 std::vector<Block *> Scratch::blocks;
-std::vector<Sprite *> Scratch::sprites;
+LayerList<Sprite *> Scratch::sprites;
 Sprite *Scratch::stageSprite;
 std::string Scratch::answer;
 ProjectType Scratch::projectType;
@@ -75,6 +82,12 @@ bool Scratch::fencing = true;
 bool Scratch::miscellaneousLimits = true;
 bool Scratch::shouldStop = false;
 bool Scratch::forceRedraw = false;
+uint64_t Scratch::sceneVersion = 1;
+#ifdef LIBRETRO
+bool Scratch::skipUnchangedFrames = false;
+#else
+bool Scratch::skipUnchangedFrames = true;
+#endif
 bool Scratch::accuratePen = false;
 bool Scratch::accurateCollision = true;
 bool Scratch::debugVars = false;
@@ -97,6 +110,28 @@ bool Scratch::useCustomUsername = false;
 std::string Scratch::customUsername;
 
 std::unordered_map<std::string, std::shared_ptr<Image>> Scratch::costumeImages;
+bool Scratch::streamCostumes = true;
+Scratch::CostumeCacheStats Scratch::costumeCacheStats;
+size_t Scratch::costumeCacheBudget = Scratch::defaultCostumeCacheBudget;
+
+// costumes requested by requestCurrentCostumeImage that are still being decoded
+static std::unordered_set<std::string> streamingCostumes;
+// costumes uploaded ahead of time that no sprite has switched to yet
+static std::unordered_set<std::string> prefetchedCostumes;
+
+struct CostumeHints {
+    bool nextCostume = false; // the sprite animates by switching to the next costume
+    std::vector<std::string> names;
+};
+static std::unordered_map<std::string, CostumeHints> costumeHints; // by sprite name, so clones share them
+
+static struct {
+    uint64_t prefetchHits = 0; // switches to a costume that was prefetched
+    uint64_t deferred = 0;     // switches that kept showing the previous costume instead of stalling
+    uint64_t stalls = 0;       // switches that decoded on the main thread
+} streamingStats;
+
+constexpr size_t maxPrefetchedPerSprite = 16;
 
 bool Scratch::initializeRuntime() {
     if (!OS::init()) {
@@ -113,6 +148,7 @@ bool Scratch::initializeRuntime() {
 #ifdef ENABLE_DECTALK
     TextToSpeechSafeInit();
 #endif
+    Mixer::init();
     if (!SoundPlayer::init()) {
         Log::logCritical("Failed to initialize audio.", false);
         return false;
@@ -123,6 +159,7 @@ bool Scratch::initializeRuntime() {
 
 void Scratch::initializeScratchProject() {
     Parser::loadUsernameFromSettings();
+    markSceneChanged();
 #ifdef ENABLE_CLOUDVARS
     if (cloudProject) Parser::initMist();
 #endif
@@ -150,6 +187,114 @@ void Scratch::initializeScratchProject() {
     if (debugVars) fpsTimer.start();
 }
 
+// the scene version last drawn, and how many frames were skipped since
+static uint64_t presentedSceneVersion = 0;
+static int skippedFrames = 0;
+
+namespace {
+
+// FNV-1a over the values that decide what a frame looks like
+struct SceneHash {
+    uint64_t value = 14695981039346656037ull;
+
+    void bytes(const void *data, size_t size) {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++) {
+            value ^= p[i];
+            value *= 1099511628211ull;
+        }
+    }
+
+    template <typename T>
+    void add(const T &x) {
+        static_assert(std::is_trivially_copyable<T>::value);
+        bytes(&x, sizeof(x));
+    }
+
+    void add(const std::string &x) {
+        add(x.size());
+        bytes(x.data(), x.size());
+    }
+
+    // hashes the stored alternative directly so monitors don't build a string every frame
+    void add(const Value &x) {
+        x.visit([this](const auto &v) {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, double>) {
+                add('d');
+                add(v);
+            } else if constexpr (std::is_same_v<T, std::string>) {
+                add('s');
+                add(v);
+            } else if constexpr (std::is_same_v<T, bool>) {
+                add('b');
+                add(v);
+            } else if constexpr (std::is_same_v<T, Color>) {
+                add('c');
+                add(v);
+            } else {
+                add('u');
+            }
+        });
+    }
+};
+
+} // namespace
+
+void Scratch::updateSceneVersion() {
+    SceneHash hash;
+    hash.add(Render::getWidth());
+    hash.add(Render::getHeight());
+    hash.add(Input::mousePointer.x);
+    hash.add(Input::mousePointer.y);
+    hash.add(Input::mousePointer.isMoving);
+
+    hash.add(sprites.size());
+    for (const Sprite *sprite : sprites) {
+        hash.add(sprite);
+        hash.add(sprite->visible);
+        if (!sprite->visible) continue;
+        hash.add(sprite->xPosition);
+        hash.add(sprite->yPosition);
+        hash.add(sprite->size);
+        hash.add(sprite->rotation);
+        hash.add(sprite->rotationStyle);
+        hash.add(sprite->currentCostume);
+        hash.add(getRenderedCostume(sprite));
+        hash.add(sprite->ghostEffect);
+        hash.add(sprite->brightnessEffect);
+        hash.add(sprite->colorEffect);
+        hash.add(sprite->fisheyeEffect);
+        hash.add(sprite->whirlEffect);
+        hash.add(sprite->pixelateEffect);
+        hash.add(sprite->mosaicEffect);
+    }
+
+    hash.add(Render::monitors.size());
+    for (const auto &[id, monitor] : Render::monitors) {
+        hash.add(monitor.visible);
+        if (!monitor.visible) continue;
+        hash.add(id);
+        hash.add(monitor.mode);
+        hash.add(monitor.displayName);
+        hash.add(monitor.x);
+        hash.add(monitor.y);
+        hash.add(monitor.width);
+        hash.add(monitor.height);
+        hash.add(monitor.listPage);
+        hash.add(monitor.value);
+        hash.add(monitor.list.size());
+        for (const Value &item : monitor.list)
+            hash.add(item);
+    }
+
+    static uint64_t lastHash = 0;
+    if (hash.value != lastHash) {
+        lastHash = hash.value;
+        markSceneChanged();
+    }
+}
+
 std::pair<bool, bool> Scratch::stepScratchProject(ScriptThread &monitorDisplayThread) {
     if (!Render::appShouldRun()) {
 #ifdef ENABLE_MENU
@@ -166,15 +311,24 @@ std::pair<bool, bool> Scratch::stepScratchProject(ScriptThread &monitorDisplayTh
         if (pauseMenu->shouldUnpause) {
             MenuManager::cleanup();
             pauseMenu = nullptr;
+            markSceneChanged();
         }
         return std::make_pair(Render::appShouldRun(), false);
     }
 #endif
 
+    Replay::beginStep();
+
+    SE_TRACE_BEGIN("checkFramerate", "frame");
     const bool checkFPS = Render::checkFramerate();
+    SE_TRACE_END("checkFramerate", "frame");
     if (Scratch::turbo) forceRedraw = false;
 
+    // lock the interpreter to one step per frame, so a replay goes through exactly the same steps as the recording
+    if (Replay::recording || Replay::replaying) forceRedraw = true;
+
     if (!forceRedraw || checkFPS) {
+        SE_TRACE_SCOPE(checkFPS ? "frame" : "step", "frame");
         forceRedraw = false;
 
         float currentFPS;
@@ -188,18 +342,31 @@ std::pair<bool, bool> Scratch::stepScratchProject(ScriptThread &monitorDisplayTh
         if (debugVars) scriptTimer.start();
 
 #ifdef ENABLE_CUSTOM_EXTENSIONS
+        SE_TRACE_BEGIN("extensions PRE_UPDATE", "frame");
         extensions::runUpdateFunctions(extensions::PRE_UPDATE);
+        SE_TRACE_END("extensions PRE_UPDATE", "frame");
 #endif
 
-        if (checkFPS) Input::getInput();
+        if (checkFPS) {
+            SE_TRACE_BEGIN("getInput", "frame");
+            Input::getInput();
+            Replay::recordInput();
+            SE_TRACE_END("getInput", "frame");
+        }
+        SE_TRACE_BEGIN("runThreads", "frame");
         BlockExecutor::runThreads();
+        SE_TRACE_END("runThreads", "frame");
 
 #ifdef ENABLE_CUSTOM_EXTENSIONS
+        SE_TRACE_BEGIN("extensions POST_UPDATE", "frame");
         extensions::runUpdateFunctions(extensions::POST_UPDATE);
+        SE_TRACE_END("extensions POST_UPDATE", "frame");
 #endif
 
 #ifdef ENABLE_INSPECTOR
+        SE_TRACE_BEGIN("processCommands", "frame");
         Inspector::processCommands();
+        SE_TRACE_END("processCommands", "frame");
 #endif
 
         if (debugVars) stageSprite->variables["SE!__ScriptTime"].value = Value(std::to_string(scriptTimer.getTimeMsDouble()) + " ms");
@@ -207,23 +374,46 @@ std::pair<bool, bool> Scratch::stepScratchProject(ScriptThread &monitorDisplayTh
         Timer renderTimer(false);
         if (debugVars) renderTimer.start();
 
+        SE_TRACE_BEGIN("updateMonitors", "frame");
         BlockExecutor::updateMonitors(&monitorDisplayThread);
+        SE_TRACE_END("updateMonitors", "frame");
         SpeechManager *speechManager = Render::getSpeechManager();
         if (speechManager) {
+            SE_TRACE_BEGIN("speech update", "frame");
             speechManager->update();
+            SE_TRACE_END("speech update", "frame");
         }
+        Mixer::update();
         if (checkFPS) {
 #ifdef ENABLE_CUSTOM_EXTENSIONS
+            SE_TRACE_BEGIN("extensions PRE_RENDER", "frame");
             extensions::runUpdateFunctions(extensions::PRE_RENDER);
+            SE_TRACE_END("extensions PRE_RENDER", "frame");
 #endif
 
-            Render::renderSprites();
-            Scratch::flushCostumeImages();
+            SE_TRACE_BEGIN("renderSprites", "frame");
+            updateSceneVersion();
+            // still present now and then, for anything outside the runtime's view (the window being uncovered, overlays)
+            if (!skipUnchangedFrames || sceneVersion != presentedSceneVersion || ++skippedFrames >= FPS) {
+                Image::currentFrame++;
+                Render::renderSprites();
+                presentedSceneVersion = sceneVersion;
+                skippedFrames = 0;
+            }
+            SE_TRACE_END("renderSprites", "frame");
+            SE_TRACE_BEGIN("trimCostumeImages", "frame");
+            Scratch::trimCostumeImages();
+            SE_TRACE_END("trimCostumeImages", "frame");
+            SE_TRACE_BEGIN("updateCostumeStreaming", "frame");
+            Scratch::updateCostumeStreaming();
+            SE_TRACE_END("updateCostumeStreaming", "frame");
 
             if (debugVars) stageSprite->variables["SE!__FPS"].value = Value(std::to_string(std::clamp(static_cast<int>(currentFPS), 0, FPS)));
 
 #ifdef ENABLE_CUSTOM_EXTENSIONS
+            SE_TRACE_BEGIN("extensions POST_RENDER", "frame");
             extensions::runUpdateFunctions(extensions::POST_RENDER);
+            SE_TRACE_END("extensions POST_RENDER", "frame");
 #endif
         }
 #ifdef ENABLE_MENU
@@ -288,12 +478,24 @@ bool Scratch::startScratchProject() {
 }
 
 void Scratch::cleanupScratchProject() {
+    Replay::onProjectCleanup();
+
 #ifdef ENABLE_CUSTOM_EXTENSIONS
     extensions::cleanup();
 #endif
 
+    if (DecodePool::running()) {
+        Log::log("Costume streaming: " + std::to_string(streamingStats.prefetchHits) + " switches hit prefetched costumes, " + std::to_string(streamingStats.deferred) + " showed the previous costume instead of stalling, " + std::to_string(streamingStats.stalls) + " decoded on the main thread.");
+    }
+    DecodePool::stop();
+    SVGCache::flush();
+    streamingCostumes.clear();
+    prefetchedCostumes.clear();
+    costumeHints.clear();
+    streamingStats = {};
     Scratch::cleanupSprites();
     costumeImages.clear();
+    costumeCacheStats = {};
     Mixer::cleanupAudio();
     Render::monitorTexts.clear();
     Render::listMonitors.clear();
@@ -307,10 +509,7 @@ void Scratch::cleanupScratchProject() {
 
     // Clean up ZIP archive if it was initialized
     if (projectType != ProjectType::UNZIPPED) {
-        mz_zip_reader_end(&Unzip::zipArchive);
-        Unzip::zipBuffer.clear();
-        Unzip::zipBuffer.shrink_to_fit();
-        memset(&Unzip::zipArchive, 0, sizeof(Unzip::zipArchive));
+        Unzip::closeArchive();
     }
 
     DownloadManager::deinit();
@@ -437,7 +636,13 @@ bool Scratch::getInputValue(Block *block, std::string_view inputName, ScriptThre
         Block *targetBlock = input->block;
         input->value = Value();
 
+#ifdef ENABLE_PROFILER
+        const Profiler::Sample sample = Profiler::beginSample();
+#endif
         BlockResult res = targetBlock->blockFunction(targetBlock, thread, sprite, &(input->value));
+#ifdef ENABLE_PROFILER
+        Profiler::endBlockSample(targetBlock, sample);
+#endif
         if (res != BlockResult::REPEAT) {
             input->calculated = true;
             outValue = input->value;
@@ -506,28 +711,12 @@ void Scratch::stopClicked() {
         currentSprite->ghostEffect = 0.0f;
         currentSprite->brightnessEffect = 0.0f;
         currentSprite->colorEffect = 0.0f;
-        for (Sound sound : currentSprite->sounds)
-            Mixer::stopSound(sound.fullName);
-    }
-    for (auto *spr : toDelete) {
-        Scratch::sprites.erase(std::remove(Scratch::sprites.begin(), Scratch::sprites.end(), spr),
-                               Scratch::sprites.end());
-        for (ScriptThread *thread : BlockExecutor::threads) {
-            if (thread->sprite == spr) {
-                thread->finished = true;
-            }
-        }
-        delete spr;
-    }
-
-    // ToDo: This fixes a crash that can occur when the maximum number of layers is higher than the number of sprites
-    //  (due to cloning and layer shifting, or when re-executing "when flag clicked" blocks).
-    //  However, this could potentially break projects logically if the content isn't currently sorted correctly.
-    //  I'm too lazy to test that right now.
-    for (unsigned int i = 0; i < Scratch::sprites.size(); i++) {
-        Scratch::sprites[i]->layer = (Scratch::sprites.size() - 1) - i;
     }
-    BlockExecutor::sortSprites = false;
+    Mixer::stopAllSounds();
+    // one pass over the sprites instead of one per clone
+    Scratch::sprites.eraseIf([](const Sprite *s) { return s->isClone; });
+    for (auto *spr : toDelete)
+        delete spr;
 }
 
 std::pair<float, float> Scratch::screenToScratchCoords(float screenX, float screenY, int windowWidth, int windowHeight) {
@@ -636,6 +825,7 @@ void Scratch::gotoXY(Sprite *sprite, double x, double y) {
     if (sprite->penData.down && (oldX != sprite->xPosition || oldY != sprite->yPosition)) {
         if (accuratePen) Render::penMoveAccurate(oldX, oldY, sprite->xPosition, sprite->yPosition, sprite);
         else Render::penMoveFast(oldX, oldY, sprite->xPosition, sprite->yPosition, sprite);
+        markSceneChanged();
     }
     if (sprite->visible) Scratch::forceRedraw = true;
 }
@@ -689,44 +879,209 @@ void Scratch::switchCostume(Sprite *sprite, double costumeIndex) {
     costumeIndex = std::round(costumeIndex);
     sprite->currentCostume = std::isfinite(costumeIndex) ? (costumeIndex - std::floor(costumeIndex / sprite->costumes.size()) * sprite->costumes.size()) : 0;
 
-    loadCurrentCostumeImage(sprite);
+    requestCurrentCostumeImage(sprite);
 
     if (sprite->visible) Scratch::forceRedraw = true;
 }
 
-void Scratch::sortSprites() {
-    std::sort(sprites.begin(), sprites.end(),
-              [](const Sprite *a, const Sprite *b) {
-                  if (a->isStage && !b->isStage) return false;
-                  if (!a->isStage && b->isStage) return true;
-                  return a->layer > b->layer;
-              });
+void Scratch::setSprites(std::vector<Sprite *> loaded) {
+    std::stable_sort(loaded.begin(), loaded.end(),
+                     [](const Sprite *a, const Sprite *b) {
+                         if (a->isStage != b->isStage) return b->isStage;
+                         return a->layer > b->layer;
+                     });
+
+    sprites.clear();
+    sprites.reserve(loaded.size());
+    for (Sprite *sprite : loaded) {
+        sprites.push_back(sprite);
+        if (sprite->isStage) stageSprite = sprite;
+    }
+}
 
-    unsigned int currentLayer = sprites.size() - 1;
-    for (auto *sprite : sprites)
-        sprite->layer = currentLayer--;
+int Scratch::getSpriteIndex(Sprite *sprite) {
+    return static_cast<int>(sprites.indexOf(sprite));
+}
+
+int Scratch::getLayer(Sprite *sprite) {
+    return static_cast<int>(sprites.size() - 1 - sprites.indexOf(sprite));
+}
+
+void Scratch::moveSpriteToIndex(Sprite *sprite, int index) {
+    if (sprite->isStage || sprites.size() < 2) return;
+    sprites.move(sprite, std::clamp<int>(index, 0, sprites.size() - 2));
+}
+
+void Scratch::insertClone(Sprite *clone, Sprite *original) {
+    sprites.insert(sprites.indexOf(original) + 1, clone);
+}
+
+static void addCostumeImage(const std::string &name, const std::shared_ptr<Image> &image) {
+    auto [it, inserted] = Scratch::costumeImages.try_emplace(name, image);
+    if (!inserted) {
+        Scratch::costumeCacheStats.residentBytes -= it->second->getMemorySize();
+        it->second = image;
+    }
+    Scratch::costumeCacheStats.residentBytes += image->getMemorySize();
+    image->markUsed();
+    Scratch::markSceneChanged();
+}
+
+static void removeCostumeImage(const std::string &name) {
+    auto it = Scratch::costumeImages.find(name);
+    if (it == Scratch::costumeImages.end()) return;
+    Scratch::costumeCacheStats.residentBytes -= it->second->getMemorySize();
+    Scratch::costumeImages.erase(it);
+    Scratch::markSceneChanged();
+}
+
+float Scratch::getCostumeScale(const Sprite *sprite) {
+    const int screenWidth = Render::getWidth();
+    const int screenHeight = Render::renderMode == Render::BOTH_SCREENS ? 480 : Render::getHeight();
+
+    const float scale = (sprite->size / 100);
+    return scale * std::min(static_cast<float>(screenWidth) / Scratch::projectWidth, static_cast<float>(screenHeight) / Scratch::projectHeight);
+}
+
+void Scratch::queueCostumeImage(Sprite *sprite, size_t costumeIndex) {
+    if (!DecodePool::running() || costumeIndex >= sprite->costumes.size()) return;
+
+    const Costume &costume = sprite->costumes[costumeIndex];
+    if (costumeImages.find(costume.fullName) != costumeImages.end()) return;
+
+    DecodePool::submit(costume.fullName, bitmapHalfQuality && costume.bitmapResolution == 2, getCostumeScale(sprite));
+}
+
+void Scratch::requestCurrentCostumeImage(Sprite *sprite) {
+    const std::string &costumeName = sprite->costumes[sprite->currentCostume].fullName;
+
+    if (costumeImages.find(costumeName) != costumeImages.end()) {
+        if (prefetchedCostumes.erase(costumeName) > 0) streamingStats.prefetchHits++;
+        loadCurrentCostumeImage(sprite);
+    } else if (!DecodePool::running() || !streamCostumes || sprite->renderInfo.oldCostumeID < 0) {
+        // nothing to show in the meantime
+        if (DecodePool::running()) streamingStats.stalls++;
+        loadCurrentCostumeImage(sprite);
+    } else {
+        SE_TRACE_INSTANT("costume deferred", "assets", costumeName);
+        queueCostumeImage(sprite, sprite->currentCostume);
+        streamingCostumes.insert(costumeName);
+        streamingStats.deferred++;
+    }
+
+    auto hints = costumeHints.find(sprite->name);
+    if (hints != costumeHints.end() && hints->second.nextCostume)
+        queueCostumeImage(sprite, (sprite->currentCostume + 1) % sprite->costumes.size());
+}
+
+void Scratch::updateCostumeStreaming() {
+    if (!DecodePool::running()) return;
+
+    for (const std::string &costumeName : DecodePool::finished()) {
+        const bool requested = streamingCostumes.erase(costumeName) > 0;
+
+        bool loaded = false;
+        for (Sprite *sprite : sprites) {
+            if (sprite->costumes.empty() || sprite->costumes[sprite->currentCostume].fullName != costumeName) continue;
+            loadCurrentCostumeImage(sprite);
+            if (sprite->visible) forceRedraw = true;
+            loaded = true;
+        }
+
+        for (auto it = sprites.begin(); !loaded && it != sprites.end(); ++it) {
+            for (size_t i = 0; i < (*it)->costumes.size(); i++) {
+                if ((*it)->costumes[i].fullName != costumeName) continue;
+                loadCostumeImage(*it, i);
+                loaded = true;
+                break;
+            }
+        }
+
+        // whoever wanted it is gone
+        if (!loaded) DecodePool::take(costumeName);
+        else if (!requested && costumeImages.find(costumeName) != costumeImages.end()) prefetchedCostumes.insert(costumeName);
+    }
+}
+
+void Scratch::prefetchCostumeImages() {
+    costumeHints.clear();
+    if (!DecodePool::running()) return;
+
+    for (Sprite *sprite : sprites) {
+        if (sprite->isClone) continue;
+        CostumeHints &hints = costumeHints[sprite->name];
+
+        std::unordered_set<const Block *> visited;
+        std::vector<const Block *> stack;
+        for (const auto &[opcode, hatBlocks] : sprite->hats)
+            stack.insert(stack.end(), hatBlocks.begin(), hatBlocks.end());
+
+        while (!stack.empty()) {
+            const Block *block = stack.back();
+            stack.pop_back();
+            if (block == nullptr || !visited.insert(block).second) continue;
+
+            if (block->opcode == "looks_nextcostume") hints.nextCostume = true;
+            for (const auto &[name, input] : block->inputs) {
+                if (input.inputType == ParsedInput::BLOCK) stack.push_back(input.block);
+                else if (input.inputType == ParsedInput::VALUE && name == "COSTUME" && block->opcode == "looks_switchcostumeto") {
+                    const std::string costumeName = input.value.asString();
+                    if (costumeName == "next costume") hints.nextCostume = true;
+                    else hints.names.push_back(costumeName);
+                }
+            }
+            stack.push_back(block->nextBlock);
+        }
+
+        size_t queued = 0;
+        for (const std::string &costumeName : hints.names) {
+            for (size_t i = 0; i < sprite->costumes.size() && queued < maxPrefetchedPerSprite; i++) {
+                if (sprite->costumes[i].name != costumeName) continue;
+                queueCostumeImage(sprite, i);
+                queued++;
+                break;
+            }
+        }
+    }
+}
+
+int Scratch::getRenderedCostume(const Sprite *sprite) {
+    const int shown = sprite->renderInfo.oldCostumeID;
+    if (streamingCostumes.empty() || shown == sprite->currentCostume || shown < 0 || shown >= static_cast<int>(sprite->costumes.size())) return sprite->currentCostume;
+
+    const std::string &current = sprite->costumes[sprite->currentCostume].fullName;
+    if (streamingCostumes.count(current) == 0 || costumeImages.count(current) != 0) return sprite->currentCostume;
+    if (costumeImages.count(sprite->costumes[shown].fullName) == 0) return sprite->currentCostume;
+    return shown;
 }
 
 void Scratch::loadCurrentCostumeImage(Sprite *sprite) {
-    Costume &costume = sprite->costumes[sprite->currentCostume];
+    loadCostumeImage(sprite, sprite->currentCostume);
+}
+
+void Scratch::loadCostumeImage(Sprite *sprite, size_t costumeIndex) {
+    Costume &costume = sprite->costumes[costumeIndex];
     const std::string &costumeName = costume.fullName;
+    const bool isCurrent = static_cast<int>(costumeIndex) == sprite->currentCostume;
 
     auto it = costumeImages.find(costumeName);
     if (it != costumeImages.end()) {
+        costumeCacheStats.hits++;
+        if (!isCurrent) return;
         sprite->spriteWidth = it->second->getWidth();
         sprite->spriteHeight = it->second->getHeight();
         return;
     }
+    costumeCacheStats.misses++;
 
+    SE_TRACE_SCOPE("image load", "assets", costumeName);
     std::shared_ptr<Image> image;
-    const int screenWidth = Render::getWidth();
-    const int screenHeight = Render::renderMode == Render::BOTH_SCREENS ? 480 : Render::getHeight();
 
     auto onErr = [&](std::string error) -> bool {
         static std::set<std::string> failedImages;
         if (failedImages.count(costumeName) == 0) {
             Log::logWarning("Failed to load image: " + costumeName + ": " + error);
-            freeUnusedCostumeImages();
+            trimCostumeImages(0);
             failedImages.insert(costumeName);
 
             const std::string missingName = "SE__Missingno";
@@ -739,24 +1094,25 @@ void Scratch::loadCurrentCostumeImage(Sprite *sprite) {
                         Log::logWarning("Failed to load missing image texture: " + img.error());
                         failedImages.insert(missingName);
                     } else {
-                        costumeImages[missingName] = img.value();
+                        addCostumeImage(missingName, img.value());
                         image = img.value();
                         return true;
                     }
                 }
             } else {
-                const auto missingImage = costumeImages[missingName];
+                const auto missingImage = missingIt->second;
                 image = missingImage;
                 return true;
             }
         }
-        sprite->spriteWidth = 0;
-        sprite->spriteHeight = 0;
+        if (isCurrent) {
+            sprite->spriteWidth = 0;
+            sprite->spriteHeight = 0;
+        }
         return false;
     };
 
-    float scale = (sprite->size / 100);
-    scale *= std::min(static_cast<float>(screenWidth) / Scratch::projectWidth, static_cast<float>(screenHeight) / Scratch::projectHeight);
+    const float scale = getCostumeScale(sprite);
     const bool shouldDownscale = bitmapHalfQuality && costume.bitmapResolution == 2;
 
     if (projectType == ProjectType::UNZIPPED) {
@@ -776,39 +1132,53 @@ void Scratch::loadCurrentCostumeImage(Sprite *sprite) {
     }
 
     if (image) {
-        sprite->spriteWidth = image->getWidth();
-        sprite->spriteHeight = image->getHeight();
+        if (isCurrent) {
+            sprite->spriteWidth = image->getWidth();
+            sprite->spriteHeight = image->getHeight();
+        }
 
         // if rotation center wasn't present in project.json, set a default one
         if (costume.rotationCenterX == -6767.6767)
-            costume.rotationCenterX = sprite->spriteWidth / 2;
+            costume.rotationCenterX = image->getWidth() / 2;
         if (costume.rotationCenterY == -6767.6767)
-            costume.rotationCenterY = sprite->spriteHeight / 2;
+            costume.rotationCenterY = image->getHeight() / 2;
 
-        costumeImages[costumeName] = image;
+        addCostumeImage(costumeName, image);
     }
 }
 
-void Scratch::flushCostumeImages() {
-    std::vector<std::string> toDelete;
-    for (auto &[id, img] : costumeImages) {
-        img->freeTimer--;
-        if (img->freeTimer <= 0) toDelete.push_back(id);
-    }
+void Scratch::trimCostumeImages(size_t budget) {
+    if (costumeCacheStats.residentBytes <= budget) return;
 
-    for (const std::string &id : toDelete) {
-        costumeImages.erase(id);
+    std::unordered_set<const Image *> visibleImages;
+    for (Sprite *sprite : sprites) {
+        if (!sprite->visible || sprite->costumes.empty()) continue;
+        auto it = costumeImages.find(sprite->costumes[getRenderedCostume(sprite)].fullName);
+        if (it != costumeImages.end()) visibleImages.insert(it->second.get());
     }
-}
 
-void Scratch::freeUnusedCostumeImages() {
-    std::vector<std::string> toDelete;
-    for (auto &[id, img] : costumeImages) {
-        if (img->freeTimer < img->maxFreeTimer - 2) toDelete.push_back(id);
+    struct Candidate {
+        std::string name;
+        bool visible;
+        uint64_t lastUsedFrame;
+    };
+    std::vector<Candidate> candidates;
+    for (const auto &[name, image] : costumeImages) {
+        // drawn in the last couple of frames, so it would only be loaded again right away
+        if (Image::currentFrame - image->lastUsedFrame < 2) continue;
+        candidates.push_back({name, visibleImages.count(image.get()) != 0, image->lastUsedFrame});
     }
 
-    for (const std::string &id : toDelete) {
-        costumeImages.erase(id);
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+        if (a.visible != b.visible) return !a.visible;
+        return a.lastUsedFrame < b.lastUsedFrame;
+    });
+
+    for (const Candidate &candidate : candidates) {
+        if (costumeCacheStats.residentBytes <= budget) break;
+        SE_TRACE_INSTANT("image evict", "assets", candidate.name);
+        removeCostumeImage(candidate.name);
+        costumeCacheStats.evictions++;
     }
 }
 
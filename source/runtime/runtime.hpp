@@ -2,6 +2,7 @@
 #include "blockExecutor.hpp"
 #include "sprite.hpp"
 #include <image.hpp>
+#include <layerList.hpp>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <time.hpp>
@@ -65,13 +66,108 @@ class Scratch {
     static bool isColliding(const std::string &collisionType, Sprite *currentSprite, Sprite *targetSprite = nullptr, const std::string &targetName = "");
     static void switchCostume(Sprite *sprite, double costumeIndex);
     static void setDirection(Sprite *sprite, double direction);
-    static void sortSprites();
-    static void moveLayer(Sprite *s, int layers);
+
+    /**
+     * Makes `loaded` the sprites of the project, ordered by the layers they were saved with and the stage at the back.
+     */
+    static void setSprites(std::vector<Sprite *> loaded);
+
+    /**
+     * Where `sprite` is in `sprites`, counted from the front.
+     */
+    static int getSpriteIndex(Sprite *sprite);
+    /**
+     * The layer of `sprite`, counted from the back, where the stage is 0.
+     */
+    static int getLayer(Sprite *sprite);
+    /**
+     * Moves `sprite` to `index` in `sprites`, clamped so the stage stays at the back.
+     */
+    static void moveSpriteToIndex(Sprite *sprite, int index);
+    /**
+     * Puts `clone` directly behind `original` in `sprites`.
+     */
+    static void insertClone(Sprite *clone, Sprite *original);
 
     static std::unordered_map<std::string, std::shared_ptr<Image>> costumeImages;
     static void loadCurrentCostumeImage(Sprite *sprite);
-    static void flushCostumeImages();
-    static void freeUnusedCostumeImages();
+    static void loadCostumeImage(Sprite *sprite, size_t costumeIndex);
+    /**
+     * The scale SVG costumes of `sprite` are rasterised at for how big it is on screen.
+     */
+    static float getCostumeScale(const Sprite *sprite);
+    /**
+     * Starts decoding a costume on a `DecodePool` worker, so `loadCurrentCostumeImage` only has to upload it.
+     */
+    static void queueCostumeImage(Sprite *sprite, size_t costumeIndex);
+    /**
+     * Like `loadCurrentCostumeImage`, but if the costume isn't loaded yet it is decoded on a `DecodePool` worker while
+     * the sprite keeps showing its previous costume. Also prefetches the costume the sprite is likely to switch to next.
+     */
+    static void requestCurrentCostumeImage(Sprite *sprite);
+    /**
+     * Whether `requestCurrentCostumeImage` may keep showing the previous costume. Golden runs and replays turn this off,
+     * since decode timing would make their frames differ between runs.
+     */
+    static bool streamCostumes;
+    /**
+     * Uploads the costumes `DecodePool` workers finished since the last frame.
+     */
+    static void updateCostumeStreaming();
+    /**
+     * Queues the costumes each sprite's scripts switch to by name, and notes which sprites animate with "next costume".
+     */
+    static void prefetchCostumeImages();
+    /**
+     * The costume to draw `sprite` with: its current costume, or the last one drawn while the current one is still
+     * being decoded.
+     */
+    static int getRenderedCostume(const Sprite *sprite);
+
+    struct CostumeCacheStats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t residentBytes = 0;
+    };
+    static CostumeCacheStats costumeCacheStats;
+
+    /**
+     * How many bytes of costume images may stay loaded. Set from the `costumeCacheMB` setting, or
+     * `defaultCostumeCacheBudget`.
+     */
+    static size_t costumeCacheBudget;
+
+    /**
+     * Frees the least recently drawn costume images until the cache fits in `budget` bytes.
+     * Costumes of visible sprites are freed last, and images drawn this frame are never freed.
+     */
+    static void trimCostumeImages(size_t budget = costumeCacheBudget);
+
+    /**
+     * Bumped whenever something on screen may have changed. Frames where it stays the same aren't drawn again.
+     */
+    static uint64_t sceneVersion;
+
+    /**
+     * Whether frames that wouldn't change the screen skip rendering and presenting. Off for libretro, whose frontend
+     * expects a frame every run.
+     */
+    static bool skipUnchangedFrames;
+
+    /**
+     * For changes `updateSceneVersion` can't see: the pen layer, speech bubbles and costume images being loaded.
+     */
+    static void markSceneChanged() {
+        sceneVersion++;
+    }
+
+    /**
+     * Bumps `sceneVersion` if any sprite, monitor, the mouse pointer or the window size changed since the last call.
+     * Comparing a fingerprint once per frame catches every way they can change (blocks, dragging, extensions, the
+     * inspector) without each of them having to report it.
+     */
+    static void updateSceneVersion();
 
     static void createDebugMonitor(const std::string &name, int x, int y);
     static void toggleDebugVars(const bool enabled);
@@ -101,6 +197,22 @@ class Scratch {
     constexpr static bool bitmapHalfQuality = false;
 #endif
 
+#if defined(__NDS__)
+    constexpr static size_t defaultCostumeCacheBudget = 1 * 1024 * 1024;
+#elif defined(GAMECUBE) || defined(__PSP__)
+    constexpr static size_t defaultCostumeCacheBudget = 8 * 1024 * 1024;
+#elif defined(__3DS__) || defined(WII)
+    constexpr static size_t defaultCostumeCacheBudget = 16 * 1024 * 1024;
+#elif defined(VITA) || defined(WEBOS)
+    constexpr static size_t defaultCostumeCacheBudget = 64 * 1024 * 1024;
+#elif defined(__WIIU__) || defined(__EMSCRIPTEN__)
+    constexpr static size_t defaultCostumeCacheBudget = 128 * 1024 * 1024;
+#elif defined(__SWITCH__) || defined(__PS4__)
+    constexpr static size_t defaultCostumeCacheBudget = 256 * 1024 * 1024;
+#else
+    constexpr static size_t defaultCostumeCacheBudget = 512 * 1024 * 1024;
+#endif
+
     static bool debugVars;
     static bool sb3InRam;
 
@@ -116,7 +228,10 @@ class Scratch {
     static PauseMenu *pauseMenu;
 #endif
 
-    static std::vector<Sprite *> sprites;
+    /**
+     * Every sprite and clone, front to back, with the stage last. Layer changes only move the sprite involved.
+     */
+    static LayerList<Sprite *> sprites;
     static Sprite *stageSprite;
     static std::vector<Block *> blocks;
     static std::string answer;
@@ -75,6 +75,12 @@ struct ScriptThread {
     int finished = true;
     bool withoutScreenRefresh = false;
 
+    /**
+     * Where the last note or rest of this thread ends on the music timeline (see `Mixer::musicPosition`), so the next
+     * one can start on that exact frame instead of whenever the thread gets to run again.
+     */
+    uint64_t musicTime = 0;
+
     std::unordered_map<std::string, Value> MyBlocksVariablen;
     Value returnValue;
 
@@ -282,6 +288,10 @@ class Sprite {
     float yPosition;
     float size;
     float rotation;
+    /**
+     * The layer the sprite was saved with, only used to order the sprites when the project loads.
+     * Use `Scratch::getLayer` for the current one.
+     */
     int layer;
     RenderInfo renderInfo;
 
@@ -299,8 +309,8 @@ class Sprite {
 
     /** Audio effects */
     float volume = 100.0f;
-    float pitch = 100.0f;
-    float pan = 100.0f;
+    float pitch = 0.0f;
+    float pan = 0.0f;
 
     enum RotationStyle {
         NONE,
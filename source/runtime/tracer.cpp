@@ -0,0 +1,155 @@
+#include "tracer.hpp"
+#ifdef ENABLE_PROFILER
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <log.hpp>
+#include <nlohmann/json.hpp>
+#include <thread.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace Tracer {
+
+std::atomic<bool> enabled{false};
+
+static std::vector<Event> events;
+static size_t head = 0;
+static size_t count = 0;
+static std::chrono::steady_clock::time_point startTime;
+static std::string exitPath;
+
+// image loads and sound decodes can happen off the main thread
+static SE_Mutex mutex;
+static bool mutexInitialized = false;
+
+static void push(const char *name, const char *category, char phase, std::string_view detail) {
+    const uint64_t timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count());
+    const uint32_t threadId = SE_Thread::getCurrentThreadId();
+
+    mutex.lock();
+    Event &event = events[head];
+    event.name = name;
+    event.category = category;
+    event.phase = phase;
+    event.threadId = threadId;
+    event.timestampNs = timestamp;
+    const size_t detailSize = std::min(detail.size(), sizeof(event.detail) - 1);
+    memcpy(event.detail, detail.data(), detailSize);
+    event.detail[detailSize] = '\0';
+
+    head = (head + 1) % CAPACITY;
+    if (count < CAPACITY) count++;
+    mutex.unlock();
+}
+
+void start() {
+    if (!mutexInitialized) {
+        mutex.init();
+        mutexInitialized = true;
+    }
+
+    mutex.lock();
+    events.resize(CAPACITY);
+    head = 0;
+    count = 0;
+    startTime = std::chrono::steady_clock::now();
+    mutex.unlock();
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+void stop() {
+    enabled.store(false, std::memory_order_relaxed);
+}
+
+void begin(const char *name, const char *category, std::string_view detail) {
+    push(name, category, 'B', detail);
+}
+
+void end(const char *name, const char *category) {
+    push(name, category, 'E', {});
+}
+
+void instant(const char *name, const char *category, std::string_view detail) {
+    push(name, category, 'i', detail);
+}
+
+nonstd::expected<void, std::string> write(const std::string &path) {
+    if (!mutexInitialized) return nonstd::make_unexpected("Tracing was never started.");
+
+    mutex.lock();
+    std::vector<Event> snapshot;
+    snapshot.reserve(count);
+    const size_t first = (head + CAPACITY - count) % CAPACITY;
+    for (size_t i = 0; i < count; i++) {
+        snapshot.push_back(events[(first + i) % CAPACITY]);
+    }
+    mutex.unlock();
+
+    std::ofstream file(path);
+    if (!file) return nonstd::make_unexpected("Failed to open " + path + " for writing.");
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Scratch Everywhere!\"}}";
+
+    // the ring buffer may have dropped the begin of a scope, skip ends that have nothing to close
+    std::unordered_map<uint32_t, int> depth;
+    char timestamp[32];
+    for (const Event &event : snapshot) {
+        if (event.phase == 'B') depth[event.threadId]++;
+        else if (event.phase == 'E') {
+            if (depth[event.threadId] == 0) continue;
+            depth[event.threadId]--;
+        }
+
+        snprintf(timestamp, sizeof(timestamp), "%.3f", static_cast<double>(event.timestampNs) / 1000.0);
+        file << ",\n{\"name\":" << nlohmann::json(event.name).dump()
+             << ",\"cat\":\"" << event.category
+             << "\",\"ph\":\"" << event.phase
+             << "\",\"ts\":" << timestamp
+             << ",\"pid\":1,\"tid\":" << event.threadId;
+        if (event.phase == 'i') file << ",\"s\":\"t\"";
+        if (event.detail[0] != '\0') file << ",\"args\":{\"detail\":" << nlohmann::json(event.detail).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) << "}";
+        file << "}";
+    }
+    file << "\n]}\n";
+
+    if (!file) return nonstd::make_unexpected("Failed to write " + path);
+    return {};
+}
+
+void setExitPath(const std::string &path) {
+    exitPath = path;
+}
+
+void shutdown() {
+    if (exitPath.empty()) return;
+    stop();
+    auto written = write(exitPath);
+    if (!written.has_value()) Log::logError("Failed to write trace: " + written.error());
+    else Log::log("Wrote trace to " + exitPath);
+    exitPath.clear();
+}
+
+} // namespace Tracer
+
+#else
+
+namespace Tracer {
+std::atomic<bool> enabled{false};
+
+void start() {}
+void stop() {}
+void begin(const char *name, const char *category, std::string_view detail) {}
+void end(const char *name, const char *category) {}
+void instant(const char *name, const char *category, std::string_view detail) {}
+nonstd::expected<void, std::string> write(const std::string &path) {
+    return nonstd::make_unexpected("Tracing is not available in this build. Configure with -DSE_PROFILE=ON.");
+}
+void setExitPath(const std::string &path) {}
+void shutdown() {}
+} // namespace Tracer
+
+#endif
@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <nonstd/expected.hpp>
+#include <string>
+#include <string_view>
+
+/**
+ * Records timestamped events into a fixed size ring buffer, and writes them out as a Chrome `trace_event` JSON file
+ * (viewable in Perfetto or chrome://tracing). Only compiled in with `SE_PROFILE`; use the `SE_TRACE_*` macros so
+ * call sites disappear in normal builds.
+ */
+namespace Tracer {
+
+/**
+ * Number of events kept. Once full, the oldest events are overwritten.
+ */
+constexpr size_t CAPACITY = 1 << 16;
+
+struct Event {
+    const char *name;
+    const char *category;
+    char phase; // 'B' begin, 'E' end, 'i' instant
+    uint32_t threadId;
+    uint64_t timestampNs;
+    char detail[48];
+};
+
+// read by every thread that records events, written by `start()` and `stop()`
+extern std::atomic<bool> enabled;
+
+inline bool isEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * Clears the buffer and starts recording.
+ */
+void start();
+
+/**
+ * Stops recording. Recorded events are kept until the next `start()`.
+ */
+void stop();
+
+void begin(const char *name, const char *category, std::string_view detail = {});
+void end(const char *name, const char *category);
+void instant(const char *name, const char *category, std::string_view detail = {});
+
+/**
+ * Writes every event currently in the buffer to `path`.
+ */
+nonstd::expected<void, std::string> write(const std::string &path);
+
+/**
+ * Sets a file to write the trace to when `shutdown()` is called.
+ */
+void setExitPath(const std::string &path);
+
+/**
+ * Writes the trace to the exit path, if one was set.
+ */
+void shutdown();
+
+class Scope {
+  public:
+    Scope(const char *name, const char *category, std::string_view detail = {}) : name(name), category(category), active(isEnabled()) {
+        if (active) begin(name, category, detail);
+    }
+    // a scope still open when tracing stops leaves its end out, like the ones cut off by the ring buffer
+    ~Scope() {
+        if (active && isEnabled()) end(name, category);
+    }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    const char *name;
+    const char *category;
+    bool active;
+};
+
+} // namespace Tracer
+
+#ifdef ENABLE_PROFILER
+#define SE_TRACE_CONCAT_INNER(a, b) a##b
+#define SE_TRACE_CONCAT(a, b) SE_TRACE_CONCAT_INNER(a, b)
+#define SE_TRACE_SCOPE(...) Tracer::Scope SE_TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
+#define SE_TRACE_BEGIN(...)                                  \
+    do {                                                     \
+        if (Tracer::isEnabled()) Tracer::begin(__VA_ARGS__); \
+    } while (0)
+#define SE_TRACE_END(...)                                  \
+    do {                                                   \
+        if (Tracer::isEnabled()) Tracer::end(__VA_ARGS__); \
+    } while (0)
+#define SE_TRACE_INSTANT(...)                                  \
+    do {                                                       \
+        if (Tracer::isEnabled()) Tracer::instant(__VA_ARGS__); \
+    } while (0)
+#else
+#define SE_TRACE_SCOPE(...)
+#define SE_TRACE_BEGIN(...)
+#define SE_TRACE_END(...)
+#define SE_TRACE_INSTANT(...)
+#endif
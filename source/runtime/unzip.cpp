@@ -6,6 +6,7 @@
 #include "translation.hpp"
 #include <cstring>
 #include <ctime>
+#include <decodePool.hpp>
 #include <errno.h>
 #include <filesystem.hpp>
 #include <fstream>
@@ -13,10 +14,14 @@
 #include <istream>
 #include <log.hpp>
 #include <menus/loading.hpp>
+#include <mutex>
 #include <random>
 #include <settings.hpp>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <thread.hpp>
+#include <timer.hpp>
+#include <unordered_map>
 #include <vector>
 
 #ifdef _WIN32
@@ -26,10 +31,14 @@
 #include <dirent.h>
 #endif
 
-#ifdef ENABLE_LOADSCREEN
-#include <thread.hpp>
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+#define SE_ZIP_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
+
 #ifdef USE_CMAKERC
 #include <cmrc/cmrc.hpp>
 #include <sstream>
@@ -45,6 +54,15 @@ mz_zip_archive Unzip::zipArchive;
 std::vector<char> Unzip::zipBuffer;
 bool Unzip::UnpackedInSD = false;
 
+// name -> central directory index of every file in zipArchive
+static std::unordered_map<std::string, mz_uint> zipIndex;
+// zipArchive may be backed by a FILE*, which can't be read from two threads at once
+static SE_Mutex zipMutex;
+#ifdef SE_ZIP_MMAP
+static void *zipMapping = nullptr;
+static size_t zipMappingSize = 0;
+#endif
+
 int Unzip::openFile(std::istream *&file) {
     Log::log("Unzipping Scratch project...");
 
@@ -140,10 +158,36 @@ void projectLoaderThread(void *data) {
 
 void loadInitialImages() {
     Unzip::loadingState = TranslationManager::getTranslation("ui.loading.images");
+    Timer timer;
+
+    const unsigned int decodeThreads = DecodePool::configuredWorkerCount();
+    DecodePool::start(decodeThreads);
+    if (DecodePool::running()) {
+        std::unordered_map<std::string, std::vector<Sprite *>> spritesByCostume;
+        for (auto &currentSprite : Scratch::sprites) {
+            spritesByCostume[currentSprite->costumes[currentSprite->currentCostume].fullName].push_back(currentSprite);
+            Scratch::queueCostumeImage(currentSprite, currentSprite->currentCostume);
+        }
+
+        // upload costumes in the order the workers finish them
+        while (true) {
+            const bool done = DecodePool::pending() == 0;
+            for (const std::string &costumeName : DecodePool::finished()) {
+                for (Sprite *sprite : spritesByCostume[costumeName])
+                    Scratch::loadCurrentCostumeImage(sprite);
+            }
+            if (done) break;
+            SE_Thread::sleep(1);
+        }
+    }
+
     for (auto &currentSprite : Scratch::sprites) {
 
         Scratch::loadCurrentCostumeImage(currentSprite);
     }
+    Scratch::prefetchCostumeImages();
+
+    Log::log("Loaded starting costumes in " + std::to_string(timer.getTimeMs()) + " ms (" + std::to_string(DecodePool::running() ? decodeThreads : 1) + " decoding threads).");
 }
 
 bool Unzip::load() {
@@ -203,9 +247,42 @@ void Unzip::openScratchProject(void *arg) {
         return;
     }
     loadingState = TranslationManager::getTranslation("ui.loading.unzipping");
-    nlohmann::json project_json = unzipProject(file);
+    std::function<bool(const ProjectCache::Key &)> useCache = nullptr;
+    ProjectCache::Key cacheKey;
+    bool cacheChecked = false;
+    bool loadedFromCache = false;
+    if (ProjectCache::enabled()) {
+        useCache = [&](const ProjectCache::Key &key) {
+            loadingState = TranslationManager::getTranslation("ui.loading.sprites");
+            cacheKey = key;
+            cacheChecked = true;
+            auto cached = ProjectCache::load(key);
+            if (!cached.has_value()) Log::log(cached.error());
+            loadedFromCache = cached.has_value();
+            return loadedFromCache;
+        };
+    }
+    std::string projectJson = unzipProject(file, useCache);
     delete file;
-    if (project_json.empty()) {
+
+    if (loadedFromCache) {
+        Unzip::projectOpened = 1;
+        Unzip::threadFinished = true;
+        return;
+    }
+
+    loadingState = TranslationManager::getTranslation("ui.loading.sprites");
+    ProjectData project;
+    auto projectRead = ProjectReader::read(projectJson.data(), projectJson.size(), project);
+    projectJson.clear();
+    projectJson.shrink_to_fit();
+    if (!projectRead.has_value()) {
+        Log::logCritical("Failed to parse project.json: " + projectRead.error(), false);
+        Unzip::projectOpened = -2;
+        Unzip::threadFinished = true;
+        return;
+    }
+    if (project.targets.empty()) {
         Log::logCritical("Project.json is empty.", false);
         Unzip::projectOpened = -2;
         Unzip::threadFinished = true;
@@ -213,10 +290,16 @@ void Unzip::openScratchProject(void *arg) {
     }
 
     loadingState = TranslationManager::getTranslation("ui.loading.extensions");
-    Scratch::hasNativeExtensions = Parser::loadExtensions(project_json);
+    Scratch::hasNativeExtensions = Parser::loadExtensions(project.extensions);
 
     loadingState = TranslationManager::getTranslation("ui.loading.sprites");
-    Parser::loadSprites(project_json);
+    Parser::loadSprites(project);
+
+    if (cacheChecked) {
+        auto saved = ProjectCache::save(cacheKey, project);
+        if (!saved.has_value()) Log::logWarning("Failed to write project cache: " + saved.error());
+    }
+    Parser::handlerNames.clear();
 
     Unzip::projectOpened = 1;
     Unzip::threadFinished = true;
@@ -260,56 +343,131 @@ std::vector<std::string> Unzip::getProjectFiles(const std::string &directory) {
     return projectFiles.value();
 }
 
-void *Unzip::getFileInSB3(const std::string &fileName, size_t *outSize) {
-    mz_zip_archive archive;
-    memset(&archive, 0, sizeof(archive));
+static void buildZipIndex() {
+    zipIndex.clear();
+    const mz_uint count = mz_zip_reader_get_num_files(&Unzip::zipArchive);
+    zipIndex.reserve(count);
+
+    char name[MZ_ZIP_MAX_ARCHIVE_FILENAME_SIZE];
+    for (mz_uint i = 0; i < count; i++) {
+        const mz_uint length = mz_zip_reader_get_filename(&Unzip::zipArchive, i, name, sizeof(name));
+        if (length > 1) zipIndex.emplace(std::string(name, length - 1), i);
+    }
+}
+
+// Opens the .sb3 at Unzip::filePath for as long as the project is loaded, without reading all of it into memory.
+static bool openArchive() {
+    memset(&Unzip::zipArchive, 0, sizeof(Unzip::zipArchive));
     bool initSuccess = false;
 
 #ifdef USE_CMAKERC
     if (Scratch::projectType == ProjectType::EMBEDDED) {
         const auto &fs = cmrc::romfs::get_filesystem();
         const auto &romfsFile = fs.open(Unzip::filePath);
-        initSuccess = mz_zip_reader_init_mem(&archive, romfsFile.begin(), romfsFile.size(), 0);
+        initSuccess = mz_zip_reader_init_mem(&Unzip::zipArchive, romfsFile.begin(), romfsFile.size(), 0);
     } else {
 #endif
-        initSuccess = mz_zip_reader_init_file(&archive, Unzip::filePath.c_str(), 0);
+#ifdef SE_ZIP_MMAP
+        // let the OS page assets in on demand instead of seeking and reading through a FILE*
+        const int fd = open(Unzip::filePath.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                zipMapping = mapping;
+                zipMappingSize = static_cast<size_t>(st.st_size);
+                initSuccess = mz_zip_reader_init_mem(&Unzip::zipArchive, zipMapping, zipMappingSize, 0);
+                if (!initSuccess) {
+                    munmap(zipMapping, zipMappingSize);
+                    zipMapping = nullptr;
+                    zipMappingSize = 0;
+                }
+            }
+        }
+        if (fd >= 0) close(fd);
+        if (!initSuccess) {
+            memset(&Unzip::zipArchive, 0, sizeof(Unzip::zipArchive));
+            initSuccess = mz_zip_reader_init_file(&Unzip::zipArchive, Unzip::filePath.c_str(), 0);
+        }
+#else
+    initSuccess = mz_zip_reader_init_file(&Unzip::zipArchive, Unzip::filePath.c_str(), 0);
+#endif
 #ifdef USE_CMAKERC
     }
 #endif
     if (!initSuccess) {
+        memset(&Unzip::zipArchive, 0, sizeof(Unzip::zipArchive));
+        return false;
+    }
+
+    buildZipIndex();
+    return true;
+}
+
+void Unzip::closeArchive() {
+    std::lock_guard<SE_Mutex> lock(zipMutex);
+    if (zipArchive.m_zip_mode != MZ_ZIP_MODE_INVALID) mz_zip_reader_end(&zipArchive);
+    memset(&zipArchive, 0, sizeof(zipArchive));
+    zipBuffer.clear();
+    zipBuffer.shrink_to_fit();
+    zipIndex.clear();
+#ifdef SE_ZIP_MMAP
+    if (zipMapping != nullptr) munmap(zipMapping, zipMappingSize);
+    zipMapping = nullptr;
+    zipMappingSize = 0;
+#endif
+}
+
+int Unzip::findFile(mz_zip_archive *zip, const std::string &fileName) {
+    if (zip == &zipArchive && !zipIndex.empty()) {
+        auto it = zipIndex.find(fileName);
+        if (it != zipIndex.end()) return static_cast<int>(it->second);
+    }
+    // miniz matches names case-insensitively, so still ask it before giving up
+    return mz_zip_reader_locate_file(zip, fileName.c_str(), nullptr, 0);
+}
+
+void *Unzip::getFileInSB3(const std::string &fileName, size_t *outSize) {
+    std::lock_guard<SE_Mutex> lock(zipMutex);
+    if (zipArchive.m_zip_mode != MZ_ZIP_MODE_READING && !openArchive()) {
         Log::logWarning("Failed to open SB3 archive: " + Unzip::filePath);
         return nullptr;
     }
 
-    int file_index = mz_zip_reader_locate_file(&archive, fileName.c_str(), NULL, 0);
+    int file_index = findFile(&zipArchive, fileName);
     if (file_index < 0) {
         Log::logWarning("File not found in SB3: " + fileName);
-        mz_zip_reader_end(&archive);
         return nullptr;
     }
 
     size_t size = 0;
-    void *data = mz_zip_reader_extract_to_heap(&archive, file_index, &size, 0);
+    void *data = mz_zip_reader_extract_to_heap(&zipArchive, file_index, &size, 0);
 
     if (outSize != nullptr) {
         *outSize = size;
     }
 
-    mz_zip_reader_end(&archive);
-
     return data;
 }
 
-static size_t miniz_istream_read_func(void *pOpaque, mz_uint64 file_ofs, void *pBuf, size_t n) {
-    std::istream *stream = static_cast<std::istream *>(pOpaque);
-    stream->clear();
-    stream->seekg(file_ofs, std::ios::beg);
-    stream->read(static_cast<char *>(pBuf), n);
-    return static_cast<size_t>(stream->gcount());
+// Extracts straight into the returned string, so project.json is only ever held once while it gets parsed.
+static std::string extractProjectJson(mz_zip_archive *archive, const std::function<bool(const ProjectCache::Key &)> &useCache, bool &cached) {
+    std::string content;
+    int file_index = mz_zip_reader_locate_file(archive, "project.json", NULL, 0);
+    if (file_index < 0) return content;
+
+    mz_zip_archive_file_stat stat;
+    if (!mz_zip_reader_file_stat(archive, file_index, &stat)) return content;
+    cached = useCache && useCache({stat.m_crc32, stat.m_uncomp_size});
+    if (cached) return content;
+
+    content.resize(static_cast<size_t>(stat.m_uncomp_size));
+    if (!mz_zip_reader_extract_to_mem(archive, file_index, content.data(), content.size(), 0)) content.clear();
+    return content;
 }
 
-nlohmann::json Unzip::unzipProject(std::istream *file) {
-    nlohmann::json project_json;
+std::string Unzip::unzipProject(std::istream *file, const std::function<bool(const ProjectCache::Key &)> &useCache) {
+    std::string project_json;
 
     if (Scratch::projectType != ProjectType::UNZIPPED) {
         auto setting = Unzip::getSetting("sb3InRam");
@@ -324,6 +482,7 @@ nlohmann::json Unzip::unzipProject(std::istream *file) {
             keepInRam = setting.get<bool>();
         }
 
+        closeArchive();
         if (keepInRam) {
             Scratch::sb3InRam = true;
 
@@ -340,54 +499,27 @@ nlohmann::json Unzip::unzipProject(std::istream *file) {
             if (!mz_zip_reader_init_mem(&zipArchive, zipBuffer.data(), zipBuffer.size(), 0)) {
                 return project_json;
             }
+            buildZipIndex();
 
             // extract project.json
-            int file_index = mz_zip_reader_locate_file(&zipArchive, "project.json", NULL, 0);
-            if (file_index < 0) {
-                return project_json;
-            }
-
-            size_t json_size;
-            const char *json_data = static_cast<const char *>(mz_zip_reader_extract_to_heap(&zipArchive, file_index, &json_size, 0));
-
-            // Parse JSON file
-            project_json = nlohmann::json::parse(std::string(json_data, json_size));
-            mz_free((void *)json_data);
+            bool cached = false;
+            project_json = extractProjectJson(&zipArchive, useCache, cached);
         } else {
             Scratch::sb3InRam = false;
-            memset(&zipArchive, 0, sizeof(zipArchive));
 
-            file->seekg(0, std::ios::end);
-            mz_uint64 file_size = file->tellg();
-            file->seekg(0, std::ios::beg);
-
-            zipArchive.m_pIO_opaque = file;
-            zipArchive.m_pRead = miniz_istream_read_func;
-
-            if (!mz_zip_reader_init(&zipArchive, file_size, 0)) {
-                Log::logCritical("Failed to initialize SB3 zip reader from stream.", false);
+            // the archive stays open so assets can be extracted from it later
+            if (!openArchive()) {
+                Log::logCritical("Failed to open SB3 archive: " + Unzip::filePath, false);
                 return project_json;
             }
 
-            int file_index = mz_zip_reader_locate_file(&zipArchive, "project.json", NULL, 0);
-            if (file_index < 0) {
+            bool cached = false;
+            project_json = extractProjectJson(&zipArchive, useCache, cached);
+            if (project_json.empty() && !cached) {
                 Log::logCritical("Failed to extract project.json", false);
-                mz_zip_reader_end(&zipArchive);
+                closeArchive();
                 return project_json;
             }
-
-            size_t json_size;
-            const char *json_data = static_cast<const char *>(mz_zip_reader_extract_to_heap(&zipArchive, file_index, &json_size, 0));
-
-            if (json_data) {
-                project_json = nlohmann::json::parse(std::string(json_data, json_size));
-                mz_free((void *)json_data);
-            }
-
-            mz_zip_reader_end(&zipArchive);
-            zipBuffer.clear();
-            zipBuffer.shrink_to_fit();
-            memset(&zipArchive, 0, sizeof(zipArchive));
         }
 
     } else {
@@ -398,14 +530,14 @@ nlohmann::json Unzip::unzipProject(std::istream *file) {
         file->seekg(0, std::ios::end);
         std::streamsize size = file->tellg();
         file->seekg(0, std::ios::beg);
+        if (size <= 0) return project_json;
 
         // put file into string
-        std::string json_content;
-        json_content.reserve(size);
-        json_content.assign(std::istreambuf_iterator<char>(*file),
-                            std::istreambuf_iterator<char>());
+        project_json.resize(static_cast<size_t>(size));
+        if (!file->read(project_json.data(), size)) project_json.clear();
 
-        project_json = nlohmann::json::parse(json_content);
+        const ProjectCache::Key key = {static_cast<uint32_t>(mz_crc32(MZ_CRC32_INIT, reinterpret_cast<const unsigned char *>(project_json.data()), project_json.size())), project_json.size()};
+        if (!project_json.empty() && useCache && useCache(key)) project_json.clear();
     }
     return project_json;
 }
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <functional>
 #include <iosfwd>
 #include <miniz.h>
 #include <os.hpp>
 #include <parser.hpp>
+#include <projectCache.hpp>
 #include <string>
 #include <vector>
 
@@ -24,7 +26,21 @@ class Unzip {
     static void openScratchProject(void *arg);
     static std::vector<std::string> getProjectFiles(const std::string &directory);
     static void *getFileInSB3(const std::string &fileName, size_t *outSize = nullptr);
-    static nlohmann::json unzipProject(std::istream *file);
+    /**
+     * Returns the index of `fileName` in `zip`, or -1 if it isn't there.
+     * Lookups in `zipArchive` go through a name index built once when the project is opened.
+     */
+    static int findFile(mz_zip_archive *zip, const std::string &fileName);
+    /**
+     * Closes the project's archive and frees everything backing it.
+     */
+    static void closeArchive();
+    /**
+     * Extracts the project's project.json text. Returns an empty string on failure.
+     * `useCache` is called with the cache key of project.json before it's extracted; if it returns true, nothing is
+     * extracted.
+     */
+    static std::string unzipProject(std::istream *file, const std::function<bool(const ProjectCache::Key &)> &useCache = nullptr);
     static int openFile(std::istream *&file);
     static bool load();
     static bool extractProject(const std::string &zipPath, const std::string &destFolder);
@@ -61,6 +61,14 @@ class Value {
 
     Color asColor() const;
 
+    /**
+     * Calls `visitor` with the stored value as-is, without converting it to another type.
+     */
+    template <typename Visitor>
+    decltype(auto) visit(Visitor &&visitor) const {
+        return std::visit(std::forward<Visitor>(visitor), value);
+    }
+
     // Arithmetic operations
     Value operator+(const Value &other) const;
 
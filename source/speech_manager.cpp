@@ -36,6 +36,7 @@ void SpeechManager::showSpeech(Sprite *sprite, const std::string &message, doubl
     }
 
     speechStyles[sprite] = style;
+    Scratch::markSceneChanged();
 
     // Create / update speech object
     if (!hasSpeechObject(sprite)) {
@@ -47,6 +48,7 @@ void SpeechManager::showSpeech(Sprite *sprite, const std::string &message, doubl
 
 void SpeechManager::clearSpeech(Sprite *sprite) {
     if (!sprite) return;
+    if (hasSpeechObject(sprite)) Scratch::markSceneChanged();
 
     speechStartTimes.erase(sprite);
     removeSpeechObject(sprite);
@@ -70,6 +72,7 @@ void SpeechManager::update() {
             removeSpeechObject(sprite);
             speechStyles.erase(sprite);
             speechDurations.erase(sprite);
+            Scratch::markSceneChanged();
         } else {
             ++it;
         }
@@ -77,6 +80,7 @@ void SpeechManager::update() {
 }
 
 void SpeechManager::cleanup() {
+    if (!speechObjects.empty()) Scratch::markSceneChanged();
     clearAllSpeechObjects();
     speechStyles.clear();
     speechStartTimes.clear();
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+/**
+ * A fixed-size queue that one thread pushes to and one other thread pops from, without locking.
+ * Never allocates, so it can be used from audio callbacks.
+ */
+template <typename T, size_t Capacity>
+class SPSCQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+  public:
+    /**
+     * Adds `item` to the back of the queue. Only call this from the producing thread.
+     * @return false if the queue is full.
+     */
+    bool push(const T &item) {
+        const size_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail - head.load(std::memory_order_acquire) == Capacity) return false;
+
+        items[tail & (Capacity - 1)] = item;
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Takes the item at the front of the queue. Only call this from the consuming thread.
+     * @return false if the queue is empty.
+     */
+    bool pop(T &item) {
+        const size_t head = this->head.load(std::memory_order_relaxed);
+        if (head == tail.load(std::memory_order_acquire)) return false;
+
+        item = items[head & (Capacity - 1)];
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+  private:
+    T items[Capacity];
+    // kept on separate cache lines so the two threads don't keep stealing each other's line
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
@@ -0,0 +1,278 @@
+#include "svgCache.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <decodePool.hpp>
+#include <filesystem.hpp>
+#include <fstream>
+#include <image.hpp>
+#include <log.hpp>
+#include <mutex>
+#include <os.hpp>
+#include <runtime.hpp>
+#include <sstream>
+#include <sys/stat.h>
+#include <thread.hpp>
+#include <unordered_map>
+#include <unordered_set>
+#include <unzip.hpp>
+#include <vector>
+
+namespace SVGCache {
+
+static constexpr char MAGIC[4] = {'S', 'E', 'S', 'V'};
+static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+static constexpr uint32_t FORMAT_VERSION = 1;
+
+#if defined(__NDS__) || defined(GAMECUBE) || defined(__PSP__) || defined(__3DS__) || defined(WII)
+static constexpr uint64_t maxCacheBytes = 32ull * 1024 * 1024;
+#elif defined(__WIIU__) || defined(VITA) || defined(WEBOS) || defined(__EMSCRIPTEN__)
+static constexpr uint64_t maxCacheBytes = 128ull * 1024 * 1024;
+#else
+static constexpr uint64_t maxCacheBytes = 512ull * 1024 * 1024;
+#endif
+
+struct Header {
+    char magic[4];
+    uint32_t byteOrderMark;
+    uint32_t version;
+    uint32_t sourceCrc;
+    uint64_t sourceSize;
+    int32_t width;
+    int32_t height;
+    float finalScale;
+};
+
+struct Entry {
+    uint64_t size = 0;
+    int64_t lastUsed = 0;
+};
+
+static SE_Mutex mutex;
+static bool indexLoaded = false;
+static bool indexDirty = false;
+static std::unordered_map<std::string, Entry> entries;
+static uint64_t totalBytes = 0;
+
+static std::string cacheFolder() {
+    return OS::getScratchFolderLocation() + "cache/svg/";
+}
+
+static std::string fileName(const Key &key, float scale) {
+    std::string asset = key.asset.substr(0, key.asset.find_last_of('.'));
+    for (char &c : asset) {
+        if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_') c = '_';
+    }
+
+    uint32_t scaleBits;
+    memcpy(&scaleBits, &scale, sizeof(scaleBits));
+
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), "-%08x-%c-%ux%u.bin", scaleBits, key.bitmapHalfQuality ? 'h' : 'f', key.maxTextureWidth, key.maxTextureHeight);
+    return asset + suffix;
+}
+
+// Reads the index of entries and when they were last used, and picks up any files that are missing from it
+// (e.g. after the app was closed without flushing). Expects `mutex` to be locked.
+static void loadIndex() {
+    if (indexLoaded) return;
+    indexLoaded = true;
+
+    std::unordered_map<std::string, int64_t> lastUsed;
+    std::ifstream index(cacheFolder() + "index.txt");
+    std::string line;
+    while (std::getline(index, line)) {
+        std::istringstream fields(line);
+        int64_t time;
+        std::string name;
+        if (fields >> time >> name) lastUsed[name] = time;
+    }
+
+    auto files = FileSystem::listDirectory(cacheFolder());
+    if (!files.has_value()) return;
+
+    for (const std::string &name : files.value()) {
+        if (name.size() < 4 || name.compare(name.size() - 4, 4, ".bin") != 0) continue;
+
+        struct stat st;
+        if (stat((cacheFolder() + name).c_str(), &st) != 0) continue;
+
+        auto it = lastUsed.find(name);
+        Entry &entry = entries[name];
+        entry.size = static_cast<uint64_t>(st.st_size);
+        entry.lastUsed = it != lastUsed.end() ? it->second : 0;
+        totalBytes += entry.size;
+    }
+}
+
+// Deletes the least recently used entries until the cache fits its cap. Expects `mutex` to be locked.
+static void trim() {
+    if (totalBytes <= maxCacheBytes) return;
+
+    std::vector<std::pair<int64_t, std::string>> byAge;
+    byAge.reserve(entries.size());
+    for (const auto &[name, entry] : entries)
+        byAge.emplace_back(entry.lastUsed, name);
+    std::sort(byAge.begin(), byAge.end());
+
+    for (const auto &[lastUsed, name] : byAge) {
+        if (totalBytes <= maxCacheBytes) break;
+        remove((cacheFolder() + name).c_str());
+        totalBytes -= entries[name].size;
+        entries.erase(name);
+    }
+    indexDirty = true;
+}
+
+static void touch(const std::string &name, uint64_t size) {
+    std::lock_guard<SE_Mutex> lock(mutex);
+    loadIndex();
+    Entry &entry = entries[name];
+    totalBytes += size - entry.size;
+    entry.size = size;
+    entry.lastUsed = static_cast<int64_t>(time(nullptr));
+    indexDirty = true;
+}
+
+bool enabled() {
+#ifdef ENABLE_SVG
+    auto setting = Unzip::getSetting("svgCache");
+    return !setting.is_boolean() || setting.get<bool>();
+#else
+    return false;
+#endif
+}
+
+float bucket(float scale) {
+    if (!(scale > 0)) return scale;
+    return std::exp2(std::ceil(std::log2(scale) * 2.0f - 1e-4f) / 2.0f);
+}
+
+unsigned char *load(const Key &key, float scale, int &width, int &height, float &finalScale) {
+    const std::string name = fileName(key, scale);
+    FILE *file = fopen((cacheFolder() + name).c_str(), "rb");
+    if (!file) return nullptr;
+
+    Header header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.byteOrderMark != BYTE_ORDER_MARK || header.version != FORMAT_VERSION ||
+        header.sourceCrc != key.sourceCrc || header.sourceSize != key.sourceSize ||
+        header.width <= 0 || header.height <= 0) {
+        fclose(file);
+        return nullptr;
+    }
+
+    const size_t pixelsSize = static_cast<size_t>(header.width) * header.height * 4;
+    unsigned char *pixels = static_cast<unsigned char *>(malloc(pixelsSize));
+    if (!pixels || fread(pixels, 1, pixelsSize, file) != pixelsSize) {
+        free(pixels);
+        fclose(file);
+        return nullptr;
+    }
+    fclose(file);
+
+    width = header.width;
+    height = header.height;
+    finalScale = header.finalScale;
+    touch(name, sizeof(header) + pixelsSize);
+    return pixels;
+}
+
+void store(const Key &key, float scale, const unsigned char *pixels, int width, int height, float finalScale) {
+    const std::string name = fileName(key, scale);
+    const std::string path = cacheFolder() + name;
+
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.byteOrderMark = BYTE_ORDER_MARK;
+    header.version = FORMAT_VERSION;
+    header.sourceCrc = key.sourceCrc;
+    header.sourceSize = key.sourceSize;
+    header.width = width;
+    header.height = height;
+    header.finalScale = finalScale;
+
+    auto created = FileSystem::createDirectory(cacheFolder());
+    if (!created.has_value()) {
+        Log::logWarning("Failed to create the SVG cache folder: " + created.error());
+        return;
+    }
+
+    // write to a temporary file first so an interrupted write never leaves a truncated raster behind
+    const std::string tempPath = path + ".tmp";
+    FILE *file = fopen(tempPath.c_str(), "wb");
+    if (!file) return;
+
+    const size_t pixelsSize = static_cast<size_t>(width) * height * 4;
+    const bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(pixels, 1, pixelsSize, file) == pixelsSize;
+    if (fclose(file) != 0 || !written) {
+        remove(tempPath.c_str());
+        return;
+    }
+    remove(path.c_str());
+    FileSystem::renameFile(tempPath, path);
+
+    touch(name, sizeof(header) + pixelsSize);
+    std::lock_guard<SE_Mutex> lock(mutex);
+    trim();
+}
+
+void flush() {
+    std::lock_guard<SE_Mutex> lock(mutex);
+    if (!indexDirty) return;
+
+    trim();
+
+    const std::string path = cacheFolder() + "index.txt";
+    std::ofstream index(path + ".tmp", std::ios::trunc);
+    for (const auto &[name, entry] : entries)
+        index << entry.lastUsed << ' ' << name << '\n';
+    index.close();
+    if (!index) return;
+    remove(path.c_str());
+    FileSystem::renameFile(path + ".tmp", path);
+    indexDirty = false;
+}
+
+size_t warm() {
+    if (!enabled()) return 0;
+
+    struct Job {
+        std::string name;
+        bool bitmapHalfQuality;
+        float scale;
+    };
+    std::vector<Job> jobs;
+    std::unordered_set<std::string> queued;
+    for (Sprite *sprite : Scratch::sprites) {
+        if (sprite->isClone) continue;
+        for (const Costume &costume : sprite->costumes) {
+            if (!costume.isSVG || Scratch::costumeImages.count(costume.fullName) != 0 || !queued.insert(costume.fullName).second) continue;
+            jobs.push_back({costume.fullName, Scratch::bitmapHalfQuality && costume.bitmapResolution == 2, Scratch::getCostumeScale(sprite)});
+        }
+    }
+
+    if (!DecodePool::running()) DecodePool::start(DecodePool::configuredWorkerCount());
+    for (const Job &job : jobs)
+        DecodePool::submit(job.name, job.bitmapHalfQuality, job.scale);
+
+    size_t rasterised = 0;
+    for (const Job &job : jobs) {
+        auto image = Scratch::projectType == ProjectType::UNZIPPED
+                         ? createImageFromFile(job.name, true, job.bitmapHalfQuality, job.scale)
+                         : createImageFromZip(job.name, Scratch::sb3InRam ? &Unzip::zipArchive : nullptr, job.bitmapHalfQuality, job.scale);
+        if (!image.has_value()) {
+            Log::logWarning("Failed to rasterise " + job.name + ": " + image.error());
+            continue;
+        }
+        rasterised++;
+    }
+
+    flush();
+    return rasterised;
+}
+
+} // namespace SVGCache
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Keeps rasterised SVG costumes on disk, so later launches can skip parsing and rendering them with LunaSVG.
+ *
+ * Files live in the `cache/svg/` folder of the Scratch Everywhere! folder and hold raw RGBA pixels behind a small
+ * header. An entry is only used when the CRC-32 and size of the SVG it was made from still match. Once the folder
+ * grows past its size cap, the least recently used entries are deleted. Disable it per project with the `svgCache`
+ * setting.
+ */
+namespace SVGCache {
+
+/**
+ * Identifies the SVG a raster was made from, and everything besides the scale that changes how it is rasterised.
+ */
+struct Key {
+    /**
+     * File name of the costume in the project (its MD5 and extension). Empty when the image should not be cached.
+     */
+    std::string asset;
+    uint32_t sourceCrc = 0;
+    uint64_t sourceSize = 0;
+    bool bitmapHalfQuality = false;
+    unsigned int maxTextureWidth = 0;
+    unsigned int maxTextureHeight = 0;
+};
+
+/**
+ * Whether the current project may use the cache.
+ */
+bool enabled();
+
+/**
+ * Loads the raster of `key` at `scale`.
+ * @return The pixels (allocated with `malloc`), or nullptr if nothing usable is cached.
+ */
+unsigned char *load(const Key &key, float scale, int &width, int &height, float &finalScale);
+
+/**
+ * Rounds `scale` up to the nearest half octave. Costumes are only cached at these scales, so a sprite that grows
+ * smoothly reuses a handful of rasters instead of making one per step.
+ */
+float bucket(float scale);
+
+/**
+ * Writes the raster of `key` at `scale` to the cache. `finalScale` is the scale it was actually rendered at.
+ * Only for costumes being loaded or warmed; rasters made while resizing a loaded costume are never written.
+ * Deletes the least recently used entries right away if this puts the cache over its size cap.
+ */
+void store(const Key &key, float scale, const unsigned char *pixels, int width, int height, float finalScale);
+
+/**
+ * Deletes the least recently used entries until the cache fits its size cap, and saves when each entry was last used.
+ */
+void flush();
+
+/**
+ * Rasterises every SVG costume of the loaded project into the cache, at the scale its sprite would load it at.
+ * @return The number of costumes rasterised.
+ */
+size_t warm();
+
+} // namespace SVGCache
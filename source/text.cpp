@@ -128,5 +128,7 @@ void TextObject::cleanupText() {
     TextObjectGL2D::cleanupText();
 #elif defined(RENDERER_OPENGL_CORE)
     TextObjectGLCore::cleanupText();
+#elif defined(RENDERER_HEADLESS)
+    TextObjectHeadless::cleanupText();
 #endif
 }
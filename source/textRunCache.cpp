@@ -0,0 +1,42 @@
+#include "textRunCache.hpp"
+#include <algorithm>
+
+TextRunCache::TextRunCache(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {
+}
+
+const TextRun *TextRunCache::find(const std::string &text, int pixelSize, uint64_t atlasEvictions) {
+    auto it = index.find({text, pixelSize});
+    if (it == index.end()) return nullptr;
+
+    if (it->second->run.atlasEvictions != atlasEvictions) {
+        runs.erase(it->second);
+        index.erase(it);
+        return nullptr;
+    }
+
+    runs.splice(runs.begin(), runs, it->second);
+    return &it->second->run;
+}
+
+const TextRun &TextRunCache::insert(const std::string &text, int pixelSize, TextRun run) {
+    Key key = {text, pixelSize};
+    auto it = index.find(key);
+    if (it != index.end()) {
+        runs.erase(it->second);
+        index.erase(it);
+    }
+
+    runs.push_front({key, std::move(run)});
+    index.emplace(std::move(key), runs.begin());
+
+    while (runs.size() > capacity) {
+        index.erase(runs.back().key);
+        runs.pop_back();
+    }
+    return runs.front().run;
+}
+
+void TextRunCache::clear() {
+    runs.clear();
+    index.clear();
+}
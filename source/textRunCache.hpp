@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * One glyph of a laid out string: where it goes, relative to the top left of the text at scale 1, and where its
+ * pixels are on the glyph atlas.
+ */
+struct TextQuad {
+    float x0, y0, x1, y1;
+    float s0, t0, s1, t1;
+    int page;
+};
+
+/**
+ * A string laid out once, so drawing it again is a single upload of its quads.
+ */
+struct TextRun {
+    std::vector<TextQuad> quads;
+    std::vector<int> pages;      // every atlas page the quads use
+    uint64_t atlasEvictions = 0; // `GlyphAtlas::getEvictions` when it was laid out
+    bool complete = true;        // false if a glyph didn't fit on the atlas and was left out; such runs aren't cached
+};
+
+/**
+ * The most recently drawn runs of one font, keyed by string and pixel size, least recently used dropped first.
+ * Doesn't touch a graphics API.
+ */
+class TextRunCache {
+  public:
+    explicit TextRunCache(size_t capacity);
+
+    /**
+     * The run laid out for `text` at `pixelSize`, or nullptr if there is none or the atlas emptied a page since it
+     * was laid out.
+     */
+    const TextRun *find(const std::string &text, int pixelSize, uint64_t atlasEvictions);
+
+    /**
+     * Stores `run`, replacing any older run for the same string and size.
+     */
+    const TextRun &insert(const std::string &text, int pixelSize, TextRun run);
+
+    void clear();
+    size_t size() const { return runs.size(); }
+    size_t getCapacity() const { return capacity; }
+
+  private:
+    struct Key {
+        std::string text;
+        int pixelSize;
+
+        bool operator==(const Key &other) const { return pixelSize == other.pixelSize && text == other.text; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const { return std::hash<std::string>()(key.text) * 31 + key.pixelSize; }
+    };
+
+    struct Entry {
+        Key key;
+        TextRun run;
+    };
+
+    size_t capacity;
+    std::list<Entry> runs; // most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+};
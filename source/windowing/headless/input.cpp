@@ -1,16 +1,25 @@
+#include <blockExecutor.hpp>
 #include <input.hpp>
 #include <iostream>
 #include <log.hpp>
 #include <os.hpp>
+#include <replay.hpp>
 
 std::array<int, 2> Input::getTouchPosition() {
     return {0, 0};
 }
 
 void Input::getInput() {
+    // input only ever comes from a replay here, the recorded keys already include "any"
+    if (!Replay::applyInput()) return;
+
+    BlockExecutor::executeKeyHats();
+    BlockExecutor::doSpriteClicking();
 }
 
 std::string Input::openSoftwareKeyboard(const char *hintText) {
+    if (Replay::replaying) return Replay::nextAnswer();
+
     Log::log(std::string(hintText));
     std::string input;
     std::getline(std::cin, input);
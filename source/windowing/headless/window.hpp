@@ -2,17 +2,28 @@
 #include <window.hpp>
 
 class WindowHeadless : public WindowSE {
+  private:
+    int width = 0;
+    int height = 0;
+
   public:
-    bool init(int width, int height, const std::string &title) override { return true; }
+    bool init(int width, int height, const std::string &title) override {
+        this->width = width;
+        this->height = height;
+        return true;
+    }
     void cleanup() override {}
 
     bool shouldClose() override { return false; }
     void pollEvents() override {}
     void swapBuffers() override {}
-    void resize(int width, int height) override {}
+    void resize(int width, int height) override {
+        this->width = width;
+        this->height = height;
+    }
 
-    int getWidth() const override { return 0; }
-    int getHeight() const override { return 0; }
+    int getWidth() const override { return width; }
+    int getHeight() const override { return height; }
     float getPixelDensity() const override { return 1.0f; }
     void *getHandle() override { return nullptr; }
 };
@@ -0,0 +1,201 @@
+// Checks the skyline atlas packer: rectangles stay on their page and never overlap, padding added by the caller keeps
+// neighbours apart, full pages roll over to new ones, and repacking keeps all of that true.
+
+#include "test.hpp"
+#include <atlasPacker.hpp>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+struct Random {
+    uint32_t state = 2463534242u;
+    int next(int lo, int hi) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return lo + (int)(state % (uint32_t)(hi - lo + 1));
+    }
+};
+
+bool overlap(const AtlasPacker::Rect &a, const AtlasPacker::Rect &b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+// every live rectangle lies on its page, inside the page, clear of every other one there
+void checkLayout(const AtlasPacker &packer, const std::vector<uint32_t> &ids) {
+    for (size_t i = 0; i < ids.size(); i++) {
+        const AtlasPacker::Allocation &a = packer.get(ids[i]);
+        CHECK(a.page >= 0 && (size_t)a.page < packer.getPageCount());
+        CHECK(a.rect.x >= 0 && a.rect.y >= 0);
+        CHECK_LE(a.rect.x + a.rect.w, packer.getPageWidth());
+        CHECK_LE(a.rect.y + a.rect.h, packer.getPageHeight());
+        for (size_t j = i + 1; j < ids.size(); j++) {
+            const AtlasPacker::Allocation &b = packer.get(ids[j]);
+            if (a.page == b.page && overlap(a.rect, b.rect)) Test::fail(__FILE__, __LINE__, "allocations " + std::to_string(ids[i]) + " and " + std::to_string(ids[j]) + " overlap");
+        }
+    }
+}
+
+// the occupancy of each page is exactly the area of what lives on it
+void checkOccupancy(const AtlasPacker &packer, const std::vector<uint32_t> &ids) {
+    std::vector<double> area(packer.getPageCount());
+    for (uint32_t id : ids) {
+        const AtlasPacker::Allocation &a = packer.get(id);
+        area[a.page] += (double)a.rect.w * a.rect.h;
+    }
+    for (size_t page = 0; page < area.size(); page++) {
+        const double expected = area[page] / ((double)packer.getPageWidth() * packer.getPageHeight());
+        CHECK_LE(std::abs(packer.getOccupancy((int)page) - expected), 1e-6);
+    }
+}
+
+void noOverlap() {
+    AtlasPacker packer(256, 256);
+    Random random;
+    std::vector<uint32_t> ids;
+    for (int i = 0; i < 400; i++) {
+        const auto id = packer.allocate(random.next(1, 80), random.next(1, 80));
+        CHECK(id.has_value());
+        if (id) ids.push_back(*id);
+    }
+    CHECK(packer.getPageCount() > 1);
+    CHECK_EQ(packer.getAllocationCount(), ids.size());
+    checkLayout(packer, ids);
+    checkOccupancy(packer, ids);
+}
+
+// callers pad each image by a border on every side; the images themselves must end up at least two borders apart
+void padding() {
+    const int border = 1;
+    AtlasPacker packer(128, 128);
+    Random random;
+    std::vector<AtlasPacker::Allocation> images;
+    for (int i = 0; i < 120; i++) {
+        const int w = random.next(1, 30), h = random.next(1, 30);
+        const auto id = packer.allocate(w + border * 2, h + border * 2);
+        CHECK(id.has_value());
+        if (!id) continue;
+        AtlasPacker::Allocation image = packer.get(*id);
+        image.rect = {image.rect.x + border, image.rect.y + border, w, h};
+        images.push_back(image);
+    }
+    for (size_t i = 0; i < images.size(); i++) {
+        const AtlasPacker::Rect &a = images[i].rect;
+        CHECK(a.x >= border && a.y >= border);
+        CHECK_LE(a.x + a.w + border, 128);
+        CHECK_LE(a.y + a.h + border, 128);
+        for (size_t j = i + 1; j < images.size(); j++) {
+            if (images[i].page != images[j].page) continue;
+            // grown by a border each, they still don't touch
+            const AtlasPacker::Rect &b = images[j].rect;
+            const AtlasPacker::Rect grown = {a.x - border, a.y - border, a.w + border * 2, a.h + border * 2};
+            const AtlasPacker::Rect grownB = {b.x - border, b.y - border, b.w + border * 2, b.h + border * 2};
+            CHECK(!overlap(grown, grownB));
+        }
+    }
+}
+
+void rollover() {
+    AtlasPacker packer(128, 128);
+    std::vector<uint32_t> ids;
+    for (int i = 0; i < 4; i++)
+        ids.push_back(*packer.allocate(64, 64));
+    CHECK_EQ(packer.getPageCount(), 1u);
+    CHECK_LE(1.0f - packer.getOccupancy(0), 1e-6f);
+
+    // a full page rolls over to a new one, and later pages are only opened when earlier ones are full
+    ids.push_back(*packer.allocate(64, 64));
+    CHECK_EQ(packer.get(ids.back()).page, 1);
+    CHECK_EQ(packer.get(ids.back()).rect.x, 0);
+    CHECK_EQ(packer.get(ids.back()).rect.y, 0);
+    ids.push_back(*packer.allocate(64, 64));
+    CHECK_EQ(packer.get(ids.back()).page, 1);
+    checkLayout(packer, ids);
+
+    // a hole under the skyline stays empty until a repack
+    packer.release(ids[1]);
+    const uint32_t refill = *packer.allocate(32, 32);
+    CHECK_EQ(packer.get(refill).page, 1);
+
+    // but a page emptied by releases starts over from its corner
+    for (uint32_t id : {ids[4], ids[5], refill})
+        packer.release(id);
+    const uint32_t fresh = *packer.allocate(100, 100);
+    CHECK_EQ(packer.get(fresh).page, 1);
+    CHECK_EQ(packer.get(fresh).rect.x, 0);
+    CHECK_EQ(packer.get(fresh).rect.y, 0);
+
+    // what can never fit is refused instead of opening pages
+    CHECK(!packer.allocate(129, 1));
+    CHECK(!packer.allocate(1, 129));
+    CHECK(!packer.allocate(0, 10));
+    CHECK(packer.allocate(128, 128).has_value());
+
+    // with a page limit, a full atlas refuses instead of rolling over
+    AtlasPacker limited(64, 64, 1);
+    CHECK(limited.allocate(64, 32).has_value());
+    CHECK(limited.allocate(64, 32).has_value());
+    CHECK(!limited.allocate(1, 1));
+    CHECK_EQ(limited.getPageCount(), 1u);
+}
+
+void repack() {
+    AtlasPacker packer(128, 128, 2);
+    Random random;
+    std::vector<uint32_t> ids;
+    while (auto id = packer.allocate(random.next(8, 40), random.next(8, 40)))
+        ids.push_back(*id);
+    CHECK_EQ(packer.getPageCount(), 2u);
+    CHECK(!packer.needsRepack());
+
+    // free most of what's there, leaving holes on both pages
+    std::vector<uint32_t> kept;
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (i % 4 == 0) kept.push_back(ids[i]);
+        else packer.release(ids[i]);
+    }
+    CHECK(packer.needsRepack());
+
+    std::vector<AtlasPacker::Allocation> before;
+    for (uint32_t id : kept)
+        before.push_back(packer.get(id));
+    const std::vector<AtlasPacker::Move> moves = packer.repack();
+    CHECK(!packer.needsRepack());
+    CHECK(!moves.empty());
+
+    // every move is reported with where it was and where it went
+    for (const AtlasPacker::Move &move : moves) {
+        const AtlasPacker::Allocation &now = packer.get(move.id);
+        CHECK(now.page == move.to.page && now.rect.x == move.to.rect.x && now.rect.y == move.to.rect.y);
+        CHECK(move.from.rect.w == move.to.rect.w && move.from.rect.h == move.to.rect.h);
+    }
+    // and anything not reported stayed put
+    for (size_t i = 0; i < kept.size(); i++) {
+        bool moved = false;
+        for (const AtlasPacker::Move &move : moves)
+            moved = moved || move.id == kept[i];
+        const AtlasPacker::Allocation &now = packer.get(kept[i]);
+        if (!moved) CHECK(now.page == before[i].page && now.rect.x == before[i].rect.x && now.rect.y == before[i].rect.y);
+    }
+
+    // a quarter of two pages fits on one
+    CHECK_EQ(packer.getPageCount(), 1u);
+    CHECK_EQ(packer.getAllocationCount(), kept.size());
+    checkLayout(packer, kept);
+    checkOccupancy(packer, kept);
+
+    // and the freed page is there to allocate into again
+    CHECK(packer.allocate(128, 128).has_value());
+}
+
+} // namespace
+
+int main() {
+    noOverlap();
+    padding();
+    rollover();
+    repack();
+    return Test::result();
+}
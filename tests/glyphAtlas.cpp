@@ -0,0 +1,132 @@
+// Checks the glyph atlas bookkeeping: glyphs are found again instead of placed twice, keep their border clear of each
+// other, and full atlases empty the page used longest ago, never one touched in the current use.
+
+#include "test.hpp"
+#include <glyphAtlas.hpp>
+#include <vector>
+
+namespace {
+
+bool overlap(const AtlasPacker::Rect &a, const AtlasPacker::Rect &b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+// the page a 30×30 glyph went on, or -1 if it was refused
+int insertOnPage(GlyphAtlas &atlas, uint32_t codepoint) {
+    const auto glyph = atlas.insert(codepoint, 30, 30, 30);
+    return glyph ? glyph->page : -1;
+}
+
+void reuse() {
+    GlyphAtlas atlas(64, 2);
+    atlas.begin();
+    CHECK(atlas.find('a', 16) == nullptr);
+
+    const auto a = atlas.insert('a', 16, 8, 10);
+    CHECK(a.has_value());
+    CHECK_EQ(atlas.getGlyphCount(), 1u);
+
+    // found where it was put, without taking more room
+    const GlyphAtlas::Glyph *found = atlas.find('a', 16);
+    CHECK(found != nullptr);
+    if (found && a) CHECK(found->page == a->page && found->rect.x == a->rect.x && found->rect.y == a->rect.y && found->rect.w == 8 && found->rect.h == 10);
+    CHECK_EQ(atlas.getGlyphCount(), 1u);
+
+    // the same codepoint at another size is another glyph
+    CHECK(atlas.find('a', 17) == nullptr);
+    CHECK(atlas.insert('a', 17, 9, 11).has_value());
+    CHECK_EQ(atlas.getGlyphCount(), 2u);
+    CHECK(atlas.find('a', 16) != nullptr);
+
+    // what can never fit on a page is refused
+    CHECK(!atlas.insert('b', 16, 63, 4));
+    CHECK(!atlas.insert('b', 16, 0, 4));
+    CHECK(atlas.find('b', 16) == nullptr);
+    CHECK_EQ(atlas.getEvictions(), 0u);
+}
+
+// each glyph's rect grown by the border stays on its page and clear of every other one
+void border() {
+    const int border = 2;
+    GlyphAtlas atlas(128, 1, border);
+    atlas.begin();
+    std::vector<GlyphAtlas::Glyph> glyphs;
+    for (uint32_t codepoint = 0; codepoint < 40; codepoint++) {
+        const auto glyph = atlas.insert(codepoint, 12, 5 + codepoint % 7, 6 + codepoint % 5);
+        CHECK(glyph.has_value());
+        if (glyph) glyphs.push_back(*glyph);
+    }
+    for (size_t i = 0; i < glyphs.size(); i++) {
+        const AtlasPacker::Rect &r = glyphs[i].rect;
+        const AtlasPacker::Rect a = {r.x - border, r.y - border, r.w + border * 2, r.h + border * 2};
+        CHECK(a.x >= 0 && a.y >= 0);
+        CHECK_LE(a.x + a.w, atlas.getPageSize());
+        CHECK_LE(a.y + a.h, atlas.getPageSize());
+        for (size_t j = i + 1; j < glyphs.size(); j++) {
+            const AtlasPacker::Rect &s = glyphs[j].rect;
+            if (overlap(a, {s.x - border, s.y - border, s.w + border * 2, s.h + border * 2}))
+                Test::fail(__FILE__, __LINE__, "glyphs " + std::to_string(i) + " and " + std::to_string(j) + " overlap");
+        }
+    }
+}
+
+void eviction() {
+    // pages fit exactly four 30×30 glyphs with their border
+    GlyphAtlas atlas(64, 2);
+    atlas.begin();
+    for (uint32_t codepoint = 0; codepoint < 4; codepoint++)
+        CHECK_EQ(insertOnPage(atlas, codepoint), 0);
+    atlas.begin();
+    for (uint32_t codepoint = 4; codepoint < 8; codepoint++)
+        CHECK_EQ(insertOnPage(atlas, codepoint), 1);
+    CHECK_EQ(atlas.getPageCount(), 2u);
+    CHECK_EQ(atlas.getEvictions(), 0u);
+
+    // every page was touched in this use, so nothing can be emptied for a new glyph
+    CHECK(atlas.find(0, 30) != nullptr);
+    CHECK(!atlas.insert(8, 30, 30, 30));
+    CHECK_EQ(atlas.getEvictions(), 0u);
+    CHECK_EQ(atlas.getGlyphCount(), 8u);
+
+    // page 1 was filled after page 0, but a cached run drawn since used page 0 again, so page 1 is emptied
+    atlas.begin();
+    atlas.touch(0);
+    atlas.begin();
+    const auto glyph = atlas.insert(8, 30, 30, 30);
+    CHECK(glyph.has_value());
+    if (glyph) CHECK_EQ(glyph->page, 1);
+    CHECK_EQ(atlas.getEvictions(), 1u);
+
+    // everything on the emptied page is gone, the rest is still there
+    for (uint32_t codepoint = 0; codepoint < 4; codepoint++)
+        CHECK(atlas.find(codepoint, 30) != nullptr);
+    for (uint32_t codepoint = 4; codepoint < 8; codepoint++)
+        CHECK(atlas.find(codepoint, 30) == nullptr);
+    CHECK(atlas.find(8, 30) != nullptr);
+    CHECK_EQ(atlas.getGlyphCount(), 5u);
+    CHECK_EQ(atlas.getPageCount(), 2u);
+
+    // the emptied page starts over from its corner
+    if (glyph) CHECK(glyph->rect.x == 1 && glyph->rect.y == 1);
+
+    // and the next glyph that doesn't fit empties the other page, now the older one
+    atlas.begin();
+    for (uint32_t codepoint = 9; codepoint < 12; codepoint++)
+        CHECK_EQ(insertOnPage(atlas, codepoint), 1);
+    CHECK_EQ(insertOnPage(atlas, 12), 0);
+    CHECK_EQ(atlas.getEvictions(), 2u);
+    CHECK(atlas.find(0, 30) == nullptr);
+
+    // touching pages that don't exist is harmless
+    atlas.touch(-1);
+    atlas.touch(5);
+}
+
+} // namespace
+
+int main() {
+    reuse();
+    border();
+    eviction();
+    return Test::result();
+}
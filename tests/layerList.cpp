@@ -0,0 +1,141 @@
+// Runs LayerList through random inserts, moves and erases next to a plain vector doing the same, and checks after
+// each step that both hold the same items in the same order: by index, by indexOf, and iterating either way.
+//
+// Usage: test-layerList [steps]
+
+#include "test.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <layerList.hpp>
+#include <vector>
+
+namespace {
+
+struct Random {
+    uint32_t state = 88172645u;
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    size_t below(size_t count) { return count == 0 ? 0 : next() % count; }
+};
+
+void checkSame(const LayerList<int> &list, const std::vector<int> &model) {
+    CHECK_EQ(list.size(), model.size());
+    CHECK_EQ(list.empty(), model.empty());
+    if (list.size() != model.size()) return;
+
+    size_t index = 0;
+    for (int value : list) {
+        CHECK_EQ(value, model[index]);
+        index++;
+    }
+    CHECK_EQ(index, model.size());
+
+    index = model.size();
+    for (auto it = list.rbegin(); it != list.rend(); ++it) {
+        index--;
+        CHECK_EQ(*it, model[index]);
+    }
+
+    for (size_t i = 0; i < model.size(); i++) {
+        CHECK_EQ(list[i], model[i]);
+        CHECK_EQ(list.indexOf(model[i]), i);
+        CHECK(list.contains(model[i]));
+    }
+    if (!model.empty()) {
+        CHECK_EQ(list.front(), model.front());
+        CHECK_EQ(list.back(), model.back());
+        CHECK_EQ(*--list.end(), model.back());
+    }
+}
+
+// what collision asks for: the item just before another one
+void checkPrevious(const LayerList<int> &list, const std::vector<int> &model, size_t index) {
+    auto it = list.find(model[index]);
+    CHECK(it != list.end());
+    if (index == 0) {
+        CHECK(it == list.begin());
+    } else {
+        CHECK_EQ(*--it, model[index - 1]);
+    }
+}
+
+void randomSteps(size_t steps) {
+    LayerList<int> list;
+    std::vector<int> model;
+    Random random;
+    int nextValue = 0;
+
+    for (size_t step = 0; step < steps; step++) {
+        const uint32_t action = random.next() % 16;
+        if (action < 5 || model.size() < 2) {
+            const size_t index = random.below(model.size() + 1);
+            list.insert(index, nextValue);
+            model.insert(model.begin() + index, nextValue);
+            nextValue++;
+        } else if (action < 10) {
+            const int value = model[random.below(model.size())];
+            const size_t index = random.below(model.size());
+            list.move(value, index);
+            model.erase(std::find(model.begin(), model.end(), value));
+            model.insert(model.begin() + index, value);
+        } else if (action < 13) {
+            const int value = model[random.below(model.size())];
+            list.erase(value);
+            model.erase(std::find(model.begin(), model.end(), value));
+        } else if (action < 14) {
+            // like removing every clone when the green flag is clicked
+            const uint32_t every = 2 + random.next() % 4;
+            auto remove = [every](int value) { return value % every == 0; };
+            list.eraseIf(remove);
+            model.erase(std::remove_if(model.begin(), model.end(), remove), model.end());
+        } else {
+            list.push_back(nextValue);
+            model.push_back(nextValue);
+            nextValue++;
+        }
+
+        if (!model.empty()) checkPrevious(list, model, random.below(model.size()));
+        // checking everything is O(n), so do it every so often once the list is big
+        if (model.size() < 64 || step % 97 == 0) checkSame(list, model);
+        if (Test::failures != 0) return;
+    }
+    checkSame(list, model);
+
+    list.clear();
+    CHECK(list.empty());
+    CHECK(list.begin() == list.end());
+}
+
+void edgeCases() {
+    LayerList<int> list;
+    CHECK(list.begin() == list.end());
+    CHECK(list.rbegin() == list.rend());
+    CHECK(list.find(1) == list.end());
+    list.erase(1);
+    CHECK(list.empty());
+
+    // indexes past the end are clamped
+    list.insert(5, 1);
+    list.insert(5, 2);
+    list.move(1, 10);
+    checkSame(list, {2, 1});
+
+    list.eraseIf([](int) { return true; });
+    checkSame(list, {});
+    list.push_back(3);
+    checkSame(list, {3});
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t steps = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+    edgeCases();
+    randomSteps(steps);
+    return Test::result();
+}
@@ -0,0 +1,109 @@
+// Plays a metronome against a simulated audio device and checks that the notes stay on the beat: every note starts
+// exactly where the previous one ended, and waits end at most one project frame before the mixer gets there.
+
+#include "test.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <musicTimeline.hpp>
+
+namespace {
+
+constexpr uint64_t rate = 48000;
+
+struct Device {
+    uint64_t buffer;
+    // buffers the device keeps queued ahead of what it is playing
+    uint64_t queued;
+
+    // what the mixer has mixed by `now`, which is what Mixer::musicPosition reports
+    uint64_t position(uint64_t now) const {
+        return (now / buffer + queued) * buffer;
+    }
+};
+
+// deterministic jitter for when the runtime gets to run each frame
+struct Jitter {
+    uint32_t state = 12345;
+    uint64_t next(uint64_t range) {
+        state = state * 1664525u + 1013904223u;
+        return range == 0 ? 0 : (state >> 8) % range;
+    }
+};
+
+void metronome(int fps, Device device, uint64_t noteLength, bool jitter) {
+    const uint64_t frameLength = rate / fps;
+    const uint64_t slack = frameLength + device.buffer;
+    const uint64_t lateness = jitter ? frameLength / 2 : 0;
+    const int notes = 200;
+
+    Jitter random;
+    uint64_t musicTime = 0;
+    uint64_t firstStart = 0;
+    int played = 0;
+    bool waiting = false;
+
+    // a second in, so the first note starts wherever the mixer is
+    for (uint64_t frame = fps; played < notes || waiting; frame++) {
+        const uint64_t now = frame * frameLength + random.next(lateness);
+        const uint64_t position = device.position(now);
+
+        if (waiting) {
+            if (!MusicTimeline::reached(position, musicTime, frameLength)) continue;
+            waiting = false;
+        }
+        if (played == notes) break;
+
+        const uint64_t start = MusicTimeline::nextStart(musicTime, position, slack);
+        if (played == 0) firstStart = start;
+        // on the beat, however the frames and buffers line up
+        CHECK_EQ(start, firstStart + played * noteLength);
+        // A start the mixer already passed is heard when the command reaches it. That is at most a buffer late, plus
+        // however late the runtime got to this frame.
+        CHECK_LE(std::max(start, position) - start, device.buffer + lateness);
+
+        musicTime = start + noteLength;
+        played++;
+        waiting = true;
+    }
+
+    CHECK_EQ(musicTime, firstStart + notes * noteLength);
+}
+
+// a thread that stopped playing for a while starts its next note now, not back where it left off
+void afterPause() {
+    const uint64_t frameLength = rate / 60;
+    const uint64_t slack = frameLength + 1024;
+    CHECK_EQ(MusicTimeline::nextStart(1000, 2 * rate, slack), 2 * rate);
+    CHECK_EQ(MusicTimeline::nextStart(rate, rate - 500, slack), rate);
+    CHECK_EQ(MusicTimeline::nextStart(rate, rate + slack, slack), rate);
+    CHECK_EQ(MusicTimeline::nextStart(rate, rate + slack + 1, slack), rate + slack + 1);
+}
+
+void reached() {
+    const uint64_t frameLength = rate / 30;
+    CHECK(!MusicTimeline::reached(0, frameLength + 1, frameLength));
+    CHECK(MusicTimeline::reached(1, frameLength + 1, frameLength));
+    CHECK(MusicTimeline::reached(rate, rate, frameLength));
+    CHECK(MusicTimeline::reached(rate + 1, rate, frameLength));
+}
+
+} // namespace
+
+int main() {
+    reached();
+    afterPause();
+
+    for (int fps : {30, 60, 144}) {
+        for (uint64_t buffer : {256, 512, 1024, 2048, 4096}) {
+            for (uint64_t queued : {1, 2}) {
+                // a quarter beat at 60 bpm, and lengths that don't line up with frames or buffers, down to about a frame
+                for (uint64_t noteLength : {12000, 11025, 7919, 1733}) {
+                    metronome(fps, {buffer, queued}, noteLength, false);
+                    metronome(fps, {buffer, queued}, noteLength, true);
+                }
+            }
+        }
+    }
+
+    return Test::result();
+}
@@ -0,0 +1,196 @@
+// Checks which pen strokes PenBuffer merges or drops and the triangles it queues for them: opaque lines that carry on
+// in the same direction merge, dots under an opaque line's round end are dropped, and everything else stays apart.
+
+#include "test.hpp"
+#include <algorithm>
+#include <cmath>
+#include <penBuffer.hpp>
+#include <vector>
+
+namespace {
+
+const PenBuffer::Color red = {255, 0, 0, 255};
+const PenBuffer::Color blue = {0, 0, 255, 255};
+const PenBuffer::Color ghost = {255, 0, 0, 128};
+
+// triangles of a rounded line: the body and a half circle on each end
+size_t lineVertices(float radius) {
+    return 6 + 2 * 3 * PenBuffer::capSegments(radius);
+}
+
+size_t dotVertices(float radius) {
+    return 3 * 2 * PenBuffer::capSegments(radius);
+}
+
+// the distance from (px, py) to the segment from (x1, y1) to (x2, y2)
+float distance(float px, float py, float x1, float y1, float x2, float y2) {
+    const float dx = x2 - x1, dy = y2 - y1;
+    const float lengthSquared = dx * dx + dy * dy;
+    const float t = lengthSquared > 0 ? std::clamp(((px - x1) * dx + (py - y1) * dy) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+    return std::hypot(px - (x1 + t * dx), py - (y1 + t * dy));
+}
+
+// every vertex lies within `radius` of the segment, and the outline reaches out about that far past both ends
+void checkOutline(const std::vector<PenVertex> &vertices, size_t first, size_t count, float x1, float y1, float x2, float y2, float radius) {
+    float farthest = 0;
+    float beyondStart = 0, beyondEnd = 0;
+    const float length = std::hypot(x2 - x1, y2 - y1);
+    for (size_t i = first; i < first + count && i < vertices.size(); i++) {
+        const float d = distance(vertices[i].x, vertices[i].y, x1, y1, x2, y2);
+        farthest = std::max(farthest, d);
+        if (length > 0) {
+            const float along = ((vertices[i].x - x1) * (x2 - x1) + (vertices[i].y - y1) * (y2 - y1)) / length;
+            beyondStart = std::max(beyondStart, -along);
+            beyondEnd = std::max(beyondEnd, along - length);
+        }
+    }
+    CHECK_LE(farthest, radius + 1e-3f);
+    CHECK_LE(radius - 1e-3f, farthest);
+    // the caps are polygons, within a third of a pixel of the circle
+    if (length > 0) {
+        CHECK_LE(radius - 1.0f / 3.0f, beyondStart);
+        CHECK_LE(radius - 1.0f / 3.0f, beyondEnd);
+    }
+}
+
+bool colored(const std::vector<PenVertex> &vertices, size_t first, size_t count, PenBuffer::Color color) {
+    for (size_t i = first; i < first + count && i < vertices.size(); i++) {
+        const PenVertex &v = vertices[i];
+        if (v.r != color.r || v.g != color.g || v.b != color.b || v.a != color.a) return false;
+    }
+    return true;
+}
+
+void collinear() {
+    PenBuffer pen;
+    pen.line(0, 0, 10, 0, 2, red);
+    pen.line(10, 0, 25, 0, 2, red);
+    pen.line(25, 0, 40, 0, 2, red);
+    CHECK_EQ(pen.size(), 1u);
+
+    // one body from the first start to the last end, with a cap at each
+    const std::vector<PenVertex> &vertices = pen.tessellate();
+    CHECK_EQ(vertices.size(), lineVertices(2));
+    checkOutline(vertices, 0, vertices.size(), 0, 0, 40, 0, 2);
+    CHECK(colored(vertices, 0, vertices.size(), red));
+
+    // diagonal lines merge too
+    pen.clear();
+    CHECK(pen.empty());
+    pen.line(0, 0, 3, 4, 1, red);
+    pen.line(3, 4, 9, 12, 1, red);
+    CHECK_EQ(pen.size(), 1u);
+}
+
+void notMerged() {
+    struct Case {
+        const char *name;
+        float x1, y1, x2, y2;
+        float radius;
+        PenBuffer::Color color;
+        bool rounded;
+    };
+    // each follows a red line from (0, 0) to (10, 0) of radius 2
+    const Case cases[] = {
+        {"corner", 10, 0, 10, 10, 2, red, true},
+        {"turning back", 10, 0, 5, 0, 2, red, true},
+        {"gap", 11, 0, 20, 0, 2, red, true},
+        {"other color", 10, 0, 20, 0, 2, blue, true},
+        {"other size", 10, 0, 20, 0, 3, red, true},
+        {"square ends", 10, 0, 20, 0, 2, red, false},
+    };
+    for (const Case &c : cases) {
+        PenBuffer pen;
+        pen.line(0, 0, 10, 0, 2, red);
+        pen.line(c.x1, c.y1, c.x2, c.y2, c.radius, c.color, c.rounded);
+        if (pen.size() != 2) Test::fail(__FILE__, __LINE__, std::string(c.name) + " was merged");
+
+        // both lines come out whole, in the order they were drawn
+        const std::vector<PenVertex> &vertices = pen.tessellate();
+        const size_t second = c.rounded ? lineVertices(c.radius) : 6;
+        CHECK_EQ(vertices.size(), lineVertices(2) + second);
+        checkOutline(vertices, 0, lineVertices(2), 0, 0, 10, 0, 2);
+        if (c.rounded) checkOutline(vertices, lineVertices(2), second, c.x1, c.y1, c.x2, c.y2, c.radius);
+        CHECK(colored(vertices, lineVertices(2), second, c.color));
+    }
+
+    // overlapping translucent ends are visibly darker, so translucent lines are never merged
+    PenBuffer pen;
+    pen.line(0, 0, 10, 0, 2, ghost);
+    pen.line(10, 0, 20, 0, 2, ghost);
+    CHECK_EQ(pen.size(), 2u);
+    CHECK(colored(pen.tessellate(), 0, 2 * lineVertices(2), ghost));
+}
+
+void dots() {
+    // a dot at an opaque round end is already covered by the cap
+    PenBuffer pen;
+    pen.line(0, 0, 10, 0, 2, red);
+    pen.dot(10, 0, 2, red);
+    pen.dot(10, 0, 1, red);
+    CHECK_EQ(pen.size(), 1u);
+
+    // so is a dot drawn twice
+    pen.clear();
+    pen.dot(5, 5, 2, red);
+    pen.dot(5, 5, 2, red);
+    CHECK_EQ(pen.size(), 1u);
+    CHECK_EQ(pen.tessellate().size(), dotVertices(2));
+    checkOutline(pen.tessellate(), 0, dotVertices(2), 5, 5, 5, 5, 2);
+
+    // anything the end doesn't cover is kept
+    const struct {
+        const char *name;
+        float x, y, radius;
+        PenBuffer::Color color;
+        bool rounded;
+    } kept[] = {
+        {"bigger", 10, 0, 3, red, true},
+        {"elsewhere", 0, 0, 2, red, true},
+        {"other color", 10, 0, 2, blue, true},
+        {"translucent", 10, 0, 2, ghost, true},
+        {"square", 10, 0, 2, red, false},
+    };
+    for (const auto &c : kept) {
+        PenBuffer pen;
+        pen.line(0, 0, 10, 0, 2, c.color.a == 255 ? red : ghost);
+        pen.dot(c.x, c.y, c.radius, c.color, c.rounded);
+        if (pen.size() != 2) Test::fail(__FILE__, __LINE__, std::string(c.name) + " dot was dropped");
+    }
+
+    // a line with square ends doesn't cover a round dot
+    pen.clear();
+    pen.line(0, 0, 10, 0, 2, red, false);
+    pen.dot(10, 0, 2, red);
+    CHECK_EQ(pen.size(), 2u);
+
+    // square dots are one quad
+    pen.clear();
+    pen.dot(5, 5, 2, red, false);
+    const std::vector<PenVertex> &square = pen.tessellate();
+    CHECK_EQ(square.size(), 6u);
+    for (const PenVertex &v : square)
+        CHECK(std::abs(v.x - 5) == 2 && std::abs(v.y - 5) == 2);
+}
+
+void capSegments() {
+    CHECK_EQ(PenBuffer::capSegments(0.1f), 2);
+    CHECK_EQ(PenBuffer::capSegments(100000.0f), 64);
+    for (float radius = 0.5f; radius <= 200.0f; radius *= 1.3f) {
+        const int segments = PenBuffer::capSegments(radius);
+        // the chord of each step stays within a third of a pixel of the circle, unless the cap hit the limit
+        const double sagitta = radius * (1.0 - std::cos(3.14159265358979323846 / segments / 2.0));
+        if (segments < 64) CHECK_LE(sagitta, 1.0 / 3.0 + 1e-6);
+        CHECK_LE(segments, PenBuffer::capSegments(radius * 1.3f));
+    }
+}
+
+} // namespace
+
+int main() {
+    collinear();
+    notMerged();
+    dots();
+    capSegments();
+    return Test::result();
+}
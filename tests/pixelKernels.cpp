@@ -0,0 +1,191 @@
+// Runs every version of the pixel kernels this CPU supports and checks it writes exactly the same bytes as the scalar
+// one, for every color and alpha pair and for lengths that leave a tail after the vector loops. Also checks that
+// downsampling never lets the color of transparent pixels into the edge next to them.
+
+#include "test.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <pixelKernels.hpp>
+#include <vector>
+
+namespace {
+
+// deterministic bytes for the test images
+struct Random {
+    uint32_t state = 2463534242u;
+    uint8_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return static_cast<uint8_t>(state >> 24);
+    }
+};
+
+// every (color, alpha) pair once, in LunaSVG's BGRA order, with each channel taking a different color
+std::vector<uint8_t> colorAlphaPairs() {
+    std::vector<uint8_t> pixels;
+    for (int a = 0; a < 256; a++) {
+        for (int c = 0; c < 256; c++) {
+            pixels.push_back(static_cast<uint8_t>(c));
+            pixels.push_back(static_cast<uint8_t>(255 - c));
+            pixels.push_back(static_cast<uint8_t>(c * 7));
+            pixels.push_back(static_cast<uint8_t>(a));
+        }
+    }
+    return pixels;
+}
+
+std::vector<uint8_t> unpremultiplied(const std::vector<uint8_t> &src, size_t offset, size_t count) {
+    // a byte either side catches writes past the end
+    std::vector<uint8_t> dst(count * 4 + 2, 0xCD);
+    PixelKernels::unpremultiply(src.data() + offset * 4, dst.data() + 1, count);
+    return dst;
+}
+
+std::vector<uint8_t> downsampled(const std::vector<uint8_t> &src, int width, int height) {
+    const int dstWidth = std::max(1, width / 2);
+    const int dstHeight = std::max(1, height / 2);
+    std::vector<uint8_t> dst(static_cast<size_t>(dstWidth) * dstHeight * 4 + 2, 0xCD);
+    PixelKernels::downsample2x(src.data(), width, height, dst.data() + 1, dstWidth, dstHeight);
+    return dst;
+}
+
+std::vector<uint8_t> alpha(const std::vector<uint8_t> &src, size_t offset, size_t stride, size_t count) {
+    std::vector<uint8_t> dst(count + 2, 0xCD);
+    PixelKernels::extractAlpha(src.data() + offset * 4, stride, dst.data() + 1, count);
+    return dst;
+}
+
+// A 512×512 image of 2×2 blocks, one for every (color, alpha) pair: the top left pixel has the pair, and the other
+// three are transparent with random colors.
+std::vector<uint8_t> transparentEdges(Random &random) {
+    std::vector<uint8_t> pixels(512 * 512 * 4);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = (i % 4 == 3) ? 0 : random.next();
+    for (int a = 0; a < 256; a++) {
+        for (int c = 0; c < 256; c++) {
+            uint8_t *pixel = &pixels[(static_cast<size_t>(a) * 2 * 512 + c * 2) * 4];
+            pixel[0] = static_cast<uint8_t>(c);
+            pixel[1] = static_cast<uint8_t>(255 - c);
+            pixel[2] = static_cast<uint8_t>(c * 7);
+            pixel[3] = static_cast<uint8_t>(a);
+        }
+    }
+    return pixels;
+}
+
+// A 512×2 image of 2×2 blocks, one for every color: opaque on the top row and transparent with random colors below.
+std::vector<uint8_t> opaqueEdges(Random &random) {
+    std::vector<uint8_t> pixels(512 * 2 * 4);
+    for (int x = 0; x < 512; x++) {
+        const int c = x / 2;
+        uint8_t *top = &pixels[x * 4];
+        top[0] = static_cast<uint8_t>(c);
+        top[1] = static_cast<uint8_t>(255 - c);
+        top[2] = static_cast<uint8_t>(c * 7);
+        top[3] = 255;
+        uint8_t *bottom = &pixels[(512 + x) * 4];
+        bottom[0] = random.next();
+        bottom[1] = random.next();
+        bottom[2] = random.next();
+        bottom[3] = 0;
+    }
+    return pixels;
+}
+
+// each block keeps exactly the color of its visible pixels, and fully transparent blocks come out transparent black
+void scalarDownsampleEdges(const std::vector<uint8_t> &transparent, const std::vector<uint8_t> &opaque) {
+    const std::vector<uint8_t> out = downsampled(transparent, 512, 512);
+    for (int a = 0; a < 256; a++) {
+        for (int c = 0; c < 256; c++) {
+            const uint8_t *pixel = &out[1 + (static_cast<size_t>(a) * 256 + c) * 4];
+            const uint8_t expected[4] = {
+                static_cast<uint8_t>(a > 0 ? c : 0),
+                static_cast<uint8_t>(a > 0 ? 255 - c : 0),
+                static_cast<uint8_t>(a > 0 ? c * 7 : 0),
+                static_cast<uint8_t>((a + 2) / 4)};
+            if (std::memcmp(pixel, expected, 4) != 0)
+                Test::fail(__FILE__, __LINE__, "transparent edge of color " + std::to_string(c) + " and alpha " + std::to_string(a) + " changed color");
+        }
+    }
+
+    const std::vector<uint8_t> half = downsampled(opaque, 512, 2);
+    for (int c = 0; c < 256; c++) {
+        const uint8_t *pixel = &half[1 + c * 4];
+        const uint8_t expected[4] = {static_cast<uint8_t>(c), static_cast<uint8_t>(255 - c), static_cast<uint8_t>(c * 7), 128};
+        if (std::memcmp(pixel, expected, 4) != 0)
+            Test::fail(__FILE__, __LINE__, "opaque edge of color " + std::to_string(c) + " changed color");
+    }
+}
+
+// what unpremultiply is defined as, to check the scalar version against
+void scalarUnpremultiply(const std::vector<uint8_t> &pairs) {
+    const std::vector<uint8_t> out = unpremultiplied(pairs, 0, pairs.size() / 4);
+    for (size_t i = 0; i < pairs.size(); i += 4) {
+        const int a = pairs[i + 3];
+        const auto channel = [a](int c) { return a > 0 && a < 255 ? static_cast<uint8_t>(c * 255 / a) : static_cast<uint8_t>(c); };
+        CHECK_EQ(out[1 + i + 0], channel(pairs[i + 2]));
+        CHECK_EQ(out[1 + i + 1], channel(pairs[i + 1]));
+        CHECK_EQ(out[1 + i + 2], channel(pairs[i + 0]));
+        CHECK_EQ(out[1 + i + 3], a);
+    }
+}
+
+using Outputs = std::vector<std::vector<uint8_t>>;
+
+// everything the kernels write for the test inputs, with the current backend
+Outputs run(const std::vector<uint8_t> &pairs, const std::vector<uint8_t> &image, const std::vector<uint8_t> &transparent, const std::vector<uint8_t> &opaque) {
+    Outputs outputs;
+    outputs.push_back(unpremultiplied(pairs, 0, pairs.size() / 4));
+
+    // short runs and tails at every alignment, over alphas that take the solid and the dividing paths
+    const size_t mixed = 250 * 256 + 200;
+    for (size_t offset = 0; offset < 4; offset++) {
+        for (size_t count = 0; count <= 70; count++) {
+            outputs.push_back(unpremultiplied(pairs, mixed + offset, count));
+            outputs.push_back(unpremultiplied(pairs, offset, count));
+            outputs.push_back(alpha(image, offset, 1, count));
+        }
+    }
+    for (size_t stride = 2; stride <= 3; stride++)
+        outputs.push_back(alpha(image, 0, stride, 100));
+
+    for (int width = 1; width <= 41; width++) {
+        for (int height = 1; height <= 4; height++)
+            outputs.push_back(downsampled(image, width, height));
+    }
+    outputs.push_back(downsampled(transparent, 512, 512));
+    outputs.push_back(downsampled(opaque, 512, 2));
+    return outputs;
+}
+
+} // namespace
+
+int main() {
+    const std::vector<uint8_t> pairs = colorAlphaPairs();
+    std::vector<uint8_t> image(41 * 4 * 4 * 4);
+    Random random;
+    for (uint8_t &byte : image)
+        byte = random.next();
+    const std::vector<uint8_t> transparent = transparentEdges(random);
+    const std::vector<uint8_t> opaque = opaqueEdges(random);
+
+    CHECK(PixelKernels::useBackend("scalar"));
+    CHECK(!PixelKernels::useBackend("mmx"));
+    scalarUnpremultiply(pairs);
+    scalarDownsampleEdges(transparent, opaque);
+    const Outputs expected = run(pairs, image, transparent, opaque);
+
+    for (const char *backend : PixelKernels::backends()) {
+        CHECK(PixelKernels::useBackend(backend));
+        CHECK(std::strcmp(PixelKernels::backend(), backend) == 0);
+        const Outputs actual = run(pairs, image, transparent, opaque);
+        CHECK_EQ(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size() && i < actual.size(); i++) {
+            if (actual[i] != expected[i]) Test::fail(__FILE__, __LINE__, std::string(backend) + ": output " + std::to_string(i) + " differs from scalar");
+        }
+    }
+
+    return Test::result();
+}
@@ -0,0 +1,651 @@
+#!/usr/bin/env python3
+"""
+Writes the small .sb3 projects the golden runs step through.
+
+Every project is built from the script descriptions below so changes stay reviewable; rerun this after editing it, then
+refresh the goldens with `scratch-everywhere <project>.sb3 --golden tests/golden --frames 60 --update-goldens`.
+
+The projects avoid anything that depends on the platform or the clock: no random numbers, no costume bounds (edges,
+touching, bouncing), no input and no sound playback.
+"""
+
+import hashlib
+import json
+import os
+import sys
+import zipfile
+
+COSTUME_SVG = b'<svg xmlns="http://www.w3.org/2000/svg" width="%d" height="%d"><rect width="%d" height="%d" fill="%s"/></svg>'
+COLORS = ["#4c97ff", "#ffab19", "#59c059", "#ff6680"]
+
+
+def costume(name, index, stage=False):
+    width, height = (480, 360) if stage else (40 + index * 10, 40)
+    svg = COSTUME_SVG % (width, height, width, height, (b"#ffffff" if stage else COLORS[index % len(COLORS)].encode()))
+    asset = hashlib.md5(svg).hexdigest()
+    return {
+        "name": name,
+        "bitmapResolution": 1,
+        "dataFormat": "svg",
+        "assetId": asset,
+        "md5ext": asset + ".svg",
+        "rotationCenterX": width / 2,
+        "rotationCenterY": height / 2,
+    }, svg
+
+
+class Target:
+    def __init__(self, project, name, stage=False, costumes=1, **props):
+        self.project = project
+        self.name = name
+        self.stage = stage
+        self.blocks = {}
+        self.variables = {}
+        self.lists = {}
+        self.costumes = []
+        for i in range(costumes):
+            self.add_costume()
+        self.props = props
+
+    def add_costume(self):
+        data, svg = costume(("backdrop" if self.stage else "costume") + str(len(self.costumes) + 1), len(self.costumes), self.stage)
+        self.costumes.append(data)
+        self.project.assets[data["md5ext"]] = svg
+
+    # ids are derived from a counter so regenerating gives identical files
+    def id(self):
+        self.project.counter += 1
+        return "%s-%d" % (self.name.replace(" ", "_"), self.project.counter)
+
+    def variable(self, name, value=0):
+        vid = "var-" + name
+        self.variables[vid] = [name, value]
+        return (name, vid)
+
+    def list(self, name, items=None):
+        lid = "list-" + name
+        self.lists[lid] = [name, items or []]
+        return (name, lid)
+
+    def block(self, opcode, inputs=None, fields=None, shadow=False, mutation=None):
+        bid = self.id()
+        block = {"opcode": opcode, "next": None, "parent": None, "inputs": {}, "fields": fields or {}, "shadow": shadow, "topLevel": False}
+        if mutation is not None:
+            block["mutation"] = mutation
+        self.blocks[bid] = block
+        for key, value in (inputs or {}).items():
+            block["inputs"][key] = self.input(bid, value)
+        return bid
+
+    def input(self, parent, value):
+        if isinstance(value, Stack):
+            first = self.chain(value.blocks, parent)
+            return [2, first]
+        if isinstance(value, Reporter):
+            self.blocks[value.id]["parent"] = parent
+            return [2, value.id] if value.boolean else [3, value.id, [10, ""]]
+        if isinstance(value, Var):
+            return [3, [12, value.ref[0], value.ref[1]], [10, ""]]
+        if isinstance(value, Broadcast):
+            return [1, [11, value.name, "broadcast-" + value.name]]
+        if isinstance(value, Menu):
+            self.blocks[value.id]["parent"] = parent
+            return [1, value.id]
+        if isinstance(value, (int, float)):
+            return [1, [4, num(value)]]
+        return [1, [10, str(value)]]
+
+    def chain(self, ids, parent=None):
+        for i, bid in enumerate(ids):
+            self.blocks[bid]["parent"] = ids[i - 1] if i > 0 else parent
+            self.blocks[bid]["next"] = ids[i + 1] if i + 1 < len(ids) else None
+        return ids[0] if ids else None
+
+    def script(self, hat, *body):
+        self.blocks[hat]["topLevel"] = True
+        self.blocks[hat]["x"] = 0
+        self.blocks[hat]["y"] = 0
+        self.chain([hat] + list(body))
+
+    # ---- shorthands ----
+
+    def r(self, opcode, inputs=None, fields=None, boolean=False):
+        return Reporter(self.block(opcode, inputs, fields), boolean)
+
+    def menu(self, opcode, field, value):
+        return Menu(self.block(opcode, fields={field: [value, None]}, shadow=True))
+
+    def flag(self):
+        return self.block("event_whenflagclicked")
+
+    def set_var(self, var, value):
+        return self.block("data_setvariableto", {"VALUE": value}, {"VARIABLE": [var[0], var[1]]})
+
+    def change_var(self, var, value):
+        return self.block("data_changevariableby", {"VALUE": value}, {"VARIABLE": [var[0], var[1]]})
+
+    def define(self, proccode, names, warp, *body):
+        ids = ["arg-" + n for n in names]
+        prototype_inputs = {}
+        proto = self.block("procedures_prototype", shadow=True, mutation={
+            "tagName": "mutation", "children": [], "proccode": proccode,
+            "argumentids": json.dumps(ids), "argumentnames": json.dumps(names),
+            "argumentdefaults": json.dumps([""] * len(names)), "warp": "true" if warp else "false"})
+        for aid, name in zip(ids, names):
+            reporter = self.block("argument_reporter_string_number", fields={"VALUE": [name, None]}, shadow=True)
+            self.blocks[reporter]["parent"] = proto
+            prototype_inputs[aid] = [1, reporter]
+        self.blocks[proto]["inputs"] = prototype_inputs
+        definition = self.block("procedures_definition")
+        self.blocks[definition]["inputs"]["custom_block"] = [1, proto]
+        self.blocks[proto]["parent"] = definition
+        self.script(definition, *body)
+
+    def call(self, proccode, names, warp, *args):
+        ids = ["arg-" + n for n in names]
+        return self.block("procedures_call", dict(zip(ids, args)), mutation={
+            "tagName": "mutation", "children": [], "proccode": proccode,
+            "argumentids": json.dumps(ids), "warp": "true" if warp else "false"})
+
+    def arg(self, name):
+        return self.r("argument_reporter_string_number", fields={"VALUE": [name, None]})
+
+    def to_json(self, layer):
+        out = {
+            "isStage": self.stage,
+            "name": self.name,
+            "variables": self.variables,
+            "lists": self.lists,
+            "broadcasts": {"broadcast-" + b: b for b in self.project.broadcasts} if self.stage else {},
+            "blocks": self.blocks,
+            "comments": {},
+            "currentCostume": self.props.get("currentCostume", 0),
+            "costumes": self.costumes,
+            "sounds": [],
+            "volume": 100,
+            "layerOrder": layer,
+        }
+        if self.stage:
+            out.update({"tempo": 60, "videoTransparency": 50, "videoState": "on", "textToSpeechLanguage": None})
+        else:
+            out.update({
+                "visible": self.props.get("visible", True),
+                "x": self.props.get("x", 0),
+                "y": self.props.get("y", 0),
+                "size": self.props.get("size", 100),
+                "direction": self.props.get("direction", 90),
+                "draggable": False,
+                "rotationStyle": "all around",
+            })
+        return out
+
+
+class Reporter:
+    def __init__(self, bid, boolean):
+        self.id = bid
+        self.boolean = boolean
+
+
+class Menu:
+    def __init__(self, bid):
+        self.id = bid
+
+
+class Stack:
+    def __init__(self, *blocks):
+        self.blocks = list(blocks)
+
+
+class Var:
+    def __init__(self, ref):
+        self.ref = ref
+
+
+class Broadcast:
+    def __init__(self, name):
+        self.name = name
+
+
+def num(value):
+    return str(int(value)) if float(value).is_integer() else repr(value)
+
+
+class Project:
+    def __init__(self, name, extensions=()):
+        self.name = name
+        self.counter = 0
+        self.assets = {}
+        self.broadcasts = []
+        self.extensions = list(extensions)
+        self.stage = Target(self, "Stage", stage=True)
+        self.sprites = []
+
+    def sprite(self, name="Sprite1", **props):
+        sprite = Target(self, name, **props)
+        self.sprites.append(sprite)
+        return sprite
+
+    def write(self, directory):
+        targets = [self.stage.to_json(0)] + [s.to_json(i + 1) for i, s in enumerate(self.sprites)]
+        project = {"targets": targets, "monitors": [], "extensions": self.extensions, "meta": {"semver": "3.0.0", "vm": "0.2.0", "agent": ""}}
+        path = os.path.join(directory, self.name + ".sb3")
+        with zipfile.ZipFile(path, "w", zipfile.ZIP_DEFLATED) as zf:
+            entries = [("project.json", json.dumps(project, sort_keys=True).encode())] + sorted(self.assets.items())
+            for name, data in entries:
+                info = zipfile.ZipInfo(name, date_time=(2020, 1, 1, 0, 0, 0))
+                info.compress_type = zipfile.ZIP_DEFLATED
+                zf.writestr(info, data)
+
+
+PROJECTS = []
+
+
+def project(fn):
+    PROJECTS.append(fn)
+    return fn
+
+
+# ---- motion ----
+
+@project
+def motion_goto(p):
+    s = p.sprite()
+    s.script(s.flag(), s.block("motion_gotoxy", {"X": 50, "Y": -30}), s.block("motion_changexby", {"DX": 15}), s.block("motion_changeyby", {"DY": -5}))
+
+
+@project
+def motion_steps(p):
+    s = p.sprite()
+    s.script(s.flag(), s.block("motion_pointindirection", {"DIRECTION": 45}), s.block("motion_movesteps", {"STEPS": 100}), s.block("motion_turnright", {"DEGREES": 45}), s.block("motion_movesteps", {"STEPS": 20}))
+
+
+@project
+def motion_direction(p):
+    s = p.sprite()
+    s.script(s.flag(), s.block("motion_pointindirection", {"DIRECTION": -90}), s.block("motion_turnleft", {"DEGREES": 120}),
+             s.block("motion_setrotationstyle", fields={"STYLE": ["left-right", None]}))
+
+
+@project
+def motion_setxy(p):
+    s = p.sprite(x=10, y=10)
+    s.script(s.flag(), s.block("motion_setx", {"X": -120}), s.block("motion_sety", {"Y": 75.5}))
+
+
+@project
+def motion_glide(p):
+    s = p.sprite()
+    s.script(s.flag(), s.block("motion_glidesecstoxy", {"SECS": 0.5, "X": 100, "Y": 50}), s.block("motion_glidesecstoxy", {"SECS": 0.25, "X": -40, "Y": 20}))
+
+
+@project
+def motion_repeat_move(p):
+    s = p.sprite()
+    s.script(s.flag(), s.block("control_repeat", {"TIMES": 12, "SUBSTACK": Stack(s.block("motion_changexby", {"DX": 5}), s.block("motion_turnright", {"DEGREES": 15}))}))
+
+
+@project
+def motion_reporters(p):
+    s = p.sprite(x=30, y=-40, direction=120)
+    x = s.variable("x")
+    y = s.variable("y")
+    d = s.variable("direction")
+    s.script(s.flag(), s.set_var(x, s.r("motion_xposition")), s.set_var(y, s.r("motion_yposition")), s.set_var(d, s.r("motion_direction")))
+
+
+# ---- looks ----
+
+@project
+def looks_size(p):
+    s = p.sprite()
+    s.script(s.flag(), s.block("looks_setsizeto", {"SIZE": 150}), s.block("looks_changesizeby", {"CHANGE": -25}))
+
+
+@project
+def looks_effects(p):
+    s = p.sprite()
+    s.script(s.flag(), s.block("looks_seteffectto", {"VALUE": 50}, {"EFFECT": ["GHOST", None]}),
+             s.block("looks_changeeffectby", {"CHANGE": 25}, {"EFFECT": ["COLOR", None]}),
+             s.block("looks_seteffectto", {"VALUE": -20}, {"EFFECT": ["BRIGHTNESS", None]}),
+             s.block("looks_changeeffectby", {"CHANGE": 10}, {"EFFECT": ["GHOST", None]}))
+
+
+@project
+def looks_clear_effects(p):
+    s = p.sprite()
+    s.script(s.flag(), s.block("looks_seteffectto", {"VALUE": 80}, {"EFFECT": ["GHOST", None]}),
+             s.block("looks_seteffectto", {"VALUE": 30}, {"EFFECT": ["PIXELATE", None]}),
+             s.block("looks_cleargraphiceffects"),
+             s.block("looks_seteffectto", {"VALUE": 40}, {"EFFECT": ["WHIRL", None]}))
+
+
+@project
+def looks_costumes(p):
+    s = p.sprite(costumes=3)
+    s.script(s.flag(), s.block("looks_switchcostumeto", {"COSTUME": s.menu("looks_costume", "COSTUME", "costume3")}), s.block("looks_nextcostume"), s.block("looks_nextcostume"))
+
+
+@project
+def looks_costume_reporter(p):
+    s = p.sprite(costumes=3)
+    n = s.variable("number")
+    name = s.variable("name")
+    s.script(s.flag(), s.block("looks_nextcostume"),
+             s.set_var(n, s.r("looks_costumenumbername", fields={"NUMBER_NAME": ["number", None]})),
+             s.set_var(name, s.r("looks_costumenumbername", fields={"NUMBER_NAME": ["name", None]})))
+
+
+@project
+def looks_backdrops(p):
+    s = p.stage
+    s.add_costume()
+    s.script(s.flag(), s.block("looks_nextbackdrop"))
+
+
+@project
+def looks_hide(p):
+    s = p.sprite()
+    other = p.sprite("Sprite2")
+    s.script(s.flag(), s.block("looks_hide"))
+    other.script(other.flag(), other.block("looks_hide"), other.block("looks_show"))
+
+
+@project
+def looks_layers(p):
+    a = p.sprite("A")
+    b = p.sprite("B")
+    c = p.sprite("C")
+    a.script(a.flag(), a.block("looks_gotofrontback", fields={"FRONT_BACK": ["front", None]}))
+    c.script(c.flag(), c.block("control_wait", {"DURATION": 0.1}), c.block("looks_goforwardbackwardlayers", {"NUM": 1}, {"FORWARD_BACKWARD": ["backward", None]}))
+    b.script(b.flag(), b.block("control_wait", {"DURATION": 0.2}), b.block("looks_gotofrontback", fields={"FRONT_BACK": ["back", None]}))
+
+
+# ---- data ----
+
+@project
+def data_variables(p):
+    s = p.sprite()
+    a = s.variable("a")
+    b = p.stage.variable("global", "")
+    s.script(s.flag(), s.set_var(a, 5), s.change_var(a, 3), s.set_var(b, "hello"), s.change_var(a, -0.5))
+
+
+@project
+def data_lists(p):
+    s = p.sprite()
+    items = s.list("items")
+    s.script(s.flag(),
+             s.block("data_deletealloflist", fields={"LIST": list(items)}),
+             s.block("data_addtolist", {"ITEM": "apple"}, {"LIST": list(items)}),
+             s.block("data_addtolist", {"ITEM": "banana"}, {"LIST": list(items)}),
+             s.block("data_addtolist", {"ITEM": 3}, {"LIST": list(items)}),
+             s.block("data_insertatlist", {"ITEM": "first", "INDEX": 1}, {"LIST": list(items)}),
+             s.block("data_replaceitemoflist", {"INDEX": 3, "ITEM": "cherry"}, {"LIST": list(items)}),
+             s.block("data_deleteoflist", {"INDEX": "last"}, {"LIST": list(items)}))
+
+
+@project
+def data_list_reporters(p):
+    s = p.sprite()
+    items = s.list("items", ["a", "b", "c", "b"])
+    length = s.variable("length")
+    index = s.variable("index")
+    item = s.variable("item")
+    contains = s.variable("contains")
+    s.script(s.flag(),
+             s.set_var(length, s.r("data_lengthoflist", fields={"LIST": list(items)})),
+             s.set_var(index, s.r("data_itemnumoflist", {"ITEM": "b"}, {"LIST": list(items)})),
+             s.set_var(item, s.r("data_itemoflist", {"INDEX": 3}, {"LIST": list(items)})),
+             s.set_var(contains, s.r("data_listcontainsitem", {"ITEM": "c"}, {"LIST": list(items)}, boolean=True)))
+
+
+@project
+def data_stage_list(p):
+    stage = p.stage
+    log = stage.list("log")
+    s = p.sprite()
+    s.script(s.flag(), s.block("control_repeat", {"TIMES": 4, "SUBSTACK": Stack(s.block("data_addtolist", {"ITEM": s.r("motion_xposition")}, {"LIST": list(log)}), s.block("motion_changexby", {"DX": 7}))}))
+
+
+# ---- operators ----
+
+@project
+def operators_arithmetic(p):
+    s = p.sprite()
+    results = [s.variable("r%d" % i) for i in range(7)]
+    s.script(s.flag(),
+             s.set_var(results[0], s.r("operator_add", {"NUM1": 7, "NUM2": 5})),
+             s.set_var(results[1], s.r("operator_subtract", {"NUM1": 7, "NUM2": 12})),
+             s.set_var(results[2], s.r("operator_multiply", {"NUM1": 6, "NUM2": 7})),
+             s.set_var(results[3], s.r("operator_divide", {"NUM1": 7, "NUM2": 2})),
+             s.set_var(results[4], s.r("operator_mod", {"NUM1": -7, "NUM2": 3})),
+             s.set_var(results[5], s.r("operator_round", {"NUM": 2.5})),
+             s.set_var(results[6], s.r("operator_add", {"NUM1": 0.1, "NUM2": 0.2})))
+
+
+@project
+def operators_mathop(p):
+    s = p.sprite()
+    ops = ["abs", "floor", "ceiling", "sqrt", "sin", "cos", "10 ^"]
+    inputs = [-3.5, 2.7, 2.1, 16, 30, 60, 2]
+    refs = [s.variable(op.replace(" ^", "pow")) for op in ops]
+    body = [s.set_var(ref, s.r("operator_mathop", {"NUM": value}, {"OPERATOR": [op, None]})) for ref, op, value in zip(refs, ops, inputs)]
+    s.script(s.flag(), *body)
+
+
+@project
+def operators_strings(p):
+    s = p.sprite()
+    joined = s.variable("joined")
+    letter = s.variable("letter")
+    length = s.variable("length")
+    contains = s.variable("contains")
+    s.script(s.flag(),
+             s.set_var(joined, s.r("operator_join", {"STRING1": "hello ", "STRING2": "world"})),
+             s.set_var(letter, s.r("operator_letter_of", {"LETTER": 2, "STRING": "scratch"})),
+             s.set_var(length, s.r("operator_length", {"STRING": "everywhere"})),
+             s.set_var(contains, s.r("operator_contains", {"STRING1": "Scratch", "STRING2": "CRA"}, boolean=True)))
+
+
+@project
+def operators_compare(p):
+    s = p.sprite()
+    refs = [s.variable("c%d" % i) for i in range(6)]
+    s.script(s.flag(),
+             s.set_var(refs[0], s.r("operator_lt", {"OPERAND1": 9, "OPERAND2": 10}, boolean=True)),
+             s.set_var(refs[1], s.r("operator_gt", {"OPERAND1": "apple", "OPERAND2": "Banana"}, boolean=True)),
+             s.set_var(refs[2], s.r("operator_equals", {"OPERAND1": "ABC", "OPERAND2": "abc"}, boolean=True)),
+             s.set_var(refs[3], s.r("operator_equals", {"OPERAND1": "1.0", "OPERAND2": 1}, boolean=True)),
+             s.set_var(refs[4], s.r("operator_and", {"OPERAND1": s.r("operator_lt", {"OPERAND1": 1, "OPERAND2": 2}, boolean=True),
+                                                      "OPERAND2": s.r("operator_not", {"OPERAND": s.r("operator_gt", {"OPERAND1": 1, "OPERAND2": 2}, boolean=True)}, boolean=True)}, boolean=True)),
+             s.set_var(refs[5], s.r("operator_or", {"OPERAND1": s.r("operator_equals", {"OPERAND1": 1, "OPERAND2": 2}, boolean=True)}, boolean=True)))
+
+
+# ---- control ----
+
+@project
+def control_repeat(p):
+    s = p.sprite()
+    count = s.variable("count")
+    s.script(s.flag(), s.set_var(count, 0), s.block("control_repeat", {"TIMES": 10, "SUBSTACK": Stack(s.change_var(count, 2))}))
+
+
+@project
+def control_repeat_until(p):
+    s = p.sprite()
+    n = s.variable("n")
+    s.script(s.flag(), s.set_var(n, 1),
+             s.block("control_repeat_until", {"CONDITION": s.r("operator_gt", {"OPERAND1": Var(n), "OPERAND2": 100}, boolean=True),
+                                              "SUBSTACK": Stack(s.set_var(n, s.r("operator_multiply", {"NUM1": Var(n), "NUM2": 3})))}))
+
+
+@project
+def control_if_else(p):
+    s = p.sprite()
+    evens = s.variable("evens")
+    odds = s.variable("odds")
+    i = s.variable("i")
+    s.script(s.flag(), s.set_var(evens, 0), s.set_var(odds, 0), s.set_var(i, 0),
+             s.block("control_repeat", {"TIMES": 9, "SUBSTACK": Stack(
+                 s.change_var(i, 1),
+                 s.block("control_if_else", {"CONDITION": s.r("operator_equals", {"OPERAND1": s.r("operator_mod", {"NUM1": Var(i), "NUM2": 2}), "OPERAND2": 0}, boolean=True),
+                                             "SUBSTACK": Stack(s.change_var(evens, 1)), "SUBSTACK2": Stack(s.change_var(odds, 1))}))}))
+
+
+@project
+def control_wait(p):
+    s = p.sprite()
+    step = s.variable("step")
+    s.script(s.flag(), s.set_var(step, 1), s.block("control_wait", {"DURATION": 0.5}), s.set_var(step, 2), s.block("control_wait", {"DURATION": 0.5}), s.set_var(step, 3))
+
+
+@project
+def control_wait_until(p):
+    s = p.sprite()
+    ready = s.variable("ready")
+    done = s.variable("done")
+    s.script(s.flag(), s.set_var(ready, 0), s.block("control_wait_until", {"CONDITION": s.r("operator_equals", {"OPERAND1": Var(ready), "OPERAND2": 1}, boolean=True)}), s.set_var(done, "yes"))
+    s.script(s.flag(), s.block("control_wait", {"DURATION": 0.3}), s.set_var(ready, 1))
+
+
+@project
+def control_stop(p):
+    s = p.sprite()
+    n = s.variable("n")
+    s.script(s.flag(), s.set_var(n, 0), s.block("control_repeat", {"TIMES": 10, "SUBSTACK": Stack(
+        s.change_var(n, 1),
+        s.block("control_if", {"CONDITION": s.r("operator_equals", {"OPERAND1": Var(n), "OPERAND2": 4}, boolean=True),
+                               "SUBSTACK": Stack(s.block("control_stop", fields={"STOP_OPTION": ["this script", None]}, mutation={"tagName": "mutation", "children": [], "hasnext": "false"}))}))}))
+
+
+@project
+def control_clones(p):
+    s = p.sprite()
+    total = p.stage.variable("clones started")
+    s.script(s.flag(), s.set_var(total, 0), s.block("control_repeat", {"TIMES": 3, "SUBSTACK": Stack(s.block("control_create_clone_of", {"CLONE_OPTION": s.menu("control_create_clone_of_menu", "CLONE_OPTION", "_myself_")}), s.block("motion_changexby", {"DX": 30}))}))
+    s.script(s.block("control_start_as_clone"), s.change_var(total, 1), s.block("motion_changeyby", {"DY": 40}))
+
+
+@project
+def control_delete_clones(p):
+    s = p.sprite()
+    s.script(s.flag(), s.block("control_repeat", {"TIMES": 4, "SUBSTACK": Stack(s.block("control_create_clone_of", {"CLONE_OPTION": s.menu("control_create_clone_of_menu", "CLONE_OPTION", "_myself_")}), s.block("motion_changexby", {"DX": 20}))}))
+    s.script(s.block("control_start_as_clone"),
+             s.block("control_if", {"CONDITION": s.r("operator_gt", {"OPERAND1": s.r("motion_xposition"), "OPERAND2": 30}, boolean=True),
+                                    "SUBSTACK": Stack(s.block("control_delete_this_clone"))}))
+
+
+# ---- events ----
+
+@project
+def events_broadcast(p):
+    p.broadcasts.append("go")
+    s = p.sprite()
+    other = p.sprite("Receiver")
+    got = other.variable("received", 0)
+    s.script(s.flag(), s.block("event_broadcast", {"BROADCAST_INPUT": Broadcast("go")}), s.block("event_broadcast", {"BROADCAST_INPUT": Broadcast("go")}))
+    other.script(other.block("event_whenbroadcastreceived", fields={"BROADCAST_OPTION": ["go", "broadcast-go"]}), other.change_var(got, 1), other.block("motion_changexby", {"DX": 10}))
+
+
+@project
+def events_broadcast_wait(p):
+    p.broadcasts.append("work")
+    s = p.sprite()
+    order = p.stage.list("order")
+    s.script(s.flag(), s.block("data_addtolist", {"ITEM": "before"}, {"LIST": list(order)}),
+             s.block("event_broadcastandwait", {"BROADCAST_INPUT": Broadcast("work")}),
+             s.block("data_addtolist", {"ITEM": "after"}, {"LIST": list(order)}))
+    s.script(s.block("event_whenbroadcastreceived", fields={"BROADCAST_OPTION": ["work", "broadcast-work"]}),
+             s.block("control_wait", {"DURATION": 0.2}), s.block("data_addtolist", {"ITEM": "worked"}, {"LIST": list(order)}))
+
+
+# ---- procedures ----
+
+@project
+def procedures_args(p):
+    s = p.sprite()
+    result = s.variable("result")
+    s.define("add %s to %s", ["a", "b"], True, s.set_var(result, s.r("operator_add", {"NUM1": s.arg("a"), "NUM2": s.arg("b")})))
+    s.script(s.flag(), s.call("add %s to %s", ["a", "b"], True, 12, 30))
+
+
+@project
+def procedures_recursion(p):
+    s = p.sprite()
+    result = s.variable("result")
+    s.define("factorial %s", ["n"], True,
+             s.block("control_if", {"CONDITION": s.r("operator_gt", {"OPERAND1": s.arg("n"), "OPERAND2": 1}, boolean=True),
+                                    "SUBSTACK": Stack(s.set_var(result, s.r("operator_multiply", {"NUM1": Var(result), "NUM2": s.arg("n")})),
+                                                      s.call("factorial %s", ["n"], True, s.r("operator_subtract", {"NUM1": s.arg("n"), "NUM2": 1})))}))
+    s.script(s.flag(), s.set_var(result, 1), s.call("factorial %s", ["n"], True, 6))
+
+
+@project
+def procedures_screen_refresh(p):
+    s = p.sprite()
+    s.define("walk %s", ["steps"], False, s.block("control_repeat", {"TIMES": s.arg("steps"), "SUBSTACK": Stack(s.block("motion_changexby", {"DX": 3}))}))
+    s.script(s.flag(), s.call("walk %s", ["steps"], False, 10), s.block("motion_changeyby", {"DY": 10}))
+
+
+# ---- pen, sound, sensing, music ----
+
+@project
+def pen_state(p):
+    p.extensions.append("pen")
+    s = p.sprite()
+    s.script(s.flag(), s.block("pen_clear"), s.block("pen_penDown"), s.block("pen_setPenSizeTo", {"SIZE": 4}),
+             s.block("pen_changePenSizeBy", {"SIZE": 1.5}),
+             s.block("pen_setPenColorParamTo", {"COLOR_PARAM": s.menu("pen_menu_colorParam", "colorParam", "color"), "VALUE": 30}),
+             s.block("pen_changePenColorParamBy", {"COLOR_PARAM": s.menu("pen_menu_colorParam", "colorParam", "transparency"), "VALUE": 20}),
+             s.block("motion_gotoxy", {"X": 60, "Y": 60}), s.block("pen_penUp"))
+
+
+@project
+def sound_effects(p):
+    s = p.sprite()
+    s.script(s.flag(), s.block("sound_setvolumeto", {"VOLUME": 40}), s.block("sound_changevolumeby", {"VOLUME": -15}),
+             s.block("sound_seteffectto", {"VALUE": 50}, {"EFFECT": ["PITCH", None]}),
+             s.block("sound_changeeffectby", {"VALUE": -30}, {"EFFECT": ["PAN", None]}))
+
+
+@project
+def sensing_of(p):
+    target = p.sprite("Target", x=42, y=-17, direction=75)
+    s = p.sprite("Watcher")
+    x = s.variable("x")
+    d = s.variable("direction")
+    secret = target.variable("secret", 99)
+    s.script(s.flag(),
+             s.set_var(x, s.r("sensing_of", {"OBJECT": s.menu("sensing_of_object_menu", "OBJECT", "Target")}, {"PROPERTY": ["x position", None]})),
+             s.set_var(d, s.r("sensing_of", {"OBJECT": s.menu("sensing_of_object_menu", "OBJECT", "Target")}, {"PROPERTY": ["direction", None]})),
+             s.block("motion_gotoxy", {"X": s.r("sensing_of", {"OBJECT": s.menu("sensing_of_object_menu", "OBJECT", "Target")}, {"PROPERTY": ["secret", None]}), "Y": 0}))
+
+
+@project
+def sensing_drag_mode(p):
+    s = p.sprite()
+    s.script(s.flag(), s.block("sensing_setdragmode", fields={"DRAG_MODE": ["draggable", None]}))
+
+
+@project
+def music_tempo(p):
+    p.extensions.append("music")
+    s = p.sprite()
+    tempo = s.variable("tempo")
+    s.script(s.flag(), s.block("music_setTempo", {"TEMPO": 90}), s.block("music_changeTempo", {"TEMPO": 30}), s.set_var(tempo, s.r("music_getTempo")))
+
+
+def main():
+    directory = os.path.dirname(os.path.abspath(__file__))
+    only = set(sys.argv[1:])
+    for fn in PROJECTS:
+        if only and fn.__name__ not in only:
+            continue
+        p = Project(fn.__name__)
+        fn(p)
+        p.write(directory)
+    print("Wrote %d projects to %s" % (len(PROJECTS) if not only else len(only), directory))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,174 @@
+// Plays sine sweeps and tones through the mixer's resampler at several pitches, mixing in blocks of uneven sizes, and
+// checks the result against the ideal resampled signal: no clicks where blocks meet, and little distortion.
+
+#include "test.hpp"
+#include <algorithm>
+#include <cmath>
+#include <resampler.hpp>
+#include <vector>
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+
+// input frames per output frame: 22050 and 44100 Hz sounds at 48 kHz, and pitch changes on top
+const double steps[] = {22050.0 / 48000.0, 44100.0 / 48000.0, 1.0, 0.5, 1.5, 2.0, 2.75};
+
+struct Sound {
+    int channels;
+    int frames;
+    // the phase of the sine at input frame `x`, which may be fractional
+    double (*phase)(double x);
+
+    std::vector<float> samples() const {
+        std::vector<float> out;
+        for (int i = 0; i < frames; i++) {
+            for (int c = 0; c < channels; c++)
+                out.push_back(channel(c, phase(i)));
+        }
+        return out;
+    }
+
+    // the left channel is the sine, the right one a quieter cosine, and any others noise the mixer must ignore
+    static float channel(int c, double phase) {
+        if (c == 0) return (float)(0.8 * std::sin(phase));
+        if (c == 1) return (float)(0.5 * std::cos(phase));
+        return c % 2 == 0 ? 1.0f : -1.0f;
+    }
+};
+
+// a logarithmic sweep from 20 Hz up to a fifth of the sample rate of a 22050 Hz sound, over the whole sound
+constexpr int sweepFrames = 30000;
+double sweepPhase(double x) {
+    const double f0 = 20.0 / 22050.0, f1 = 0.2;
+    const double k = std::log(f1 / f0) / sweepFrames;
+    return 2.0 * pi * f0 * (std::exp(k * x) - 1.0) / k;
+}
+
+// a tone at a tenth of the input rate
+double tonePhase(double x) {
+    return 2.0 * pi * 0.1 * x;
+}
+
+// Resamples `sound` through Resampler::mix, `blockSizes` output frames at a time, cycling through them.
+std::vector<float> play(const Sound &sound, double step, bool cubic, const std::vector<int> &blockSizes, int windowSamples) {
+    const std::vector<float> input = sound.samples();
+    size_t readPosition = 0;
+    const auto read = [&](float *dst, int frames) {
+        const int n = std::min(frames, (int)(input.size() - readPosition) / sound.channels);
+        std::copy(input.begin() + readPosition, input.begin() + readPosition + n * sound.channels, dst);
+        readPosition += n * sound.channels;
+        return n;
+    };
+
+    Resampler::State state;
+    std::vector<float> window(windowSamples);
+    std::vector<float> out;
+    bool playing = true;
+    for (size_t block = 0; playing; block++) {
+        const int frames = blockSizes[block % blockSizes.size()];
+        const size_t start = out.size();
+        out.resize(start + frames * 2, 0.0f);
+        playing = Resampler::mix(state, read, sound.channels, step, cubic, 1.0f, 1.0f, window.data(), windowSamples, out.data() + start, frames);
+    }
+    return out;
+}
+
+struct Error {
+    double signal = 0;
+    double noise = 0;
+    double largest = 0;
+
+    // signal to error ratio in dB
+    double snr() const { return 10.0 * std::log10(signal / noise); }
+};
+
+// compares both output channels with the sound sampled exactly where the output frames fall
+Error compare(const Sound &sound, double step, const std::vector<float> &out) {
+    Error error;
+    // skip the first frames, whose taps reach back before the sound started, and stop before the end rings out
+    const int last = (int)((sound.frames - 4) / step);
+    for (int n = 4; n < last && (size_t)n * 2 + 1 < out.size(); n++) {
+        const double phase = sound.phase(n * step);
+        for (int c = 0; c < 2; c++) {
+            // mono sounds play on both sides
+            const double ideal = Sound::channel(sound.channels == 1 ? 0 : c, phase);
+            const double e = out[n * 2 + c] - ideal;
+            error.signal += ideal * ideal;
+            error.noise += e * e;
+            error.largest = std::max(error.largest, std::abs(e));
+        }
+    }
+    return error;
+}
+
+void sweep() {
+    const std::vector<int> whole = {1 << 20};
+    const std::vector<int> uneven = {1, 7, 256, 3, 1024, 61, 2, 500};
+
+    for (int channels : {1, 2, 6}) {
+        const Sound sound = {channels, sweepFrames, sweepPhase};
+        for (double step : steps) {
+            const std::vector<float> reference = play(sound, step, true, whole, (sweepFrames + 16) * channels);
+            // small windows make the resampler decode in chunks inside each block too
+            for (int windowSamples : {64 * channels, 8192}) {
+                const std::vector<float> blocked = play(sound, step, true, uneven, windowSamples);
+
+                // splitting the output into blocks must not change it beyond float rounding
+                double seam = 0;
+                for (size_t i = 0; i < std::min(reference.size(), blocked.size()); i++)
+                    seam = std::max(seam, (double)std::abs(reference[i] - blocked[i]));
+                CHECK_LE(seam, 1e-4);
+
+                // and no output frame may be far off, which is what a click looks like
+                const Error error = compare(sound, step, blocked);
+                CHECK_LE(error.largest, 0.05);
+                CHECK_LE(40.0, error.snr());
+            }
+
+            // the cubic resampler has to do clearly better than the linear one (both are exact at whole steps)
+            const Error cubic = compare(sound, step, reference);
+            const Error linear = compare(sound, step, play(sound, step, false, whole, (sweepFrames + 16) * channels));
+            CHECK_LE(cubic.noise, linear.noise * 0.5);
+        }
+    }
+}
+
+// harmonic distortion plus noise of a tone, from what's left after fitting out the tone itself
+void tone() {
+    const Sound sound = {1, 20000, tonePhase};
+    for (double step : steps) {
+        const std::vector<float> out = play(sound, step, true, {333, 17, 1024}, 8192);
+        const int last = (int)((sound.frames - 4) / step);
+        const double w = 2.0 * pi * 0.1 * step;
+
+        // least squares fit of a sin + b cos at the output frequency
+        double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0;
+        for (int n = 4; n < last; n++) {
+            const double s = std::sin(w * n), c = std::cos(w * n), y = out[n * 2];
+            ss += s * s, cc += c * c, sc += s * c, ys += y * s, yc += y * c;
+        }
+        const double det = ss * cc - sc * sc;
+        const double a = (ys * cc - yc * sc) / det, b = (yc * ss - ys * sc) / det;
+
+        double fundamental = 0, rest = 0;
+        for (int n = 4; n < last; n++) {
+            const double fit = a * std::sin(w * n) + b * std::cos(w * n);
+            const double residual = out[n * 2] - fit;
+            fundamental += fit * fit;
+            rest += residual * residual;
+        }
+        const double thd = 10.0 * std::log10(rest / fundamental);
+        CHECK_LE(thd, -45.0);
+        // the tone keeps its level
+        CHECK_LE(std::abs(std::sqrt(a * a + b * b) - 0.8), 0.01);
+    }
+}
+
+} // namespace
+
+int main() {
+    sweep();
+    tone();
+    return Test::result();
+}
@@ -0,0 +1,182 @@
+// Checks the instance data and draw calls the OpenGL core renderer's SpriteBatch builds, and the damage SpriteDamage
+// reports, without a GL context.
+
+#include "test.hpp"
+#include <cmath>
+#include <sprite_batch_gl_core.hpp>
+#include <vector>
+
+namespace {
+
+const unsigned int textureA = 1, textureB = 2;
+const unsigned int sprites = 10, effects = 11;
+
+SpriteInstance quad(unsigned int texture, unsigned int program, uint32_t order, float x = 0.0f) {
+    ImageRenderParams params;
+    params.x = x;
+    SpriteInstance instance = SpriteBatch::makeInstance(params, 16, 16, 16, 16, texture, program);
+    instance.order = order;
+    return instance;
+}
+
+// where the unit quad's point (u, v) lands on screen
+void place(const SpriteInstance &instance, float u, float v, float &x, float &y) {
+    x = instance.transform[0] * u + instance.transform[2] * v + instance.translate[0];
+    y = instance.transform[1] * u + instance.transform[3] * v + instance.translate[1];
+}
+
+bool near(float a, float b) {
+    return std::abs(a - b) < 1e-3f;
+}
+
+void instanceData() {
+    ImageSubrect subrect = {8, 4, 16, 8};
+    ImageRenderParams params;
+    params.x = 100;
+    params.y = 50;
+    params.scale = 2;
+    params.opacity = 0.5f;
+    params.brightness = -30;
+    params.colorEffect = 0.25f;
+    params.fisheyeEffect = 1.5f;
+    params.whirlEffect = 90;
+    params.pixelateEffect = 4;
+    params.mosaicEffect = 3;
+    params.subrect = &subrect;
+
+    const SpriteInstance instance = SpriteBatch::makeInstance(params, 32, 32, 64, 32, textureA, effects);
+    // the subrect sets the size and the texture coordinates
+    CHECK(near(instance.transform[0], 32) && near(instance.transform[3], 16));
+    CHECK(near(instance.transform[1], 0) && near(instance.transform[2], 0));
+    CHECK(near(instance.uvRect[0], 8.0f / 64) && near(instance.uvRect[1], 4.0f / 32));
+    CHECK(near(instance.uvRect[2], 24.0f / 64) && near(instance.uvRect[3], 12.0f / 32));
+    CHECK(instance.texSize[0] == 32 && instance.texSize[1] == 32);
+
+    CHECK_EQ(instance.opacity, 0.5f);
+    CHECK_EQ(instance.brightness, -30.0f);
+    CHECK_EQ(instance.color, 0.25f);
+    CHECK_EQ(instance.fisheye, 1.5f);
+    CHECK_EQ(instance.whirl, 90.0f);
+    CHECK_EQ(instance.pixelate, 4.0f);
+    CHECK_EQ(instance.mosaic, 3.0f);
+    CHECK(instance.atlasRect[0] == 0 && instance.atlasRect[1] == 0 && instance.atlasRect[2] == 1 && instance.atlasRect[3] == 1);
+    CHECK_EQ(instance.texture, textureA);
+    CHECK_EQ(instance.program, effects);
+    CHECK_EQ(instance.order, 0u);
+
+    // centered quads rotate about their middle
+    float cx, cy, rx, ry;
+    place(instance, 0.5f, 0.5f, cx, cy);
+    params.rotation = 1.0f;
+    const SpriteInstance rotated = SpriteBatch::makeInstance(params, 32, 32, 64, 32, textureA, effects);
+    place(rotated, 0.5f, 0.5f, rx, ry);
+    CHECK(near(cx, rx) && near(cy, ry));
+
+    // flipping mirrors the quad, which then starts where the unflipped one ends, as Image_GLCore::render placed it
+    params.rotation = 0;
+    params.flip = true;
+    const SpriteInstance flipped = SpriteBatch::makeInstance(params, 32, 32, 64, 32, textureA, effects);
+    float fx0, fy0, fx1, fy1, x0, y0, x1, y1;
+    place(instance, 0, 0, x0, y0);
+    place(instance, 1, 1, x1, y1);
+    place(flipped, 0, 0, fx0, fy0);
+    place(flipped, 1, 1, fx1, fy1);
+    CHECK(flipped.transform[0] < 0);
+    CHECK(near(fx1, x1) && near(fx0, x1 + (x1 - x0)));
+    CHECK(near(fy0, y0) && near(fy1, y1));
+}
+
+void drawCalls() {
+    SpriteBatch batch;
+
+    // neighbours on the same texture and program share a call, whatever their effects
+    SpriteInstance ghost = quad(textureA, sprites, 0);
+    ghost.opacity = 0.25f;
+    ghost.whirl = 45;
+    batch.add(quad(textureA, sprites, 0));
+    batch.add(ghost);
+    batch.add(quad(textureB, sprites, 0));
+    batch.add(quad(textureB, effects, 0));
+    batch.add(quad(textureA, sprites, 0));
+    batch.build();
+
+    const std::vector<SpriteDrawCall> &calls = batch.getDrawCalls();
+    CHECK_EQ(calls.size(), 4u);
+    if (calls.size() == 4) {
+        CHECK(calls[0].texture == textureA && calls[0].program == sprites && calls[0].first == 0 && calls[0].count == 2);
+        CHECK(calls[1].texture == textureB && calls[1].program == sprites && calls[1].first == 2 && calls[1].count == 1);
+        CHECK(calls[2].texture == textureB && calls[2].program == effects && calls[2].first == 3 && calls[2].count == 1);
+        CHECK(calls[3].texture == textureA && calls[3].program == sprites && calls[3].first == 4 && calls[3].count == 1);
+    }
+    CHECK_EQ(batch.getInstances()[1].whirl, 45.0f);
+
+    batch.clear();
+    CHECK(batch.getInstances().empty() && batch.getDrawCalls().empty());
+}
+
+void layers() {
+    SpriteBatch batch;
+
+    // queued out of layer order; equal layers keep the order they were queued in
+    batch.add(quad(textureA, sprites, 2, 1));
+    batch.add(quad(textureB, sprites, 1, 2));
+    batch.add(quad(textureA, sprites, 2, 3));
+    batch.add(quad(textureB, sprites, 1, 4));
+    batch.add(quad(textureA, sprites, 0, 5));
+    batch.build();
+
+    const std::vector<SpriteInstance> &instances = batch.getInstances();
+    const float expectedX[] = {5, 2, 4, 1, 3};
+    CHECK_EQ(instances.size(), 5u);
+    for (size_t i = 0; i < 5 && i < instances.size(); i++) {
+        float x, y;
+        place(instances[i], 0.5f, 0.5f, x, y);
+        CHECK(near(x, expectedX[i] + 0.5f));
+    }
+
+    // A on layer 0 can't merge with A on layer 2 across the B in between
+    const std::vector<SpriteDrawCall> &calls = batch.getDrawCalls();
+    CHECK_EQ(calls.size(), 3u);
+    if (calls.size() == 3) {
+        CHECK(calls[0].texture == textureA && calls[0].count == 1);
+        CHECK(calls[1].texture == textureB && calls[1].first == 1 && calls[1].count == 2);
+        CHECK(calls[2].texture == textureA && calls[2].first == 3 && calls[2].count == 2);
+    }
+}
+
+void damage() {
+    int cat, dog;
+    SpriteDamage tracker;
+    std::vector<const void *> keys = {&cat, &dog};
+    std::vector<SpriteInstance> frame = {quad(textureA, sprites, 0, 0), quad(textureB, sprites, 0, 100)};
+
+    const SpriteDamage::Rect first = tracker.update(keys, frame);
+    CHECK(first.left < -1e30f && first.right > 1e30f);
+    CHECK(tracker.update(keys, frame).empty());
+
+    // a sprite that moves damages where it was and where it is
+    frame[1] = quad(textureB, sprites, 0, 200);
+    const SpriteDamage::Rect moved = tracker.update(keys, frame);
+    const SpriteDamage::Rect was = SpriteDamage::bounds(quad(textureB, sprites, 0, 100));
+    const SpriteDamage::Rect now = SpriteDamage::bounds(frame[1]);
+    CHECK(near(moved.left, was.left) && near(moved.right, now.right));
+
+    // one that goes away damages where it was
+    keys.pop_back();
+    frame.pop_back();
+    const SpriteDamage::Rect removed = tracker.update(keys, frame);
+    CHECK(near(removed.left, now.left) && near(removed.right, now.right));
+
+    tracker.invalidate();
+    CHECK(!tracker.update(keys, frame).empty());
+}
+
+} // namespace
+
+int main() {
+    instanceData();
+    drawCalls();
+    layers();
+    damage();
+    return Test::result();
+}
@@ -0,0 +1,146 @@
+// Hammers the mixer's command queue the way the game uses it: the runtime starts, changes and stops sounds through
+// Mixer's API while an audio thread keeps calling Mixer::requestSound, and whenever the queue is full sendCommand
+// suspends the audio thread and applies the rest itself. Every command must be applied exactly once and in order: a
+// stopped sound ends up finished, the one left playing plays at the last volume it was given, and the mixer never
+// reads a sound after letting go of it.
+//
+// Usage: test-spscQueue [seconds]
+
+#include "test.hpp"
+#include <atomic>
+#include <audiostack.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <log.hpp>
+#include <os.hpp>
+#include <runtime.hpp>
+#include <string>
+#include <thread>
+#include <unzip.hpp>
+#include <vector>
+
+namespace {
+
+constexpr float level = 0.25f;
+
+std::atomic<bool> running{true};
+// keeps the audio thread from calling back, like a device that's late, so the queue fills up
+std::atomic<bool> held{false};
+std::atomic<uint64_t> readsAfterFinish{0};
+
+// a sound that never ends, at a constant level
+int tone(SoundStream *stream, float *output, int frames) {
+    if (stream->finished.load(std::memory_order_acquire)) readsAfterFinish++;
+    for (int i = 0; i < frames; i++)
+        output[i] = level;
+    return frames;
+}
+
+SoundStream *play(const std::string &name) {
+    SoundStream *stream = new SoundStream(name, tone, 1, Mixer::rate);
+    stream->auto_clean = true;
+    return stream;
+}
+
+struct Random {
+    uint32_t state = 88172645u;
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const double seconds = argc > 1 ? std::atof(argv[1]) : 2.0;
+    Mixer::init();
+
+    std::thread audio([] {
+        Random random;
+        std::vector<short> output(Mixer::rate / 10 * 2);
+        while (running.load(std::memory_order_relaxed)) {
+            if (!held.load()) Mixer::requestSound(output.data(), 64 + random.next() % 2048);
+            // devices call back at uneven intervals
+            const uint32_t wait = random.next() % 64;
+            if (wait < 48) std::this_thread::yield();
+            else std::this_thread::sleep_for(std::chrono::microseconds(wait * 4));
+        }
+    });
+
+    const char *names[] = {"pop", "meow", "drum", "boing", "zap", "chord"};
+    Random random;
+    uint64_t commands = 0;
+    float volume = 0.0f;
+    const auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    while (std::chrono::steady_clock::now() < end) {
+        // mostly a few commands a frame, now and then more than the queue holds while the device is late
+        const bool flood = random.next() % 16 == 0;
+        if (flood) held.store(true);
+        const uint32_t burst = flood ? 300 + random.next() % 200 : random.next() % 8;
+        for (uint32_t i = 0; i < burst; i++) {
+            const std::string name = names[random.next() % 6];
+            const uint32_t action = random.next() % 8;
+            if (action == 0) play(name);
+            else if (action == 1) Mixer::stopSound(name);
+            else Mixer::setSoundVolume(name, volume = volume >= 100.0f ? 1.0f : volume + 1.0f);
+            commands++;
+        }
+        if (flood) held.store(false);
+
+        Mixer::update();
+        std::this_thread::yield();
+    }
+
+    // leave one sound playing, and take over the consuming side for good
+    for (const char *name : names)
+        Mixer::stopSound(name);
+    SoundStream *last = play("last");
+    running.store(false);
+    audio.join();
+    std::vector<short> output(2048 * 2);
+    Mixer::requestSound(output.data(), 2048);
+
+    // one volume more than the queue's 256 commands, so the last one finds it full and has to be applied after the
+    // ones queued before it
+    for (int step = 1; step <= 257; step++)
+        Mixer::setSoundVolume("last", static_cast<float>(282 - step));
+    Mixer::requestSound(output.data(), 2048);
+    Mixer::update();
+
+    CHECK(commands > 0);
+    CHECK_EQ(readsAfterFinish.load(), 0u);
+    for (SoundStream *stream : Mixer::streams) {
+        if (stream != last && !stream->finished.load()) Test::fail(__FILE__, __LINE__, "stopped sound " + stream->name + " still playing");
+    }
+    CHECK(!last->finished.load());
+    const short expected = static_cast<short>(level * 0.25f * 32767.0f);
+    CHECK_EQ(output[output.size() - 2], expected);
+    CHECK_EQ(output[output.size() - 1], expected);
+
+    Mixer::cleanupAudio();
+    return Test::result();
+}
+
+// audiostack.cpp also loads sounds from the project and reads a few runtime settings, none of which are used here
+int Scratch::FPS = 30;
+float Scratch::tempo = 60.0f;
+ProjectType Scratch::projectType = ProjectType::UNZIPPED;
+std::string Unzip::filePath;
+bool Unzip::UnpackedInSD = false;
+mz_zip_archive Unzip::zipArchive;
+void *Unzip::getFileInSB3(const std::string &fileName, size_t *outSize) {
+    return nullptr;
+}
+int Unzip::findFile(mz_zip_archive *zip, const std::string &fileName) {
+    return -1;
+}
+std::string OS::getRomFSLocation() {
+    return "";
+}
+void Log::log(std::string message) {}
+void Log::logError(std::string message) {}
+void Log::logCritical(std::string message, bool fatal) {}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+/**
+ * Just enough to write the unit tests in this directory. Each test is its own executable: the CHECK macros report a
+ * failure and carry on, and `main` returns `Test::result()` so CTest sees whether any of them failed.
+ */
+namespace Test {
+
+inline int failures = 0;
+
+inline void fail(const char *file, int line, const std::string &message) {
+    std::fprintf(stderr, "%s:%d: %s\n", file, line, message.c_str());
+    failures++;
+}
+
+template <typename A, typename B>
+std::string describe(const char *expression, const A &a, const B &b) {
+    std::ostringstream out;
+    out << expression << " (" << +a << " vs " << +b << ")";
+    return out.str();
+}
+
+inline int result() {
+    if (failures != 0) std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace Test
+
+#define CHECK(condition)                                                                                               \
+    do {                                                                                                               \
+        if (!(condition)) Test::fail(__FILE__, __LINE__, #condition);                                                  \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                                                 \
+    do {                                                                                                               \
+        const auto &checkA = (a);                                                                                      \
+        const auto &checkB = (b);                                                                                      \
+        if (!(checkA == checkB)) Test::fail(__FILE__, __LINE__, Test::describe(#a " == " #b, checkA, checkB));         \
+    } while (0)
+
+#define CHECK_LE(a, b)                                                                                                 \
+    do {                                                                                                               \
+        const auto &checkA = (a);                                                                                      \
+        const auto &checkB = (b);                                                                                      \
+        if (!(checkA <= checkB)) Test::fail(__FILE__, __LINE__, Test::describe(#a " <= " #b, checkA, checkB));         \
+    } while (0)
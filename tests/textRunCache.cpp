@@ -0,0 +1,99 @@
+// Checks the text run cache: runs are found again by string and size, the least recently drawn is dropped once it's
+// full, and runs laid out before the glyph atlas emptied a page are never handed out.
+
+#include "test.hpp"
+#include <textRunCache.hpp>
+
+namespace {
+
+TextRun run(int page, uint64_t atlasEvictions = 0) {
+    TextRun run;
+    run.quads.push_back({0, 0, 8, 10, 0, 0, 0.125f, 0.25f, page});
+    run.pages.push_back(page);
+    run.atlasEvictions = atlasEvictions;
+    return run;
+}
+
+void hits() {
+    TextRunCache cache(4);
+    CHECK(cache.find("hello", 16, 0) == nullptr);
+
+    const TextRun &stored = cache.insert("hello", 16, run(1));
+    CHECK_EQ(stored.pages.size(), 1u);
+    CHECK_EQ(cache.size(), 1u);
+
+    // the same string at the same size comes back as it was stored
+    const TextRun *found = cache.find("hello", 16, 0);
+    CHECK(found == &stored);
+    if (found) CHECK(found->quads.size() == 1 && found->quads[0].page == 1 && found->quads[0].x1 == 8);
+
+    // another size or string is another run
+    CHECK(cache.find("hello", 17, 0) == nullptr);
+    CHECK(cache.find("hell", 16, 0) == nullptr);
+    CHECK(cache.find("", 16, 0) == nullptr);
+
+    // storing the same key again replaces the run
+    cache.insert("hello", 16, run(2));
+    CHECK_EQ(cache.size(), 1u);
+    found = cache.find("hello", 16, 0);
+    CHECK(found != nullptr && found->pages[0] == 2);
+
+    cache.clear();
+    CHECK_EQ(cache.size(), 0u);
+    CHECK(cache.find("hello", 16, 0) == nullptr);
+}
+
+void eviction() {
+    TextRunCache cache(3);
+    cache.insert("a", 16, run(0));
+    cache.insert("b", 16, run(0));
+    cache.insert("c", 16, run(0));
+
+    // drawing "a" again makes "b" the least recently used, so it goes first
+    CHECK(cache.find("a", 16, 0) != nullptr);
+    cache.insert("d", 16, run(0));
+    CHECK_EQ(cache.size(), 3u);
+    CHECK(cache.find("b", 16, 0) == nullptr);
+    CHECK(cache.find("c", 16, 0) != nullptr);
+    CHECK(cache.find("a", 16, 0) != nullptr);
+    CHECK(cache.find("d", 16, 0) != nullptr);
+
+    // "c" is now the oldest
+    cache.insert("e", 16, run(0));
+    CHECK(cache.find("c", 16, 0) == nullptr);
+    CHECK_EQ(cache.size(), 3u);
+
+    // a cache always keeps at least the run just stored
+    TextRunCache tiny(0);
+    CHECK_EQ(tiny.getCapacity(), 1u);
+    tiny.insert("x", 16, run(0));
+    tiny.insert("y", 16, run(0));
+    CHECK_EQ(tiny.size(), 1u);
+    CHECK(tiny.find("y", 16, 0) != nullptr);
+}
+
+void staleAtlas() {
+    TextRunCache cache(4);
+    cache.insert("hello", 16, run(0, 3));
+    cache.insert("world", 16, run(1, 3));
+
+    // once the atlas has emptied a page, the run's glyphs may be gone, and it's dropped rather than drawn
+    CHECK(cache.find("hello", 16, 4) == nullptr);
+    CHECK_EQ(cache.size(), 1u);
+    CHECK(cache.find("hello", 16, 3) == nullptr);
+
+    // a run laid out again afterwards is good until the next eviction
+    cache.insert("hello", 16, run(0, 4));
+    CHECK(cache.find("hello", 16, 4) != nullptr);
+    CHECK(cache.find("world", 16, 4) == nullptr);
+    CHECK_EQ(cache.size(), 1u);
+}
+
+} // namespace
+
+int main() {
+    hits();
+    eviction();
+    staleAtlas();
+    return Test::result();
+}